@@ -48,6 +48,7 @@
  *  [] Each driver structure contains a rwlock write-locked when/if it is restarted.
  *  [] Each message contains a mutex to guard its usage count.
  *  [] The log file is marshalled by a mutex.
+ *  [] Restart requests from the supervisor (-s) are guarded by a mutex.
  *
  */
 
@@ -87,6 +88,7 @@
 #define	RDRTIME		2		/* remote driver retry delay, secs */
 #define EXITEXFAIL	98		/* driver execlp failed */
 #define	RESTARTDT	10		/* don't restart a driver sooner than this, seconds */
+#define	SUPWAITDT	60		/* restart anyway if the supervisor has not asked by now, seconds */
 static char lockout_fn[] = "/tmp/noindi";	/* do not restart local driver if this exists */
 
 /* associate a usage count with a single message queued to potentially multiple
@@ -162,6 +164,7 @@ typedef struct {
     pthread_t stderr_thr;		/* stderr reader thread */
     time_t start;			/* time this driver was started */
     int restarts;			/* n times this process has been restarted */
+    int startreq;			/* pid the supervisor asked us to replace -- guard with sup_lock */
     LilXML *lp;				/* XML parsing context */
     Msg *mp;				/* new incoming message */
     FQ *msgq;				/* outbound Msg queue  -- guard with q_lock */
@@ -182,6 +185,9 @@ static char *ldir;			/* log directory f -l */
 static pthread_mutex_t log_lock;	/* lock when writing to our error log */
 static int maxqsiz = (DEFMAXQSIZ*1024*1024); /* kill if these many bytes behind */
 static int ignore_lockout;              /* whether to honor lockout_fn */
+static char *supfifo;			/* if set, local drivers are restarted when asked here */
+static pthread_mutex_t sup_lock;	/* guard startreq of each driver */
+static pthread_cond_t sup_cond;		/* tell drivers waiting in startDvr of a new startreq */
 
 /* local prototypes */
 static void logDrivers (int ac, char *av[]);
@@ -195,6 +201,8 @@ static void shutdownClient (ClInfo *cp);
 static void initDvr (DvrInfo *dp, char *name);
 static void startDvr (DvrInfo *dp);
 static void *startDvrThread (void *dp);
+static void startSupervisor (void);
+static void *supervisorReaderThread (void *unused);
 static void startLocalDvr (DvrInfo *dp);
 static void startRemoteDvr (DvrInfo *dp);
 static int openRemoteConnection (char host[], int port);
@@ -263,6 +271,14 @@ main (int ac, char *av[])
                 case 'n':
                     ignore_lockout++;
                     break;
+		case 's':
+		    if (ac < 2) {
+			fprintf (stderr, "-s requires supervisor fifo\n");
+			usage();
+		    }
+		    supfifo = *++av;
+		    ac--;
+		    break;
 		case 'p':
 		    if (ac < 2) {
 			fprintf (stderr, "-p requires port value\n");
@@ -314,6 +330,10 @@ main (int ac, char *av[])
 	while (ac-- > 0)
 	    initDvr (&dvrinfo[ac], *av++);
 
+	/* listen for restart requests once all drivers are known */
+	if (supfifo)
+	    startSupervisor();
+
 	/* handle new clients forever */
 	while (1)
 	    newClient();
@@ -348,6 +368,8 @@ usage(void)
 	fprintf (stderr," -m m  : kill client if gets more than this many MB behind, default %d\n", DEFMAXQSIZ);
 	fprintf (stderr," -n    : ignore %s\n", lockout_fn);
 	fprintf (stderr," -p p  : alternate IP port, default %d\n", INDIPORT);
+	fprintf (stderr," -s f  : restart local drivers when \"start <driver> <pid>\" is read from fifo f,\n");
+	fprintf (stderr,"         or after %d secs, instead of after %d secs\n", SUPWAITDT, RESTARTDT);
 	fprintf (stderr," -v    : show key events, no traffic\n");
 	fprintf (stderr," -vv   : -v + key message content\n");
 	fprintf (stderr," -vvv  : -vv + complete xml\n");
@@ -431,7 +453,26 @@ startDvr (DvrInfo *dp)
 	time_t now = time(NULL);
 	long age = now - dp->start;
 
-	if (age < RESTARTDT) {
+	if (supfifo && dp->start != 0 && !strchr (dp->name, '@')) {
+	    /* the supervisor decides when, it saw the old pid exit */
+	    struct timespec until;
+
+	    clock_gettime (CLOCK_REALTIME, &until);
+	    until.tv_sec += SUPWAITDT;
+
+	    if (verbose > 0)
+		logMessage ("Driver %s: waiting for supervisor to restart\n", dp->name);
+
+	    pthread_mutex_lock (&sup_lock);
+	    while (dp->startreq != dp->pid)
+		if (pthread_cond_timedwait (&sup_cond, &sup_lock, &until) == ETIMEDOUT) {
+		    logMessage ("Driver %s: no word from supervisor in %d secs, restarting\n",
+		    	dp->name, SUPWAITDT);
+		    break;
+		}
+	    dp->startreq = 0;
+	    pthread_mutex_unlock (&sup_lock);
+	} else if (age < RESTARTDT) {
 	    unsigned int sdt = RESTARTDT - age;
 	    logMessage ("Driver %s: delaying restart by %d secs, min restart interval is %d secs\n",
 	    	dp->name, sdt, RESTARTDT);
@@ -445,6 +486,79 @@ startDvr (DvrInfo *dp)
 	    startLocalDvr (dp);
 }
 
+/* prepare the supervisor lock and start the thread reading its restart requests.
+ * exit if trouble.
+ */
+static void
+startSupervisor (void)
+{
+	pthread_attr_t attr;
+	pthread_t thr;
+
+	pthread_mutex_init (&sup_lock, NULL);
+	pthread_cond_init (&sup_cond, NULL);
+
+	if (pthread_attr_init (&attr))
+	    Bye ("Supervisor attr init: %s\n", strerror(errno));
+	if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
+	    Bye ("Supervisor setdetacthed: %s\n", strerror(errno));
+	if (pthread_create (&thr, &attr, supervisorReaderThread, NULL))
+	    Bye ("Supervisor thread: %s\n", strerror(errno));
+	pthread_attr_destroy (&attr);
+}
+
+/* read "start <driver> <pid>" lines from supfifo, each asking that the given
+ *   local driver, which was running as pid, be restarted now.
+ * requests for a pid we have already replaced, e.g. from before we were
+ *   restarted, are ignored.
+ * N.B. we open supfifo for writing too so we never see EOF.
+ */
+static void *
+supervisorReaderThread (void *unused)
+{
+	char line[2048];
+	FILE *fp;
+	int fd;
+
+	(void) unused;
+
+	fd = open (supfifo, O_RDWR);
+	if (fd < 0)
+	    Bye ("Supervisor fifo %s: %s\n", supfifo, strerror(errno));
+	fp = fdopen (fd, "r");
+	if (!fp)
+	    Bye ("Supervisor fifo %s: %s\n", supfifo, strerror(errno));
+
+	while (fgets (line, sizeof(line), fp)) {
+	    char name[1024];
+	    int i, pid;
+
+	    if (sscanf (line, "start %1023s %d", name, &pid) != 2) {
+		logMessage ("Supervisor: bad request: %s", line);
+		continue;
+	    }
+
+	    for (i = 0; i < ndvrinfo; i++)
+		if (!strcmp (dvrinfo[i].name, name))
+		    break;
+	    if (i == ndvrinfo) {
+		logMessage ("Supervisor: no driver %s\n", name);
+		continue;
+	    }
+
+	    if (verbose > 0)
+		logMessage ("Driver %s: supervisor asks to replace pid %d\n", name, pid);
+
+	    pthread_mutex_lock (&sup_lock);
+	    dvrinfo[i].startreq = pid;
+	    pthread_cond_broadcast (&sup_cond);
+	    pthread_mutex_unlock (&sup_lock);
+	}
+
+	Bye ("Supervisor fifo %s: %s\n", supfifo, strerror(errno));
+	return (NULL);
+}
+
 /* start the given local INDI driver process.
  * exit if trouble.
  * N.B. we assume restart_lock is already write-locked.
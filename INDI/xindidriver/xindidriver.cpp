@@ -1,6 +1,7 @@
 
 #include <iostream>
 #include <string>
+#include <cstdlib>
 #include <cstring>
 
 #include <fcntl.h>
@@ -23,6 +24,11 @@
 std::string myName;
 bool timeToDie;
 
+/// If true, the FIFOs are held open by a supervisor (xindiserver) so we can start without waiting.
+/** Set by the XINDID_FASTSTART environment variable, which is inherited from xindiserver through indiserver.
+  */
+bool fastStart {false};
+
 #ifdef DEBUG
 #include <fstream>
 std::ofstream debug;
@@ -67,9 +73,9 @@ int flushFIFO(const std::string & fileName)
    FD_ZERO( &fdsRead );
    FD_SET( fd, &fdsRead );
 
-   // Set the timeout on the select call.
+   // Set the timeout on the select call.  On a fast start just take what is already there.
    timeval tv;
-   tv.tv_sec = 1;
+   tv.tv_sec = fastStart ? 0 : 1;
    tv.tv_usec = 0;
 
    #ifdef DEBUG
@@ -415,14 +421,20 @@ int main( int argc, char **argv)
    debug.open("/tmp/" + myName + ".dbg");
    #endif
    
+   fastStart = (getenv("XINDID_FASTSTART") != nullptr);
+
    //Now that myName is known, install signal handler
    if( setSigTermHandler() < 0) return -1;
 
    //setSigIOHandler();
    
-   std::string stdinFifo = std::string(XINDID_FIFODIR) + "/" + myName + ".in";
-   std::string stdoutFifo = std::string(XINDID_FIFODIR) + "/" + myName + ".out";
-   std::string ctrlFifo = std::string(XINDID_FIFODIR) + "/" + myName + ".ctrl";
+   //The XINDID_FIFODIR environment variable overrides the compiled-in directory, e.g. for testing
+   std::string fifoDir = XINDID_FIFODIR;
+   if(getenv("XINDID_FIFODIR") != nullptr) fifoDir = getenv("XINDID_FIFODIR");
+
+   std::string stdinFifo = fifoDir + "/" + myName + ".in";
+   std::string stdoutFifo = fifoDir + "/" + myName + ".out";
+   std::string ctrlFifo = fifoDir + "/" + myName + ".ctrl";
 
    #ifdef DEBUG
    debug << __FILE__ << " " << __LINE__ << std::endl;
@@ -454,7 +466,7 @@ int main( int argc, char **argv)
 
    driverFIFO dfCtrl (ctrlFifo, 0);
    
-   sleep(2); //This gives indiserver time to startup so it can handle any thing that comes from the fifos.
+   if(!fastStart) sleep(2); //This gives indiserver time to startup so it can handle any thing that comes from the fifos.
 
    //Launch the read/write threads, one each for STDIN and STDOUT and for control.
    pthread_t stdIn_th = 0;
@@ -164,6 +164,8 @@ protected:
    
    int * m_actuator_mapping {nullptr}; ///< Array containing the mapping from 2D grid position to linear index in the command vector
    
+   dev::dmCommandPlan m_cmdPlan; ///< The index plan built from m_actuator_mapping, used by commandDM
+   
    Scalar * m_dminputs {nullptr}; ///< Pre-allocated command vector, used only in commandDM
    
    asdkDM * m_dm {nullptr}; ///< ALPAO SDK handle for the DM.
@@ -364,6 +366,11 @@ int alpaoCtrl::initDM()
       return log<software_error, -1>({__FILE__, __LINE__, "DM initialization failed.  null pointer."});
    }
    
+   if(m_cmdPlan.build(m_actuator_mapping, m_nbAct) < 0)
+   {
+      return log<software_error, -1>({__FILE__, __LINE__, "DM initialization failed.  Invalid actuator mapping."});
+   }
+   
    state(stateCodes::OPERATING);
    
    return 0;
@@ -408,55 +415,20 @@ int alpaoCtrl::commandDM(void * curr_src)
 
    //This is based on Kyle Van Gorkoms original sendCommand function.
    
-   /*This loop performs the following steps:
+   /*This performs the following steps:
      1) converts from float to double (ALPAO Scalar)
      2) convert to volume-normalized displacement (microns)
      3) convert to fractional stroke (-1 to +1) that the ALPAO SDK expects
-     4) calculate the mean
-   */
-   Scalar mean = 0;
-   for (UInt idx = 0; idx < m_nbAct; ++idx)
-   {
-     m_dminputs[idx] = ((Scalar)  ((realT *) curr_src)[m_actuator_mapping[idx]]) * m_volume_factor/m_max_stroke;
-     mean += m_dminputs[idx];
-   }
-   mean /= m_nbAct;
-
-   /*This loop performas the following steps:
-      1) remove mean from each actuator input
-      2) clip to fractional values between -1 and 1.
-         The ALPAO SDK doesn't seem to check for this, which
-         is scary and a little odd.
+     4) remove the mean from each actuator input
+     5) clip to fractional values between -1 and 1.
+        The ALPAO SDK doesn't seem to check for this, which
+        is scary and a little odd.
+     6) update the instantaneous sat map
    */
-   for (UInt idx = 0 ; idx < m_nbAct ; ++idx)
-   {
-      m_dminputs[idx] -= mean;
-      if (m_dminputs[idx] > 1)
-      {
-         ++m_nsat;
-         m_dminputs[idx] = 1;
-      } else if (m_dminputs[idx] < -1)
-      {
-         ++m_nsat;
-         m_dminputs[idx] = - 1;
-      }
-   }
+   m_nsat += dev::dmCommandMeanClip(m_dminputs, (realT *) curr_src, m_cmdPlan, m_volume_factor/m_max_stroke, m_instSatMap.data());
     
    /* Finally, send the command to the DM */
    ret = asdkSend(m_dm, m_dminputs);
-
-   /* Now update the instantaneous sat map */
-   for (UInt idx = 0; idx < m_nbAct; ++idx)
-   {
-      if(m_dminputs[idx] >= 1 || m_dminputs[idx] <= -1)
-      {
-         m_instSatMap.data()[m_actuator_mapping[idx]] = 1;
-      }
-      else
-      {
-         m_instSatMap.data()[m_actuator_mapping[idx]] = 0;
-      }
-   }
    
    return ret;
     
@@ -178,6 +178,8 @@ protected:
    
    int * m_actuator_mapping {nullptr}; ///< Array containing the mapping from 2D grid position to linear index in the command vector
    
+   dev::dmCommandPlan m_cmdPlan; ///< The index plan built from m_actuator_mapping, used by commandDM
+   
    double * m_dminputs {nullptr}; ///< Pre-allocated command vector, used only in commandDM
    
    DM m_dm = {}; ///< BMC SDK handle for the DM.
@@ -391,6 +393,12 @@ int bmcCtrl::initDM()
       return -1;
    }
    
+   if(m_cmdPlan.build(m_actuator_mapping, m_nbAct) < 0)
+   {
+      log<text_log>("DM initialization failed.  Invalid actuator mapping.", logPrio::LOG_ERROR);
+      return -1;
+   }
+   
    state(stateCodes::OPERATING);
    
    return 0;
@@ -434,52 +442,14 @@ int bmcCtrl::commandDM(void * curr_src)
 {
    //This is based on Kyle Van Gorkoms original sendCommand function.
    
-   /*This loop performs the following steps:
+   /*In one pass over the mapped actuators this:
      1) converts from float to double
      2) convert to volume-normalized displacement
-     3) convert to squared fractional voltage (0 to +1)
-     4) calculate the mean
+     3) clips to fractional values between 0 and 1.
+     4) takes the square root to approximate the voltage-displacement curve
+     5) updates the instantaneous sat map
    */
-
-
-   // want to rework the logic here so that we don't have to check
-   // if every actuator is addressable.
-   // Loop over addressable only?
-   //double mean = 0;
-   for (uint32_t idx = 0; idx < m_nbAct; ++idx)
-   {
-     int address = m_actuator_mapping[idx];
-     if(address == -1)
-     {
-        m_dminputs[idx] = 0.; // addressable but ignored actuators set to 0
-     } 
-     else 
-     {
-        m_dminputs[idx] = ((double)  ((realT *) curr_src)[address]) * m_volume_factor/m_act_gain;
-        //mean += m_dminputs[idx];
-     }
-   }
-   //mean /= m_nbAct;
-
-   /*This loop performas the following steps:
-      1) remove mean from each actuator input (and add midpoint bias)
-      2) clip to fractional values between 0 and 1.
-      3) take the square root to approximate the voltage-displacement curve
-   */
-   for (uint32_t idx = 0 ; idx < m_nbAct ; ++idx)
-   {
-      //m_dminputs[idx] -= mean - 0.5;
-      if (m_dminputs[idx] > 1)
-      {
-         ++m_nsat;
-         m_dminputs[idx] = 1;
-      } else if (m_dminputs[idx] < 0)
-      {
-         ++m_nsat;
-         m_dminputs[idx] = 0;
-      }
-      m_dminputs[idx] = sqrt(m_dminputs[idx]);
-   }
+   m_nsat += dev::dmCommandSqrt(m_dminputs, (realT *) curr_src, m_cmdPlan, m_volume_factor/m_act_gain, m_instSatMap.data());
 
    /* Finally, send the command to the DM */
    BMCRC ret = BMCSetArray(&m_dm, m_dminputs, NULL);
@@ -493,22 +463,6 @@ int bmcCtrl::commandDM(void * curr_src)
       log<text_log>(std::string("DM command failed: ") + err, logPrio::LOG_ERROR);
       return -1;
    }
-
-   /* Now update the instantaneous sat map */
-   for (uint32_t idx = 0; idx < m_nbAct; ++idx)
-   {
-      int address = m_actuator_mapping[idx];
-      if(address == -1) continue;
-     
-      if(m_dminputs[idx] >= 1 || m_dminputs[idx] <= 0)
-      {
-         m_instSatMap.data()[address] = 1;
-      }
-      else
-      {
-         m_instSatMap.data()[address] = 0;
-      }
-   }
    
    return ret;
 }
@@ -18,6 +18,8 @@
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#include "simFrameBank.hpp"
+
 namespace MagAOX
 {
 namespace app
@@ -37,6 +39,12 @@ namespace app
   */
 
 /** MagAO-X application to simulate a camera
+  *
+  * Frames are pre-rendered into a bank in memory when acquisition is configured, and played back in a loop
+  * paced by absolute deadlines with `clock_nanosleep`, so the simulator can run at kHz rates as a load generator
+  * for the stream pipeline.  The scene can be random pixels, pyramid WFS pupils, or a PSF with speckle, with
+  * photon, EMCCD and read noise.  See simFrameBank.  The achieved frame rate and the pacing jitter are reported
+  * in the sim_pacing INDI property.
   *
   * \ingroup cameraSim
   * 
@@ -86,10 +94,42 @@ public:
    
 protected:
 
-   mx::improc::eigenImage<int16_t> m_fgimage;
+   /** \name Configurable Parameters
+     * @{
+     */
+
+   simFrameParams m_simParams; ///< The parameters of the simulated frames.  The size is set from the ROI, and the EM gain from the current EM gain.
+
+   ///@}
+
+   simFrameBank m_bank; ///< The pre-rendered frames
+
+   uint32_t m_bankIdx {0}; ///< The next frame in the bank to play back
+
+   /** \name Pacing
+     * @{
+     */
+
+   timespec m_nextFrame {0,0}; ///< The absolute CLOCK_MONOTONIC deadline of the next frame
+
+   int64_t m_framePeriod {0}; ///< The frame period in ns
+
+   std::atomic<uint64_t> m_nPaced {0}; ///< The number of frames delivered
+
+   std::atomic<uint64_t> m_nMissed {0}; ///< The number of deadlines missed by more than a frame, which are skipped rather than caught up.
+
+   utils::latencyHistogram m_paceHist; ///< Histogram of the time past the deadline at which each frame is delivered.
 
-   double m_lastTime {0};
-   double m_offset = {0};
+   uint64_t m_lastPaced {0}; ///< m_nPaced at the last pacing update
+
+   double m_lastPaceTime {0}; ///< The time of the last pacing update
+
+   pcf::IndiProperty m_indiP_pacing; ///< Property used to report the achieved frame rate and pacing jitter
+
+   /// Update the pacing property.  Called from appLogic with the INDI mutex locked.
+   void updatePacing();
+
+   ///@}
 
 public:
 
@@ -247,6 +287,21 @@ void cameraSim::setupConfig()
       
    dev::telemeter<cameraSim>::setupConfig(config);
    
+   config.add("sim.scene", "", "sim.scene", argType::Required, "sim", "scene", false, "string", "The scene to simulate: random, pupils (pyramid WFS pupils), or psf (a PSF with speckle).  Default is random.");
+   config.add("sim.bankSize", "", "sim.bankSize", argType::Required, "sim", "bankSize", false, "int", "The number of frames to pre-render and play back in a loop.  Default is 50.");
+   config.add("sim.flux", "", "sim.flux", argType::Required, "sim", "flux", false, "real", "The mean number of photo-electrons per frame from the source.  Default is 1e6.");
+   config.add("sim.background", "", "sim.background", argType::Required, "sim", "background", false, "real", "The mean number of photo-electrons per pixel per frame from sky and dark current.  Default is 0.");
+   config.add("sim.ttAmp", "", "sim.ttAmp", argType::Required, "sim", "ttAmp", false, "real", "The tip/tilt modulation amplitude.  Pixels for psf, fraction of the saturating slope for pupils.  Default is 0.2.");
+   config.add("sim.ttCycles", "", "sim.ttCycles", argType::Required, "sim", "ttCycles", false, "int", "The number of tip/tilt modulation cycles in the bank.  Default is 1.");
+   config.add("sim.ttJitter", "", "sim.ttJitter", argType::Required, "sim", "ttJitter", false, "real", "The rms random tip/tilt added to each frame, in the units of ttAmp.  Default is 0.02.");
+   config.add("sim.pupilRadius", "", "sim.pupilRadius", argType::Required, "sim", "pupilRadius", false, "real", "The pupil radius in pixels for pupils.  Default is 0.2 times the smaller frame dimension.");
+   config.add("sim.aberration", "", "sim.aberration", argType::Required, "sim", "aberration", false, "real", "The static defocus slope across each pupil for pupils, as a fraction of the saturating slope.  Default is 0.3.");
+   config.add("sim.psfFWHM", "", "sim.psfFWHM", argType::Required, "sim", "psfFWHM", false, "real", "The FWHM of the PSF core and the speckle size in pixels for psf.  Default is 3.");
+   config.add("sim.speckleFrac", "", "sim.speckleFrac", argType::Required, "sim", "speckleFrac", false, "real", "The fraction of the flux in the speckle halo for psf.  Default is 0.05.");
+   config.add("sim.readNoise", "", "sim.readNoise", argType::Required, "sim", "readNoise", false, "real", "The rms read noise in electrons.  Default is 1.");
+   config.add("sim.gain", "", "sim.gain", argType::Required, "sim", "gain", false, "real", "The detector gain in electrons per ADU.  Default is 1.");
+   config.add("sim.bias", "", "sim.bias", argType::Required, "sim", "bias", false, "real", "The bias level in ADU.  Default is 100.");
+   config.add("sim.seed", "", "sim.seed", argType::Required, "sim", "seed", false, "int", "The random number seed.  Default is 1, so runs are reproducible.");
 }
 
 inline
@@ -257,6 +312,22 @@ void cameraSim::loadConfig()
    dev::frameGrabber<cameraSim>::loadConfig(config);
    
    dev::telemeter<cameraSim>::loadConfig(config);
+
+   config(m_simParams.scene, "sim.scene");
+   config(m_simParams.nFrames, "sim.bankSize");
+   config(m_simParams.flux, "sim.flux");
+   config(m_simParams.background, "sim.background");
+   config(m_simParams.ttAmp, "sim.ttAmp");
+   config(m_simParams.ttCycles, "sim.ttCycles");
+   config(m_simParams.ttJitter, "sim.ttJitter");
+   config(m_simParams.pupilRadius, "sim.pupilRadius");
+   config(m_simParams.aberration, "sim.aberration");
+   config(m_simParams.psfFWHM, "sim.psfFWHM");
+   config(m_simParams.speckleFrac, "sim.speckleFrac");
+   config(m_simParams.readNoise, "sim.readNoise");
+   config(m_simParams.gain, "sim.gain");
+   config(m_simParams.bias, "sim.bias");
+   config(m_simParams.seed, "sim.seed");
 }
    
 
@@ -299,6 +370,18 @@ int cameraSim::appStartup()
       return log<software_error,-1>({__FILE__,__LINE__});
    }
 
+   createROIndiNumber( m_indiP_pacing, "sim_pacing", "Simulator Pacing");
+   m_indiP_pacing.add(pcf::IndiElement("fps"));
+   m_indiP_pacing.add(pcf::IndiElement("late_p50"));
+   m_indiP_pacing.add(pcf::IndiElement("late_p99"));
+   m_indiP_pacing.add(pcf::IndiElement("late_max"));
+   m_indiP_pacing.add(pcf::IndiElement("missed"));
+
+   if( registerIndiPropertyReadOnly( m_indiP_pacing ) < 0)
+   {
+      return log<software_critical,-1>({__FILE__,__LINE__});
+   }
+
    m_currentROI.x = 511.5;
    m_currentROI.y = 511.5;
    m_currentROI.w = 1024;
@@ -314,9 +397,6 @@ int cameraSim::appStartup()
    m_expTime = 1.0/m_fps;
    m_expTimeSet = m_expTime;
 
-   m_lastTime = mx::sys::get_curr_time();
-   m_offset = 0;
-
    state(stateCodes::OPERATING);
    
    return 0;
@@ -338,8 +418,6 @@ int cameraSim::appLogic()
       return log<software_error, -1>({__FILE__, __LINE__});
    }
    
-   std::cerr << m_offset << "\n";
-
    if( state() == stateCodes::READY || state() == stateCodes::OPERATING )
    {
       //Get a lock if we can
@@ -367,6 +445,8 @@ int cameraSim::appLogic()
          log<software_error>({__FILE__, __LINE__});
          return 0;
       }
+
+      updatePacing();
    }
 
    ///\todo Fall through check?
@@ -406,8 +486,6 @@ int cameraSim::configureAcquisition()
       m_xbinning = m_currentROI.bin_x;
       m_ybinning = m_currentROI.bin_y;
 
-      m_fgimage.resize(m_width, m_height);
-
       m_dataType = IMAGESTRUCT_UINT16;
       m_typeSize = imageStructDataType<IMAGESTRUCT_UINT16>::size;
             
@@ -420,15 +498,43 @@ int cameraSim::configureAcquisition()
       state(stateCodes::NOTCONNECTED);
       return -1;
    }
+
+   //Now render the frames to play back
+   m_simParams.width = m_width;
+   m_simParams.height = m_height;
+   m_simParams.emGain = m_emGain;
+
+   double t0 = mx::sys::get_curr_time();
+
+   try
+   {
+      if(m_bank.render(m_simParams) < 0)
+      {
+         log<software_error>({__FILE__, __LINE__, "invalid simulation scene: " + m_simParams.scene});
+         state(stateCodes::NOTCONNECTED);
+         return -1;
+      }
+   }
+   catch(const std::bad_alloc &)
+   {
+      log<software_error>({__FILE__, __LINE__, "could not allocate frame bank"});
+      state(stateCodes::NOTCONNECTED);
+      return -1;
+   }
+
+   log<text_log>("rendered " + std::to_string(m_bank.nFrames()) + " " + m_simParams.scene + " frames in " 
+                    + std::to_string(mx::sys::get_curr_time() - t0) + " sec");
+
+   m_bankIdx = 0;
    
    return 0;
 }
 
 int cameraSim::startAcquisition()
 {    
-   
-   m_offset = 0;
-   m_lastTime = mx::sys::get_curr_time();
+   m_framePeriod = (m_fps > 0) ? 1e9/m_fps : 1e9;
+
+   clock_gettime(CLOCK_MONOTONIC, &m_nextFrame);
 
    state(stateCodes::OPERATING);
     
@@ -439,20 +545,32 @@ int cameraSim::startAcquisition()
 
 int cameraSim::acquireAndCheckValid()
 {
-   double et = mx::sys::get_curr_time() - m_lastTime;
-   while(et <= m_expTime - m_offset)
+   //The deadlines are absolute, so time spent outside of this function does not accumulate as drift.
+   m_nextFrame.tv_nsec += m_framePeriod;
+   while(m_nextFrame.tv_nsec >= 1000000000)
    {
-      mx::sys::nanoSleep(et*1e6);
-      et = mx::sys::get_curr_time() - m_lastTime;
+      m_nextFrame.tv_nsec -= 1000000000;
+      ++m_nextFrame.tv_sec;
    }
 
-   double dt = mx::sys::get_curr_time(m_currImageTimestamp);
-   
-   m_offset += 0.1*((dt - m_lastTime) - m_expTime);
+   timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
 
-   m_lastTime = dt;
+   //If we have fallen more than a frame behind, skip ahead rather than delivering a burst to catch up.
+   if( (now.tv_sec - m_nextFrame.tv_sec)*1000000000LL + (now.tv_nsec - m_nextFrame.tv_nsec) > m_framePeriod)
+   {
+      m_nextFrame = now;
+      ++m_nMissed;
+   }
+
+   while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &m_nextFrame, nullptr) == EINTR);
+
+   clock_gettime(CLOCK_REALTIME, &m_currImageTimestamp);
 
-   m_fgimage.setRandom();
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   m_paceHist.record(now, m_nextFrame);
+
+   ++m_nPaced;
 
    return 0;
 }
@@ -460,9 +578,10 @@ int cameraSim::acquireAndCheckValid()
 
 int cameraSim::loadImageIntoStream(void * dest)
 {
+   if( frameGrabber<cameraSim>::loadImageIntoStreamCopy(dest, const_cast<uint16_t *>(m_bank.frame(m_bankIdx)), m_width, m_height, sizeof(uint16_t)) == nullptr) return -1;
+
+   if(++m_bankIdx >= m_bank.nFrames()) m_bankIdx = 0;
 
-   if( frameGrabber<cameraSim>::loadImageIntoStreamCopy(dest, m_fgimage.data(), m_width, m_height, sizeof(uint16_t)) == nullptr) return -1;
-   m_imageStream->md->atime = m_imageStream->md->writetime;
    return 0;
 }
 
@@ -526,7 +645,7 @@ int cameraSim::setExpTime()
 {
 
    m_expTime = m_expTimeSet;
-   m_fps = 1./m_fps;
+   m_fps = 1./m_expTime;
    m_fpsSet = m_fps;
 
    
@@ -565,6 +684,10 @@ inline
 int cameraSim::setEMGain()
 {
     m_emGain = m_emGainSet;
+
+    //The bank is re-rendered with the new EM gain
+    m_reconfig = true;
+
     return 0;
 }
 
@@ -621,6 +744,25 @@ bool cameraSim::stateStringValid()
     return true;
 }
 
+inline
+void cameraSim::updatePacing()
+{
+   double t = mx::sys::get_curr_time();
+   uint64_t nPaced = m_nPaced;
+
+   double fps = 0;
+   if(m_lastPaceTime > 0 && t > m_lastPaceTime) fps = (nPaced - m_lastPaced)/(t - m_lastPaceTime);
+
+   m_lastPaced = nPaced;
+   m_lastPaceTime = t;
+
+   utils::latencyStats st;
+   m_paceHist.stats(st, true);
+
+   updateIfChanged(m_indiP_pacing, std::vector<std::string>({"fps", "late_p50", "late_p99", "late_max", "missed"}), 
+                        std::vector<double>({fps, st.p50, st.p99, st.max, static_cast<double>(m_nMissed)}));
+}
+
 inline
 int cameraSim::checkRecordTimes()
 {
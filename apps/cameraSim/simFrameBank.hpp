@@ -0,0 +1,418 @@
+/** \file simFrameBank.hpp
+  * \brief A bank of pre-rendered, physically modeled frames for the camera simulator.
+  *
+  * \ingroup cameraSim_files
+  */
+
+#ifndef simFrameBank_hpp
+#define simFrameBank_hpp
+
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <complex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace MagAOX
+{
+namespace app
+{
+
+/// Parameters of the frames rendered by simFrameBank
+/** \ingroup cameraSim
+  */
+struct simFrameParams
+{
+   std::string scene {"random"}; ///< The scene: "random" (uniform random pixels), "pupils" (pyramid WFS pupils), or "psf" (a PSF with speckle).
+
+   uint32_t width {0};  ///< The width of the frames in pixels.
+   uint32_t height {0}; ///< The height of the frames in pixels.
+
+   uint32_t nFrames {50}; ///< The number of frames in the bank.
+
+   double flux {1e6}; ///< The mean number of photo-electrons per frame from the source.
+   double background {0}; ///< The mean number of photo-electrons per pixel per frame from sky and dark current.
+
+   double ttAmp {0.2}; ///< The amplitude of the tip/tilt modulation.  In pixels for "psf", in units of the saturating pyramid slope for "pupils".
+   uint32_t ttCycles {1}; ///< The number of tip/tilt modulation cycles in the bank.  An integer, so that the bank loops seamlessly.
+   double ttJitter {0.02}; ///< The rms of random tip/tilt added to each frame, in the same units as ttAmp.
+
+   double pupilRadius {0}; ///< The radius of the pupils for "pupils", in pixels.  If 0, 0.2 times the smaller frame dimension is used.
+   double aberration {0.3}; ///< The slope of the static defocus across each pupil for "pupils", in units of the saturating pyramid slope.
+
+   double psfFWHM {3}; ///< The FWHM of the PSF core, and the size of the speckles, for "psf", in pixels.
+   double speckleFrac {0.05}; ///< The fraction of the flux in the speckle halo for "psf".
+
+   double readNoise {1}; ///< The rms read noise in electrons.
+   double emGain {1}; ///< The EMCCD gain.  Values above 1 turn on the EM register model.
+   double gain {1}; ///< The detector gain, in electrons per ADU.
+   double bias {100}; ///< The bias level in ADU.
+
+   uint64_t seed {1}; ///< The random number seed, so that the bank is reproducible.
+};
+
+/// A bank of pre-rendered simulated frames, for high-rate playback.
+/** Rendering is done once, up front, so that playing back a frame is only a copy.  The "pupils" scene is a set of
+  * four pyramid WFS pupils with a tip/tilt modulated across the bank plus a static aberration, suitable for slope
+  * calculation.  The "psf" scene is a Gaussian core with tip/tilt plus a speckle halo which decorrelates across the
+  * bank, suitable for PSF fitting and photon counting.  The photo-electrons of each pixel are Poisson distributed,
+  * amplified by a gamma-distributed EM register if the EM gain is above 1, and then read noise and bias are added.
+  *
+  * The tip/tilt is modulated with an integer number of cycles, and the speckles rotate through a full period, across
+  * the bank, so that looping the bank is seamless apart from the noise.
+  *
+  * \ingroup cameraSim
+  */
+class simFrameBank
+{
+protected:
+   uint32_t m_width {0}; ///< The width of the frames
+   uint32_t m_height {0}; ///< The height of the frames
+   uint32_t m_nFrames {0}; ///< The number of frames
+
+   std::vector<uint16_t> m_frames; ///< The frames, contiguous in memory.
+
+   std::mt19937_64 m_gen; ///< The random number generator
+
+   /// Render the expected photo-electrons of a "pupils" frame.
+   void renderPupils( std::vector<float> & ideal,    ///< [out] the expected photo-electrons in each pixel
+                      const simFrameParams & params, ///< [in] the parameters
+                      double tx,                     ///< [in] the tip slope
+                      double ty                      ///< [in] the tilt slope
+                    );
+
+   /// Render the expected photo-electrons of a "psf" frame.
+   void renderPSF( std::vector<float> & ideal,                   ///< [out] the expected photo-electrons in each pixel
+                   const simFrameParams & params,                ///< [in] the parameters
+                   double tx,                                    ///< [in] the x shift of the PSF in pixels
+                   double ty,                                    ///< [in] the y shift of the PSF in pixels
+                   const std::vector<std::complex<float>> & E1,  ///< [in] the first speckle field
+                   const std::vector<std::complex<float>> & E2,  ///< [in] the second speckle field
+                   double theta                                  ///< [in] the speckle phase, mixing E1 and E2
+                 );
+
+   /// Make a random speckle field, complex Gaussian noise smoothed to the speckle size
+   void speckleField( std::vector<std::complex<float>> & E, ///< [out] the field
+                      double fwhm                           ///< [in] the speckle size in pixels
+                    );
+
+   /// Add detector noise to the expected photo-electrons, and convert to ADU
+   void detect( uint16_t * frame,                  ///< [out] the frame in ADU
+                const std::vector<float> & ideal,  ///< [in] the expected photo-electrons in each pixel
+                const simFrameParams & params      ///< [in] the parameters
+              );
+
+public:
+
+   /// Render the bank
+   /**
+     * \returns 0 on success
+     * \returns -1 on an invalid scene or size
+     */
+   int render( const simFrameParams & params /**< [in] the parameters of the frames*/);
+
+   /// Get the width of the frames
+   uint32_t width() const;
+
+   /// Get the height of the frames
+   uint32_t height() const;
+
+   /// Get the number of frames in the bank
+   uint32_t nFrames() const;
+
+   /// Get a pointer to a frame
+   /**
+     * \returns a pointer to the first pixel of frame n, which is width()*height() pixels, row-major.
+     */
+   const uint16_t * frame( uint32_t n /**< [in] the frame number, from 0 to nFrames()-1*/) const;
+
+};
+
+inline
+int simFrameBank::render( const simFrameParams & params )
+{
+   if(params.width == 0 || params.height == 0 || params.nFrames == 0) return -1;
+
+   if(params.scene != "random" && params.scene != "pupils" && params.scene != "psf") return -1;
+
+   m_width = params.width;
+   m_height = params.height;
+   m_nFrames = params.nFrames;
+
+   size_t npix = static_cast<size_t>(m_width)*m_height;
+
+   m_frames.resize(npix*m_nFrames);
+
+   m_gen.seed(params.seed);
+
+   if(params.scene == "random")
+   {
+      std::uniform_int_distribution<uint16_t> dist;
+      for(size_t n = 0; n < m_frames.size(); ++n) m_frames[n] = dist(m_gen);
+      return 0;
+   }
+
+   std::vector<float> ideal(npix);
+
+   std::vector<std::complex<float>> E1, E2;
+   if(params.scene == "psf")
+   {
+      speckleField(E1, params.psfFWHM);
+      speckleField(E2, params.psfFWHM);
+   }
+
+   std::normal_distribution<double> jitter(0, params.ttJitter > 0 ? params.ttJitter : 1);
+
+   for(uint32_t k = 0; k < m_nFrames; ++k)
+   {
+      double ph = 2*M_PI*params.ttCycles*k/m_nFrames;
+
+      double tx = params.ttAmp*cos(ph);
+      double ty = params.ttAmp*sin(ph);
+
+      if(params.ttJitter > 0)
+      {
+         tx += jitter(m_gen);
+         ty += jitter(m_gen);
+      }
+
+      if(params.scene == "pupils")
+      {
+         renderPupils(ideal, params, tx, ty);
+      }
+      else
+      {
+         renderPSF(ideal, params, tx, ty, E1, E2, 2*M_PI*k/m_nFrames);
+      }
+
+      detect(m_frames.data() + k*npix, ideal, params);
+   }
+
+   return 0;
+}
+
+inline
+void simFrameBank::renderPupils( std::vector<float> & ideal,
+                                 const simFrameParams & params,
+                                 double tx,
+                                 double ty
+                               )
+{
+   double r = params.pupilRadius;
+   if(r <= 0) r = 0.2*std::min(m_width, m_height);
+
+   //The four pupils are centered in the quadrants.  The flux is spread over the pupil area, and the
+   //quadrant fractions of a pixel sum to 1, so the total in all four pupils is the flux.
+   double fluxPerPix = params.flux/(M_PI*r*r);
+
+   for(size_t n = 0; n < ideal.size(); ++n) ideal[n] = 0;
+
+   for(int qy = 0; qy < 2; ++qy)
+   {
+      for(int qx = 0; qx < 2; ++qx)
+      {
+         double xc = (0.25 + 0.5*qx)*m_width - 0.5;
+         double yc = (0.25 + 0.5*qy)*m_height - 0.5;
+
+         //The sign of the slope in each quadrant, as a pyramid divides the light
+         double sx = (qx == 0) ? 1 : -1;
+         double sy = (qy == 0) ? 1 : -1;
+
+         int y0 = std::max(0, static_cast<int>(yc - r - 1));
+         int y1 = std::min(static_cast<int>(m_height) - 1, static_cast<int>(yc + r + 1));
+         int x0 = std::max(0, static_cast<int>(xc - r - 1));
+         int x1 = std::min(static_cast<int>(m_width) - 1, static_cast<int>(xc + r + 1));
+
+         for(int y = y0; y <= y1; ++y)
+         {
+            double v = (y - yc)/r;
+            for(int x = x0; x <= x1; ++x)
+            {
+               double u = (x - xc)/r;
+               if(u*u + v*v > 1) continue;
+
+               //Local slope is the tip/tilt plus the gradient of a defocus
+               double gx = std::max(-1.0, std::min(1.0, tx + params.aberration*u));
+               double gy = std::max(-1.0, std::min(1.0, ty + params.aberration*v));
+
+               ideal[static_cast<size_t>(y)*m_width + x] = fluxPerPix*0.25*(1 + sx*gx)*(1 + sy*gy);
+            }
+         }
+      }
+   }
+
+   if(params.background > 0)
+   {
+      for(size_t n = 0; n < ideal.size(); ++n) ideal[n] += params.background;
+   }
+}
+
+inline
+void simFrameBank::renderPSF( std::vector<float> & ideal,
+                              const simFrameParams & params,
+                              double tx,
+                              double ty,
+                              const std::vector<std::complex<float>> & E1,
+                              const std::vector<std::complex<float>> & E2,
+                              double theta
+                            )
+{
+   double xc = 0.5*m_width - 0.5 + tx;
+   double yc = 0.5*m_height - 0.5 + ty;
+
+   double sig = params.psfFWHM/(2*sqrt(2*log(2)));
+   double r0 = 2*params.psfFWHM; //the halo core radius
+
+   float c = cos(theta);
+   float s = sin(theta);
+
+   //First the core into ideal, then the halo into halo, each normalized to its share of the flux.
+   std::vector<float> halo(ideal.size());
+   double coreSum = 0;
+   double haloSum = 0;
+
+   for(uint32_t y = 0; y < m_height; ++y)
+   {
+      double dy = y - yc;
+      for(uint32_t x = 0; x < m_width; ++x)
+      {
+         double dx = x - xc;
+         double rr = dx*dx + dy*dy;
+         size_t idx = static_cast<size_t>(y)*m_width + x;
+
+         ideal[idx] = exp(-0.5*rr/(sig*sig));
+         coreSum += ideal[idx];
+
+         double env = pow(1.0 + rr/(r0*r0), -1.5);
+         halo[idx] = env*std::norm(c*E1[idx] + s*E2[idx]);
+         haloSum += halo[idx];
+      }
+   }
+
+   double coreNorm = (coreSum > 0) ? (1-params.speckleFrac)*params.flux/coreSum : 0;
+   double haloNorm = (haloSum > 0) ? params.speckleFrac*params.flux/haloSum : 0;
+
+   for(size_t n = 0; n < ideal.size(); ++n)
+   {
+      ideal[n] = coreNorm*ideal[n] + haloNorm*halo[n] + params.background;
+   }
+}
+
+inline
+void simFrameBank::speckleField( std::vector<std::complex<float>> & E,
+                                 double fwhm
+                               )
+{
+   size_t npix = static_cast<size_t>(m_width)*m_height;
+   E.resize(npix);
+
+   std::normal_distribution<float> dist;
+   for(size_t n = 0; n < npix; ++n) E[n] = std::complex<float>(dist(m_gen), dist(m_gen));
+
+   //Separable Gaussian smoothing to the speckle size
+   double sig = fwhm/(2*sqrt(2*log(2)));
+   int hw = std::max(1, static_cast<int>(ceil(3*sig)));
+
+   std::vector<float> kern(2*hw+1);
+   for(int n = -hw; n <= hw; ++n) kern[n+hw] = exp(-0.5*n*n/(sig*sig));
+
+   std::vector<std::complex<float>> tmp(npix);
+
+   int w = m_width;
+   int h = m_height;
+
+   for(uint32_t y = 0; y < m_height; ++y)
+   {
+      for(uint32_t x = 0; x < m_width; ++x)
+      {
+         std::complex<float> sum = 0;
+         for(int k = -hw; k <= hw; ++k)
+         {
+            int xx = ((static_cast<int>(x) + k) % w + w) % w; //wrap, so there are no edge effects
+            sum += kern[k+hw]*E[static_cast<size_t>(y)*m_width + xx];
+         }
+         tmp[static_cast<size_t>(y)*m_width + x] = sum;
+      }
+   }
+
+   for(uint32_t y = 0; y < m_height; ++y)
+   {
+      for(uint32_t x = 0; x < m_width; ++x)
+      {
+         std::complex<float> sum = 0;
+         for(int k = -hw; k <= hw; ++k)
+         {
+            int yy = ((static_cast<int>(y) + k) % h + h) % h;
+            sum += kern[k+hw]*tmp[static_cast<size_t>(yy)*m_width + x];
+         }
+         E[static_cast<size_t>(y)*m_width + x] = sum;
+      }
+   }
+}
+
+inline
+void simFrameBank::detect( uint16_t * frame,
+                           const std::vector<float> & ideal,
+                           const simFrameParams & params
+                         )
+{
+   std::poisson_distribution<int64_t> poisson;
+   std::normal_distribution<double> norm;
+
+   for(size_t n = 0; n < ideal.size(); ++n)
+   {
+      double e = 0;
+      if(ideal[n] > 0)
+      {
+         poisson.param(std::poisson_distribution<int64_t>::param_type(ideal[n]));
+         e = poisson(m_gen);
+      }
+
+      //The output of an EM register is gamma distributed, with shape the number of input electrons.
+      if(params.emGain > 1 && e > 0)
+      {
+         std::gamma_distribution<double> em(e, params.emGain);
+         e = em(m_gen);
+      }
+
+      if(params.readNoise > 0) e += params.readNoise*norm(m_gen);
+
+      double adu = e/params.gain + params.bias + 0.5;
+
+      if(adu < 0) adu = 0;
+      if(adu > 65535) adu = 65535;
+
+      frame[n] = static_cast<uint16_t>(adu);
+   }
+}
+
+inline
+uint32_t simFrameBank::width() const
+{
+   return m_width;
+}
+
+inline
+uint32_t simFrameBank::height() const
+{
+   return m_height;
+}
+
+inline
+uint32_t simFrameBank::nFrames() const
+{
+   return m_nFrames;
+}
+
+inline
+const uint16_t * simFrameBank::frame( uint32_t n ) const
+{
+   return m_frames.data() + static_cast<size_t>(n)*m_width*m_height;
+}
+
+} //namespace app
+} //namespace MagAOX
+
+#endif //simFrameBank_hpp
@@ -0,0 +1,138 @@
+/** \file simFrameBank_test.cpp
+  * \brief Catch2 tests for the cameraSim frame bank.
+  *
+  * History:
+  */
+
+#include "../../../tests/catch2/catch.hpp"
+
+#include "../simFrameBank.hpp"
+
+using namespace MagAOX::app;
+
+namespace simFrameBank_test
+{
+
+/// Sum a frame, minus the bias
+double frameSum( const simFrameBank & bank,
+                 uint32_t n,
+                 double bias
+               )
+{
+   const uint16_t * f = bank.frame(n);
+   double sum = 0;
+   for(size_t p = 0; p < static_cast<size_t>(bank.width())*bank.height(); ++p) sum += f[p] - bias;
+   return sum;
+}
+
+SCENARIO( "Rendering simulated frames", "[cameraSim]" )
+{
+   simFrameParams params;
+   params.width = 64;
+   params.height = 48;
+   params.nFrames = 8;
+   params.flux = 1e5;
+   params.readNoise = 0;
+
+   simFrameBank bank;
+
+   GIVEN("an invalid scene")
+   {
+      params.scene = "nope";
+
+      THEN("rendering fails")
+      {
+         REQUIRE(bank.render(params) == -1);
+      }
+   }
+
+   GIVEN("the same seed")
+   {
+      params.scene = "psf";
+      REQUIRE(bank.render(params) == 0);
+
+      simFrameBank bank2;
+      REQUIRE(bank2.render(params) == 0);
+
+      THEN("the banks are identical")
+      {
+         REQUIRE(bank.nFrames() == 8);
+         REQUIRE(bank.width() == 64);
+         REQUIRE(bank.height() == 48);
+
+         bool same = true;
+         for(uint32_t n = 0; n < bank.nFrames(); ++n)
+         {
+            for(size_t p = 0; p < 64*48; ++p) same = same && (bank.frame(n)[p] == bank2.frame(n)[p]);
+         }
+         REQUIRE(same);
+      }
+   }
+
+   GIVEN("the psf scene")
+   {
+      params.scene = "psf";
+      params.ttAmp = 2;
+      params.ttJitter = 0;
+      REQUIRE(bank.render(params) == 0);
+
+      THEN("the flux is conserved within the photon noise, and the peak is near the center")
+      {
+         for(uint32_t n = 0; n < bank.nFrames(); ++n)
+         {
+            REQUIRE(frameSum(bank, n, params.bias) == Approx(params.flux).epsilon(5.0/sqrt(params.flux)));
+         }
+
+         const uint16_t * f = bank.frame(0);
+         size_t pk = std::max_element(f, f + 64*48) - f;
+         REQUIRE( fabs( static_cast<double>(pk % 64) - (31.5 + params.ttAmp)) <= 1.5 );
+         REQUIRE( fabs( static_cast<double>(pk / 64) - 23.5) <= 1.5 );
+      }
+   }
+
+   GIVEN("the pupils scene with a tip")
+   {
+      params.scene = "pupils";
+      params.ttAmp = 0.5;
+      params.ttCycles = 1;
+      params.ttJitter = 0;
+      params.aberration = 0;
+      REQUIRE(bank.render(params) == 0);
+
+      THEN("the left pupils are brighter than the right pupils in the first frame")
+      {
+         const uint16_t * f = bank.frame(0);
+         double left = 0, right = 0;
+         for(size_t y = 0; y < 48; ++y)
+         {
+            for(size_t x = 0; x < 64; ++x)
+            {
+               if(x < 32) left += f[y*64+x] - params.bias;
+               else right += f[y*64+x] - params.bias;
+            }
+         }
+
+         //(1+0.5)/(1-0.5) = 3
+         REQUIRE(left/right == Approx(3).epsilon(0.05));
+         REQUIRE(left + right == Approx(params.flux).epsilon(0.02));
+      }
+   }
+
+   GIVEN("EM gain")
+   {
+      params.scene = "psf";
+      params.emGain = 100;
+      params.flux = 1e3;
+      REQUIRE(bank.render(params) == 0);
+
+      THEN("the mean signal is amplified by the gain")
+      {
+         double sum = 0;
+         for(uint32_t n = 0; n < bank.nFrames(); ++n) sum += frameSum(bank, n, params.bias);
+
+         REQUIRE(sum/bank.nFrames() == Approx(params.flux*params.emGain).epsilon(0.1));
+      }
+   }
+}
+
+} //namespace simFrameBank_test
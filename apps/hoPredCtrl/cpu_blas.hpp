@@ -0,0 +1,233 @@
+#ifndef PCCPUBLAS_HPP
+#define PCCPUBLAS_HPP
+
+/*
+	CPU stand-ins for the cuBLAS types and calls used by the predictive controller.
+	This is included instead of the CUDA headers when HOPREDCTRL_CPU is defined, so the
+	Matrix and controller code is the same for both backends. On the CPU the "device"
+	pointers of a Matrix are the host pointers.
+
+	The batched calls run one BLAS call per batch (i.e. per mode) across OpenMP threads.
+	The matrices are small, so use an OpenMP build of OpenBLAS (or MKL), or set
+	OPENBLAS_NUM_THREADS=1, so that BLAS does not also start threads inside the loop.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <cblas.h>
+
+namespace DDSPC
+{
+
+struct cublasContext {};
+typedef cublasContext* cublasHandle_t;
+
+enum cublasOperation_t { CUBLAS_OP_N = 0, CUBLAS_OP_T = 1 };
+
+enum cublasStatus_t { CUBLAS_STATUS_SUCCESS = 0, CUBLAS_STATUS_INVALID_VALUE = 7 };
+
+static inline cublasStatus_t cublasCreate(cublasHandle_t* handle)
+{
+	*handle = nullptr;
+	return CUBLAS_STATUS_SUCCESS;
+}
+
+static inline cublasStatus_t cublasDestroy(cublasHandle_t handle)
+{
+	static_cast<void>(handle);
+	return CUBLAS_STATUS_SUCCESS;
+}
+
+static inline CBLAS_TRANSPOSE cblasOp(cublasOperation_t op)
+{
+	return (op == CUBLAS_OP_T) ? CblasTrans : CblasNoTrans;
+}
+
+static inline void cblasXgemm(CBLAS_TRANSPOSE transa, CBLAS_TRANSPOSE transb, int m, int n, int k,
+	float alpha, const float *A, int lda, const float *B, int ldb, float beta, float *C, int ldc)
+{
+	cblas_sgemm(CblasColMajor, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+static inline void cblasXgemm(CBLAS_TRANSPOSE transa, CBLAS_TRANSPOSE transb, int m, int n, int k,
+	double alpha, const double *A, int lda, const double *B, int ldb, double beta, double *C, int ldc)
+{
+	cblas_dgemm(CblasColMajor, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+template<typename T>
+static inline cublasStatus_t cublasXgemmStridedBatched(cublasHandle_t handle,
+	cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k,
+	T *alpha, const T *A, int lda, long long int strideA,
+	const T *B, int ldb, long long int strideB,
+	T *beta,
+	T *C, int ldc, long long int strideC,
+	int batchCount)
+{
+	static_cast<void>(handle);
+	CBLAS_TRANSPOSE ta = cblasOp(transa);
+	CBLAS_TRANSPOSE tb = cblasOp(transb);
+
+	#pragma omp parallel for if(batchCount > 1) schedule(static)
+	for(int b = 0; b < batchCount; ++b){
+		cblasXgemm(ta, tb, m, n, k, *alpha, A + b * strideA, lda, B + b * strideB, ldb, *beta, C + b * strideC, ldc);
+	}
+
+	return CUBLAS_STATUS_SUCCESS;
+}
+
+template<typename T>
+static inline cublasStatus_t cublasXgemmBatched(cublasHandle_t handle,
+	cublasOperation_t transa,
+	cublasOperation_t transb,
+	int m, int n, int k,
+	T *alpha,
+	T ** Aarray, int lda,
+	T ** Barray, int ldb,
+	T *beta,
+	T ** Carray, int ldc,
+	int batchCount)
+{
+	static_cast<void>(handle);
+	CBLAS_TRANSPOSE ta = cblasOp(transa);
+	CBLAS_TRANSPOSE tb = cblasOp(transb);
+
+	#pragma omp parallel for if(batchCount > 1) schedule(static)
+	for(int b = 0; b < batchCount; ++b){
+		cblasXgemm(ta, tb, m, n, k, *alpha, Aarray[b], lda, Barray[b], ldb, *beta, Carray[b], ldc);
+	}
+
+	return CUBLAS_STATUS_SUCCESS;
+}
+
+/*
+	Gauss-Jordan elimination with partial pivoting of one column-major n x n matrix.
+	A is overwritten, and Ainv must not alias it. Returns 0, or the 1-based column at which A was found to be singular.
+*/
+template<typename T>
+static inline int cpu_matinv(int n, T* A, T* Ainv)
+{
+	for(int j = 0; j < n; ++j){
+		for(int i = 0; i < n; ++i){
+			Ainv[j * n + i] = (i == j) ? 1 : 0;
+		}
+	}
+
+	for(int c = 0; c < n; ++c){
+		int p = c;
+		for(int i = c + 1; i < n; ++i){
+			if(std::abs(A[c * n + i]) > std::abs(A[c * n + p]))
+				p = i;
+		}
+
+		if(A[c * n + p] == 0)
+			return c + 1;
+
+		if(p != c){
+			for(int j = 0; j < n; ++j){
+				std::swap(A[j * n + p], A[j * n + c]);
+				std::swap(Ainv[j * n + p], Ainv[j * n + c]);
+			}
+		}
+
+		T d = 1 / A[c * n + c];
+		for(int j = 0; j < n; ++j){
+			A[j * n + c] *= d;
+			Ainv[j * n + c] *= d;
+		}
+
+		for(int i = 0; i < n; ++i){
+			if(i == c)
+				continue;
+
+			T f = A[c * n + i];
+			if(f == 0)
+				continue;
+
+			for(int j = 0; j < n; ++j){
+				A[j * n + i] -= f * A[j * n + c];
+				Ainv[j * n + i] -= f * Ainv[j * n + c];
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+	Like cublas<t>matinvBatched, which is also meant for small matrices.
+	The inputs are nfuture x nfuture, so no LAPACK is needed.
+*/
+template<typename T>
+static inline cublasStatus_t cublasXmatinvBatched(cublasHandle_t handle,
+	int n,
+	T ** A,
+	T ** Ainv,
+	int batchCount,
+	int* info)
+{
+	static_cast<void>(handle);
+
+	#pragma omp parallel if(batchCount > 1)
+	{
+		std::vector<T> work(n * n);
+
+		#pragma omp for schedule(static)
+		for(int b = 0; b < batchCount; ++b){
+			std::copy(A[b], A[b] + n * n, work.data());
+			info[b] = cpu_matinv(n, work.data(), Ainv[b]);
+		}
+	}
+
+	return CUBLAS_STATUS_SUCCESS;
+}
+
+static inline cublasStatus_t cublasXscal(cublasHandle_t handle, int n, float alpha, float *x)
+{
+	static_cast<void>(handle);
+	cblas_sscal(n, alpha, x, 1);
+	return CUBLAS_STATUS_SUCCESS;
+}
+
+static inline cublasStatus_t cublasXscal(cublasHandle_t handle, int n, double alpha, double *x)
+{
+	static_cast<void>(handle);
+	cblas_dscal(n, alpha, x, 1);
+	return CUBLAS_STATUS_SUCCESS;
+}
+
+static inline cublasStatus_t cublasXaxpy(cublasHandle_t handle, int n, float alpha, float *x, float *y)
+{
+	static_cast<void>(handle);
+	cblas_saxpy(n, alpha, x, 1, y, 1);
+	return CUBLAS_STATUS_SUCCESS;
+}
+
+static inline cublasStatus_t cublasXaxpy(cublasHandle_t handle, int n, double alpha, double *x, double *y)
+{
+	static_cast<void>(handle);
+	cblas_daxpy(n, alpha, x, 1, y, 1);
+	return CUBLAS_STATUS_SUCCESS;
+}
+
+static inline cublasStatus_t cublasXcopy(cublasHandle_t handle, int n, float *x, int incx, float *y, int incy)
+{
+	static_cast<void>(handle);
+	cblas_scopy(n, x, incx, y, incy);
+	return CUBLAS_STATUS_SUCCESS;
+}
+
+static inline cublasStatus_t cublasXcopy(cublasHandle_t handle, int n, double *x, int incx, double *y, int incy)
+{
+	static_cast<void>(handle);
+	cblas_dcopy(n, x, incx, y, incy);
+	return CUBLAS_STATUS_SUCCESS;
+}
+
+}
+
+#endif
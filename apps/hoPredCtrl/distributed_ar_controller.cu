@@ -1,4 +1,6 @@
+#ifndef HOPREDCTRL_CPU
 #include "device_launch_parameters.h"
+#endif
 #include "utils.cuh"
 #include "distributed_ar_controller.cuh"
 #include "new_matrix.cuh"
@@ -294,6 +296,17 @@ void DistributedAutoRegressiveController::set_new_regularization(float* new_lamb
 	update_controller();
 }
 
+#ifdef HOPREDCTRL_CPU
+
+void clip_array(float* x, float clip_value, int n){
+	for (int k = 0; k < n; k++) {
+		x[k] = x[k] < -clip_value ? -clip_value : x[k];
+		x[k] = x[k] > clip_value ? clip_value : x[k];
+	}
+}
+
+#else
+
 __global__ void clip_array(float* x, float clip_value, int n){
 	/*
 		calculates:
@@ -309,6 +322,8 @@ __global__ void clip_array(float* x, float clip_value, int n){
 	}
 }
 
+#endif
+
 
 Matrix* DistributedAutoRegressiveController::get_new_control_command(float clip_val, Matrix* exploration_signal){
 	
@@ -317,7 +332,11 @@ Matrix* DistributedAutoRegressiveController::get_new_control_command(float clip_
 		
 		controller->dot(wp, delta_command, 1.0, 0.0, CUBLAS_OP_N, CUBLAS_OP_N);
 		delta_command->add(exploration_signal);
+#ifdef HOPREDCTRL_CPU
+		clip_array(delta_command->gpu_data[0], clip_val, delta_command->total_size_);
+#else
 		clip_array <<<8*32, 64 >>>(delta_command->gpu_data[0], clip_val, delta_command->total_size_);
+#endif
 		
 		// Copy the new measurement into our data buffer
 		gpu_col_copy(command_buffer, 0, buffer_index & buffer_size, delta_command);
@@ -1,8 +1,10 @@
 #ifndef PCDDSC_CUH
 #define PCDDSC_CUH
 
+#ifndef HOPREDCTRL_CPU
 #include "cuda_runtime.h"
 #include "cublas_v2.h"     // if you need CUBLAS v2, include before magma.h
+#endif
 
 #include "recursive_least_squares.cuh"
 #include "new_matrix.cuh"
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstring>
 
 
 namespace DDSPC
@@ -36,6 +37,12 @@ Matrix::Matrix(float initialization_value, int num_rows, int num_columns, int nu
 		}
 	}
 
+#ifdef HOPREDCTRL_CPU
+	// There is no device, the device pointers are the host pointers.
+	gpu_data = cpu_data;
+	dev_gpu_data = cpu_data;
+	info = new int[batch_size_];
+#else
 	// Host side pointers
 	gpu_data = new float* [batch_size_];
 	// Allocate gpu memory and use the first host side pointer as start of
@@ -63,6 +70,7 @@ Matrix::Matrix(float initialization_value, int num_rows, int num_columns, int nu
 	// Allocate memory for the information for batch processes
 	cudaError_t err3 = cudaMalloc(&info, batch_size_ * sizeof(int));
 	check_cuda_error(err3);
+#endif
 
 	// std::cout << "Print gpu buffer::" <<std::endl;
 	// print(true);
@@ -79,6 +87,9 @@ Matrix::~Matrix(){
 		delete cpu_data;
 	}
 
+#ifdef HOPREDCTRL_CPU
+	delete [] info;
+#else
 	if(gpu_data != nullptr){
 		// Free device side data
 		if(gpu_data[0] != nullptr)
@@ -96,8 +107,25 @@ Matrix::~Matrix(){
 
 	if(info != nullptr)
 		cudaFree(info);
+#endif
 }
 
+#ifdef HOPREDCTRL_CPU
+
+// The data is shared between host and "device", so there is nothing to transfer
+void Matrix::to_gpu(){
+}
+
+void Matrix::to_cpu(){
+}
+
+void Matrix::print(bool print_gpu){
+	static_cast<void>(print_gpu);
+	print_batch_buffer(cpu_data, batch_size_, nrows_, ncols_);
+}
+
+#else
+
 void Matrix::to_gpu(){
 	// Copy one contineous block of memory A pointer just point to the beginning of the data
 	cudaError_t err3 = cudaMemcpy(gpu_data[0], cpu_data[0], element_size_ * size_ * batch_size_, cudaMemcpyHostToDevice);
@@ -120,6 +148,8 @@ void Matrix::print(bool print_gpu){
 	}
 }	
 
+#endif //HOPREDCTRL_CPU
+
 void Matrix::shift_columns_cpu(){
 	float reset_value = 0.0;
 	for (int k=0; k < batch_size_; k++) {
@@ -139,7 +169,21 @@ void Matrix::shift_columns_cpu(){
 }
 
 void Matrix::divide_by_scalar(Matrix* other, Matrix* out){
+#ifdef HOPREDCTRL_CPU
+	/*
+		calculates:
+			out = self / other
+	*/
+	#pragma omp parallel for if(batch_size_ > 1) schedule(static)
+	for (int k = 0; k < batch_size_; k++) {
+		float d = 1.0f / other->cpu_data[0][k];
+		for(int i=0; i < size_; i++){
+			out->cpu_data[0][BIDX2C(i, 0, k, size_, 1)] = cpu_data[0][BIDX2C(i, 0, k, size_, 1)] * d;
+		}
+	}
+#else
 	divide_scalar_gpu<<<32 * 8, 64>>>(other->gpu_data[0], gpu_data[0], out->gpu_data[0], size_, batch_size_);
+#endif
 }
 
 void Matrix::set_to_zero(){
@@ -374,7 +418,11 @@ void cpu_full_copy(float * destination, Matrix* source){
 void gpu_col_copy(Matrix* destination, int dcol_index, int dbatch_index, Matrix* source, int scol_index, int sbatch_index){
 	int sindex = IDX2C(0, scol_index, source->nrows_);
 	int dindex = IDX2C(0, dcol_index, destination->nrows_);
+#ifdef HOPREDCTRL_CPU
+	memcpy(destination->gpu_data[dbatch_index] + dindex, source->gpu_data[sbatch_index] + sindex, destination->nrows_ * sizeof(float));
+#else
 	cudaMemcpy(destination->gpu_data[dbatch_index] + dindex, source->gpu_data[sbatch_index] + sindex, destination->nrows_ * sizeof(float), cudaMemcpyDeviceToDevice);
+#endif
 }
 
 
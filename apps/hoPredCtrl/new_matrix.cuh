@@ -2,8 +2,10 @@
 #define PCMATRIX_CUH
 
 #include <iostream>
+#ifndef HOPREDCTRL_CPU
 #include <cuda_runtime.h>
 #include "cublas_v2.h"
+#endif
 #include "utils.cuh"
 
 namespace DDSPC
@@ -24,8 +26,8 @@ class Matrix{
 		int ncols_;
 			
 		float** cpu_data; // Host side pointers to host data
-		float** gpu_data; // Host side pointers to device data
-		float** dev_gpu_data; // Device side pointers to device data
+		float** gpu_data; // Host side pointers to device data (the host data for HOPREDCTRL_CPU)
+		float** dev_gpu_data; // Device side pointers to device data (the host pointers for HOPREDCTRL_CPU)
 		int *info;
 	
 		Matrix(float initialization_value, int num_rows, int num_columns, int num_batches=1);
@@ -4,12 +4,15 @@
 #include <chrono>
 #include <string>
 #include <sstream>
+#include <cstring>
 
 namespace DDSPC
 {	
 	PredictiveController::PredictiveController(int num_history, int num_future, int num_modes, int num_measurements, float gamma, float lambda, float P0, int num_actuators){
+#ifndef HOPREDCTRL_CPU
 		cudaError_t cudaerr = cudaSetDevice(0);
 		check_cuda_error(cudaerr);
+#endif
 
 		cublasStatus_t stat = cublasCreate(&handle);
 		if (stat != CUBLAS_STATUS_SUCCESS)
@@ -108,10 +111,18 @@ namespace DDSPC
 	void PredictiveController::get_next_exploration_signal(){
 		if(m_exploration_index < m_exploration_buffer_size){
 			// Copy the data from the data buffer to the new vector
+#ifdef HOPREDCTRL_CPU
+			memcpy(m_exploration_signal->gpu_data[0], m_exploration_buffer->gpu_data[m_exploration_index], m_num_modes * sizeof(float));
+#else
 			cudaMemcpy(m_exploration_signal->gpu_data[0], m_exploration_buffer->gpu_data[m_exploration_index], m_num_modes * sizeof(float), cudaMemcpyDeviceToDevice);
+#endif
 			m_exploration_index += 1;
 		}else{
+#ifdef HOPREDCTRL_CPU
+			memset(m_exploration_signal->gpu_data[0], 0, m_num_modes * sizeof(float));
+#else
 			cudaMemset(m_exploration_signal->gpu_data[0], 0, m_num_modes * sizeof(float));
+#endif
 		}
 
 	}
@@ -1,8 +1,10 @@
 #ifndef RDDSC_CUH
 #define RDDSC_CUH
 
+#ifndef HOPREDCTRL_CPU
 #include "cuda_runtime.h"
 #include "cublas_v2.h"     // if you need CUBLAS v2, include before magma.h
+#endif
 
 #include "new_matrix.cuh"
 #include "distributed_ar_controller.cuh"
@@ -1,9 +1,11 @@
 #ifndef PCRLS_CUH
 #define PCRLS_CUH
 
+#ifndef HOPREDCTRL_CPU
 #include "cuda_runtime.h"
 #include "device_launch_parameters.h"
 #include "cublas_v2.h"
+#endif
 
 #include "utils.cuh"
 #include "new_matrix.cuh"
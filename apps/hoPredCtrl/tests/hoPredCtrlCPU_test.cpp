@@ -0,0 +1,265 @@
+/** \file hoPredCtrlCPU_test.cpp
+  * \brief Catch2 tests for the CPU backend of the hoPredCtrl predictive controller.
+  *
+  * History:
+  */
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../tests/catch2/catch.hpp"
+
+#include <cmath>
+#include <random>
+#include <string>
+
+#define HOPREDCTRL_CPU
+
+//The controller is not header-only, so build it here with the CPU backend
+#include "../utils.cu"
+#include "../new_matrix.cu"
+#include "../recursive_least_squares.cu"
+#include "../distributed_ar_controller.cu"
+#include "../predictive_controller.cu"
+
+namespace hoPredCtrlCPU_test
+{
+
+using namespace DDSPC;
+
+/// Fill a matrix with normal deviates
+void fillRandom( Matrix * m,
+                 std::mt19937 & gen
+               )
+{
+   std::normal_distribution<float> dist(0, 1);
+   for(int n = 0; n < m->total_size_; ++n) m->cpu_data[0][n] = dist(gen);
+}
+
+SCENARIO( "Batched matrix operations on the CPU", "[hoPredCtrl::cpu]" )
+{
+   cublasHandle_t handle;
+   cublasCreate(&handle);
+
+   std::mt19937 gen(5);
+
+   GIVEN("a batch of 3 matrices")
+   {
+      Matrix A(0, 4, 3, 3);
+      Matrix B(0, 4, 5, 3);
+      Matrix C(0, 3, 5, 3);
+      A.set_handle(&handle);
+
+      fillRandom(&A, gen);
+      fillRandom(&B, gen);
+
+      WHEN("multiplying A^T B")
+      {
+         A.dot(&B, &C, 1.0, 0.0, CUBLAS_OP_T, CUBLAS_OP_N);
+
+         THEN("each batch matches the direct product")
+         {
+            for(int k = 0; k < 3; ++k)
+            {
+               for(int i = 0; i < 3; ++i)
+               {
+                  for(int j = 0; j < 5; ++j)
+                  {
+                     float s = 0;
+                     for(int l = 0; l < 4; ++l) s += A.get(l, i, k) * B.get(l, j, k);
+                     REQUIRE(C.get(i, j, k) == Approx(s).margin(1e-5));
+                  }
+               }
+            }
+         }
+      }
+
+      WHEN("multiplying with the pointer-array version")
+      {
+         Matrix C2(0, 3, 5, 3);
+         A.dot(&B, &C, 1.0, 0.0, CUBLAS_OP_T, CUBLAS_OP_N, true);
+         A.dot(&B, &C2, 1.0, 0.0, CUBLAS_OP_T, CUBLAS_OP_N, false);
+
+         THEN("the results are the same")
+         {
+            for(int n = 0; n < C.total_size_; ++n) REQUIRE(C2.cpu_data[0][n] == Approx(C.cpu_data[0][n]));
+         }
+      }
+   }
+
+   GIVEN("a batch of well conditioned matrices")
+   {
+      Matrix H(0, 5, 5, 4);
+      Matrix invH(0, 5, 5, 4);
+      H.set_handle(&handle);
+
+      fillRandom(&H, gen);
+      for(int k = 0; k < 4; ++k)
+      {
+         for(int i = 0; i < 5; ++i) H.set(H.get(i, i, k) + 10, i, i, k);
+      }
+
+      Matrix H0(0, 5, 5, 4);
+      cpu_full_copy(&H0, H.cpu_data[0]);
+
+      WHEN("inverting")
+      {
+         H.inverse(&invH);
+
+         THEN("H invH is the identity and H is unchanged")
+         {
+            for(int k = 0; k < 4; ++k)
+            {
+               REQUIRE(H.info[k] == 0);
+               for(int i = 0; i < 5; ++i)
+               {
+                  for(int j = 0; j < 5; ++j)
+                  {
+                     float s = 0;
+                     for(int l = 0; l < 5; ++l) s += H.get(i, l, k) * invH.get(l, j, k);
+                     REQUIRE(s == Approx(i == j ? 1 : 0).margin(1e-5));
+                  }
+               }
+            }
+
+            for(int n = 0; n < H.total_size_; ++n) REQUIRE(H.cpu_data[0][n] == H0.cpu_data[0][n]);
+         }
+      }
+   }
+
+   cublasDestroy(handle);
+}
+
+SCENARIO( "Recursive least squares on the CPU", "[hoPredCtrl::cpu]" )
+{
+   GIVEN("a batch of 3 linear systems y = W x")
+   {
+      cublasHandle_t handle;
+      cublasCreate(&handle);
+
+      std::mt19937 gen(6);
+
+      int nfeat = 4;
+      int npred = 2;
+      int nbatch = 3;
+
+      Matrix W(0, npred, nfeat, nbatch);
+      fillRandom(&W, gen);
+
+      Matrix x(0, nfeat, 1, nbatch);
+      Matrix y(0, npred, 1, nbatch);
+      W.set_handle(&handle);
+      x.set_handle(&handle);
+      y.set_handle(&handle);
+
+      RecursiveLeastSquares rls(&handle, nfeat, npred, nbatch, 0.999, 100);
+
+      WHEN("the RLS is updated with noiseless samples")
+      {
+         for(int n = 0; n < 50; ++n)
+         {
+            fillRandom(&x, gen);
+            W.dot(&x, &y);
+            rls.update(&x, &y);
+         }
+
+         THEN("the prediction matrix converges to W")
+         {
+            for(int n = 0; n < W.total_size_; ++n) REQUIRE(rls.A->cpu_data[0][n] == Approx(W.cpu_data[0][n]).margin(1e-3));
+         }
+      }
+
+      cublasDestroy(handle);
+   }
+}
+
+SCENARIO( "Running the predictive controller on the CPU", "[hoPredCtrl::cpu]" )
+{
+   GIVEN("a controller for 10 modes")
+   {
+      int nmodes = 10;
+      int nact = 12;
+
+      PredictiveController pc(3, 2, nmodes, nmodes, 0.99, 1, 100, nact);
+
+      std::vector<float> imat(nmodes*nmodes, 0);
+      for(int i = 0; i < nmodes; ++i) imat[i*nmodes + i] = 1;
+      pc.set_interaction_matrix(imat.data());
+
+      std::vector<float> mmat(nact*nmodes, 0);
+      for(int i = 0; i < nmodes; ++i) mmat[i*nact + i] = 1;
+      pc.set_mapping_matrix(mmat.data());
+
+      pc.create_exploration_buffer(0.01, 100);
+      pc.controller->set_integrator(true, 0.2, 0.99);
+      pc.set_new_regularization(1);
+
+      WHEN("the loop is run on a slowly varying disturbance")
+      {
+         std::vector<float> meas(nmodes);
+         float * cmd = nullptr;
+
+         for(int n = 0; n < 200; ++n)
+         {
+            for(int i = 0; i < nmodes; ++i) meas[i] = 0.1*sin(0.05*n + i);
+
+            pc.add_measurement(meas.data());
+            cmd = pc.get_command(0.5);
+            pc.update_predictor();
+            if(n % 10 == 0) pc.update_controller();
+         }
+
+         THEN("the commands are finite and only the mapped actuators are set")
+         {
+            for(int i = 0; i < nmodes; ++i) REQUIRE(std::abs(cmd[i]) < 1e6);
+            for(int i = nmodes; i < nact; ++i) REQUIRE(cmd[i] == 0);
+
+            for(int k = 0; k < nmodes; ++k) REQUIRE(pc.controller->H11->info[k] == 0);
+         }
+      }
+   }
+}
+
+TEST_CASE( "Benchmark the CPU predictive controller", "[.benchmark][hoPredCtrl::cpu]" )
+{
+   cublasHandle_t handle;
+   cublasCreate(&handle);
+
+   std::mt19937 gen(7);
+
+   for(int nmodes : {100, 500, 2000})
+   {
+      for(int nhist : {2, 5, 10})
+      {
+         int nfut = 2;
+         std::vector<float> lambda(nmodes, 1);
+
+         DistributedAutoRegressiveController ctrl(&handle, nhist, nfut, nmodes, 0.99, lambda.data(), 100);
+         ctrl.set_handle(&handle);
+
+         Matrix meas(0, nmodes, 1);
+         fillRandom(&meas, gen);
+
+         std::string sz = " nmodes=" + std::to_string(nmodes) + " nhist=" + std::to_string(nhist);
+
+         BENCHMARK("add_measurement" + sz)
+         {
+            ctrl.add_measurement(&meas);
+            return ctrl.phi->cpu_data[0][0];
+         };
+
+         BENCHMARK("update_predictor" + sz)
+         {
+            ctrl.update_predictor();
+            return ctrl.rls->A->cpu_data[0][0];
+         };
+
+         BENCHMARK("update_controller" + sz)
+         {
+            ctrl.update_controller();
+            return ctrl.controller->cpu_data[0][0];
+         };
+      }
+   }
+
+   cublasDestroy(handle);
+}
+
+} //namespace hoPredCtrlCPU_test
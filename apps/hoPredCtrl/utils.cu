@@ -1,5 +1,7 @@
 #include <iostream>
+#ifndef HOPREDCTRL_CPU
 #include "device_launch_parameters.h"
+#endif
 #include "utils.cuh"
 #include <sstream>
 
@@ -36,6 +38,8 @@ std::vector<std::string> split (const std::string &s, char delim) {
 }
 
 
+#ifndef HOPREDCTRL_CPU
+
 //	cudaError_t cudaerr = cudaDeviceSynchronize();
 void check_cuda_error(cudaError_t cudaerr ){
 	if (cudaerr != cudaSuccess)
@@ -92,6 +96,8 @@ __global__ void gpu_print_buffer(float* data, int batch_count, int nrow, int nco
 	//printf("]\n");
 };
 
+#endif //HOPREDCTRL_CPU
+
 void print_batch_buffer(float** data, int batch_count, int nrow, int ncol) {
 	for (int k = 0; k < batch_count; k++) {
 
@@ -3,8 +3,12 @@
 #include <string>
 #include <vector>
 
+#ifdef HOPREDCTRL_CPU
+#include "cpu_blas.hpp"
+#else
 #include "cuda_runtime.h"
 #include "cublas_v2.h"
+#endif
 
 namespace DDSPC
 {
@@ -20,9 +24,12 @@ std::vector<std::string> split (const std::string &s, char delim);
 #define IDX2C(i, j, nrow) (((j) * (nrow)) + (i))
 #define BIDX2C(i, j, k, nrow, ncol) (((j) * (nrow)) + (i) + ((k) * (ncol) * (nrow)))
 
+void print_batch_buffer(float** data, int batch_count, int nrow, int ncol);
+
+#ifndef HOPREDCTRL_CPU
+
 __global__ void divide_scalar_gpu(float* x, float* y, float* z, int element_size, int batch_size);
 __global__ void gpu_print_buffer(float* data, int batch_count, int nrow, int ncol, int row_max=-1, int col_max=-1);
-void print_batch_buffer(float** data, int batch_count, int nrow, int ncol);
 void check_cuda_error(cudaError_t cudaerr);
 
 /*
@@ -176,6 +183,8 @@ static inline cublasStatus_t cublasXcopy(cublasHandle_t handle, int n, double *x
 	return cublasDcopy(handle, n, x, incx, y, incy);
 }
 
+#endif //HOPREDCTRL_CPU
+
 static inline uint64_t find_next_power_of_2(int sample){
     uint64_t num_bits = 0;
     
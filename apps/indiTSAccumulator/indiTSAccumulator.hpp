@@ -7,11 +7,14 @@
 #ifndef indiTSAccumulator_hpp
 #define indiTSAccumulator_hpp
 
+#include <algorithm>
 #include <map>
 
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#include "../../libMagAOX/utils/tsRing.hpp"
+
 /** \defgroup indiTSAccumulator
   * \brief The indiTSAccumulator application to do YYYYYYY
   *
@@ -31,8 +34,14 @@ namespace app
 {
 
 /// The MagAO-X indiTSAccumulator
-/** An application to accumulate a time-series from an INDI element. 
+/** An application to accumulate a time-series from INDI elements. 
   * 
+  * Each property gets one shared memory stream, named `device.property`, which is a time-series ring (see
+  * utils::tsRing) with one float column per configured element, in the order they are listed in the configuration.
+  * Each update of the property writes one sample of all columns, with the property timestamp as the sample time.
+  * Elements missing from an update keep their previous value.  Consistent time windows, and downsampled views, are
+  * read with utils::tsRingReader.
+  *
   * \ingroup indiTSAccumulator
   */
 class indiTSAccumulator : public MagAOXApp<true>
@@ -51,25 +60,50 @@ protected:
    
    ///@}
 
-   struct element
+   struct property
    {
-      std::string m_name;
-      
-      timespec m_lastUpdate {0,0};
+      pcf::IndiProperty m_property;
+
+      std::vector<std::string> m_elements; ///< The element names, in column order
 
-      IMAGE * m_imageStream {nullptr};
+      IMAGE * m_imageStream {nullptr}; ///< The time-series ring for all elements of this property
 
-      explicit element(const std::string & el) : m_name{el}
-      {}
+      utils::tsRing m_ring; ///< The ring pointers into m_imageStream
+
+      std::vector<float> m_row; ///< The latest value of each element
+
+      std::vector<std::pair<std::string, size_t>> m_columns; ///< The element names and their columns, sorted by name at startup
    };
 
-   struct property
+   /// Compare a device.property key to an INDI property, without building the property's key.
+   /**
+     * \returns < 0 if key is before the property's key, 0 if they are equal, and > 0 if it is after
+     */
+   static int compareKey( const std::string & key,
+                          const pcf::IndiProperty & ip
+                        )
    {
-      pcf::IndiProperty m_property;
-      std::vector<element> m_elements;
+      const std::string & dev = ip.getDevice();
+      int c = key.compare(0, dev.size(), dev);
+      if(c != 0) return c;
+
+      if(key.size() == dev.size()) return -1;
+      if(key[dev.size()] != '.') return static_cast<unsigned char>(key[dev.size()]) < '.' ? -1 : 1;
+
+      return key.compare(dev.size()+1, std::string::npos, ip.getName());
+   }
+
+   /// Orders the device.property keys, and allows them to be looked up by the INDI property itself
+   struct keyLess
+   {
+      typedef void is_transparent;
+
+      bool operator()(const std::string & a, const std::string & b) const { return a < b; }
+      bool operator()(const std::string & a, const pcf::IndiProperty & b) const { return compareKey(a, b) < 0; }
+      bool operator()(const pcf::IndiProperty & a, const std::string & b) const { return compareKey(b, a) > 0; }
    };
 
-   std::map<std::string, property> m_properties;
+   std::map<std::string, property, keyLess> m_properties;
 
 
    static int st_setCallBack_all( void * app, const pcf::IndiProperty &ipRecv)
@@ -169,7 +203,7 @@ int indiTSAccumulator::loadConfigImpl( mx::app::appConfigurator & _config )
 
          m_properties[key].m_property.setDevice(devName);
          m_properties[key].m_property.setName(propName);
-         m_properties[key].m_elements.push_back(element(elName));
+         m_properties[key].m_elements.push_back(elName);
       }
       catch(const std::exception& e)
       {
@@ -200,32 +234,29 @@ int indiTSAccumulator::appStartup()
          return -1;
       }
 
-      for(size_t n=0; n < it->second.m_elements.size(); ++n)
-      {
-         it->second.m_elements[n].m_imageStream = (IMAGE *) malloc(sizeof(IMAGE));
+      it->second.m_imageStream = (IMAGE *) malloc(sizeof(IMAGE));
          
-         uint32_t imsize[3] = {0,0,0};
-         imsize[0] = 1; 
-         imsize[1] = 1;
-         imsize[2] = m_maxEntries;
-         std::string shmimName = devName + "." + propName + "." + it->second.m_elements[n].m_name;
+      uint32_t imsize[3] = {0,0,0};
+      imsize[0] = it->second.m_elements.size(); 
+      imsize[1] = 1;
+      imsize[2] = m_maxEntries;
+      std::string shmimName = devName + "." + propName;
       
-         std::cerr << "Creating: " << shmimName << " " << imsize[0] << " " << imsize[1] << " " << imsize[2] << "\n";
-      
-         ImageStreamIO_createIm_gpu(it->second.m_elements[n].m_imageStream, shmimName.c_str(), 3, imsize, IMAGESTRUCT_FLOAT, -1, 1, IMAGE_NB_SEMAPHORE, 0, CIRCULAR_BUFFER | ZAXIS_TEMPORAL, 0);
+      if(ImageStreamIO_createIm_gpu(it->second.m_imageStream, shmimName.c_str(), 3, imsize, IMAGESTRUCT_FLOAT, -1, 1, IMAGE_NB_SEMAPHORE, 0, CIRCULAR_BUFFER | ZAXIS_TEMPORAL, 0) != 0)
+      {
+         log<software_critical>({__FILE__, __LINE__, "Error creating stream: " + shmimName});
+         return -1;
+      }
 
-         it->second.m_elements[n].m_imageStream->md->cnt1 = it->second.m_elements[n].m_imageStream->md->size[2] - 1;
+      it->second.m_ring = utils::tsRingFromImage(it->second.m_imageStream);
+      utils::tsRingInit(it->second.m_ring);
 
-         it->second.m_elements[n].m_imageStream->md->atime = {0,0};
-         it->second.m_elements[n].m_imageStream->md->writetime = {0,0};
+      it->second.m_row.assign(it->second.m_elements.size(), 0);
 
-         for(size_t m = 0; m < it->second.m_elements[n].m_imageStream->md->size[2]; ++m )
-         {
-            it->second.m_elements[n].m_imageStream->cntarray[m] = std::numeric_limits<uint64_t>::max();
-            it->second.m_elements[n].m_imageStream->atimearray[m] = {0,0};
-            it->second.m_elements[n].m_imageStream->writetimearray[m] = {0,0};
-         }
-      }
+      //Sort the columns by element name, the order of the elements of an update, so the callback can match them in one pass
+      it->second.m_columns.clear();
+      for(size_t n = 0; n < it->second.m_elements.size(); ++n) it->second.m_columns.push_back({it->second.m_elements[n], n});
+      std::sort(it->second.m_columns.begin(), it->second.m_columns.end());
    }
 
    return 0;
@@ -243,67 +274,55 @@ int indiTSAccumulator::appShutdown()
 
 int indiTSAccumulator::setCallBack_all( const pcf::IndiProperty &ipRecv )
 {
-   std::string key = ipRecv.createUniqueKey();
-   if(m_properties.count(key) > 0)
-   {
-      if(ipRecv.getType() != pcf::IndiProperty::Number) 
-      {
-         log<text_log>(key + " is not a Number property.  Can't time-series this.", logPrio::LOG_WARNING);
-         return -1; //only numbers are supported for now.
-      }
+   auto it = m_properties.find(ipRecv);
+   if(it == m_properties.end()) return 0;
 
-      //Now look for this property's elements
-      for(size_t n=0; n < m_properties[key].m_elements.size(); ++n)
-      {
-         if(!ipRecv.find( m_properties[key].m_elements[n].m_name)) continue;
+   property & prop = it->second;
 
-         IMAGE * image = m_properties[key].m_elements[n].m_imageStream;
+   if(ipRecv.getType() != pcf::IndiProperty::Number) 
+   {
+      log<text_log>(it->first + " is not a Number property.  Can't time-series this.", logPrio::LOG_WARNING);
+      return -1; //only numbers are supported for now.
+   }
+
+   IMAGE * image = prop.m_imageStream;
          
-         if(image == nullptr) 
-         {
-            log<software_error>({__FILE__, __LINE__, "Image for " + key + "." + m_properties[key].m_elements[n].m_name + " is nullptr"});
-            continue;
-         }
-
-         timespec ts;
-         ts.tv_sec = ipRecv.getTimeStamp().getTimeValSecs();
-         ts.tv_nsec = ipRecv.getTimeStamp().getTimeValMicros()*1000;
-
-         if(ts.tv_sec != image->md->atime.tv_sec || ts.tv_nsec != image->md->atime.tv_nsec)
-         {
-            //Get the value as a float
-            float val = ipRecv[ m_properties[key].m_elements[n].m_name].get<float>();
-
-            //Get cnt1 and rollover if needed
-            uint64_t cnt1 = image->md->cnt1 + 1;
-            if(cnt1 >= image->md->size[2]) cnt1 = 0;
-
-            //Set the writing flag
-            image->md->write=1;
-
-            //Set the times            
-            clock_gettime(CLOCK_REALTIME, &image->md->writetime);
-            image->writetimearray[cnt1] = image->md->writetime;
-
-            image->md->atime = ts;
-            image->atimearray[cnt1] = ts;
-            
-            //Set the value
-            image->array.F[cnt1] = val;
-            
-            //Now update counters
-            image->md->cnt0++;
-            image->cntarray[cnt1] = image->md->cnt0;
-            image->md->cnt1 = cnt1;
-
-            //And post
-            image->md->write=0;
-            ImageStreamIO_sempost(image,-1);
-            std::cerr << ipRecv.createUniqueKey() << " " << ts.tv_sec << " " << ts.tv_nsec << "\n";
-         }
+   if(image == nullptr) 
+   {
+      log<software_error>({__FILE__, __LINE__, "Image for " + it->first + " is nullptr"});
+      return -1;
+   }
+
+   timespec ts;
+   ts.tv_sec = ipRecv.getTimeStamp().getTimeValSecs();
+   ts.tv_nsec = ipRecv.getTimeStamp().getTimeValMicros()*1000;
+
+   if(ts.tv_sec == image->md->atime.tv_sec && ts.tv_nsec == image->md->atime.tv_nsec) return 0;
+
+   //Update the columns present in this update, the rest keep their last value.
+   //The update's elements are in name order, as are m_columns, so they are matched in one pass.
+   const std::map<std::string, pcf::IndiElement> & elements = ipRecv.getElements();
+   auto el = elements.begin();
+   size_t n = 0;
+   while(el != elements.end() && n < prop.m_columns.size())
+   {
+      int c = el->first.compare(prop.m_columns[n].first);
+      if(c < 0) ++el;
+      else if(c > 0) ++n;
+      else
+      {
+         prop.m_row[prop.m_columns[n].second] = el->second.get<float>();
+         ++n; //the same element may be in more than one column
       }
    }
 
+   timespec wt;
+   clock_gettime(CLOCK_REALTIME, &wt);
+
+   utils::tsRingPush(prop.m_ring, prop.m_row.data(), ts, wt);
+
+   ImageStreamIO_sempost(image,-1);
+
    return 0;
 }
 
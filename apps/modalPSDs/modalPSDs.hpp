@@ -17,6 +17,9 @@
 #include <mx/math/fft/fftwEnvironment.hpp>
 #include <mx/math/fft/fft.hpp>
 
+#include <atomic>
+#include <condition_variable>
+
 /** \defgroup modalPSDs
   * \brief An application to calculate rolling PSDs of modal amplitudes
   *
@@ -90,17 +93,97 @@ protected:
 
    std::vector<realT> m_win; ///< The window function.  By default this is Hann.
    
-   realT * m_tsWork {nullptr};
-   size_t m_tsWorkSize {0};
-   
-   std::complex<realT> * m_fftWork {nullptr};
-   size_t m_fftWorkSize {0};
-   
    std::vector<realT> m_psd;
 
-   mx::math::fft::fftT< realT, std::complex<realT>, 1, 0> m_fft;
    mx::math::fft::fftwEnvironment<realT> m_fftEnv;
 
+   /** \name Batched PSD Calculation
+     * The modes are divided into blocks of m_blockModes.  For each block the time series are transposed from the
+     * frame-major circular buffer into mode-major rows of a work buffer, and then transformed with a single batched
+     * real-to-complex FFT.  The blocks are shared out between the PSD thread and m_nPSDThreads-1 worker threads.
+     * @{
+     */
+   int m_nPSDThreads {1}; ///< The total number of threads calculating PSDs, including the PSD thread.  The default is 1.
+
+   int m_blockModes {32}; ///< The number of modes in each block, which is the batch size of the FFT.  The default is 32.
+
+   /// Working memory for one thread
+   struct psdWorkspace
+   {
+      realT * m_ts {nullptr}; ///< The time series of the modes in the block, one row of m_tsSize per mode.
+      complexT * m_fft {nullptr}; ///< The FFT of the block, one row of m_tsSize/2+1 per mode.
+      std::vector<double> m_mean; ///< The mean of each mode in the block.
+      std::vector<double> m_var; ///< The variance of each mode in the block.
+   };
+
+   std::vector<psdWorkspace> m_workspaces; ///< One workspace per thread.  Index 0 belongs to the PSD thread.
+
+   fftwf_plan m_fftPlan {nullptr}; ///< The batched FFT plan, for m_blockModes time series of length m_tsSize.
+
+   size_t m_nBlocks {0}; ///< The number of blocks of modes.  Protected by m_workMutex.
+
+   ampCircBuffT::indexT m_workStart {0}; ///< The circular buffer index of the first sample in the current calculation.
+
+   std::atomic<size_t> m_nextBlock {0}; ///< The next block to be calculated.
+
+   size_t m_blocksDone {0}; ///< The number of blocks finished in the current calculation.  Protected by m_workMutex.
+
+   uint64_t m_workCycle {0}; ///< Incremented to start the workers on a calculation.  Protected by m_workMutex.
+
+   bool m_workOpen {false}; ///< True while workers may join the current calculation.  Protected by m_workMutex.
+
+   size_t m_workersBusy {0}; ///< The number of workers in the current calculation.  Protected by m_workMutex.
+
+   bool m_workersExit {false}; ///< Flag telling the workers to exit.  Protected by m_workMutex.
+
+   std::mutex m_workMutex; ///< Mutex for synchronizing the workers
+
+   std::condition_variable m_workCond; ///< Signals the workers to start a calculation.
+
+   std::condition_variable m_doneCond; ///< Signals that all blocks are finished, or that a worker has left the calculation.
+
+   std::vector<std::thread> m_psdWorkers; ///< The worker threads.
+
+   /// Close the current calculation to the workers, and wait for any still in it to leave.
+   /** After this returns no worker touches the workspaces until the next calculation is started.
+     */
+   void quiesceWorkers();
+
+   /// Free the FFT plan and the workspaces.
+   void freeWorkspaces();
+
+   /// Calculate the PSDs of the modes in one block.
+   void psdBlock( size_t nb,          ///< [in] the block to calculate
+                  psdWorkspace & ws   ///< [in] working memory for the calling thread
+                );
+
+   /// Calculate blocks until none are left in the current calculation.
+   void psdBlocks( psdWorkspace & ws, ///< [in] working memory for the calling thread
+                   size_t nBlocks     ///< [in] the number of blocks in the current calculation
+                 );
+
+   /// Worker thread function
+   /** Runs until m_workersExit is true.
+     */
+   void psdWorkerExec( size_t w /**< [in] the index of this worker's workspace */);
+
+   ///@}
+
+   /** \name PSD Averaging
+     * The average PSD is a running sum of the last nPSDAverage raw PSDs.  Each calculation adds the new raw PSD and
+     * subtracts the one which has left the average, read back from the raw PSD stream.
+     * @{
+     */
+   Eigen::Array<double, -1, -1> m_psdSum; ///< The running sum of the raw PSDs in the average.
+
+   int m_nInSum {0}; ///< The number of raw PSDs in m_psdSum.
+
+   int m_nPSDAverage {0}; ///< The number of raw PSDs to average, as of the last calculation.
+
+   int m_nRawValid {0}; ///< The number of raw PSDs written to the stream since it was allocated, up to its length.
+   
+   ///@}
+
    /** \name PSD Calculation Thread
      * Handling of offloads from the average woofer shape
      * @{
@@ -215,6 +298,9 @@ void modalPSDs::setupConfig()
    config.add("circBuff.fpsSource", "", "circBuff.fpsSource", argType::Required, "circBuff", "fpsSource", false, "string", "Device name for getting fps to set circular buffer length.  This device should have *.fps.current.");
    config.add("circBuff.defaultFPS", "", "circBuff.defaultFPS", argType::Required, "circBuff", "defaultFPS", false, "realT", "Default FPS at startup, will enable changing average length with psdTime before INDI available.");
    config.add("circBuff.psdTime", "", "circBuff.psdTime", argType::Required, "circBuff", "psdTime", false, "realT", "The length of time over which to calculate PSDs.  The default is 1 sec.");
+
+   config.add("psdCalc.threads", "", "psdCalc.threads", argType::Required, "psdCalc", "threads", false, "int", "The number of threads calculating PSDs.  The default is 1.");
+   config.add("psdCalc.blockModes", "", "psdCalc.blockModes", argType::Required, "psdCalc", "blockModes", false, "int", "The number of modes transformed in each batched FFT.  The default is 32.");
 }
 
 int modalPSDs::loadConfigImpl( mx::app::appConfigurator & _config )
@@ -225,6 +311,12 @@ int modalPSDs::loadConfigImpl( mx::app::appConfigurator & _config )
    _config(m_fps, "circBuff.defaultFPS");
    _config(m_psdTime, "circBuff.psdTime");
 
+   _config(m_nPSDThreads, "psdCalc.threads");
+   if(m_nPSDThreads < 1) m_nPSDThreads = 1;
+
+   _config(m_blockModes, "psdCalc.blockModes");
+   if(m_blockModes < 1) m_blockModes = 1;
+
    return 0;
 }
 
@@ -270,6 +362,12 @@ int modalPSDs::appStartup()
       return -1;
    }
 
+   m_workspaces.resize(m_nPSDThreads);
+   for(int w = 1; w < m_nPSDThreads; ++w)
+   {
+      m_psdWorkers.emplace_back(&modalPSDs::psdWorkerExec, this, w);
+   }
+
    if(shmimMonitorT::appStartup() < 0)
    {
       return log<software_error,-1>({__FILE__, __LINE__});
@@ -319,6 +417,19 @@ int modalPSDs::appShutdown()
       }
    }
 
+   {
+      std::lock_guard<std::mutex> lock(m_workMutex);
+      m_workersExit = true;
+   }
+   m_workCond.notify_all();
+
+   for(size_t w = 0; w < m_psdWorkers.size(); ++w)
+   {
+      if(m_psdWorkers[w].joinable()) m_psdWorkers[w].join();
+   }
+
+   freeWorkspaces();
+
    return 0;
 }
 
@@ -374,17 +485,40 @@ int modalPSDs::allocate( const dev::shmimT & dummy)
    m_win.resize(m_tsSize);
    mx::sigproc::window::hann(m_win);
 
-   //Set up the FFT and working memory
-   m_fft.plan(m_tsSize, MXFFT_FORWARD, false);
-   
-   if(m_tsWork) fftw_free(m_tsWork);
-   m_tsWork = mx::math::fft::fftw_malloc<realT>( m_tsSize );
-   
-   if(m_fftWork) fftw_free(m_fftWork);
-   m_fftWork = mx::math::fft::fftw_malloc<std::complex<realT>>( (m_tsSize/2 + 1) );
-
    m_psd.resize(m_tsSize/2 + 1);
 
+   //Set up the FFT and working memory.  The PSD thread is waiting, and no worker can start until it opens the
+   //next calculation.
+   quiesceWorkers();
+
+   freeWorkspaces();
+
+   {
+      std::lock_guard<std::mutex> lock(m_workMutex);
+      m_nBlocks = (m_nModes + m_blockModes - 1)/m_blockModes;
+   }
+
+   for(size_t w = 0; w < m_workspaces.size(); ++w)
+   {
+      m_workspaces[w].m_ts = mx::math::fft::fftw_malloc<realT>( m_blockModes*m_tsSize );
+      m_workspaces[w].m_fft = mx::math::fft::fftw_malloc<complexT>( m_blockModes*m_psd.size() );
+      m_workspaces[w].m_mean.resize(m_blockModes);
+      m_workspaces[w].m_var.resize(m_blockModes);
+   }
+
+   //One plan for all threads, executed on each thread's own arrays with the new-array interface.
+   int n = m_tsSize;
+   m_fftPlan = fftwf_plan_many_dft_r2c( 1, &n, m_blockModes,
+                                        m_workspaces[0].m_ts, nullptr, 1, m_tsSize,
+                                        reinterpret_cast<fftwf_complex *>(m_workspaces[0].m_fft), nullptr, 1, m_psd.size(),
+                                        FFTW_MEASURE );
+
+   if(m_fftPlan == nullptr)
+   {
+      log<software_error>({__FILE__,__LINE__, "error creating batched FFT plan"});
+      return -1;
+   }
+
    if(m_fps > 0)
    {
       m_df = 1.0/(m_tsSize/m_fps);
@@ -471,6 +605,12 @@ int modalPSDs::allocatePSDStreams()
    
    m_psdBuffer.resize(m_psd.size(), m_nModes);
 
+   m_psdSum.resize(m_psd.size(), m_nModes);
+   m_psdSum.setZero();
+   m_nInSum = 0;
+   m_nPSDAverage = 0;
+   m_nRawValid = 0;
+
    return 0;
 }
 
@@ -492,6 +632,146 @@ void modalPSDs::psdThreadStart( modalPSDs * p )
    p->psdThreadExec();
 }
 
+void modalPSDs::quiesceWorkers()
+{
+   std::unique_lock<std::mutex> lock(m_workMutex);
+   m_workOpen = false;
+   m_doneCond.wait(lock, [this]{ return m_workersBusy == 0; });
+}
+
+void modalPSDs::freeWorkspaces()
+{
+   if(m_fftPlan) fftwf_destroy_plan(m_fftPlan);
+   m_fftPlan = nullptr;
+
+   for(size_t w = 0; w < m_workspaces.size(); ++w)
+   {
+      if(m_workspaces[w].m_ts) fftw_free(m_workspaces[w].m_ts);
+      m_workspaces[w].m_ts = nullptr;
+
+      if(m_workspaces[w].m_fft) fftw_free(m_workspaces[w].m_fft);
+      m_workspaces[w].m_fft = nullptr;
+   }
+}
+
+void modalPSDs::psdBlock( size_t nb,
+                          psdWorkspace & ws
+                        )
+{
+   size_t m0 = nb*m_blockModes;
+   size_t nm = std::min<size_t>(m_blockModes, m_nModes - m0);
+   size_t nf = m_psd.size();
+
+   //get mean going over entire TS
+   for(size_t k = 0; k < nm; ++k) ws.m_mean[k] = 0;
+
+   for(size_t n = 0; n < m_ampCircBuff.size(); ++n)
+   {
+      const realT * frame = m_ampCircBuff[n] + m0;
+      for(size_t k = 0; k < nm; ++k) ws.m_mean[k] += frame[k];
+   }
+
+   for(size_t k = 0; k < nm; ++k) ws.m_mean[k] /= m_ampCircBuff.size();
+
+   //Transpose the block from frame-major to mode-major, removing the mean.
+   //Each frame contributes a short contiguous read, and each mode's row is written sequentially.
+   for(size_t n = 0; n < m_tsSize; ++n)
+   {
+      const realT * frame = m_ampCircBuff.at(m_workStart,n) + m0;
+      for(size_t k = 0; k < nm; ++k)
+      {
+         ws.m_ts[k*m_tsSize + n] = frame[k] - ws.m_mean[k];
+      }
+   }
+
+   //The last block can be short, and the unused rows are zeroed so the FFT is well behaved.
+   if(nm < (size_t) m_blockModes) memset(ws.m_ts + nm*m_tsSize, 0, (m_blockModes - nm)*m_tsSize*sizeof(realT));
+
+   for(size_t k = 0; k < nm; ++k)
+   {
+      realT * ts = ws.m_ts + k*m_tsSize;
+
+      double v = 0;
+      for(size_t n = 0; n < m_tsSize; ++n)
+      {
+         v += ts[n]*ts[n];
+         ts[n] *= m_win[n];
+      }
+      ws.m_var[k] = v/m_tsSize;
+   }
+
+   fftwf_execute_dft_r2c(m_fftPlan, ws.m_ts, reinterpret_cast<fftwf_complex *>(ws.m_fft));
+
+   for(size_t k = 0; k < nm; ++k)
+   {
+      const complexT * ft = ws.m_fft + k*nf;
+      realT * psd = m_psdBuffer.data() + (m0 + k)*m_psdBuffer.rows(); //column-major, so each mode is contiguous
+
+      double nrm = 0;
+      for(size_t n = 0; n < nf; ++n)
+      {
+         psd[n] = norm(ft[n]);
+         nrm += psd[n] * m_df;
+      }
+
+      realT scale = (nrm > 0) ? ws.m_var[k]/nrm : 0;
+      for(size_t n = 0; n < nf; ++n)
+      {
+         psd[n] *= scale;
+      }
+   }
+}
+
+void modalPSDs::psdBlocks( psdWorkspace & ws,
+                           size_t nBlocks
+                         )
+{
+   size_t nDone = 0;
+
+   size_t nb;
+   while( (nb = m_nextBlock.fetch_add(1)) < nBlocks )
+   {
+      psdBlock(nb, ws);
+      ++nDone;
+   }
+
+   if(nDone > 0)
+   {
+      std::lock_guard<std::mutex> lock(m_workMutex);
+      m_blocksDone += nDone;
+      if(m_blocksDone >= nBlocks) m_doneCond.notify_all();
+   }
+}
+
+void modalPSDs::psdWorkerExec( size_t w )
+{
+   uint64_t lastCycle = 0;
+
+   while(1)
+   {
+      size_t nBlocks;
+
+      {
+         std::unique_lock<std::mutex> lock(m_workMutex);
+         m_workCond.wait(lock, [&]{ return m_workersExit || (m_workOpen && m_workCycle != lastCycle); });
+
+         if(m_workersExit) return;
+
+         lastCycle = m_workCycle;
+         nBlocks = m_nBlocks;
+         ++m_workersBusy;
+      }
+
+      psdBlocks(m_workspaces[w], nBlocks);
+
+      {
+         std::lock_guard<std::mutex> lock(m_workMutex);
+         --m_workersBusy;
+      }
+      m_doneCond.notify_all();
+   }
+}
+
 
 void modalPSDs::psdThreadExec( )
 {
@@ -544,46 +824,72 @@ void modalPSDs::psdThreadExec( )
          std::cerr << "calculating: " << ne0 << " " << m_ampCircBuff.size() << " " << m_tsSize << "\n";
          double t0 = mx::sys::get_curr_time();
 
-         for(size_t m = 0; m < shmimMonitorT::m_width*shmimMonitorT::m_height; ++m) //Loop over each mode
+         //Share the blocks of modes out to the workers, and work on them here too.
+         size_t nBlocks;
          {
-            //get mean going over entire TS
-            float mn = 0;
-            for(size_t n =0; n < m_ampCircBuff.size(); ++n)
-            {
-               realT mn = 0;
-               mn += m_ampCircBuff[n][m];
-            }
-            mn /= m_ampCircBuff.size();
-            
-            double var = 0;
-            for(size_t n = 0; n < m_tsSize; ++n)
-            {
-               m_tsWork[n] = (m_ampCircBuff.at(ne0,n)[m]-mn);
-               var += pow(m_tsWork[n],2);
-               
-               m_tsWork[n] *= m_win[n];
-            }
-            var /= m_tsSize;
+            std::lock_guard<std::mutex> lock(m_workMutex);
+            m_workStart = ne0;
+            m_blocksDone = 0;
+            m_nextBlock = 0;
+            nBlocks = m_nBlocks;
+            m_workOpen = true;
+            ++m_workCycle;
+         }
+         m_workCond.notify_all();
 
-            m_fft( m_fftWork, m_tsWork);
+         psdBlocks(m_workspaces[0], nBlocks);
 
-            double nm = 0;
-            for(size_t n=0; n < m_psd.size(); ++n) 
-            {
-               m_psd[n] = norm(m_fftWork[n]);
-               nm += m_psd[n] * m_df;
-            }
+         {
+            std::unique_lock<std::mutex> lock(m_workMutex);
+            m_doneCond.wait(lock, [&]{ return m_blocksDone >= nBlocks; });
+         }
+
+         //Workers which woke late may still be about to find there is nothing left to do.
+         quiesceWorkers();
 
-            for(size_t n=0; n < m_psd.size(); ++n) 
+         size_t psdSz = m_psdBuffer.rows()*m_psdBuffer.cols();
+
+         uint64_t cnt1 = m_rawpsdStream->md->cnt1 + 1;
+         if(cnt1 >= m_rawpsdStream->md->size[2]) cnt1 = 0;
+
+         //-------------------------- update the running sum ----------------------------
+         //This is done before writing the new raw psd, since the oldest one in the sum can be in the slot it will overwrite.
+
+         int nPSDAverage = (m_psdAvgTime/m_psdTime) / m_psdOverlapFraction;
+
+         if(nPSDAverage <= 0) nPSDAverage = 1;
+         else if((uint64_t) nPSDAverage > m_rawpsdStream->md->size[2]) nPSDAverage = m_rawpsdStream->md->size[2];
+
+         if(nPSDAverage != m_nPSDAverage)
+         {
+            //The average length changed, so re-sum the raw psds which will be in the new average
+            m_psdSum.setZero();
+            m_nInSum = std::min(nPSDAverage - 1, m_nRawValid);
+
+            uint64_t c = cnt1;
+            for(int n = 0; n < m_nInSum; ++n)
             {
-               m_psd[n] *= (var/nm);
+               if(c == 0) c = m_rawpsdStream->md->size[2] - 1;
+               else --c;
+
+               m_psdSum += Eigen::Map<Eigen::Array<float,-1,-1>>(m_rawpsdStream->array.F + psdSz*c, m_psdBuffer.rows(), m_psdBuffer.cols()).cast<double>();
             }
 
-            //Put it in the buffer for uploading to shmim
-            for(size_t n=0; n < m_psd.size(); ++n) m_psdBuffer(n,m) = m_psd[n];
+            m_nPSDAverage = nPSDAverage;
+         }
 
+         while(m_nInSum >= nPSDAverage)
+         {
+            //Remove the oldest raw psd from the sum
+            uint64_t c = (cnt1 + m_rawpsdStream->md->size[2] - m_nInSum) % m_rawpsdStream->md->size[2];
+
+            m_psdSum -= Eigen::Map<Eigen::Array<float,-1,-1>>(m_rawpsdStream->array.F + psdSz*c, m_psdBuffer.rows(), m_psdBuffer.cols()).cast<double>();
+            --m_nInSum;
          }
 
+         m_psdSum += m_psdBuffer.cast<double>();
+         ++m_nInSum;
+
          //------------------------- the raw psds ---------------------------
          m_rawpsdStream->md->write=1;
       
@@ -591,13 +897,10 @@ void modalPSDs::psdThreadExec( )
          clock_gettime(CLOCK_REALTIME, &m_rawpsdStream->md->writetime);
          m_rawpsdStream->md->atime = m_rawpsdStream->md->writetime;
 
-         uint64_t cnt1 = m_rawpsdStream->md->cnt1 + 1;
-         if(cnt1 >= m_rawpsdStream->md->size[2]) cnt1 = 0;
-
          //Move to next pointer
-         float * F = m_rawpsdStream->array.F + m_psdBuffer.rows()*m_psdBuffer.cols()*cnt1;
+         float * F = m_rawpsdStream->array.F + psdSz*cnt1;
 
-         memcpy(F, m_psdBuffer.data(), m_psdBuffer.rows()*m_psdBuffer.cols()*sizeof(float));
+         memcpy(F, m_psdBuffer.data(), psdSz*sizeof(float));
 
          //Update cnt1
          m_rawpsdStream->md->cnt1 = cnt1;
@@ -608,40 +911,16 @@ void modalPSDs::psdThreadExec( )
          m_rawpsdStream->md->write=0;
          ImageStreamIO_sempost(m_rawpsdStream,-1);
 
-         //-------------------------- now average the psds ----------------------------
-
-         int nPSDAverage = (m_psdAvgTime/m_psdTime) / m_psdOverlapFraction;
-
-         if(nPSDAverage <= 0) nPSDAverage = 1;
-         else if((uint64_t) nPSDAverage > m_rawpsdStream->md->size[2]) nPSDAverage = m_rawpsdStream->md->size[2];
-
-         //Move to next pointer
-         F = m_rawpsdStream->array.F + m_psdBuffer.rows()*m_psdBuffer.cols()*cnt1;
-
-         memcpy(m_psdBuffer.data(), F, m_psdBuffer.rows()*m_psdBuffer.cols()*sizeof(float));
-
-         for(int n =1; n < nPSDAverage; ++n)
-         {
-            if(cnt1 == 0) cnt1 = m_rawpsdStream->md->size[2] - 1;
-            else --cnt1;
-
-            F = m_rawpsdStream->array.F + m_psdBuffer.rows()*m_psdBuffer.cols()*cnt1;
-
-            m_psdBuffer += Eigen::Map<Eigen::Array<float,-1,-1>>(F, m_psdBuffer.rows(), m_psdBuffer.cols());
-         }
-
-         m_psdBuffer /= nPSDAverage;
+         if((uint64_t) m_nRawValid < m_rawpsdStream->md->size[2]) ++m_nRawValid;
 
+         //-------------------------- now the average psd ----------------------------
          m_avgpsdStream->md->write=1;
       
          //Set the time of last write
          clock_gettime(CLOCK_REALTIME, &m_avgpsdStream->md->writetime);
          m_avgpsdStream->md->atime = m_avgpsdStream->md->writetime;
 
-         //Move to next pointer
-         F = m_avgpsdStream->array.F;
-
-         memcpy(F, m_psdBuffer.data(), m_psdBuffer.rows()*m_psdBuffer.cols()*sizeof(float));
+         Eigen::Map<Eigen::Array<float,-1,-1>>(m_avgpsdStream->array.F, m_psdBuffer.rows(), m_psdBuffer.cols()) = (m_psdSum / m_nInSum).cast<float>();
 
          //Update cnt1
          m_avgpsdStream->md->cnt1 = 0;
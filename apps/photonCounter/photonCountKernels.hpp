@@ -0,0 +1,445 @@
+/** \file photonCountKernels.hpp
+  * \brief Thresholding and calibration kernels for the photonCounter
+  *
+  * \ingroup photonCounter_files
+  */
+
+#ifndef photonCountKernels_hpp
+#define photonCountKernels_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MagAOX
+{
+namespace app
+{
+
+/// Convert a real threshold to the integer threshold used by countPhotons
+/** For an integer pixel value x, x > t is the same as x > floor(t).  The result is clamped to the range of int32_t.
+  *
+  * \returns floor(t), clamped
+  *
+  * \ingroup photonCounter
+  */
+inline
+int32_t integerThreshold( float t /**< [in] the threshold */)
+{
+   if(!(t > -2147483648.0f)) return std::numeric_limits<int32_t>::min(); //also catches NaN
+   if(t >= 2147483520.0f) return std::numeric_limits<int32_t>::max();
+
+   return static_cast<int32_t>(std::floor(t));
+}
+
+/// Count photons in a range of pixels
+/** Increments counts[i] for each pixel with im[i] > thresh[i].  The loop is branch free, and vectorizes for 8 and 16 bit
+  * input types.
+  *
+  * \ingroup photonCounter
+  */
+template<typename inT>
+void countPhotons( uint32_t * __restrict__ counts,       ///< [in/out] the photon counts
+                   const inT * __restrict__ im,          ///< [in] the image
+                   const int32_t * __restrict__ thresh,  ///< [in] the integer thresholds, see integerThreshold
+                   size_t n                              ///< [in] the number of pixels
+                 )
+{
+   for(size_t i = 0; i < n; ++i)
+   {
+      counts[i] += (static_cast<int32_t>(im[i]) > thresh[i]);
+   }
+}
+
+/// Copy photon counts to a float image, and zero them
+/**
+  * \ingroup photonCounter
+  */
+inline
+void publishCounts( float * __restrict__ out,       ///< [out] the photon counted image
+                    uint32_t * __restrict__ counts, ///< [in/out] the photon counts, zeroed on output
+                    size_t n                        ///< [in] the number of pixels
+                  )
+{
+   for(size_t i = 0; i < n; ++i)
+   {
+      out[i] = counts[i];
+      counts[i] = 0;
+   }
+}
+
+/// Streaming per-pixel quantile and mean estimation
+/** Estimates the q-quantile of the time series of each pixel with the P-squared algorithm (Jain & Chlamtac, 1985),
+  * which tracks 5 markers per pixel, and accumulates the mean.  Memory is 40 bytes per pixel independent of the number
+  * of frames, instead of one float per pixel per frame for storing the whole calibration cube.
+  *
+  * Since every pixel sees every frame, the counts and desired marker positions are shared.  Call nextFrame() once per
+  * frame, and then add() on any partition of the pixels, e.g. from several threads working on separate bands.
+  *
+  * \ingroup photonCounter
+  */
+class pixelQuantiles
+{
+protected:
+   size_t m_nPix {0}; ///< The number of pixels
+
+   float m_q {0.5}; ///< The quantile to estimate
+
+   uint32_t m_n {0}; ///< The number of frames, including the current one after nextFrame()
+
+   float m_desired[3]; ///< The desired positions of the 3 middle markers for the current frame
+
+   /// The P-squared markers of one pixel
+   struct markers
+   {
+      float h[5]; ///< The marker heights
+      int32_t n[3]; ///< The 1-based positions of the 3 middle markers.  The outer markers are at 1 and the frame count.
+   };
+
+   std::vector<markers> m_markers; ///< The markers of each pixel.  For the first 5 frames h holds the values.
+
+   std::vector<double> m_sum; ///< The sum of each pixel
+
+public:
+
+   /// Set the size and the quantile, and reset
+   void resize( size_t nPix, ///< [in] the number of pixels
+                float q      ///< [in] the quantile, from 0 to 1
+              )
+   {
+      m_nPix = nPix;
+      m_q = q;
+      if(m_q < 0) m_q = 0;
+      if(m_q > 1) m_q = 1;
+
+      m_markers.resize(m_nPix);
+      m_sum.resize(m_nPix);
+
+      reset();
+   }
+
+   /// Start over, without changing the size or quantile
+   void reset()
+   {
+      m_n = 0;
+      std::fill(m_sum.begin(), m_sum.end(), 0.0);
+   }
+
+   /// Get the number of pixels
+   size_t nPix() const
+   {
+      return m_nPix;
+   }
+
+   /// Get the quantile being estimated
+   float q() const
+   {
+      return m_q;
+   }
+
+   /// Get the number of frames
+   uint32_t frames() const
+   {
+      return m_n;
+   }
+
+   /// Start a new frame.  Must be called once before add() is called on the pixels of the frame.
+   void nextFrame()
+   {
+      ++m_n;
+
+      float nm1 = m_n - 1;
+      m_desired[0] = 1 + nm1*0.5f*m_q;
+      m_desired[1] = 1 + nm1*m_q;
+      m_desired[2] = 1 + nm1*0.5f*(1+m_q);
+   }
+
+   /// Add the current frame for a range of pixels
+   template<typename inT>
+   void add( const inT * im, ///< [in] the whole image
+             size_t i0,      ///< [in] the first pixel
+             size_t i1       ///< [in] one past the last pixel
+           )
+   {
+      for(size_t i = i0; i < i1; ++i) m_sum[i] += im[i];
+
+      if(m_n <= 5)
+      {
+         //Just collect the first 5 values, sorting them into the markers at the 5th.
+         for(size_t i = i0; i < i1; ++i) m_markers[i].h[m_n-1] = im[i];
+
+         if(m_n == 5)
+         {
+            for(size_t i = i0; i < i1; ++i)
+            {
+               std::sort(m_markers[i].h, m_markers[i].h+5);
+               m_markers[i].n[0] = 2;
+               m_markers[i].n[1] = 3;
+               m_markers[i].n[2] = 4;
+            }
+         }
+         return;
+      }
+
+      const int32_t nN = m_n;
+
+      for(size_t i = i0; i < i1; ++i)
+      {
+         float x = im[i];
+
+         float * h = m_markers[i].h;
+         int32_t n[5] = {1, m_markers[i].n[0], m_markers[i].n[1], m_markers[i].n[2], nN-1};
+
+         //Find the cell, and update the extreme markers
+         int k;
+         if(x < h[0])
+         {
+            h[0] = x;
+            k = 0;
+         }
+         else if(x < h[1]) k = 0;
+         else if(x < h[2]) k = 1;
+         else if(x < h[3]) k = 2;
+         else if(x <= h[4]) k = 3;
+         else
+         {
+            h[4] = x;
+            k = 3;
+         }
+
+         //Increment the positions of the markers above the cell
+         for(int j = k+1; j < 5; ++j) ++n[j];
+
+         //Adjust the middle markers if they are off their desired positions
+         for(int j = 1; j < 4; ++j)
+         {
+            float d = m_desired[j-1] - n[j];
+
+            if( (d >= 1 && n[j+1] - n[j] > 1) || (d <= -1 && n[j-1] - n[j] < -1) )
+            {
+               int s = (d > 0) ? 1 : -1;
+
+               //Parabolic prediction
+               float hp = h[j] + static_cast<float>(s)/(n[j+1]-n[j-1]) *
+                                   ( (n[j]-n[j-1]+s)*(h[j+1]-h[j])/(n[j+1]-n[j]) + (n[j+1]-n[j]-s)*(h[j]-h[j-1])/(n[j]-n[j-1]) );
+
+               if(h[j-1] < hp && hp < h[j+1])
+               {
+                  h[j] = hp;
+               }
+               else //Linear
+               {
+                  h[j] = h[j] + s*(h[j+s]-h[j])/(n[j+s]-n[j]);
+               }
+
+               n[j] += s;
+            }
+         }
+
+         m_markers[i].n[0] = n[1];
+         m_markers[i].n[1] = n[2];
+         m_markers[i].n[2] = n[3];
+      }
+   }
+
+   /// Get the quantile estimates for a range of pixels
+   /** With fewer than 5 frames this is the nearest-rank quantile of the frames so far.  Outputs 0 if there are no frames.
+     */
+   void quantile( float * out, ///< [out] the whole quantile image, only pixels in [i0, i1) are written
+                  size_t i0,   ///< [in] the first pixel
+                  size_t i1    ///< [in] one past the last pixel
+                ) const
+   {
+      if(m_n == 0)
+      {
+         for(size_t i = i0; i < i1; ++i) out[i] = 0;
+         return;
+      }
+
+      if(m_n >= 5)
+      {
+         for(size_t i = i0; i < i1; ++i) out[i] = m_markers[i].h[2];
+         return;
+      }
+
+      size_t idx = m_q*m_n;
+      if(idx >= m_n) idx = m_n - 1;
+
+      float v[5];
+      for(size_t i = i0; i < i1; ++i)
+      {
+         for(size_t j = 0; j < m_n; ++j) v[j] = m_markers[i].h[j];
+         std::sort(v, v+m_n);
+         out[i] = v[idx];
+      }
+   }
+
+   /// Get the means for a range of pixels.  Outputs 0 if there are no frames.
+   void mean( float * out, ///< [out] the whole mean image, only pixels in [i0, i1) are written
+              size_t i0,   ///< [in] the first pixel
+              size_t i1    ///< [in] one past the last pixel
+            ) const
+   {
+      double norm = (m_n > 0) ? 1.0/m_n : 0;
+      for(size_t i = i0; i < i1; ++i) out[i] = m_sum[i]*norm;
+   }
+};
+
+/// A pool of threads which process an image in bands
+/** The image is split into nBands contiguous bands of whole rows.  run() processes band 0 on the calling thread and the
+  * rest on nBands-1 worker threads, and returns when all bands are done.  With 1 band no threads are started and run()
+  * just calls the function.
+  *
+  * \ingroup photonCounter
+  */
+class bandWorkers
+{
+public:
+   /// The band function, called with the context, and the first and one-past-last pixel of the band.
+   typedef void (*bandFuncT)(void *, size_t, size_t);
+
+protected:
+   size_t m_nBands {1}; ///< The number of bands
+   std::vector<size_t> m_bandStart; ///< The first pixel of each band, with the total number of pixels at the end.
+
+   bandFuncT m_func {nullptr}; ///< The function for the current run.  Protected by m_mutex.
+   void * m_ctx {nullptr}; ///< The context for the current run.  Protected by m_mutex.
+
+   uint64_t m_cycle {0}; ///< Incremented to start the workers.  Protected by m_mutex.
+   size_t m_done {0}; ///< The number of worker bands finished in the current cycle.  Protected by m_mutex.
+   bool m_exit {false}; ///< Flag telling the workers to exit.  Protected by m_mutex.
+
+   std::mutex m_mutex; ///< Mutex for synchronizing the workers
+   std::condition_variable m_workCond; ///< Signals the workers to start
+   std::condition_variable m_doneCond; ///< Signals the caller of run() that the workers are done
+
+   std::vector<std::thread> m_workers; ///< The worker threads
+
+public:
+
+   ~bandWorkers()
+   {
+      stop();
+   }
+
+   /// Set the number of bands and the image size, starting the worker threads.
+   /** Any existing workers are stopped first.
+     */
+   void start( size_t nBands, ///< [in] the number of bands.  Limited to the number of rows.
+               size_t width,  ///< [in] the number of pixels in a row
+               size_t height  ///< [in] the number of rows
+             )
+   {
+      stop();
+
+      if(nBands < 1) nBands = 1;
+      if(nBands > height && height > 0) nBands = height;
+      m_nBands = nBands;
+
+      m_bandStart.resize(m_nBands+1);
+      for(size_t b = 0; b <= m_nBands; ++b) m_bandStart[b] = (height*b/m_nBands)*width;
+
+      m_exit = false;
+      for(size_t b = 1; b < m_nBands; ++b)
+      {
+         m_workers.emplace_back(&bandWorkers::workerExec, this, b, m_cycle);
+      }
+   }
+
+   /// Stop the worker threads
+   void stop()
+   {
+      {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         m_exit = true;
+      }
+      m_workCond.notify_all();
+
+      for(size_t w = 0; w < m_workers.size(); ++w)
+      {
+         if(m_workers[w].joinable()) m_workers[w].join();
+      }
+      m_workers.clear();
+   }
+
+   /// Get the number of bands
+   size_t nBands() const
+   {
+      return m_nBands;
+   }
+
+   /// Get the first pixel of a band.  bandStart(nBands()) is the total number of pixels.
+   size_t bandStart( size_t b /**< [in] the band */) const
+   {
+      return m_bandStart[b];
+   }
+
+   /// Process all bands, returning when they are done
+   void run( bandFuncT func, ///< [in] the function to call for each band
+             void * ctx      ///< [in] the context passed to func
+           )
+   {
+      if(m_nBands > 1)
+      {
+         {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_func = func;
+            m_ctx = ctx;
+            m_done = 0;
+            ++m_cycle;
+         }
+         m_workCond.notify_all();
+      }
+
+      func(ctx, m_bandStart[0], m_bandStart[1]);
+
+      if(m_nBands > 1)
+      {
+         std::unique_lock<std::mutex> lock(m_mutex);
+         m_doneCond.wait(lock, [&]{ return m_done >= m_nBands - 1; });
+      }
+   }
+
+protected:
+
+   /// Worker thread function.  Runs until m_exit is true.
+   void workerExec( size_t b,         ///< [in] the band this worker processes
+                    uint64_t lastCycle ///< [in] the cycle when the worker was started
+                  )
+   {
+      while(true)
+      {
+         bandFuncT func;
+         void * ctx;
+
+         {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workCond.wait(lock, [&]{ return m_exit || m_cycle != lastCycle; });
+
+            if(m_exit) return;
+
+            lastCycle = m_cycle;
+            func = m_func;
+            ctx = m_ctx;
+         }
+
+         func(ctx, m_bandStart[b], m_bandStart[b+1]);
+
+         {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_done;
+            if(m_done >= m_nBands - 1) m_doneCond.notify_all();
+         }
+      }
+   }
+};
+
+} //namespace app
+} //namespace MagAOX
+
+#endif //photonCountKernels_hpp
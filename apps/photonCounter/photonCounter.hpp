@@ -9,13 +9,14 @@
 
 #include <limits>
 #include <algorithm>
-#include <mx/improc/eigenCube.hpp>
 #include <mx/improc/eigenImage.hpp>
 using namespace mx::improc;
 
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#include "photonCountKernels.hpp"
+
 namespace MagAOX
 {
 namespace app
@@ -39,55 +40,60 @@ namespace app
   * \ingroup photonCounter
   * 
   */
-class photonCounter : public MagAOXApp<true>, public dev::shmimMonitor<photonCounter>, public dev::frameGrabber<photonCounter>
+class photonCounter : public MagAOXApp<true>, public dev::shmimMonitor<photonCounter>, public dev::transformStream<photonCounter>
 {
 
    //Give the test harness access.
    friend class photonCounter_test;
 
    friend class dev::shmimMonitor<photonCounter>;
-   friend class dev::frameGrabber<photonCounter>;
+   friend class dev::transformStream<photonCounter>;
    
    //The base shmimMonitor type
    typedef dev::shmimMonitor<photonCounter> shmimMonitorT;
    
-   //The base frameGrabber type
-   typedef dev::frameGrabber<photonCounter> frameGrabberT;
+   //The base transformStream type
+   typedef dev::transformStream<photonCounter> transformStreamT;
    
    ///Floating point type in which to do all calculations.
    typedef float realT;
    
-   static constexpr bool c_frameGrabber_flippable = false; ///< app:dev config to tell framegrabber these images can not be flipped
-   
 protected:
 
    /** \name Configurable Parameters
      *@{
      */
    
+   int m_threads {1}; ///< The number of threads, each processing a band of rows.  Default is 1.
+
    ///@}
 
-	sem_t m_smSemaphore; ///< Semaphore used to synchronize the fg thread and the sm thread.
-	realT (*pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
-	void * m_curr_src {nullptr};
+	void * m_curr_src {nullptr}; ///< The current frame, for the band functions.
 
 	int m_image_width;
 	int m_image_height;
 
-	mx::improc::eigenCube<realT> m_calibrationCube;
 	mx::improc::eigenImage<realT> m_dark_image;   
 	mx::improc::eigenImage<realT> m_thresholdImage;
-	mx::improc::eigenImage<realT> m_photonCountedImage;
-	realT m_quantile_cut;
+	realT m_quantile_cut {0.99};
+
+	std::vector<int32_t> m_thresholdInt; ///< The integer thresholds used by countPhotons, calculated from m_thresholdImage.
+	std::vector<uint32_t> m_counts; ///< The photon counts in the current stack.
+
+	pixelQuantiles m_pixelQuantiles; ///< The streaming estimates of the threshold quantile and the dark during calibration.
+
+	bandWorkers m_bands; ///< The threads processing bands of rows.
+
+	bandWorkers::bandFuncT m_calibrateBand {nullptr}; ///< The calibration band function for the stream data type.
+	bandWorkers::bandFuncT m_countBand {nullptr}; ///< The photon counting band function for the stream data type.
 
 	//
-	bool m_calibrate;
-	bool m_calibrationSet;
+	bool m_calibrate {false};
+	bool m_calibrationSet {false};
 
-	int calibration_steps;
-	uint32_t current_calibration_iteration;
-	int m_stack_frames;
-	int m_stack_frames_index;
+	int calibration_steps {1000};
+	int m_stack_frames {1};
+	int m_stack_frames_index {0};
 
    
 public:
@@ -139,46 +145,51 @@ public:
    
 protected:
 
-   /** \name dev::frameGrabber interface
+   /** \name dev::transformStream interface
      *
      * @{
      */
    
-   /// Implementation of the framegrabber configureAcquisition interface
-   /** 
-     * \returns 0 on success
-     * \returns -1 on error
-     */
-   int configureAcquisition();
-   
-   /// Implementation of the framegrabber startAcquisition interface
-   /** 
-     * \returns 0 on success
-     * \returns -1 on error
-     */
-   int startAcquisition();
-   
-   /// Implementation of the framegrabber acquireAndCheckValid interface
-   /** 
+   /// Implementation of the transformStream configureTransform interface
+   /** The output has the same size as the input stream.
+     *
      * \returns 0 on success
      * \returns -1 on error
+     * \returns 1 if the input stream is not yet connected
      */
-   int acquireAndCheckValid();
+   int configureTransform();
    
-   /// Implementation of the framegrabber loadImageIntoStream interface
-   /** 
+   /// Implementation of the transformStream transformImage interface
+   /** Copies the photon counts of the stack to the output, and zeroes them.
+     *
      * \returns 0 on success
      * \returns -1 on error
      */
-   int loadImageIntoStream( void * dest  /**< [in] */);
+   int transformImage( void * dest, ///< [out] the photon counted image
+                       void * src   ///< [in] unused
+                     );
    
-   /// Implementation of the framegrabber reconfig interface
-   /** 
-     * \returns 0 on success
-     * \returns -1 on error
+   ///@}
+
+   /** \name Band Functions
+     * Called by m_bands with this as the context, for the pixels of a band of rows of m_curr_src.
+     * @{
      */
-   int reconfig();
-   
+
+   /// Add the band to the calibration
+   template<typename inT>
+   static void calibrateBand( void * ctx,
+                              size_t i0,
+                              size_t i1
+                            );
+
+   /// Count photons in the band
+   template<typename inT>
+   static void countBand( void * ctx,
+                          size_t i0,
+                          size_t i1
+                        );
+
    ///@}
 	pcf::IndiProperty m_indiP_calibrateToggle;
 	pcf::IndiProperty m_indiP_calibrateSteps;
@@ -206,8 +217,9 @@ inline
 void photonCounter::setupConfig()
 {
 	shmimMonitorT::setupConfig(config);
-	frameGrabberT::setupConfig(config);
+	transformStreamT::setupConfig(config);
 
+	config.add("parameters.threads", "", "parameters.threads", argType::Required, "parameters", "threads", false, "int", "The number of threads used for calibration and thresholding, each processing a band of rows.  Default is 1.");
 	config.add("parameters.quantile", "", "parameters.quantile", argType::Required, "parameters", "quantile", false, "float", "The quantile of the threshold.");
 	config.add("parameters.Nstack", "", "parameters.Nstack", argType::Required, "parameters", "Nstack", false, "string", "The number of frames to stack.");
 	config.add("parameters.Ncalibrate", "", "parameters.Ncalibrate", argType::Required, "parameters", "Ncalibrate", false, "string", "The number of frames for calibration.");
@@ -218,7 +230,10 @@ int photonCounter::loadConfigImpl( mx::app::appConfigurator & _config )
 {
    
 	shmimMonitorT::loadConfig(_config);
-	frameGrabberT::loadConfig(_config);
+	transformStreamT::loadConfig(_config);
+
+	_config(m_threads, "parameters.threads");
+	if(m_threads < 1) m_threads = 1;
 
 	_config(m_stack_frames, "parameters.Nstack");
 	_config(m_quantile_cut, "parameters.quantile");
@@ -236,18 +251,12 @@ void photonCounter::loadConfig()
 inline
 int photonCounter::appStartup()
 {
-   if(sem_init(&m_smSemaphore, 0,0) < 0)
-   {
-      log<software_critical>({__FILE__, __LINE__, errno,0, "Initializing S.M. semaphore"});
-      return -1;
-   }
-   
    if(shmimMonitorT::appStartup() < 0)
    {
       return log<software_error,-1>({__FILE__, __LINE__});
    }
    
-   if(frameGrabberT::appStartup() < 0)
+   if(transformStreamT::appStartup() < 0)
    {
       return log<software_error,-1>({__FILE__, __LINE__});
    }
@@ -280,7 +289,7 @@ int photonCounter::appLogic()
       return log<software_error,-1>({__FILE__,__LINE__});
    }   
    
-   if( frameGrabberT::appLogic() < 0)
+   if( transformStreamT::appLogic() < 0)
    {
       return log<software_error,-1>({__FILE__,__LINE__});
    }
@@ -292,7 +301,7 @@ int photonCounter::appLogic()
       log<software_error>({__FILE__, __LINE__});
    }
       
-   if(frameGrabberT::updateINDI() < 0)
+   if(transformStreamT::updateINDI() < 0)
    {
       log<software_error>({__FILE__, __LINE__});
    }
@@ -309,7 +318,9 @@ int photonCounter::appShutdown()
 {
    shmimMonitorT::appShutdown();
    
-   frameGrabberT::appShutdown();
+   transformStreamT::appShutdown();
+
+   m_bands.stop();
    
    return 0;
 }
@@ -319,11 +330,25 @@ int photonCounter::allocate(const dev::shmimT & dummy)
 {
    static_cast<void>(dummy); //be unused
 
+   switch(shmimMonitorT::m_dataType)
+   {
+      case _DATATYPE_UINT16:
+         m_calibrateBand = calibrateBand<uint16_t>;
+         m_countBand = countBand<uint16_t>;
+         break;
+      case _DATATYPE_INT16:
+         m_calibrateBand = calibrateBand<int16_t>;
+         m_countBand = countBand<int16_t>;
+         break;
+      default:
+         log<software_error>({__FILE__, __LINE__, "unsupported data type, must be uint16 or int16"});
+         return -1;
+   }
+
 	m_image_height = shmimMonitorT::m_height;
 	m_image_width = shmimMonitorT::m_width;
 
-	m_calibrationCube.resize(shmimMonitorT::m_width, shmimMonitorT::m_height, calibration_steps);
-	m_calibrationCube.setZero();
+	size_t nPix = shmimMonitorT::m_width * shmimMonitorT::m_height;
 
 	m_thresholdImage.resize(shmimMonitorT::m_width, shmimMonitorT::m_height);
 	m_thresholdImage.setZero();
@@ -331,17 +356,19 @@ int photonCounter::allocate(const dev::shmimT & dummy)
 	m_dark_image.resize(shmimMonitorT::m_width, shmimMonitorT::m_height);
 	m_dark_image.setZero();
 
-	m_photonCountedImage.resize(shmimMonitorT::m_width, shmimMonitorT::m_height);
-	m_photonCountedImage.setZero();
-	
-	// m_stack_frames = 1;
-	// calibration_steps = 1000;
+	m_thresholdInt.assign(nPix, 0);
+	m_counts.assign(nPix, 0);
+
+	m_pixelQuantiles.resize(nPix, m_quantile_cut);
+
+	m_bands.start(m_threads, shmimMonitorT::m_width, shmimMonitorT::m_height);
 
 	m_calibrate = false;
 	m_calibrationSet = false;
-	current_calibration_iteration = 0;
 	m_stack_frames_index = 0;
 
+	transformStreamT::m_reconfig = true;
+
    	return 0;
 }
 
@@ -352,193 +379,106 @@ int photonCounter::processImage( void * curr_src,
 {
    static_cast<void>(dummy); //be unused
 
-   // Set the internal pointer to the new data stream
-   	Eigen::Map<eigenImage<unsigned short>> camera_image( static_cast<unsigned short *>(curr_src), m_image_height, m_image_width);
-
-   if(m_calibrate){
-	
-	   if(current_calibration_iteration == 0)
-	   		std::cout << "Start data collection" << std::endl;
-		
-		m_calibrationSet = false;
-		
-		// Copy the data into the stream
-		for(uint32_t col_i=0; col_i < m_image_width; ++col_i){
-			for(uint32_t row_i=0; row_i < m_image_height; ++row_i){
-
-				m_calibrationCube.image(current_calibration_iteration)(row_i, col_i) = (float)camera_image(row_i, col_i);
-
-			}
-		}
-
-		current_calibration_iteration += 1;
-
-		if(current_calibration_iteration >= calibration_steps){
-			// We have collected enough data!
-			current_calibration_iteration = 0;
-			m_calibrate = false;
-			m_calibrationSet = true;
-
-			// Measure the average dark frame
-			m_calibrationCube.mean(m_dark_image);
-
-			// Copy the data into the stream
-			for(uint32_t col_i=0; col_i < m_image_width; ++col_i){
-				for(uint32_t row_i=0; row_i < m_image_height; ++row_i){
-					
-					if( col_i == 0){
-					 	std::cout << "The dark : " << m_dark_image(row_i, col_i) << " ";
-					}
-
-					// Get the time-series of the pixel of interest
-					// auto pixelVec = m_calibrationCube.pixel(row_i, col_i);
-					
-					// Dark subtract the timeseries
-					// for(size_t p=0; p<pixelVec.size(); p++){
-					// 	pixelVec(p, 0) = pixelVec(p, 0) - m_dark_image(row_i, col_i);
-					// }
-					std::vector<float> tempVec;
-					for(int ti=0; ti < calibration_steps; ti++){
-						float val = m_calibrationCube.image(ti)(row_i, col_i);
-						tempVec.push_back(val);
-					}
-					
-					// Make it a standard library vector
-					// float* start = &pixelVec(0,0);
-					// float* end = &pixelVec(0,0) + pixelVec.size() * sizeof(float);
-					//
-					// Sort the array
-					std::sort(tempVec.begin(), tempVec.end());
-					
-					// Find the qth quantile
-					int q_index = (int)(m_quantile_cut * tempVec.size());
-					if( col_i == 0 )
-						std::cout <<"q0: [" << tempVec[0] << ", " << tempVec[q_index] << ", " << tempVec[tempVec.size()-1] << "]" << std::endl;
-					
-					m_thresholdImage(row_i, col_i) = tempVec[q_index];
-					
-				}
-			}
-
-			std::cout << "Calibration done!" << std::endl;
-		}
+   m_curr_src = curr_src;
 
+   if(m_calibrate)
+   {
+      if(m_pixelQuantiles.frames() == 0)
+      {
+         //Starting, so pick up the current quantile
+         m_calibrationSet = false;
+         m_pixelQuantiles.resize(m_thresholdInt.size(), m_quantile_cut);
+         log<text_log>("starting calibration with " + std::to_string(calibration_steps) + " frames");
+      }
 
-   }else{
-	   
-		if(m_calibrationSet){
-			// if( m_stack_frames_index == 0 )
-			// 	std::cout << "Start collecting data for stacking..." << std::endl;
+      m_pixelQuantiles.nextFrame();
+      m_bands.run(m_calibrateBand, this);
 
-			// Apply photon counting
-			for(uint32_t col_i=0; col_i < m_image_width; ++col_i){
-				for(uint32_t row_i=0; row_i < m_image_height; ++row_i){
-					float dI = (float)camera_image(row_i, col_i); // - m_dark_image(row_i, col_i);
-					
-					if( dI > m_thresholdImage(row_i, col_i)){
-						m_photonCountedImage(row_i, col_i) += 1.0;
-					}
+      if(m_pixelQuantiles.frames() >= static_cast<uint32_t>(calibration_steps))
+      {
+         // We have collected enough data!
+         size_t nPix = m_thresholdInt.size();
 
-				}
-			}
-			
-			m_stack_frames_index += 1;
+         m_pixelQuantiles.mean(m_dark_image.data(), 0, nPix);
+         m_pixelQuantiles.quantile(m_thresholdImage.data(), 0, nPix);
 
-			if( (m_stack_frames_index >= m_stack_frames) ){
+         for(size_t i = 0; i < nPix; ++i) m_thresholdInt[i] = integerThreshold(m_thresholdImage.data()[i]);
 
-				// std::cout << "Send stacked data..." << std::endl;
-				m_stack_frames_index = 0;
+         m_pixelQuantiles.reset();
+         m_calibrate = false;
+         m_calibrationSet = true;
 
-				//Now tell the f.g. to get going
-				if(sem_post(&m_smSemaphore) < 0)
-				{
-					log<software_critical>({__FILE__, __LINE__, errno, 0, "Error posting to semaphore"});
-					return -1;
-				}
+         log<text_log>("calibration done");
+      }
+   }
+   else if(m_calibrationSet)
+   {
+      // Apply photon counting
+      m_bands.run(m_countBand, this);
 
-			}
+      m_stack_frames_index += 1;
 
-		}
+      if( m_stack_frames_index >= m_stack_frames )
+      {
+         m_stack_frames_index = 0;
 
+         //Publish the stack, which zeroes the counts
+         return transformStreamT::transform(nullptr, shmimMonitorT::m_imageStream.md->atime);
+      }
    }
 
    return 0;
 }
 
 inline
-int photonCounter::configureAcquisition()
+int photonCounter::configureTransform()
 {
-   std::unique_lock<std::mutex> lock(m_indiMutex);
-   
    if(shmimMonitorT::m_width==0 || shmimMonitorT::m_height==0 || shmimMonitorT::m_dataType == 0)
    {
-      //This means we haven't connected to the stream to average. so wait.
-      sleep(1);
-      return -1;
+      //This means we haven't connected to the stream to average.
+      return 1;
    }
    
-   // The frame grabber has the exact same size as the imagestream
-   frameGrabberT::m_width = shmimMonitorT::m_width;
-   frameGrabberT::m_height = shmimMonitorT::m_height;
-   frameGrabberT::m_dataType = _DATATYPE_FLOAT;
+   // The output has the exact same size as the imagestream
+   transformStreamT::m_width = shmimMonitorT::m_width;
+   transformStreamT::m_height = shmimMonitorT::m_height;
+   transformStreamT::m_dataType = _DATATYPE_FLOAT;
    
    return 0;
 }
 
 inline
-int photonCounter::startAcquisition()
+int photonCounter::transformImage( void * dest,
+                                   void * src
+                                 )
 {
-   return 0;
-}
+   static_cast<void>(src); //be unused
 
-inline
-int photonCounter::acquireAndCheckValid()
-{
-   timespec ts;
-         
-   if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
-   {
-      log<software_critical>({__FILE__,__LINE__,errno,0,"clock_gettime"}); 
-      return -1;
-   }
-         
-   ts.tv_sec += 1;
-        
-   if(sem_timedwait(&m_smSemaphore, &ts) == 0)
-   {
-      clock_gettime(CLOCK_REALTIME, &m_currImageTimestamp);
-      return 0;
-   }
-   else
-   {
-      return 1;
-   }
+   publishCounts(static_cast<float *>(dest), m_counts.data(), m_counts.size());
+
+   return 0;
 }
 
-inline
-int photonCounter::loadImageIntoStream(void * dest)
+template<typename inT>
+void photonCounter::calibrateBand( void * ctx,
+                                   size_t i0,
+                                   size_t i1
+                                 )
 {
-   //Here is where we do it.   
-   Eigen::Map<eigenImage<float>> photon_counted_out(static_cast<uint16_t*>(dest), frameGrabberT::m_width, frameGrabberT::m_height );
-   
-	// Copy the data into the stream
-	for(uint32_t col_i=0; col_i < m_image_width; ++col_i){
-		for(uint32_t row_i=0; row_i < m_image_height; ++row_i){
-			
-			photon_counted_out(row_i, col_i) = m_photonCountedImage(row_i, col_i);
-
-			m_photonCountedImage(row_i, col_i) = 0.0;
-
-		}
-	}
+   photonCounter * pc = static_cast<photonCounter *>(ctx);
 
-   return 0;
+   pc->m_pixelQuantiles.add(static_cast<const inT *>(pc->m_curr_src), i0, i1);
 }
 
-inline
-int photonCounter::reconfig()
+template<typename inT>
+void photonCounter::countBand( void * ctx,
+                               size_t i0,
+                               size_t i1
+                             )
 {
-   return 0;
+   photonCounter * pc = static_cast<photonCounter *>(ctx);
+
+   countPhotons(pc->m_counts.data() + i0, static_cast<const inT *>(pc->m_curr_src) + i0, pc->m_thresholdInt.data() + i0, i1 - i0);
 }
 
 
@@ -556,7 +496,6 @@ INDI_NEWCALLBACK_DEFN(photonCounter, m_indiP_calibrateToggle )(const pcf::IndiPr
 	{
 		
 		if(!m_calibrate){
-			std::cout << "Request calibration" << std::endl;
 			m_calibrationSet = false;
 			m_calibrate = true;
 		}
@@ -627,8 +566,6 @@ INDI_NEWCALLBACK_DEFN(photonCounter, m_indiP_calibrateSteps )(const pcf::IndiPro
 	std::lock_guard<std::mutex> guard(m_indiMutex);
 
 	calibration_steps = target;
-	m_calibrationCube.resize(m_image_width, m_image_height, calibration_steps);
-	m_calibrationCube.setZero();
 
 	updateIfChanged(m_indiP_calibrateSteps, "target", calibration_steps);
 
@@ -0,0 +1,331 @@
+/** \file photonCountKernels_test.cpp
+  * \brief Catch2 tests and benchmarks for the photonCounter kernels.
+  *
+  * History:
+  */
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../tests/catch2/catch.hpp"
+
+#include <random>
+#include <string>
+
+#include "../photonCountKernels.hpp"
+
+using namespace MagAOX::app;
+
+namespace photonCountKernels_test
+{
+
+SCENARIO( "Thresholding images", "[photonCounter]" )
+{
+   GIVEN("a uint16 image and real thresholds")
+   {
+      size_t n = 1000;
+      std::vector<uint16_t> im(n);
+      std::vector<float> thresh(n);
+      std::vector<int32_t> ithresh(n);
+
+      std::mt19937 gen(1);
+      std::uniform_int_distribution<int> pix(0, 65535);
+      std::uniform_real_distribution<float> th(-10, 65545);
+
+      for(size_t i = 0; i < n; ++i)
+      {
+         im[i] = pix(gen);
+         thresh[i] = th(gen);
+         if(i % 7 == 0) thresh[i] = im[i]; //equal is not a photon
+         if(i % 11 == 0) thresh[i] = im[i] - 0.5; //just below is a photon
+         ithresh[i] = integerThreshold(thresh[i]);
+      }
+
+      WHEN("counting photons twice")
+      {
+         std::vector<uint32_t> counts(n, 0);
+         countPhotons(counts.data(), im.data(), ithresh.data(), n);
+         countPhotons(counts.data(), im.data(), ithresh.data(), n);
+
+         THEN("each pixel above its threshold is counted each time")
+         {
+            for(size_t i = 0; i < n; ++i)
+            {
+               REQUIRE(counts[i] == 2*(im[i] > thresh[i]));
+            }
+         }
+
+         AND_WHEN("publishing the counts")
+         {
+            std::vector<float> out(n);
+            publishCounts(out.data(), counts.data(), n);
+
+            THEN("the output has the counts, and the counts are zeroed")
+            {
+               for(size_t i = 0; i < n; ++i)
+               {
+                  REQUIRE(out[i] == 2*(im[i] > thresh[i]));
+                  REQUIRE(counts[i] == 0);
+               }
+            }
+         }
+      }
+   }
+
+   GIVEN("out of range thresholds")
+   {
+      THEN("they are clamped")
+      {
+         REQUIRE(integerThreshold(1e12) == std::numeric_limits<int32_t>::max());
+         REQUIRE(integerThreshold(-1e12) == std::numeric_limits<int32_t>::min());
+         REQUIRE(integerThreshold(-0.5) == -1);
+         REQUIRE(integerThreshold(2.999) == 2);
+      }
+   }
+}
+
+SCENARIO( "Streaming calibration", "[photonCounter]" )
+{
+   GIVEN("pixels with gaussian noise about different levels")
+   {
+      size_t nPix = 64;
+      uint32_t nFrames = 5000;
+      float q = 0.9;
+
+      std::mt19937 gen(2);
+      std::normal_distribution<float> noise(0, 10);
+
+      std::vector<std::vector<float>> series(nPix);
+      std::vector<uint16_t> im(nPix);
+
+      pixelQuantiles pq;
+      pq.resize(nPix, q);
+
+      for(uint32_t f = 0; f < nFrames; ++f)
+      {
+         for(size_t i = 0; i < nPix; ++i)
+         {
+            im[i] = std::lround(200 + 10*i + noise(gen));
+            series[i].push_back(im[i]);
+         }
+
+         pq.nextFrame();
+         pq.add(im.data(), 0, nPix/2); //in two bands
+         pq.add(im.data(), nPix/2, nPix);
+      }
+
+      WHEN("getting the quantiles and means")
+      {
+         std::vector<float> qs(nPix), mns(nPix);
+         pq.quantile(qs.data(), 0, nPix);
+         pq.mean(mns.data(), 0, nPix);
+
+         THEN("they match the exact values to within a small fraction of the noise")
+         {
+            REQUIRE(pq.frames() == nFrames);
+
+            for(size_t i = 0; i < nPix; ++i)
+            {
+               std::sort(series[i].begin(), series[i].end());
+               float exact = series[i][(size_t)(q*nFrames)];
+               REQUIRE(fabs(qs[i] - exact) < 1.5);
+
+               double mn = 0;
+               for(float v : series[i]) mn += v;
+               mn /= nFrames;
+               REQUIRE(mns[i] == Approx(mn).epsilon(1e-6));
+            }
+         }
+      }
+   }
+
+   GIVEN("fewer than 5 frames")
+   {
+      pixelQuantiles pq;
+      pq.resize(2, 0.5);
+
+      std::vector<uint16_t> vals[3] = {{30, 3}, {10, 1}, {20, 2}};
+
+      for(int f = 0; f < 3; ++f)
+      {
+         pq.nextFrame();
+         pq.add(vals[f].data(), 0, 2);
+      }
+
+      THEN("the quantile is the nearest rank")
+      {
+         std::vector<float> qs(2);
+         pq.quantile(qs.data(), 0, 2);
+         REQUIRE(qs[0] == 20);
+         REQUIRE(qs[1] == 2);
+      }
+
+      THEN("resetting starts over")
+      {
+         pq.reset();
+         REQUIRE(pq.frames() == 0);
+
+         std::vector<float> qs(2);
+         pq.mean(qs.data(), 0, 2);
+         REQUIRE(qs[0] == 0);
+      }
+   }
+}
+
+/// Adds 1 to each pixel of a band, for testing bandWorkers
+void addOne( void * ctx,
+             size_t i0,
+             size_t i1
+           )
+{
+   uint32_t * im = static_cast<uint32_t *>(ctx);
+   for(size_t i = i0; i < i1; ++i) ++im[i];
+}
+
+SCENARIO( "Processing images in bands", "[photonCounter]" )
+{
+   GIVEN("an image which does not divide evenly into bands")
+   {
+      size_t width = 13;
+      size_t height = 37;
+      std::vector<uint32_t> im(width*height, 0);
+
+      bandWorkers bands;
+
+      for(size_t nBands : {1, 3, 8})
+      {
+         WHEN("processing it " + std::to_string(nBands) + " bands at a time, many times")
+         {
+            bands.start(nBands, width, height);
+            for(int n = 0; n < 100; ++n) bands.run(addOne, im.data());
+
+            THEN("every pixel is processed once per run, and bands are whole rows")
+            {
+               REQUIRE(bands.nBands() == nBands);
+               for(size_t i = 0; i < im.size(); ++i) REQUIRE(im[i] == 100);
+               for(size_t b = 0; b <= bands.nBands(); ++b) REQUIRE(bands.bandStart(b) % width == 0);
+               REQUIRE(bands.bandStart(bands.nBands()) == im.size());
+            }
+
+            AND_WHEN("restarting with a different number of bands")
+            {
+               bands.start(nBands+1, width, height);
+               bands.run(addOne, im.data());
+
+               THEN("stale work is not repeated")
+               {
+                  for(size_t i = 0; i < im.size(); ++i) REQUIRE(im[i] == 101);
+               }
+            }
+         }
+      }
+   }
+}
+
+/// The context for the benchmark band functions
+struct benchCtx
+{
+   uint32_t * counts;
+   const uint16_t * im;
+   const int32_t * thresh;
+   pixelQuantiles * pq;
+};
+
+void benchCount( void * ctx,
+                 size_t i0,
+                 size_t i1
+               )
+{
+   benchCtx * c = static_cast<benchCtx *>(ctx);
+   countPhotons(c->counts + i0, c->im + i0, c->thresh + i0, i1 - i0);
+}
+
+void benchCalib( void * ctx,
+                 size_t i0,
+                 size_t i1
+               )
+{
+   benchCtx * c = static_cast<benchCtx *>(ctx);
+   c->pq->add(c->im, i0, i1);
+}
+
+TEST_CASE( "Benchmark photon counting", "[.benchmark][photonCounter]" )
+{
+   for(size_t sz : {512, 1024})
+   {
+      size_t nPix = sz*sz;
+
+      std::vector<uint16_t> im(nPix);
+      std::vector<int32_t> thresh(nPix);
+      std::vector<float> fthresh(nPix);
+      std::vector<uint32_t> counts(nPix, 0);
+
+      std::mt19937 gen(3);
+      std::normal_distribution<float> noise(1000, 30);
+      for(size_t i = 0; i < nPix; ++i)
+      {
+         im[i] = noise(gen);
+         fthresh[i] = 1100;
+         thresh[i] = integerThreshold(fthresh[i]);
+      }
+
+      //Calibration is benchmarked on a sequence of different frames, after the markers have settled.
+      std::vector<std::vector<uint16_t>> calFrames(8, std::vector<uint16_t>(nPix));
+      for(size_t f = 0; f < calFrames.size(); ++f)
+      {
+         for(size_t i = 0; i < nPix; ++i) calFrames[f][i] = noise(gen);
+      }
+
+      pixelQuantiles pq;
+      pq.resize(nPix, 0.99);
+      for(int n = 0; n < 100; ++n)
+      {
+         pq.nextFrame();
+         pq.add(calFrames[n % calFrames.size()].data(), 0, nPix);
+      }
+
+      benchCtx ctx {counts.data(), im.data(), thresh.data(), &pq};
+
+      std::string s = std::to_string(sz) + "x" + std::to_string(sz);
+
+      //The loop in the original processImage, for comparison
+      BENCHMARK("threshold scalar float " + s)
+      {
+         for(size_t i = 0; i < nPix; ++i)
+         {
+            float dI = im[i];
+            if(dI > fthresh[i]) counts[i] += 1;
+         }
+         return counts[0];
+      };
+
+      BENCHMARK("threshold kernel " + s)
+      {
+         countPhotons(counts.data(), im.data(), thresh.data(), nPix);
+         return counts[0];
+      };
+
+      bandWorkers bands;
+      for(size_t nb : {2, 4})
+      {
+         bands.start(nb, sz, sz);
+         BENCHMARK("threshold kernel " + s + " " + std::to_string(nb) + " bands")
+         {
+            bands.run(benchCount, &ctx);
+            return counts[0];
+         };
+      }
+
+      for(size_t nb : {1, 4})
+      {
+         bands.start(nb, sz, sz);
+         BENCHMARK("calibration frame " + s + " " + std::to_string(nb) + " bands")
+         {
+            ctx.im = calFrames[pq.frames() % calFrames.size()].data();
+            pq.nextFrame();
+            bands.run(benchCalib, &ctx);
+            return pq.frames();
+         };
+      }
+   }
+}
+
+} //namespace photonCountKernels_test
@@ -10,6 +10,8 @@
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#include "../../libMagAOX/utils/runningStats.hpp"
+
 #include <mx/math/fit/fitGaussian.hpp>
 #include <mx/improc/imageFilters.hpp>
 
@@ -112,12 +114,23 @@ protected:
 
     float m_fps {0};
 
-    mx::sigproc::circularBufferIndex<float, cbIndexT> m_xcb;
-    mx::sigproc::circularBufferIndex<float, cbIndexT> m_ycb;
+    utils::runningStats<double> m_xcb; ///< Running statistics of the x position
+    utils::runningStats<double> m_ycb; ///< Running statistics of the y position
+
+    /// Statistics of the fit positions
+    struct fitStats
+    {
+        float mnx {0};
+        float rmsx {0};
+        float mny {0};
+        float rmsy {0};
+    };
+
+    fitStats m_fitStats; ///< The statistics, published by processImage.  Protected by m_statsMutex.
 
-    std::vector<float> m_xcbD;
-    std::vector<float> m_ycbD;
+    std::mutex m_statsMutex; ///< Mutex protecting m_fitStats.
 
+    //The statistics as last copied from m_fitStats by appLogic.
     float m_mnx {0};
     float m_rmsx {0};
     float m_mny  {0};
@@ -384,35 +397,14 @@ int psfFit::appLogic()
    }
 
 
-    if( state() == stateCodes::OPERATING && m_xcb.size() > 0 )
+    //The statistics are updated in processImage
+    if( state() == stateCodes::OPERATING )
     {
-        if(m_xcb.size() >= m_xcb.maxEntries())
-        {
-            cbIndexT refEntry = m_xcb.earliest();
-         
-            m_xcbD.resize(m_xcb.maxEntries()-1);
-            m_ycbD.resize(m_xcb.maxEntries()-1);
-
-            for(size_t n=0; n <= m_atimesD.size(); ++n)
-            {
-                m_xcbD[n] = m_xcb.at(refEntry,n);
-                m_ycbD[n] = m_ycb.at(refEntry,n);
-            }
-         
-            m_mnx = mx::math::vectorMean(m_xcbD);
-            m_rmsx = sqrt(mx::math::vectorVariance(m_xcbD, m_mnx));
-         
-            m_mny = mx::math::vectorMean(m_ycbD);
-            m_rmsy = sqrt(mx::math::vectorVariance(m_ycbD, m_mny));
-
-        }
-        else
-        {
-            m_mnx = 0;
-            m_rmsx = 0;
-            m_mny = 0;
-            m_rmsy = 0;
-        }
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_mnx = m_fitStats.mnx;
+        m_rmsx = m_fitStats.rmsx;
+        m_mny = m_fitStats.mny;
+        m_rmsy = m_fitStats.rmsy;
     }
     else
     {
@@ -462,8 +454,8 @@ int psfFit::allocate(const dev::shmimT & dummy)
 
     if(m_fitCircBuffMaxLength == 0 || m_fitCircBuffMaxTime == 0 || m_fps <= 0)
     {
-        m_xcb.maxEntries(0);
-        m_ycb.maxEntries(0);
+        m_xcb.windows(std::vector<size_t>());
+        m_ycb.windows(std::vector<size_t>());
     }
     else 
     {
@@ -471,8 +463,8 @@ int psfFit::allocate(const dev::shmimT & dummy)
         cbIndexT cbSz = m_fitCircBuffMaxTime * m_fps;
         if(cbSz > m_fitCircBuffMaxLength) cbSz = m_fitCircBuffMaxLength;
         if(cbSz < 3) cbSz = 3; //Make variance meaningful
-        m_xcb.maxEntries(cbSz);
-        m_ycb.maxEntries(cbSz);
+        m_xcb.windows(cbSz-1);
+        m_ycb.windows(cbSz-1);
     }
 
    m_updated = false;
@@ -545,11 +537,24 @@ int psfFit::processImage( void* curr_src,
         return -1;
     }
          
-    //Update the latency circ. buffs
-    if(m_xcb.maxEntries()  >  0)
+    //Update the fit statistics
+    if(m_xcb.nWindows() > 0)
     {
-        m_xcb.nextEntry(m_x);
-        m_ycb.nextEntry(m_y);
+        m_xcb.add(m_x);
+        m_ycb.add(m_y);
+
+        fitStats fs;
+        if(m_xcb.samples() > m_xcb.window(0))
+        {
+            fs.mnx = m_xcb.mean(0);
+            fs.rmsx = sqrt(m_xcb.variance(0));
+            fs.mny = m_ycb.mean(0);
+            fs.rmsy = sqrt(m_ycb.variance(0));
+        }
+
+        //Publish for appLogic.  If it holds the lock, the next frame publishes instead of this thread waiting.
+        std::unique_lock<std::mutex> slock(m_statsMutex, std::try_to_lock);
+        if(slock.owns_lock()) m_fitStats = fs;
     }
 
     return 0;
@@ -53,7 +53,7 @@ struct darkShmimT
   * \ingroup pwfsSlopeCalc
   * 
   */
-class pwfsSlopeCalc : public MagAOXApp<true>, public dev::shmimMonitor<pwfsSlopeCalc>, public dev::shmimMonitor<pwfsSlopeCalc,darkShmimT>, public dev::frameGrabber<pwfsSlopeCalc>, public dev::telemeter<pwfsSlopeCalc>
+class pwfsSlopeCalc : public MagAOXApp<true>, public dev::shmimMonitor<pwfsSlopeCalc>, public dev::shmimMonitor<pwfsSlopeCalc,darkShmimT>, public dev::transformStream<pwfsSlopeCalc>, public dev::telemeter<pwfsSlopeCalc>
 {
 
    //Give the test harness access.
@@ -61,7 +61,7 @@ class pwfsSlopeCalc : public MagAOXApp<true>, public dev::shmimMonitor<pwfsSlope
 
    friend class dev::shmimMonitor<pwfsSlopeCalc>;
    friend class dev::shmimMonitor<pwfsSlopeCalc,darkShmimT>;
-   friend class dev::frameGrabber<pwfsSlopeCalc>;
+   friend class dev::transformStream<pwfsSlopeCalc>;
    friend class dev::telemeter<pwfsSlopeCalc>;
    
    //The base shmimMonitor type
@@ -70,8 +70,8 @@ class pwfsSlopeCalc : public MagAOXApp<true>, public dev::shmimMonitor<pwfsSlope
    //The dark shmimMonitor type
    typedef dev::shmimMonitor<pwfsSlopeCalc, darkShmimT> darkMonitorT;
    
-   //The base frameGrabber type
-   typedef dev::frameGrabber<pwfsSlopeCalc> frameGrabberT;
+   //The base transformStream type
+   typedef dev::transformStream<pwfsSlopeCalc> transformStreamT;
    
    //The base telemeter type
    typedef dev::telemeter<pwfsSlopeCalc> telemeterT;
@@ -79,8 +79,6 @@ class pwfsSlopeCalc : public MagAOXApp<true>, public dev::shmimMonitor<pwfsSlope
    ///Floating point type in which to do all calculations.
    typedef float realT;
    
-   static constexpr bool c_frameGrabber_flippable = false; ///< app:dev config to tell framegrabber these images can not be flipped
-   
 protected:
 
    /** \name Configurable Parameters
@@ -112,12 +110,8 @@ protected:
    
    ///@}
 
-   sem_t m_smSemaphore; ///< Semaphore used to synchronize the fg thread and the sm thread.
-   
    realT (*pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
    
-   void * m_curr_src {nullptr};
-   
    int m_quadSize {60};
    
    mx::improc::eigenImage<realT> m_darkImage;
@@ -191,45 +185,28 @@ public:
    
 protected:
 
-   /** \name dev::frameGrabber interface
+   /** \name dev::transformStream interface
      *
      * @{
      */
    
-   /// Implementation of the framegrabber configureAcquisition interface
-   /** 
-     * \returns 0 on success
-     * \returns -1 on error
-     */
-   int configureAcquisition();
-   
-   /// Implementation of the framegrabber startAcquisition interface
-   /** 
-     * \returns 0 on success
-     * \returns -1 on error
-     */
-   int startAcquisition();
-   
-   /// Implementation of the framegrabber acquireAndCheckValid interface
-   /** 
-     * \returns 0 on success
-     * \returns -1 on error
-     */
-   int acquireAndCheckValid();
-   
-   /// Implementation of the framegrabber loadImageIntoStream interface
-   /** 
+   /// Implementation of the transformStream configureTransform interface
+   /** Calculates the quadrant positions from the pupil positions, and sets the slope image size.
+     *
      * \returns 0 on success
      * \returns -1 on error
+     * \returns 1 if the source stream is not yet connected
      */
-   int loadImageIntoStream( void * dest  /**< [in] */);
+   int configureTransform();
    
-   /// Implementation of the framegrabber reconfig interface
+   /// Implementation of the transformStream transformImage interface
    /** 
      * \returns 0 on success
      * \returns -1 on error
      */
-   int reconfig();
+   int transformImage( void * dest, ///< [out] the slope image
+                       void * src   ///< [in] the PWFS image
+                     );
    
    ///@}
    
@@ -269,7 +246,7 @@ void pwfsSlopeCalc::setupConfig()
    shmimMonitorT::setupConfig(config);
    darkMonitorT::setupConfig(config);
    
-   frameGrabberT::setupConfig(config);
+   transformStreamT::setupConfig(config);
    telemeterT::setupConfig(config);
 
    config.add("pupil.fitter", "", "pupil.fitter", argType::Required, "pupil", "fitter", false, "int", "The device name of the pupil fitter.  If set, then pupil position is set by the fitter reference.");
@@ -301,7 +278,7 @@ int pwfsSlopeCalc::loadConfigImpl( mx::app::appConfigurator & _config )
    
    shmimMonitorT::loadConfig(_config);
    darkMonitorT::loadConfig(_config);
-   frameGrabberT::loadConfig(_config);
+   transformStreamT::loadConfig(_config);
    telemeterT::loadConfig(_config);
 
    config(m_fitter, "pupil.fitter");
@@ -328,12 +305,6 @@ void pwfsSlopeCalc::loadConfig()
 inline
 int pwfsSlopeCalc::appStartup()
 {
-   if(sem_init(&m_smSemaphore, 0,0) < 0)
-   {
-      log<software_critical>({__FILE__, __LINE__, errno,0, "Initializing S.M. semaphore"});
-      return -1;
-   }
-   
    if(shmimMonitorT::appStartup() < 0)
    {
       return log<software_error,-1>({__FILE__, __LINE__});
@@ -344,7 +315,7 @@ int pwfsSlopeCalc::appStartup()
       return log<software_error,-1>({__FILE__, __LINE__});
    }
    
-   if(frameGrabberT::appStartup() < 0)
+   if(transformStreamT::appStartup() < 0)
    {
       return log<software_error,-1>({__FILE__, __LINE__});
    }
@@ -384,7 +355,7 @@ int pwfsSlopeCalc::appLogic()
    }
    
    
-   if( frameGrabberT::appLogic() < 0)
+   if( transformStreamT::appLogic() < 0)
    {
       return log<software_error,-1>({__FILE__,__LINE__});
    }
@@ -406,7 +377,7 @@ int pwfsSlopeCalc::appLogic()
       log<software_error>({__FILE__, __LINE__});
    }
       
-   if(frameGrabberT::updateINDI() < 0)
+   if(transformStreamT::updateINDI() < 0)
    {
       log<software_error>({__FILE__, __LINE__});
    }
@@ -424,7 +395,7 @@ int pwfsSlopeCalc::appShutdown()
    
    darkMonitorT::appShutdown();
    
-   frameGrabberT::appShutdown();
+   transformStreamT::appShutdown();
    
    telemeterT::appShutdown();
 
@@ -444,7 +415,7 @@ int pwfsSlopeCalc::allocate(const dev::shmimT & dummy)
       m_darkSet = false;
    }
    
-   m_reconfig = true;
+   transformStreamT::m_reconfig = true;
    
    return 0;
 }
@@ -456,16 +427,7 @@ int pwfsSlopeCalc::processImage( void * curr_src,
 {
    static_cast<void>(dummy); //be unused
 
-   m_curr_src = curr_src;
-
-   //Now tell the f.g. to get going
-   if(sem_post(&m_smSemaphore) < 0)
-   {
-      log<software_critical>({__FILE__, __LINE__, errno, 0, "Error posting to semaphore"});
-       return -1;
-   }
-
-   return 0;
+   return transformStreamT::transform(curr_src, shmimMonitorT::m_imageStream.md->atime);
 }
 
 inline
@@ -513,15 +475,14 @@ int pwfsSlopeCalc::processImage( void * curr_src,
 }
 
 inline
-int pwfsSlopeCalc::configureAcquisition()
+int pwfsSlopeCalc::configureTransform()
 {
    std::unique_lock<std::mutex> lock(m_indiMutex);
    
    if(shmimMonitorT::m_width==0 || shmimMonitorT::m_height==0 || shmimMonitorT::m_dataType == 0)
    {
-      //This means we haven't connected to the stream to average. so wait.
-      sleep(1);
-      return -1;
+      //This means we haven't connected to the stream to average.
+      return 1;
    }
    
    m_quadSize = m_pupil_D + 2*m_pupil_buffer;
@@ -539,49 +500,21 @@ int pwfsSlopeCalc::configureAcquisition()
    m_pupil_sy_4 = m_pupil_cy_4 - 0.5*m_quadSize;
    
    //m_quadSize = shmimMonitorT::m_width/2;
-   frameGrabberT::m_width = m_quadSize;
-   frameGrabberT::m_height = 2*m_quadSize;
-   frameGrabberT::m_dataType = _DATATYPE_FLOAT;
+   transformStreamT::m_width = m_quadSize;
+   transformStreamT::m_height = 2*m_quadSize;
+   transformStreamT::m_dataType = _DATATYPE_FLOAT;
    
    return 0;
 }
 
 inline
-int pwfsSlopeCalc::startAcquisition()
-{
-   return 0;
-}
-
-inline
-int pwfsSlopeCalc::acquireAndCheckValid()
-{
-   timespec ts;
-         
-   if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
-   {
-      log<software_critical>({__FILE__,__LINE__,errno,0,"clock_gettime"}); 
-      return -1;
-   }
-         
-   ts.tv_sec += 1;
-        
-   if(sem_timedwait(&m_smSemaphore, &ts) == 0)
-   {
-      clock_gettime(CLOCK_REALTIME, &m_currImageTimestamp);
-      return 0;
-   }
-   else
-   {
-      return 1;
-   }
-}
-
-inline
-int pwfsSlopeCalc::loadImageIntoStream(void * dest)
+int pwfsSlopeCalc::transformImage( void * dest,
+                                   void * src
+                                 )
 {
    //Here is where we do it.
-   Eigen::Map<eigenImage<unsigned short>> pwfsIm( static_cast<unsigned short *>(m_curr_src), shmimMonitorT::m_width, shmimMonitorT::m_height );
-   Eigen::Map<eigenImage<float>> slopesIm(static_cast<float*>(dest), frameGrabberT::m_width, frameGrabberT::m_height );
+   Eigen::Map<eigenImage<unsigned short>> pwfsIm( static_cast<unsigned short *>(src), shmimMonitorT::m_width, shmimMonitorT::m_height );
+   Eigen::Map<eigenImage<float>> slopesIm(static_cast<float*>(dest), transformStreamT::m_width, transformStreamT::m_height );
    
    static float sqrt32 = sqrt(3.0)/2;
    
@@ -627,9 +560,9 @@ int pwfsSlopeCalc::loadImageIntoStream(void * dest)
    }
     
    norm /= N;
-   for(size_t ii=0; ii< frameGrabberT::m_height; ++ii)
+   for(size_t ii=0; ii< transformStreamT::m_height; ++ii)
    {
-      for(size_t jj=0; jj < frameGrabberT::m_width; ++jj)
+      for(size_t jj=0; jj < transformStreamT::m_width; ++jj)
       {
          slopesIm(jj,ii)/=norm;
       }
@@ -638,12 +571,6 @@ int pwfsSlopeCalc::loadImageIntoStream(void * dest)
    return 0;
 }
 
-inline
-int pwfsSlopeCalc::reconfig()
-{
-   return 0;
-}
-
 INDI_SETCALLBACK_DEFN(pwfsSlopeCalc, m_indiP_quad1)(const pcf::IndiProperty &ipRecv)
 {
    if(ipRecv.getName() != m_indiP_quad1.getName())
@@ -659,7 +586,7 @@ INDI_SETCALLBACK_DEFN(pwfsSlopeCalc, m_indiP_quad1)(const pcf::IndiProperty &ipR
       if(newval != m_pupil_cx_1)
       {
          m_pupil_cx_1 = newval;
-         m_reconfig = true;
+         transformStreamT::m_reconfig = true;
       }
    }
    
@@ -669,7 +596,7 @@ INDI_SETCALLBACK_DEFN(pwfsSlopeCalc, m_indiP_quad1)(const pcf::IndiProperty &ipR
       if(newval != m_pupil_cy_1)
       {
          m_pupil_cy_1 = newval;
-         m_reconfig = true;
+         transformStreamT::m_reconfig = true;
       }
    }
    
@@ -679,7 +606,7 @@ INDI_SETCALLBACK_DEFN(pwfsSlopeCalc, m_indiP_quad1)(const pcf::IndiProperty &ipR
       if(newval != m_pupil_D_1)
       {
          m_pupil_D_1 = newval;
-         m_reconfig = true;
+         transformStreamT::m_reconfig = true;
       }
    }
    
@@ -702,7 +629,7 @@ INDI_SETCALLBACK_DEFN(pwfsSlopeCalc, m_indiP_quad2)(const pcf::IndiProperty &ipR
       if(newval != m_pupil_cx_2)
       {
          m_pupil_cx_2 = newval;
-         m_reconfig = true;
+         transformStreamT::m_reconfig = true;
       }      
    }
    
@@ -712,7 +639,7 @@ INDI_SETCALLBACK_DEFN(pwfsSlopeCalc, m_indiP_quad2)(const pcf::IndiProperty &ipR
       if(newval != m_pupil_cy_2)
       {
          m_pupil_cy_2 = newval;
-         m_reconfig = true;
+         transformStreamT::m_reconfig = true;
       }
    }
    if(ipRecv.find("set-D"))
@@ -721,7 +648,7 @@ INDI_SETCALLBACK_DEFN(pwfsSlopeCalc, m_indiP_quad2)(const pcf::IndiProperty &ipR
       if(newval != m_pupil_D_2)
       {
          m_pupil_D_2 = newval;
-         m_reconfig = true;
+         transformStreamT::m_reconfig = true;
       }
    }
    
@@ -744,7 +671,7 @@ INDI_SETCALLBACK_DEFN(pwfsSlopeCalc, m_indiP_quad3)(const pcf::IndiProperty &ipR
       if(newval != m_pupil_cx_3)
       {
          m_pupil_cx_3 = newval;
-         m_reconfig = true;
+         transformStreamT::m_reconfig = true;
       }
    }
    if(ipRecv.find("set-y"))
@@ -753,7 +680,7 @@ INDI_SETCALLBACK_DEFN(pwfsSlopeCalc, m_indiP_quad3)(const pcf::IndiProperty &ipR
       if(newval != m_pupil_cy_3)
       {
          m_pupil_cy_3 = newval;
-         m_reconfig = true;
+         transformStreamT::m_reconfig = true;
       }
    }
    if(ipRecv.find("set-D"))
@@ -762,7 +689,7 @@ INDI_SETCALLBACK_DEFN(pwfsSlopeCalc, m_indiP_quad3)(const pcf::IndiProperty &ipR
       if(newval != m_pupil_D_3)
       {
          m_pupil_D_3 = newval;
-         m_reconfig = true;
+         transformStreamT::m_reconfig = true;
       }
    }
    
@@ -785,7 +712,7 @@ INDI_SETCALLBACK_DEFN(pwfsSlopeCalc, m_indiP_quad4)(const pcf::IndiProperty &ipR
       if(newval != m_pupil_cx_4)
       {
          m_pupil_cx_4 = newval;
-         m_reconfig = true;
+         transformStreamT::m_reconfig = true;
       }
    }
    if(ipRecv.find("set-y"))
@@ -794,7 +721,7 @@ INDI_SETCALLBACK_DEFN(pwfsSlopeCalc, m_indiP_quad4)(const pcf::IndiProperty &ipR
       if(newval != m_pupil_cy_4)
       {
          m_pupil_cy_4 = newval;
-         m_reconfig = true;
+         transformStreamT::m_reconfig = true;
       }
    }
    if(ipRecv.find("set-D"))
@@ -803,7 +730,7 @@ INDI_SETCALLBACK_DEFN(pwfsSlopeCalc, m_indiP_quad4)(const pcf::IndiProperty &ipR
       if(newval != m_pupil_D_4)
       {
          m_pupil_D_4 = newval;
-         m_reconfig = true;
+         transformStreamT::m_reconfig = true;
       }
    }
    
@@ -15,6 +15,8 @@
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#include "../../libMagAOX/utils/runningStats.hpp"
+
 namespace MagAOX
 {
 namespace app
@@ -61,6 +63,12 @@ struct maskShmimT
   */
 
 /** MagAO-X application to calculate the RMS of the reference subtracted WFS image.
+  *
+  * The refrms property reports the mean of the per-frame rms over the most recent 1, 2, 5, and 10 seconds of frames,
+  * and is published once 10 seconds of frames have been seen.  Previously the means were taken over the oldest
+  * samples of an 11 second history, so e.g. one_sec was the rms of the frames from 11 to 10 seconds ago.  That lagged
+  * the WFS by up to 10 seconds and made the short windows no more responsive than the long one, so the windows now
+  * end at the latest frame.
   *
   * \ingroup refRMS
   * 
@@ -101,14 +109,19 @@ protected:
    bool m_maskValid {false};
    realT m_maskSum {0};
 
-   mx::sigproc::circularBufferIndex<float, cbIndexT> m_rms;
+   utils::runningStats<double> m_rms; ///< Running means of the rms over the latest 1, 2, 5, and 10 seconds, updated in processImage
    
    mx::sigproc::circularBufferIndex<float, cbIndexT> m_mean;
 
-   double m_rms_1sec;
-   double m_rms_2sec;
-   double m_rms_5sec;
-   double m_rms_10sec;
+   //The means of the rms, published by processImage.  Protected by m_rmsMutex.
+   double m_rms_1sec {0};
+   double m_rms_2sec {0};
+   double m_rms_5sec {0};
+   double m_rms_10sec {0};
+
+   bool m_rmsValid {false}; ///< Set once the 10 second window is full, so the rms values are valid.  Protected by m_rmsMutex.
+
+   std::mutex m_rmsMutex; ///< Mutex protecting the rms values.
 
    float m_fps {0}; ///< Current FPS from the FPS source.
 
@@ -254,72 +267,15 @@ int refRMS::appLogic()
       return log<software_error,-1>({__FILE__,__LINE__});
    }
 
-   if( m_rms.size() > 0 )
+   std::vector<double> rms;
    {
-      if(m_rms.size() >= m_rms.maxEntries())
-      {
-         m_rms_1sec = 0;
-         if(m_rms.size() > 1.0*m_fps)
-         {
-            int N = 0;
-            for(size_t n=0; n < 1.0*m_fps; ++n)
-            {
-               m_rms_1sec += m_rms[n];
-               ++N;
-            }
-            m_rms_1sec /= N;
-
-            std::cerr << m_rms_1sec << " ";
-
-         }
-
-         m_rms_2sec = 0;
-         if(m_rms.size() > 2.0*m_fps)
-         {
-            int N = 0;
-            for(size_t n=0; n < 2.0*m_fps; ++n)
-            {
-               m_rms_2sec += m_rms[n];
-               ++N;
-            }
-            m_rms_2sec /= N;
-
-            std::cerr << m_rms_2sec << " ";
-         }
-
-         m_rms_5sec = 0;
-         if(m_rms.size() > 5.0*m_fps)
-         {
-            int N = 0;
-            for(size_t n=0; n < 5.0*m_fps; ++n)
-            {
-               m_rms_5sec += m_rms[n];
-               ++N;
-            }
-            m_rms_5sec /= N;
-
-            std::cerr << m_rms_5sec << " ";
-         }
-
-         m_rms_10sec = 0;
-         if(m_rms.size() > 10.0*m_fps)
-         {
-            int N = 0;
-            for(size_t n=0; n < 10.0*m_fps; ++n)
-            {
-               m_rms_10sec += m_rms[n];
-               ++N;
-            }
-            m_rms_10sec /= N;
-
-            std::cerr << m_rms_10sec << " ";
-         }
-
-         std::cerr << "\n";
-
-         updateIfChanged(m_indiP_refrms, std::vector<std::string>({"one_sec","two_sec","five_sec","ten_sec"}), std::vector<double>({m_rms_1sec, m_rms_2sec, m_rms_5sec, m_rms_10sec}));
-
-      }
+      std::lock_guard<std::mutex> lock(m_rmsMutex);
+      if( m_rmsValid ) rms = {m_rms_1sec, m_rms_2sec, m_rms_5sec, m_rms_10sec};
+   }
+
+   if( rms.size() > 0 )
+   {
+      updateIfChanged(m_indiP_refrms, std::vector<std::string>({"one_sec","two_sec","five_sec","ten_sec"}), rms);
    }     
 
 
@@ -377,7 +333,12 @@ int refRMS::allocate(const refShmimT & dummy)
 
    cbIndexT cbSz = 11 * m_fps;
    m_mean.maxEntries(cbSz);
-   m_rms.maxEntries(cbSz);
+   {
+      std::lock_guard<std::mutex> rlock(m_rmsMutex);
+      m_rmsValid = false;
+   }
+   m_rms.windows({static_cast<size_t>(ceil(1.0*m_fps)), static_cast<size_t>(ceil(2.0*m_fps)), 
+                  static_cast<size_t>(ceil(5.0*m_fps)), static_cast<size_t>(ceil(10.0*m_fps))});
 
    std::cerr << "allocated\n";
 
@@ -410,7 +371,18 @@ int refRMS::processImage( void * curr_src,
    float rms = sqrt(((m_currRef - mean)*m_mask).square().sum()/m_maskSum);
 
    m_mean.nextEntry(mean);
-   m_rms.nextEntry(rms);
+   m_rms.add(rms);
+
+   //Publish for appLogic.  If it holds the lock, the next frame publishes instead of this thread waiting.
+   std::unique_lock<std::mutex> rlock(m_rmsMutex, std::try_to_lock);
+   if(rlock.owns_lock() && m_rms.full(3))
+   {
+      m_rms_1sec = m_rms.mean(0);
+      m_rms_2sec = m_rms.mean(1);
+      m_rms_5sec = m_rms.mean(2);
+      m_rms_10sec = m_rms.mean(3);
+      m_rmsValid = true;
+   }
    
    return 0;
 }
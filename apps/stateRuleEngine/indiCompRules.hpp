@@ -130,6 +130,45 @@ rulePriority string2priority(const std::string & pstr)
     }
 }
 
+/// The value of an element, resolved when its property is updated
+/** Rules bound to a slot read the typed value here instead of looking the element up by name in the property
+  * each time they are evaluated.  Slots are owned and updated by an indiRuleGraph.
+  */
+struct ruleSlot
+{
+    bool found {false}; ///< Whether the element was found in the last update of the property
+
+    double num {0}; ///< The value of a Number element
+
+    std::string txt; ///< The value of a Text element
+
+    pcf::IndiElement::SwitchStateType sw {pcf::IndiElement::UnknownSwitchState}; ///< The value of a Switch element
+
+    /// Update from an element
+    void update( const pcf::IndiProperty & prop, ///< [in] the property containing the element
+                 const std::string & element     ///< [in] the name of the element
+               )
+    {
+        found = prop.find(element);
+        if(!found) return;
+
+        switch(prop.getType())
+        {
+            case pcf::IndiProperty::Number:
+                num = prop[element].get<double>();
+                break;
+            case pcf::IndiProperty::Text:
+                txt = prop[element].get();
+                break;
+            case pcf::IndiProperty::Switch:
+                sw = prop[element].getSwitchState();
+                break;
+            default:
+                break;
+        }
+    }
+};
+
 /// Virtual base-class for all rules
 /** Provides error handling and comparison functions.
   * Derived classes must implemented valid() and value(). 
@@ -149,6 +188,10 @@ public:
 
 protected:
 
+    bool m_evaluated {false}; ///< Whether m_result holds the result of the last call to evaluate()
+
+    boolorerr_t m_result {false}; ///< The result of the last call to evaluate(), the value or the error message
+
     /// The reporting priority for this rule
     rulePriority m_priority {rulePriority::none};
 
@@ -222,6 +265,69 @@ public:
       */
     virtual bool value() = 0; 
 
+    /// Evaluate this rule, and cache the result
+    /** Calls value(), catching any exception, and stores the value or the error message.
+      *
+      * \returns true if the result changed, including the first time it is called
+      */
+    bool evaluate()
+    {
+        boolorerr_t rv;
+        try
+        {
+            rv = value();
+        }
+        catch(const std::exception & e)
+        {
+            rv = std::string(e.what());
+        }
+
+        bool changed = (!m_evaluated || rv != m_result);
+
+        m_result = rv;
+        m_evaluated = true;
+
+        return changed;
+    }
+
+    /// Check if the rule has been evaluated, so that result() is valid
+    /**
+      * \returns the current value of m_evaluated
+      */
+    bool evaluated()
+    {
+        return m_evaluated;
+    }
+
+    /// Get the result of the last call to evaluate()
+    /**
+      * \returns the current value of m_result
+      */
+    const boolorerr_t & result()
+    {
+        return m_result;
+    }
+
+    /// Get the value, using the cached result if this rule has been evaluated
+    /** Used by rules which depend on other rules, so that a rule which is evaluated by an indiRuleGraph is not
+      * re-evaluated for each rule which depends on it.
+      *
+      * \returns the value of the rule
+      *
+      * \throws mx::err::invalidconfig if the cached result is an error
+      */
+    bool cachedValue()
+    {
+        if(!m_evaluated) return value();
+
+        if(isError(m_result))
+        {
+            mxThrowException(mx::err::invalidconfig, "indiCompRule::cachedValue", std::get<std::string>(m_result));
+        }
+
+        return std::get<bool>(m_result);
+    }
+
     /// Compare two strings
     /** String comparison can only be Eq or Neq.
       *
@@ -374,6 +480,8 @@ protected:
     
     std::string m_element; ///< The element name within the property
 
+    const ruleSlot * m_slot {nullptr}; ///< The pre-resolved element.  If nullptr, the element is looked up in the property.
+
 public:
 
     //Default c'tor is deleted, you must supply the property type
@@ -427,6 +535,21 @@ public:
         return m_element;
     }
 
+    /// Set the slot holding the pre-resolved element
+    void slot( const ruleSlot * s /**< [in] the new slot pointer, nullptr to look the element up in the property*/)
+    {
+        m_slot = s;
+    }
+
+    /// Get the slot pointer
+    /**
+      * \returns the current value of m_slot
+      */
+    const ruleSlot * slot()
+    {
+        return m_slot;
+    }
+
     /// Check if this rule is valid 
     /** The rule is valid if the property pointer is not null, and the element
       * is contained within the property.
@@ -441,7 +564,7 @@ public:
         {
             rv = "property is null";
         }
-        else if(!m_property->find(m_element))
+        else if( (m_slot != nullptr) ? !m_slot->found : !m_property->find(m_element))
         {
             rv = "element is not found";
         }
@@ -470,6 +593,10 @@ protected:
     
     std::string m_element2; ///< The element name within the second property
 
+    const ruleSlot * m_slot1 {nullptr}; ///< The pre-resolved first element.  If nullptr, the element is looked up in the property.
+
+    const ruleSlot * m_slot2 {nullptr}; ///< The pre-resolved second element.  If nullptr, the element is looked up in the property.
+
 public:
 
     //Default c'tor is deleted, you must supply the property type
@@ -567,6 +694,36 @@ public:
         return m_element2;
     }
 
+    /// Set the slot holding the pre-resolved first element
+    void slot1( const ruleSlot * s /**< [in] the new slot pointer, nullptr to look the element up in the property*/)
+    {
+        m_slot1 = s;
+    }
+
+    /// Get the first slot pointer
+    /**
+      * \returns the current value of m_slot1
+      */
+    const ruleSlot * slot1()
+    {
+        return m_slot1;
+    }
+
+    /// Set the slot holding the pre-resolved second element
+    void slot2( const ruleSlot * s /**< [in] the new slot pointer, nullptr to look the element up in the property*/)
+    {
+        m_slot2 = s;
+    }
+
+    /// Get the second slot pointer
+    /**
+      * \returns the current value of m_slot2
+      */
+    const ruleSlot * slot2()
+    {
+        return m_slot2;
+    }
+
     /// Check if this rule is valid 
     /** The rule is valid if both property pointers are not null, and the elements
       * are contained within their respective properties.
@@ -584,7 +741,7 @@ public:
             return rv;
         }
         
-        if(!m_property1->find(m_element1))
+        if( (m_slot1 != nullptr) ? !m_slot1->found : !m_property1->find(m_element1))
         {
             rv = "element1 is not found";
             return rv;
@@ -596,7 +753,7 @@ public:
             return rv;
         }
         
-        if(!m_property2->find(m_element2))
+        if( (m_slot2 != nullptr) ? !m_slot2->found : !m_property2->find(m_element2))
         {
             rv = "element2 is not found";
             return rv;
@@ -687,7 +844,7 @@ public:
             mxThrowException(mx::err::invalidconfig, "numValRule::value", std::get<std::string>(rv));
         }
         
-        double val = (*m_property)[m_element].get<double>();
+        double val = (m_slot != nullptr) ? m_slot->num : (*m_property)[m_element].get<double>();
         
         rv = compNum(val, m_target, m_tol);
         if(isError(rv))
@@ -751,7 +908,8 @@ public:
             mxThrowException(mx::err::invalidconfig, "txtValRule::value", std::get<std::string>(rv));
         }
 
-        rv = compTxt((*m_property)[m_element].get(), m_target);
+        if(m_slot != nullptr) rv = compTxt(m_slot->txt, m_target);
+        else rv = compTxt((*m_property)[m_element].get(), m_target);
         if(isError(rv))                
         {
             mxThrowException(mx::err::invalidconfig, "txtValRule::value()", std::get<std::string>(rv));
@@ -834,7 +992,7 @@ public:
             mxThrowException(mx::err::invalidconfig, "swValRule::value", std::get<std::string>(rv));
         }
 
-        rv = compSw((*m_property)[m_element].getSwitchState(), m_target);
+        rv = compSw((m_slot != nullptr) ? m_slot->sw : (*m_property)[m_element].getSwitchState(), m_target);
         if(isError(rv))
         {
             mxThrowException(mx::err::invalidconfig, "elCompSwRule::value()", std::get<std::string>(rv));
@@ -904,7 +1062,8 @@ public:
             mxThrowException(mx::err::invalidconfig, "elCompNumRule::value", std::get<std::string>(rv));
         }
 
-        rv = compNum((*m_property1)[m_element1].get<double>(), (*m_property2)[m_element2].get<double>(), m_tol);
+        rv = compNum( (m_slot1 != nullptr) ? m_slot1->num : (*m_property1)[m_element1].get<double>(),
+                      (m_slot2 != nullptr) ? m_slot2->num : (*m_property2)[m_element2].get<double>(), m_tol);
         if(isError(rv))
         {
             mxThrowException(mx::err::invalidconfig, "elCompNumRule::value()", std::get<std::string>(rv));
@@ -943,7 +1102,8 @@ public:
             mxThrowException(mx::err::invalidconfig, "elCompTxtRule::value", std::get<std::string>(rv));
         }
 
-        rv = compTxt((*m_property1)[m_element1].get(), (*m_property2)[m_element2].get());
+        if(m_slot1 != nullptr && m_slot2 != nullptr) rv = compTxt(m_slot1->txt, m_slot2->txt);
+        else rv = compTxt((*m_property1)[m_element1].get(), (*m_property2)[m_element2].get());
         if(isError(rv))
         {
             mxThrowException(mx::err::invalidconfig, "elCompTxtRule::value()", std::get<std::string>(rv));
@@ -983,7 +1143,8 @@ public:
             mxThrowException(mx::err::invalidconfig, "elCompSwRule::value", std::get<std::string>(rv));
         }
 
-        rv = compSw((*m_property1)[m_element1].getSwitchState(), (*m_property2)[m_element2].getSwitchState());
+        rv = compSw( (m_slot1 != nullptr) ? m_slot1->sw : (*m_property1)[m_element1].getSwitchState(),
+                     (m_slot2 != nullptr) ? m_slot2->sw : (*m_property2)[m_element2].getSwitchState());
         if(isError(rv))
         {
             mxThrowException(mx::err::invalidconfig, "elCompSwRule::value()", std::get<std::string>(rv));
@@ -1095,7 +1256,7 @@ public:
             mxThrowException(mx::err::invalidconfig, "ruleCompRule::value", std::get<std::string>(rv));
         }
 
-        rv = compBool(m_rule1->value(), m_rule2->value());
+        rv = compBool(m_rule1->cachedValue(), m_rule2->cachedValue());
         if(isError(rv))
         {
             mxThrowException(mx::err::invalidconfig, "ruleCompRule::value", std::get<std::string>(rv));
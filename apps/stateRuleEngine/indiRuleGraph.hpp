@@ -0,0 +1,276 @@
+/** \file indiRuleGraph.hpp
+  * \brief Incremental evaluation of rules for the MagAO-X stateRuleEngine
+  *
+  * \ingroup stateRuleEngine_files
+  */
+
+#ifndef stateRuleEngine_indiRuleGraph_hpp
+#define stateRuleEngine_indiRuleGraph_hpp
+
+#include <map>
+#include <vector>
+
+#include "indiCompRuleConfig.hpp"
+
+/// The dependency graph of the rules on the properties
+/** Maps each property to the rules which depend on it, directly or through ruleComp rules, so that when a property
+  * is updated only those rules are evaluated.  The elements used by the rules are resolved into ruleSlots when
+  * the property is updated, so evaluating a rule does not look up elements by name.
+  *
+  * Rules are evaluated in dependency order, so that a ruleComp rule uses the cached results of the rules it
+  * compares.  The results are cached in each rule, see indiCompRule::evaluate().
+  *
+  * The graph does not own any of the rules or properties, which must outlive it.
+  */
+struct indiRuleGraph
+{
+protected:
+
+    /// The dependencies of one property
+    struct propDeps
+    {
+        std::vector<std::pair<std::string, ruleSlot *>> slots; ///< The elements used by the rules, and their slots
+
+        std::vector<size_t> rules; ///< The indices of the rules to evaluate on update, in dependency order
+    };
+
+    std::vector<std::string> m_names; ///< The names of the rules, in dependency order
+
+    std::vector<indiCompRule *> m_rules; ///< The rules, in dependency order
+
+    std::map<std::pair<const pcf::IndiProperty *, std::string>, ruleSlot> m_slots; ///< The slots, one per element
+
+    std::map<const pcf::IndiProperty *, propDeps> m_props; ///< The dependencies of each property
+
+    /// Get the slot for an element, creating it if needed
+    ruleSlot * getSlot( const pcf::IndiProperty * prop, ///< [in] the property
+                        const std::string & element     ///< [in] the element name
+                      )
+    {
+        auto key = std::make_pair(prop, element);
+
+        if(m_slots.count(key) == 0)
+        {
+            ruleSlot * slot = &m_slots[key];
+            m_props[prop].slots.push_back(std::make_pair(element, slot));
+            slot->update(*prop, element);
+            return slot;
+        }
+
+        return &m_slots[key];
+    }
+
+    /// Add a rule to the evaluation order after the rules it depends on
+    /**
+      * \throws mx::err::invalidconfig if the rule depends on itself
+      */
+    void order( const std::string & name,                       ///< [in] the name of the rule
+                indiCompRule * rule,                            ///< [in] the rule
+                const std::map<const indiCompRule *, std::string> & names, ///< [in] the names of all rules
+                std::map<const indiCompRule *, int> & marks     ///< [in/out] 1 if being ordered, 2 if ordered
+              )
+    {
+        if(marks[rule] == 2) return;
+
+        if(marks[rule] == 1)
+        {
+            mxThrowException(mx::err::invalidconfig, "indiRuleGraph::build", "rule " + name + " depends on itself");
+        }
+
+        marks[rule] = 1;
+
+        ruleCompRule * rcr = dynamic_cast<ruleCompRule *>(rule);
+        if(rcr != nullptr)
+        {
+            for(const indiCompRule * child : {rcr->rule1(), rcr->rule2()})
+            {
+                if(child == nullptr || names.count(child) == 0) continue;
+
+                order(names.at(child), const_cast<indiCompRule *>(child), names, marks);
+            }
+        }
+
+        marks[rule] = 2;
+
+        m_names.push_back(name);
+        m_rules.push_back(rule);
+    }
+
+public:
+
+    /// Build the graph
+    /** Orders the rules, creates and binds the slots, and finds the rules which depend on each property.
+      * Does not evaluate any rules.
+      *
+      * \throws mx::err::invalidconfig if the ruleComp rules contain a cycle
+      */
+    void build( indiRuleMaps & maps /**< [in] the rules and properties*/ )
+    {
+        m_names.clear();
+        m_rules.clear();
+        m_slots.clear();
+        m_props.clear();
+
+        std::map<const indiCompRule *, std::string> names;
+        for(auto it = maps.rules.begin(); it != maps.rules.end(); ++it)
+        {
+            names[it->second] = it->first;
+        }
+
+        std::map<const indiCompRule *, int> marks;
+        for(auto it = maps.rules.begin(); it != maps.rules.end(); ++it)
+        {
+            order(it->first, it->second, names, marks);
+        }
+
+        std::map<const indiCompRule *, size_t> index;
+        for(size_t n = 0; n < m_rules.size(); ++n)
+        {
+            index[m_rules[n]] = n;
+        }
+
+        //The rules which depend directly on each property, and the ruleComp rules which depend on each rule
+        std::map<const pcf::IndiProperty *, std::vector<size_t>> direct;
+        std::vector<std::vector<size_t>> parents(m_rules.size());
+
+        for(size_t n = 0; n < m_rules.size(); ++n)
+        {
+            onePropRule * opr = dynamic_cast<onePropRule *>(m_rules[n]);
+            if(opr != nullptr)
+            {
+                if(opr->property() == nullptr) continue;
+
+                opr->slot(getSlot(opr->property(), opr->element()));
+                direct[opr->property()].push_back(n);
+                continue;
+            }
+
+            twoPropRule * tpr = dynamic_cast<twoPropRule *>(m_rules[n]);
+            if(tpr != nullptr)
+            {
+                if(tpr->property1() == nullptr || tpr->property2() == nullptr) continue;
+
+                tpr->slot1(getSlot(tpr->property1(), tpr->element1()));
+                tpr->slot2(getSlot(tpr->property2(), tpr->element2()));
+                direct[tpr->property1()].push_back(n);
+                direct[tpr->property2()].push_back(n);
+                continue;
+            }
+
+            ruleCompRule * rcr = dynamic_cast<ruleCompRule *>(m_rules[n]);
+            if(rcr != nullptr)
+            {
+                for(const indiCompRule * child : {rcr->rule1(), rcr->rule2()})
+                {
+                    if(child == nullptr || index.count(child) == 0) continue;
+                    parents[index[child]].push_back(n);
+                }
+            }
+        }
+
+        //Propagate to the ruleComp rules.  Indices are in dependency order, so sorting gives the evaluation order.
+        for(auto it = direct.begin(); it != direct.end(); ++it)
+        {
+            std::vector<bool> affected(m_rules.size(), false);
+            std::vector<size_t> stack = it->second;
+
+            while(stack.size() > 0)
+            {
+                size_t n = stack.back();
+                stack.pop_back();
+
+                if(affected[n]) continue;
+                affected[n] = true;
+
+                for(size_t p : parents[n]) stack.push_back(p);
+            }
+
+            std::vector<size_t> & rules = m_props[it->first].rules;
+            for(size_t n = 0; n < affected.size(); ++n)
+            {
+                if(affected[n]) rules.push_back(n);
+            }
+        }
+    }
+
+    /// Update the slots of a property and evaluate the rules which depend on it
+    /** The property should already contain the new values.
+      *
+      * \returns the number of rules evaluated
+      */
+    size_t update( const pcf::IndiProperty * prop, ///< [in] the updated property
+                   std::vector<size_t> & changed   ///< [out] the indices of the rules whose results changed
+                 )
+    {
+        changed.clear();
+
+        auto it = m_props.find(prop);
+        if(it == m_props.end()) return 0;
+
+        for(auto & sl : it->second.slots)
+        {
+            sl.second->update(*prop, sl.first);
+        }
+
+        for(size_t n : it->second.rules)
+        {
+            if(m_rules[n]->evaluate()) changed.push_back(n);
+        }
+
+        return it->second.rules.size();
+    }
+
+    /// Update all slots and evaluate all rules
+    void evaluateAll( std::vector<size_t> & changed /**< [out] the indices of the rules whose results changed*/)
+    {
+        changed.clear();
+
+        for(auto it = m_slots.begin(); it != m_slots.end(); ++it)
+        {
+            it->second.update(*it->first.first, it->first.second);
+        }
+
+        for(size_t n = 0; n < m_rules.size(); ++n)
+        {
+            if(m_rules[n]->evaluate()) changed.push_back(n);
+        }
+    }
+
+    /// Get the number of rules in the graph
+    size_t size()
+    {
+        return m_rules.size();
+    }
+
+    /// Get the name of a rule
+    /**
+      * \returns the name of the rule at index n
+      */
+    const std::string & name( size_t n /**< [in] the index of the rule*/)
+    {
+        return m_names[n];
+    }
+
+    /// Get a rule
+    /**
+      * \returns a pointer to the rule at index n
+      */
+    indiCompRule * rule( size_t n /**< [in] the index of the rule*/)
+    {
+        return m_rules[n];
+    }
+
+    /// Get the number of rules evaluated when a property is updated
+    /**
+      * \returns the number of rules which depend on the property, 0 if none
+      */
+    size_t dependents( const pcf::IndiProperty * prop /**< [in] the property*/)
+    {
+        auto it = m_props.find(prop);
+        if(it == m_props.end()) return 0;
+
+        return it->second.rules.size();
+    }
+};
+
+#endif //stateRuleEngine_indiRuleGraph_hpp
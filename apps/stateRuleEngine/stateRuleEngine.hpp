@@ -12,6 +12,7 @@
 #include "../../magaox_git_version.h"
 
 #include "indiCompRuleConfig.hpp"
+#include "indiRuleGraph.hpp"
 
 /** \defgroup stateRuleEngine
   * \brief The MagAO-X stateRuleEngine application 
@@ -51,6 +52,10 @@ protected:
      
     ///@}
 
+    indiRuleGraph m_ruleGraph; ///< The dependencies of the rules on the properties, used to evaluate only the affected rules on each update
+
+    std::vector<size_t> m_changed; ///< Working space for the indices of the rules which changed on an update
+
 public:
     /// Default c'tor.
     stateRuleEngine();
@@ -105,6 +110,11 @@ public:
       */
     int newCallBack_ruleProp( const pcf::IndiProperty &ipRecv /**< [in] the INDI property sent with the the new property request.*/);
  
+    /// Publish the cached result of a rule to its switch property
+    /** Errors are not published, the switch keeps its last state.
+      */
+    void publishRule( size_t n /**< [in] the index of the rule in m_ruleGraph*/);
+
 
     pcf::IndiProperty m_indiP_info;
     pcf::IndiProperty m_indiP_caution;
@@ -214,6 +224,16 @@ int stateRuleEngine::appStartup()
 
         registerIndiPropertySet( *it->second, devName, propName, st_newCallBack_ruleProp);
     }
+
+    try
+    {
+        m_ruleGraph.build(m_ruleMaps);
+        m_ruleGraph.evaluateAll(m_changed);
+    }
+    catch(const std::exception & e)
+    {
+        return log<software_critical,-1>({__FILE__, __LINE__, std::string("error building rule graph: ") + e.what()});
+    }
     
     state(stateCodes::READY);
 
@@ -222,49 +242,15 @@ int stateRuleEngine::appStartup()
 
 int stateRuleEngine::appLogic()
 {
-    for(auto it = m_ruleMaps.rules.begin(); it != m_ruleMaps.rules.end(); ++it)
-    {
-        if(it->second->priority() != rulePriority::none)
-        {
-            try
-            {
-                bool val = it->second->value();
-
-                pcf::IndiElement::SwitchStateType onoff = pcf::IndiElement::Off;
-                if(val) onoff = pcf::IndiElement::On;
+    //Rules are evaluated as their properties are updated in newCallBack_ruleProp.
+    //Here we only re-publish the cached results, which is a no-op unless a switch update was missed.
+    std::lock_guard<std::mutex> guard(m_indiMutex);
 
-                if(it->second->priority() == rulePriority::info)
-                {
-                    updateSwitchIfChanged(m_indiP_info, it->first, onoff);
-                }
-                else if(it->second->priority() == rulePriority::caution)
-                {
-                    updateSwitchIfChanged(m_indiP_caution, it->first, onoff);
-                }
-                else if(it->second->priority() == rulePriority::warning)
-                {
-                    updateSwitchIfChanged(m_indiP_warning, it->first, onoff);
-                }
-                else 
-                {
-                    updateSwitchIfChanged(m_indiP_alert, it->first, onoff);
-                }
-
-            }
-            catch(const std::exception & e)
-            {
-                ///\todo how to handle startup vs misconfiguration
-                
-                /*
-                if(it->second->priority() == rulePriority::none)
-                {
-                    updateSwitchIfChanged(m_indiP_info, it->first, pcf::IndiElement::Off);
-                }*/
-            }
-        }
+    for(size_t n = 0; n < m_ruleGraph.size(); ++n)
+    {
+        publishRule(n);
     }
 
-
     return 0;
 }
 
@@ -298,11 +284,50 @@ int stateRuleEngine::newCallBack_ruleProp( const pcf::IndiProperty &ipRecv)
         return 0;
     }
 
+    std::lock_guard<std::mutex> guard(m_indiMutex);
+
     *m_ruleMaps.props[key] = ipRecv;
 
+    m_ruleGraph.update(m_ruleMaps.props[key], m_changed);
+
+    for(size_t n : m_changed)
+    {
+        publishRule(n);
+    }
+
     return 0;
 }
 
+void stateRuleEngine::publishRule( size_t n )
+{
+    indiCompRule * rule = m_ruleGraph.rule(n);
+
+    if(rule->priority() == rulePriority::none) return;
+
+    ///\todo how to handle startup vs misconfiguration
+    if(!rule->evaluated() || rule->isError(rule->result())) return;
+
+    pcf::IndiElement::SwitchStateType onoff = pcf::IndiElement::Off;
+    if(std::get<bool>(rule->result())) onoff = pcf::IndiElement::On;
+
+    if(rule->priority() == rulePriority::info)
+    {
+        updateSwitchIfChanged(m_indiP_info, m_ruleGraph.name(n), onoff);
+    }
+    else if(rule->priority() == rulePriority::caution)
+    {
+        updateSwitchIfChanged(m_indiP_caution, m_ruleGraph.name(n), onoff);
+    }
+    else if(rule->priority() == rulePriority::warning)
+    {
+        updateSwitchIfChanged(m_indiP_warning, m_ruleGraph.name(n), onoff);
+    }
+    else 
+    {
+        updateSwitchIfChanged(m_indiP_alert, m_ruleGraph.name(n), onoff);
+    }
+}
+
 } //namespace app
 } //namespace MagAOX
 
@@ -0,0 +1,245 @@
+#if(__cplusplus == 201703L)
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../tests/catch2/catch.hpp"
+
+#include <algorithm>
+
+#include "../indiRuleGraph.hpp"
+
+namespace indiRuleGraph_test
+{
+
+/// Create a number property with one element, owned by the maps
+pcf::IndiProperty * numProp( indiRuleMaps & maps,
+                             const std::string & name,
+                             double val
+                           )
+{
+    pcf::IndiProperty * prop = new pcf::IndiProperty(pcf::IndiProperty::Number);
+    prop->setDevice("ruleTest");
+    prop->setName(name);
+    prop->add(pcf::IndiElement("current"));
+    (*prop)["current"] = val;
+
+    maps.props["ruleTest." + name] = prop;
+
+    return prop;
+}
+
+/// Create a numVal rule, owned by the maps
+numValRule * numRule( indiRuleMaps & maps,
+                      const std::string & name,
+                      pcf::IndiProperty * prop,
+                      ruleComparison comp,
+                      double target
+                    )
+{
+    numValRule * rule = new numValRule;
+    rule->property(prop);
+    rule->element("current");
+    rule->comparison(comp);
+    rule->target(target);
+
+    maps.rules[name] = rule;
+
+    return rule;
+}
+
+/// Create a ruleComp rule, owned by the maps
+ruleCompRule * compRule( indiRuleMaps & maps,
+                         const std::string & name,
+                         indiCompRule * rule1,
+                         indiCompRule * rule2,
+                         ruleComparison comp
+                       )
+{
+    ruleCompRule * rule = new ruleCompRule;
+    rule->rule1(rule1);
+    rule->rule2(rule2);
+    rule->comparison(comp);
+
+    maps.rules[name] = rule;
+
+    return rule;
+}
+
+SCENARIO( "incremental rule evaluation", "[stateRuleEngine::graph]" )
+{
+    GIVEN("(A && B) || C, with A and B on one property and C on another")
+    {
+        indiRuleMaps maps;
+
+        pcf::IndiProperty * prop1 = numProp(maps, "prop1", 1.0);
+        pcf::IndiProperty * prop2 = numProp(maps, "prop2", 1.0);
+        pcf::IndiProperty * prop3 = numProp(maps, "prop3", 1.0);
+
+        numValRule * ruleA = numRule(maps, "A", prop1, ruleComparison::Gt, 0.0);
+        numValRule * ruleB = numRule(maps, "B", prop1, ruleComparison::Lt, 2.0);
+        numValRule * ruleC = numRule(maps, "C", prop2, ruleComparison::Eq, 5.0);
+        ruleCompRule * ruleAB = compRule(maps, "AB", ruleA, ruleB, ruleComparison::And);
+        ruleCompRule * ruleABC = compRule(maps, "ABC", ruleAB, ruleC, ruleComparison::Or);
+
+        indiRuleGraph graph;
+        graph.build(maps);
+
+        std::vector<size_t> changed;
+        graph.evaluateAll(changed);
+
+        WHEN("the graph is built and evaluated")
+        {
+            REQUIRE(graph.size() == 5);
+            REQUIRE(changed.size() == 5);
+
+            //Dependencies are ordered before the rules using them
+            std::map<std::string, size_t> idx;
+            for(size_t n = 0; n < graph.size(); ++n) idx[graph.name(n)] = n;
+            REQUIRE(idx["A"] < idx["AB"]);
+            REQUIRE(idx["B"] < idx["AB"]);
+            REQUIRE(idx["AB"] < idx["ABC"]);
+            REQUIRE(idx["C"] < idx["ABC"]);
+
+            REQUIRE(graph.dependents(prop1) == 4);
+            REQUIRE(graph.dependents(prop2) == 2);
+            REQUIRE(graph.dependents(prop3) == 0);
+
+            REQUIRE(std::get<bool>(ruleABC->result()) == true);
+            REQUIRE(ruleABC->value() == true);
+        }
+
+        WHEN("a property is updated so the composite result changes")
+        {
+            (*prop1)["current"] = 3.0;
+            size_t nev = graph.update(prop1, changed);
+
+            REQUIRE(nev == 4);
+
+            std::vector<std::string> names;
+            for(size_t n : changed) names.push_back(graph.name(n));
+            std::sort(names.begin(), names.end());
+
+            REQUIRE(names == std::vector<std::string>({"AB", "ABC", "B"}));
+
+            //Matches evaluating from scratch
+            REQUIRE(std::get<bool>(ruleB->result()) == false);
+            REQUIRE(std::get<bool>(ruleABC->result()) == false);
+            REQUIRE(ruleABC->value() == false);
+
+            AND_WHEN("the other property is updated")
+            {
+                (*prop2)["current"] = 5.0;
+                graph.update(prop2, changed);
+
+                REQUIRE(changed.size() == 2);
+                REQUIRE(std::get<bool>(ruleC->result()) == true);
+                REQUIRE(std::get<bool>(ruleABC->result()) == true);
+                REQUIRE(std::get<bool>(ruleAB->result()) == false);
+            }
+        }
+
+        WHEN("a property is updated without changing any results")
+        {
+            (*prop1)["current"] = 1.5;
+            graph.update(prop1, changed);
+
+            REQUIRE(changed.size() == 0);
+        }
+
+        WHEN("an element is missing from the update")
+        {
+            pcf::IndiProperty empty(pcf::IndiProperty::Number);
+            empty.setDevice("ruleTest");
+            empty.setName("prop1");
+            *prop1 = empty;
+            graph.update(prop1, changed);
+
+            THEN("the rules have errors")
+            {
+                REQUIRE(changed.size() == 4);
+                REQUIRE(ruleA->isError(ruleA->result()));
+                REQUIRE(ruleABC->isError(ruleABC->result()));
+                REQUIRE_THROWS_AS(ruleABC->value(), mx::err::invalidconfig);
+            }
+        }
+
+        WHEN("an unrelated property is updated")
+        {
+            REQUIRE(graph.update(prop3, changed) == 0);
+            REQUIRE(changed.size() == 0);
+        }
+    }
+
+    GIVEN("rules which depend on each other")
+    {
+        indiRuleMaps maps;
+
+        pcf::IndiProperty * prop1 = numProp(maps, "prop1", 1.0);
+        numValRule * ruleA = numRule(maps, "A", prop1, ruleComparison::Gt, 0.0);
+        ruleCompRule * ruleB = compRule(maps, "B", ruleA, nullptr, ruleComparison::And);
+        ruleCompRule * ruleC = compRule(maps, "C", ruleB, nullptr, ruleComparison::And);
+        ruleB->rule2(ruleC);
+
+        indiRuleGraph graph;
+
+        REQUIRE_THROWS_AS(graph.build(maps), mx::err::invalidconfig);
+    }
+}
+
+TEST_CASE( "Benchmark rule evaluation", "[.benchmark][stateRuleEngine::graph]" )
+{
+    //4 rules on each of 1000 properties, with a ruleComp for each pair of rules, for 6000 rules
+    indiRuleMaps maps;
+
+    std::vector<pcf::IndiProperty *> props;
+    for(int p = 0; p < 1000; ++p)
+    {
+        props.push_back(numProp(maps, "prop" + std::to_string(p), p));
+
+        indiCompRule * r[4];
+        for(int n = 0; n < 4; ++n)
+        {
+            r[n] = numRule(maps, "rule" + std::to_string(p) + "_" + std::to_string(n), props.back(), ruleComparison::Gt, n*250);
+        }
+
+        compRule(maps, "comp" + std::to_string(p) + "_0", r[0], r[1], ruleComparison::And);
+        compRule(maps, "comp" + std::to_string(p) + "_1", r[2], r[3], ruleComparison::Or);
+    }
+
+    //The polling loop in the original appLogic, before the rules are bound to slots
+    BENCHMARK("value() of every rule")
+    {
+        size_t non = 0;
+        for(auto it = maps.rules.begin(); it != maps.rules.end(); ++it)
+        {
+            non += it->second->value();
+        }
+        return non;
+    };
+
+    indiRuleGraph graph;
+    graph.build(maps);
+
+    std::vector<size_t> changed;
+    graph.evaluateAll(changed);
+
+    REQUIRE(graph.size() == 6000);
+
+    BENCHMARK("evaluateAll")
+    {
+        graph.evaluateAll(changed);
+        return changed.size();
+    };
+
+    size_t p = 0;
+    BENCHMARK("update of one property")
+    {
+        (*props[p])["current"] = (*props[p])["current"].get<double>() + 1;
+        graph.update(props[p], changed);
+        p = (p + 1) % props.size();
+        return changed.size();
+    };
+}
+
+} //namespace indiRuleGraph_test
+
+#endif
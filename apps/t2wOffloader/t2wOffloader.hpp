@@ -82,8 +82,6 @@ protected:
    mx::improc::eigenImage<realT> m_twRespM;
    mx::improc::eigenImage<realT> m_tweeter;
    mx::improc::eigenImage<realT> m_woofer;
-   mx::improc::eigenImage<realT> m_wooferDelta;
-   mx::improc::eigenImage<realT> m_modeAmps;
 
 
    mx::improc::eigenImage<realT> m_tweeterMask;
@@ -92,6 +90,12 @@ protected:
 
    mx::improc::eigenCube<float> m_wModes;
 
+   Eigen::Matrix<realT,-1,-1> m_tModesM; ///< The orthogonalized tweeter modes, one column per mode.
+   Eigen::Matrix<realT,-1,-1> m_wModesM; ///< The woofer response to each tweeter mode, one column per mode.
+
+   Eigen::Matrix<realT,-1,-1> m_offloadM; ///< The combined modal filter and response matrix, from tweeter to woofer, for m_offloadMModes.
+   int m_offloadMModes {-1}; ///< The number of modes m_offloadM was made for, 0 for actuator offloading, -1 if it has not been made.
+
    float m_fps {0}; ///< Current FPS from the FPS source.
    int m_navg {0}; ///< Current navg from the averager
 
@@ -158,6 +162,13 @@ public:
    
    int prepareModes();
 
+   /// Make the tweeter to woofer matrix for a number of modes.
+   /** For actuator offloading (numModes = 0) this is the response matrix.  Otherwise it is the response matrix times
+     * the projector onto the first numModes (at least 1, at most m_maxModes) orthogonalized tweeter modes, so the
+     * per-frame work is a single matrix-vector product either way.
+     */
+   void makeOffloadMatrix( int numModes /**< [in] the number of modes, 0 for actuator offloading */);
+
 protected:
 
   
@@ -439,9 +450,17 @@ int t2wOffloader::allocate(const dev::shmimT & dummy)
       m_woofer.setZero();
    }
    
-   m_modeAmps.resize(1,  m_tModesOrtho.planes());
+   if(m_twRespM.rows() != m_woofer.size() || m_twRespM.cols() != m_tweeter.size())
+   {
+      return log<software_error,-1>({__FILE__, __LINE__, "response matrix size does not match the tweeter and woofer"});
+   }
 
-   ///\todo size checks here.
+   if(m_tModesM.cols() > 0 && m_tModesM.rows() != m_tweeter.size())
+   {
+      return log<software_error,-1>({__FILE__, __LINE__, "tweeter mode size does not match the tweeter"});
+   }
+   
+   m_offloadMModes = -1;
    
    //state(stateCodes::OPERATING);
    
@@ -457,39 +476,17 @@ int t2wOffloader::processImage( void * curr_src,
    
    if(!m_offloading) return 0;
    
-   if(m_numModes == 0)
-   {
-      m_wooferDelta = m_twRespM.matrix() * Eigen::Map<Eigen::Matrix<float,-1,-1>>((float *)curr_src,  m_width*m_height,1);
-   }
-   else
-   {
-      m_modeAmps = Eigen::Map<Eigen::Matrix<float,-1,-1>>((float *) curr_src, 1, m_width*m_height) * Eigen::Map<Eigen::Matrix<float,-1,-1>>(m_tModesOrtho.data(), m_tModesOrtho.rows()*m_tModesOrtho.cols(), m_tModesOrtho.planes()); 
-
-      m_wooferDelta = m_modeAmps(0,0) * m_wModes.image(0);
-      for(int p=1; p < m_numModes && p < m_maxModes; ++p)
-      {
-         m_wooferDelta += m_modeAmps(0,p)*m_wModes.image(p);
-      }
-
-      
-   }
+   int numModes = m_numModes;
+   if(numModes != m_offloadMModes) makeOffloadMatrix(numModes); //only when changed
    
    while(m_dmStream.md[0].write == 1); //Check if zero() is running
    
+   //Leaky integrator, with the update as one GEMV accumulated into the woofer, then clamp
+   Eigen::Map<Eigen::Matrix<realT,-1,1>> woofer(m_woofer.data(), m_woofer.size());
    
-   m_woofer = m_gain* Eigen::Map<Eigen::Array<float,-1,-1>>( m_wooferDelta.data(), m_dmWidth, m_dmHeight) + (1.0-m_leak)*m_woofer;
-      
-   for(int ii = 0; ii < m_woofer.rows(); ++ii)
-   {
-      for(int jj = 0; jj < m_woofer.cols(); ++jj)
-      {
-         if( fabs(m_woofer(ii,jj)) > m_actLim)
-         {
-            if(m_woofer(ii,jj) > 0) m_woofer(ii,jj) = m_actLim;
-            else m_woofer(ii,jj) = -m_actLim;
-         }
-      }
-   }
+   woofer *= (1.0-m_leak);
+   woofer.noalias() += m_gain * m_offloadM * Eigen::Map<Eigen::Matrix<realT,-1,1>>((realT *) curr_src, m_width*m_height);
+   woofer = woofer.cwiseMax(-m_actLim).cwiseMin(m_actLim);
    
    m_dmStream.md[0].write = 1;
    
@@ -575,10 +572,33 @@ int t2wOffloader::prepareModes()
 
    ff.write("/tmp/wModes.fits", m_wModes);
 
+   m_tModesM = Eigen::Map<Eigen::Matrix<realT,-1,-1>>(m_tModesOrtho.data(), m_tModesOrtho.rows()*m_tModesOrtho.cols(), m_tModesOrtho.planes());
+   m_wModesM = Eigen::Map<Eigen::Matrix<realT,-1,-1>>(m_wModes.data(), m_wModes.rows()*m_wModes.cols(), m_wModes.planes());
+
+   m_offloadMModes = -1;
+
    return 0;
 
 }
 
+inline
+void t2wOffloader::makeOffloadMatrix( int numModes )
+{
+   if(numModes <= 0 || m_wModesM.cols() == 0)
+   {
+      m_offloadM = m_twRespM.matrix();
+      m_offloadMModes = numModes;
+      return;
+   }
+
+   int n = std::min(numModes, m_maxModes);
+   n = std::min<int>(n, m_wModesM.cols());
+   if(n < 1) n = 1; //modal offloading always includes the first mode
+
+   m_offloadM.noalias() = m_wModesM.leftCols(n) * m_tModesM.leftCols(n).transpose();
+   m_offloadMModes = numModes;
+}
+
 INDI_NEWCALLBACK_DEFN(t2wOffloader, m_indiP_gain)(const pcf::IndiProperty &ipRecv)
 {
    if(ipRecv.getName() != m_indiP_gain.getName())
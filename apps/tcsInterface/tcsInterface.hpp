@@ -15,6 +15,8 @@
 
 #include "../../libMagAOX/app/dev/telemeter.hpp"
 
+#include "tcsStatus.hpp"
+
 //#define LOG_TCS_STATUS
 
 /** \defgroup tcsInterface
@@ -77,6 +79,55 @@ protected:
 
    ///@}
 
+   /** \name TCS Status Polling
+     * The status requests are polled by the status thread, each at its own rate.
+     *@{
+     */
+
+   bool m_statusPipeline {true}; ///< If true, all due status requests are sent at once and then the responses are read.  Config with status.pipeline
+
+   double m_statusPollPeriod {0.25}; ///< The time between status polls [sec].  Config with status.pollPeriod
+
+   double m_datetimePeriod {0}; ///< The minimum time between datetime requests [sec].  0 means every poll.  Config with status.datetimePeriod
+   double m_telposPeriod {0};   ///< The minimum time between telpos requests [sec].  0 means every poll.  Config with status.telposPeriod
+   double m_teldataPeriod {0};  ///< The minimum time between teldata requests [sec].  0 means every poll.  Config with status.teldataPeriod
+   double m_catdataPeriod {0};  ///< The minimum time between catdata requests [sec].  0 means every poll.  Config with status.catdataPeriod
+   double m_vedataPeriod {0};   ///< The minimum time between vedata requests [sec].  0 means every poll.  Config with status.vedataPeriod
+   double m_telenvPeriod {0};   ///< The minimum time between telenv requests [sec].  0 means every poll.  Config with status.telenvPeriod
+
+   TCS::statusPoller m_statusPoller; ///< Sends the status requests and holds the responses.
+
+   /// The index of each status request in m_statusPoller
+   enum statusRequests { REQ_DATETIME, REQ_TELPOS, REQ_TELDATA, REQ_CATDATA, REQ_VEDATA, REQ_TELENV };
+
+   /// Mutex for the telescope status values, which are written by the status thread and read by appLogic.
+   std::mutex m_statusMutex;
+
+   bool m_statusThreadInit {true}; ///< Initialization flag for the status thread.
+
+   pid_t m_statusThreadID {0}; ///< Status thread pid.
+
+   pcf::IndiProperty m_statusThreadProp; ///< Status thread INDI property.
+
+   std::thread m_statusThread; ///< The status polling thread.
+
+   /// Status thread starter function
+   static void statusThreadStart( tcsInterface * t /**< [in] pointer to this */);
+
+   /// Status thread function
+   /** Polls the TCS status while connected, until m_shutdown is true.
+     */
+   void statusThreadExec();
+
+   /// Poll the TCS status once, and parse the new responses
+   /**
+     * \returns 0 on success
+     * \returns -1 on an error, in which case the state is set to ERROR or NOTCONNECTED
+     */
+   int pollStatus();
+
+   ///@}
+
    //Telescope time:
    double m_telST {0};
 
@@ -207,10 +258,6 @@ public:
      */
    virtual int appShutdown();
 
-   int getMagTelStatus( std::string & response,
-                        const std::string &statreq
-                      );
-
    int sendMagTelCommand( const std::string &command, 
                           int timeout
                         );
@@ -221,17 +268,15 @@ public:
                   const std::string & xmsstr
                 );
    
-   std::vector<std::string> parse_teldata( std::string &tdat );
-   
+   //Parsers for the "dump" commands, which modify the response in place:
    
-   //The "dump" commands:
+   int parseTelTime( char * response );
+   int parseTelPos( char * response );
+   int parseTelData( char * response );
+   int parseCatData( char * response );
+   int parseVaneData( char * response );
+   int parseEnvData( char * response );
    
-   int getTelTime();
-   int getTelPos();
-   int getTelData();
-   int getCatData();
-   int getVaneData();
-   int getEnvData();
    int getSeeing();
    
    int updateINDI();
@@ -422,6 +467,25 @@ public:
 inline
 tcsInterface::tcsInterface() : MagAOXApp(MAGAOX_CURRENT_SHA1, MAGAOX_REPO_MODIFIED)
 {
+   //Position and telescope data are polled continuously, so only record significant changes.
+   setTelemPolicy<telem_telpos>("telpos", 0.0, 0.0, { {"epoch", &telem_telpos::epoch, 0.0},
+                                                      {"ra", &telem_telpos::ra, 1e-5},
+                                                      {"dec", &telem_telpos::dec, 1e-5},
+                                                      {"el", &telem_telpos::el, 1e-5},
+                                                      {"ha", &telem_telpos::ha, 1e-5},
+                                                      {"am", &telem_telpos::am, 1e-4},
+                                                      {"rotoff", &telem_telpos::ro, 1e-5} } );
+
+   setTelemPolicy<telem_teldata>("teldata", 0.0, 0.0, { {"roi", &telem_teldata::roi, 0.0},
+                                                        {"tracking", &telem_teldata::tracking, 0.0},
+                                                        {"guiding", &telem_teldata::guiding, 0.0},
+                                                        {"slewing", &telem_teldata::slewing, 0.0},
+                                                        {"guiderMoving", &telem_teldata::guiderMoving, 0.0},
+                                                        {"az", &telem_teldata::az, 1e-5},
+                                                        {"zd", &telem_teldata::zd, 1e-5},
+                                                        {"pa", &telem_teldata::pa, 1e-4},
+                                                        {"domeAz", &telem_teldata::domeAz, 1e-2},
+                                                        {"domeStat", &telem_teldata::domeStat, 0.0} } );
    return;
 }
 
@@ -476,6 +540,15 @@ void tcsInterface::setupConfig()
    
    config.add("device.address", "", "device.address", argType::Required, "device", "address", false, "string", "The IP address or resolvable name of the TCS.");
    config.add("device.port", "", "device.port", argType::Required, "device", "port", false, "int", "The IP port for TCS communications. Should be the command port.  Default is 5811.");
+
+   config.add("status.pipeline", "", "status.pipeline", argType::Required, "status", "pipeline", false, "bool", "If true (default), all due status requests are sent at once and then the responses are read.  If false each request waits for its response.");
+   config.add("status.pollPeriod", "", "status.pollPeriod", argType::Required, "status", "pollPeriod", false, "double", "The time between status polls [sec].  Default is 0.25.");
+   config.add("status.datetimePeriod", "", "status.datetimePeriod", argType::Required, "status", "datetimePeriod", false, "double", "The minimum time between datetime requests [sec].  Default is 0, every poll.");
+   config.add("status.telposPeriod", "", "status.telposPeriod", argType::Required, "status", "telposPeriod", false, "double", "The minimum time between telpos requests [sec].  Default is 0, every poll.");
+   config.add("status.teldataPeriod", "", "status.teldataPeriod", argType::Required, "status", "teldataPeriod", false, "double", "The minimum time between teldata requests [sec].  Default is 0, every poll.");
+   config.add("status.catdataPeriod", "", "status.catdataPeriod", argType::Required, "status", "catdataPeriod", false, "double", "The minimum time between catdata requests [sec].  Default is 0, every poll.");
+   config.add("status.vedataPeriod", "", "status.vedataPeriod", argType::Required, "status", "vedataPeriod", false, "double", "The minimum time between vedata requests [sec].  Default is 0, every poll.");
+   config.add("status.telenvPeriod", "", "status.telenvPeriod", argType::Required, "status", "telenvPeriod", false, "double", "The minimum time between telenv requests [sec].  Default is 0, every poll.");
   
    dev::ioDevice::setupConfig(config);
    dev::telemeter<tcsInterface>::setupConfig(config);
@@ -531,6 +604,15 @@ int tcsInterface::loadConfigImpl( mx::app::appConfigurator & _config )
    _config(m_deviceAddr, "device.address"); 
    _config(m_devicePort, "device.port");
 
+   _config(m_statusPipeline, "status.pipeline");
+   _config(m_statusPollPeriod, "status.pollPeriod");
+   _config(m_datetimePeriod, "status.datetimePeriod");
+   _config(m_telposPeriod, "status.telposPeriod");
+   _config(m_teldataPeriod, "status.teldataPeriod");
+   _config(m_catdataPeriod, "status.catdataPeriod");
+   _config(m_vedataPeriod, "status.vedataPeriod");
+   _config(m_telenvPeriod, "status.telenvPeriod");
+
    dev::ioDevice::loadConfig(_config);
    
    dev::telemeter<tcsInterface>::loadConfig(_config);
@@ -830,6 +912,21 @@ int tcsInterface::appStartup()
       return -1;
    }
    
+   //These must be added in the order of statusRequests
+   m_statusPoller.addQuery("datetime", m_datetimePeriod);
+   m_statusPoller.addQuery("telpos", m_telposPeriod);
+   m_statusPoller.addQuery("teldata", m_teldataPeriod);
+   m_statusPoller.addQuery("catdata", m_catdataPeriod);
+   m_statusPoller.addQuery("vedata", m_vedataPeriod);
+   m_statusPoller.addQuery("telenv", m_telenvPeriod);
+   m_statusPoller.pipeline(m_statusPipeline);
+   
+   if(threadStart( m_statusThread, m_statusThreadInit, m_statusThreadID, m_statusThreadProp, 0, "", "status", this, statusThreadStart) < 0)
+   {
+      log<software_error>({__FILE__, __LINE__});
+      return -1;
+   }
+   
    
    //Register to receive the coeff updates from Kyle
    REG_INDI_SETPROP(m_indiP_offloadCoeffs, "w2tcsOffloader", "zCoeffs");
@@ -844,7 +941,10 @@ int tcsInterface::appLogic()
 {
    if(state() == stateCodes::ERROR)
    {
+      std::unique_lock<std::mutex> lock(m_tcsMutex);
       int rv = m_sock.serialInit(m_deviceAddr.c_str(), m_devicePort);
+      m_statusPoller.reset();
+      lock.unlock();
 
       if(rv != 0)
       {
@@ -863,8 +963,10 @@ int tcsInterface::appLogic()
       static int lastrv = 0; //Used to handle a change in error within the same state.  Make general?
       static int lasterrno = 0;
        
-      
+      std::unique_lock<std::mutex> lock(m_tcsMutex);
       int rv = m_sock.serialInit(m_deviceAddr.c_str(), m_devicePort);
+      m_statusPoller.reset();
+      lock.unlock();
 
       if(rv == 0)
       {
@@ -901,45 +1003,15 @@ int tcsInterface::appLogic()
    
    if(state() == stateCodes::CONNECTED)
    {
-      std::string response;
-      
-      //If any of these are unsuccesful we go around without recording data.
-      if(getTelTime() < 0)
-      {
-         return 0; //app state will be set based on what the error was
-      }
-
-      if(getTelPos() < 0)
-      {
-         return 0; //app state will be set based on what the error was
-      }
-      
-      if(getTelData() < 0)
-      {
-         return 0;
-      }
-      
-      if(getCatData() < 0)
-      {
-         return 0;
-      }
-      
-      if(getVaneData() < 0)
-      {
-         return 0;
-      }
-      
-      if(getEnvData() < 0)
-      {
-         return 0;
-      }
+      //The TCS status is polled by the status thread
       
-
       if(getSeeing() < 0)
       {
          return 0;
       }
       
+      std::lock_guard<std::mutex> guard(m_statusMutex);
+      
       telemeter<tcsInterface>::appLogic();
       
       if(updateINDI() < 0)
@@ -957,6 +1029,18 @@ int tcsInterface::appLogic()
 inline
 int tcsInterface::appShutdown()
 {   
+   //Wait for status thread to exit on m_shutdown.
+   if(m_statusThread.joinable())
+   {
+      try
+      {
+         m_statusThread.join(); //this will throw if it was already joined
+      }
+      catch(...)
+      {
+      }
+   }
+   
    //Wait for offload thread to exit on m_shutdown.
    if(m_offloadThread.joinable())
    {
@@ -973,52 +1057,72 @@ int tcsInterface::appShutdown()
 }
 
 inline
-int tcsInterface::getMagTelStatus( std::string & response,
-                                   const std::string &statreq
-                                 )
+int tcsInterface::pollStatus()
 {
-
-   int stat;
-   char answer[512];
-   std::string statreq_nl;
-
-   #ifdef LOG_TCS_STATUS
-   log<text_log>("Sending status request: " + statreq);
-   #endif
-
-   std::lock_guard<std::mutex> guard(m_tcsMutex);
+   int rv;
    
-   statreq_nl = statreq;
-   statreq_nl += '\n';
-   stat = m_sock.serialOut(statreq_nl.c_str(), statreq_nl.length());
+   {
+      std::lock_guard<std::mutex> guard(m_tcsMutex);
+      rv = m_statusPoller.poll(m_sock, m_readTimeout);
+   }
    
-   if(stat != NETSERIAL_E_NOERROR)
+   if(rv < 0)
    {
-      log<text_log>("Error sending status request: " + statreq, logPrio::LOG_ERROR);
-      response = "";
-      return 0;
+      if(m_statusPoller.failed() >= 0)
+      {
+         log<text_log>("No response received to status request: " + m_statusPoller[m_statusPoller.failed()].m_request, logPrio::LOG_ERROR);
+      }
+      else
+      {
+         log<text_log>("Error communicating with TCS for status requests", logPrio::LOG_ERROR);
+      }
+      
+      state(stateCodes::ERROR);
+      return -1;
    }
    
-   stat = m_sock.serialInString(answer, 512, m_readTimeout, '\n');
+   std::lock_guard<std::mutex> guard(m_statusMutex);
    
-   if(stat <= 0)
+   for(size_t n = 0; n < m_statusPoller.size(); ++n)
    {
-      log<text_log>("No response received to status request: " + statreq, logPrio::LOG_ERROR);
-      response = "";
-      return 0;
+      TCS::statusQuery & q = m_statusPoller[n];
+      
+      if(!q.m_fresh) continue;
+      
+      #ifdef LOG_TCS_STATUS
+      log<text_log>(std::string("Received response: ") + q.m_response);
+      #endif
+      
+      //If any of these are unsuccesful we go around without parsing the rest.
+      switch(n)
+      {
+         case REQ_DATETIME:
+            rv = parseTelTime(q.m_response);
+            break;
+         case REQ_TELPOS:
+            rv = parseTelPos(q.m_response);
+            break;
+         case REQ_TELDATA:
+            rv = parseTelData(q.m_response);
+            break;
+         case REQ_CATDATA:
+            rv = parseCatData(q.m_response);
+            break;
+         case REQ_VEDATA:
+            rv = parseVaneData(q.m_response);
+            break;
+         case REQ_TELENV:
+            rv = parseEnvData(q.m_response);
+            break;
+         default:
+            rv = 0;
+      }
+      
+      if(rv < 0) return -1; //app state will be set based on what the error was
    }
-
-   char * nl = strchr(answer, '\n');
-   if(nl) answer[nl-answer] = '\0';
-
-   #ifdef LOG_TCS_STATUS
-   log<text_log>(std::string("Received response: ") + answer);
-   #endif
-
-   response = answer;
    
    return 0;
-}//int tcsInterface::getMagTelStatus
+}//int tcsInterface::pollStatus
 
 inline
 int tcsInterface::sendMagTelCommand( const std::string &command, 
@@ -1064,57 +1168,6 @@ int tcsInterface::sendMagTelCommand( const std::string &command,
    
 }//int tcsInterface::sendMagTelCommand
 
-inline
-std::vector<std::string> tcsInterface::parse_teldata( std::string &tdat )
-{
-   std::vector<std::string> vres;
-
-   std::string tok;
-
-   int pos1, pos2;
-
-  
-   //skip all leading spaces
-   pos1 = tdat.find_first_not_of(" " , 0);
-    
-   if(pos1 == -1) pos1 = 0;
-
-   pos2 = tdat.find_first_of(" ", pos1);
-
-   while(pos2 > 0)
-   {
-      tok = tdat.substr(pos1, pos2-pos1);
-
-      vres.push_back(tok);
-
-      //now move past end of current spaces - might be more than one.
-      pos1 = pos2;
-
-      pos2 = tdat.find_first_not_of(" ", pos1);
-
-      //and then find the end of this value.
-      pos1 = pos2;
-
-      pos2 = tdat.find_first_of(" ", pos1);
-   }
-
-   //If there is another value, we pick it up here.
-   if(pos1 >= 0)
-   {
-      pos2 = tdat.length();
-
-      tok = tdat.substr(pos1, pos2-pos1);
-
-      pos2 = tok.find_first_of(" \n\r", 0);
-
-      if(pos2 >= 0) tok.erase(pos2, tok.length()-pos2);
-
-      vres.push_back(tok);
-   }
-
-   return vres;
-}
-
 inline
 int tcsInterface::parse_xms( double &x, 
                              double &m, 
@@ -1122,117 +1175,9 @@ int tcsInterface::parse_xms( double &x,
                              const std::string & xmsstr
                            )
 {
-   size_t st, en;
-
-   int sgn = 1;
-
-   st = 0;
-   en = xmsstr.find(':', st);
-   
-   //Check not found
-   if(en == std::string::npos)
-   {
-      log<software_error>({__FILE__, __LINE__, "error parsing x:m:s"});
-      return -1;
-   }
-
-   //Check 0 length or invalid
-   if(en - st < 2 || en < st)
-   {
-      log<software_error>({__FILE__, __LINE__, "error parsing x:m:s"});
-      return -1;
-   }
-
-   std::string xstr;
-   try
-   {
-      xstr = xmsstr.substr(st, en-st);
-   }
-   catch(const std::exception & e)
-   {
-      log<software_error>({__FILE__, __LINE__, e.what()});
-      return -1;
-   }
-
-   try
-   {
-      x = std::stod(xstr);
-   }
-   catch(const std::exception & e)
-   {
-      log<software_error>({__FILE__, __LINE__, e.what()});
-      return -1;
-   }
-
-   //Check for negative
-   if(std::signbit(x)) sgn = -1;
-   if(xmsstr[0] == '-') sgn = -1;
-
-   st = en + 1;
-   
-   en = xmsstr.find(':', st);
-   
-   //Check not found
-   if(en == std::string::npos)
-   {
-      log<software_error>({__FILE__, __LINE__, "error parsing x:m:s"});
-      return -1;
-   }
-
-   //Check 0 length or invalid
-   if(en - st < 2 || en < st)
-   {
-      log<software_error>({__FILE__, __LINE__, "error parsing x:m:s"});
-      return -1;
-   }
-
-   std::string mstr;
-   try
-   {
-      mstr = xmsstr.substr(st, en-st);
-   }
-   catch(const std::exception & e)
-   {
-      log<software_error>({__FILE__, __LINE__, e.what()});
-      return -1;
-   }
-
-   try
-   {
-      m = sgn*std::stod(mstr);
-   }
-   catch(const std::exception & e)
-   {
-      log<software_error>({__FILE__, __LINE__, e.what()});
-      return -1;
-   }
-
-   st = en+1;
-
-   if(st >= xmsstr.length() - 1)
-   {
-      log<software_error>({__FILE__, __LINE__, "error parsing x:m:s"});
-      return -1;
-   }
-
-   std::string sstr;
-   try
-   {
-      sstr = xmsstr.substr(st, xmsstr.length()-st);
-   }
-   catch(const std::exception & e)
-   {
-      log<software_error>({__FILE__, __LINE__, e.what()});
-      return -1;
-   }
-   
-   try
-   {
-      s = sgn*std::stod(sstr);
-   }
-   catch(const std::exception & e)
+   if(TCS::parseXms(x, m, s, xmsstr.c_str()) != 0)
    {
-      log<software_error>({__FILE__, __LINE__, e.what()});
+      log<software_error>({__FILE__, __LINE__, "error parsing x:m:s: " + xmsstr});
       return -1;
    }
 
@@ -1240,23 +1185,14 @@ int tcsInterface::parse_xms( double &x,
 }
 
 inline
-int tcsInterface::getTelTime()
+int tcsInterface::parseTelTime( char * response )
 {
    double  h,m,s;
 
-   std::vector<std::string> pdat;
-   std::string posstr;
-   
-   if(getMagTelStatus( posstr, "datetime") < 0)
-   {
-      state(stateCodes::NOTCONNECTED);
-      log<text_log>("Error getting telescope position (telpos)", logPrio::LOG_ERROR);
-      return -1;
-   }
-
-   pdat = parse_teldata(posstr);
+   TCS::statusFields pdat;
+   pdat.split(response);
 
-   if(pdat[0] == "-1")
+   if(pdat.isError())
    {
       state(stateCodes::ERROR);
       log<text_log>("Error getting telescope time (datetime): TCS returned -1", logPrio::LOG_WARNING);
@@ -1270,7 +1206,7 @@ int tcsInterface::getTelTime()
       return -1;
    }
 
-   if(parse_xms(h,m,s,pdat[2]) != 0)
+   if(TCS::parseXms(h,m,s,pdat[2]) != 0)
    {
       log<text_log>("Error parsing telescope ST", logPrio::LOG_WARNING);
       return -1;
@@ -1279,26 +1215,17 @@ int tcsInterface::getTelTime()
    m_telST = (h + m/60. + s/3600.);
 
    return 0;
-}//int tcsInterface::getTelTime()
+}//int tcsInterface::parseTelTime()
 
 inline
-int tcsInterface::getTelPos()
+int tcsInterface::parseTelPos( char * response )
 {
    double  h,m,s;
 
-   std::vector<std::string> pdat;
-   std::string posstr;
-   
-   if(getMagTelStatus( posstr, "telpos") < 0)
-   {
-      state(stateCodes::NOTCONNECTED);
-      log<text_log>("Error getting telescope position (telpos)", logPrio::LOG_ERROR);
-      return -1;
-   }
-
-   pdat = parse_teldata(posstr);
+   TCS::statusFields pdat;
+   pdat.split(response);
 
-   if(pdat[0] == "-1")
+   if(pdat.isError())
    {
       state(stateCodes::ERROR);
       log<text_log>("Error getting telescope position (telpos): TCS returned -1", logPrio::LOG_WARNING);
@@ -1312,7 +1239,7 @@ int tcsInterface::getTelPos()
       return -1;
    }
 
-   if(parse_xms(h,m,s,pdat[0]) != 0)
+   if(TCS::parseXms(h,m,s,pdat[0]) != 0)
    {
       log<text_log>("Error parsing telescope RA", logPrio::LOG_WARNING);
       return -1;
@@ -1320,7 +1247,7 @@ int tcsInterface::getTelPos()
 
    m_telRA = (h + m/60. + s/3600.)*15.;
 
-   if(parse_xms(h,m,s,pdat[1]) != 0)
+   if(TCS::parseXms(h,m,s,pdat[1]) != 0)
    {
       log<text_log>("Error parsing telescope Dec", logPrio::LOG_WARNING);
       return -1;
@@ -1328,11 +1255,11 @@ int tcsInterface::getTelPos()
    
    m_telDec = h + m/60. + s/3600.;
 
-   //m_telEl = strtod(pdat[1].c_str(),0);// * 3600.;
+   //m_telEl = strtod(pdat[1],0);// * 3600.;
 
-   m_telEpoch = strtod(pdat[2].c_str(),0);
+   m_telEpoch = strtod(pdat[2],0);
 
-   if(parse_xms( h, m, s, pdat[3]) != 0)
+   if(TCS::parseXms(h, m, s, pdat[3]) != 0)
    {
       log<text_log>("Error parsing telescope HA", logPrio::LOG_WARNING);
       return -1;
@@ -1342,9 +1269,9 @@ int tcsInterface::getTelPos()
    */
    m_telHA = h + m/60. + s/3600.;
 
-   m_telAM = strtod(pdat[4].c_str(),0);
+   m_telAM = strtod(pdat[4],0);
 
-   m_telRotOff = strtod(pdat[5].c_str(),0);
+   m_telRotOff = strtod(pdat[5],0);
 
    if( recordTelPos() < 0)
    {
@@ -1352,24 +1279,15 @@ int tcsInterface::getTelPos()
    }
    
    return 0;
-}//int tcsInterface::getTelPos()
+}//int tcsInterface::parseTelPos()
 
 inline
-int tcsInterface::getTelData()
+int tcsInterface::parseTelData( char * response )
 {
-   std::string xstr;
-   std::vector<std::string> tdat;
-
-   if(getMagTelStatus(xstr, "teldata") < 0)
-   {
-      state(stateCodes::NOTCONNECTED);
-      log<text_log>("Error getting telescope data (teldata)", logPrio::LOG_ERROR);
-      return -1;
-   }
+   TCS::statusFields tdat;
+   tdat.split(response);
 
-   tdat = parse_teldata(xstr);
-
-   if(tdat[0] == "-1")
+   if(tdat.isError())
    {
       state(stateCodes::ERROR);
       log<text_log>("Error getting telescope data (teldata): TCS returned -1", logPrio::LOG_WARNING);
@@ -1384,35 +1302,35 @@ int tcsInterface::getTelData()
    }
 
 
-   m_telROI = atoi(tdat[0].c_str());
+   m_telROI = atoi(tdat[0]);
 
    //Parse the telguide string
    char bit[2] = {0,0};
    bit[1] = 0;
-   bit[0] = tdat[1].c_str()[0];
+   bit[0] = tdat[1][0];
    m_telTracking= atoi(bit);
-   bit[0] = tdat[1].c_str()[1];
+   bit[0] = tdat[1][1];
    m_telGuiding= atoi(bit);
 
    //parse the gdrmountmv string
-   bit[0] = tdat[2].c_str()[0];
+   bit[0] = tdat[2][0];
    m_telSlewing= atoi(bit);
-   bit[0] = tdat[2].c_str()[1];
+   bit[0] = tdat[2][1];
    m_telGuiderMoving = atoi(bit);
 
    //number 3 is mountmv
 
-   m_telAz = strtod(tdat[4].c_str(),0);
+   m_telAz = strtod(tdat[4],0);
 
-   m_telEl = strtod(tdat[5].c_str(),0);
+   m_telEl = strtod(tdat[5],0);
 
-   m_telZd = strtod(tdat[6].c_str(),0);// * 3600.;
+   m_telZd = strtod(tdat[6],0);// * 3600.;
 
-   m_telPA = strtod(tdat[7].c_str(),0);
+   m_telPA = strtod(tdat[7],0);
 
-   m_telDomeAz = strtod(tdat[8].c_str(),0);
+   m_telDomeAz = strtod(tdat[8],0);
 
-   m_telDomeStat = atoi(tdat[9].c_str());
+   m_telDomeStat = atoi(tdat[9]);
 
    if( recordTelData() < 0)
    {
@@ -1420,26 +1338,17 @@ int tcsInterface::getTelData()
    }
    
    return 0;
-}//int tcsInterface::getTelData()
+}//int tcsInterface::parseTelData()
 
 inline
-int tcsInterface::getCatData()
+int tcsInterface::parseCatData( char * response )
 {
    double h, m,s;
 
-   std::vector<std::string> cdat;
-   std::string cstr;
-   
-   if( getMagTelStatus(cstr, "catdata") < 0)
-   {
-      state(stateCodes::NOTCONNECTED);
-      log<text_log>("Error getting catalog data (catdata)", logPrio::LOG_ERROR);
-      return -1;
-   }
-
-   cdat = parse_teldata(cstr);
+   TCS::statusFields cdat;
+   cdat.split(response);
 
-   if(cdat[0] == "-1")
+   if(cdat.isError())
    {
       state(stateCodes::ERROR);
       log<text_log>("Error getting catalog data (catdata): TCS returned -1", logPrio::LOG_WARNING);
@@ -1465,7 +1374,7 @@ int tcsInterface::getCatData()
       return 1;
    }
 
-   if(parse_xms(h,m,s,cdat[0]) != 0)
+   if(TCS::parseXms(h,m,s,cdat[0]) != 0)
    {
       log<text_log>("Error parsing catalog RA", logPrio::LOG_WARNING);
       return -1;
@@ -1473,7 +1382,7 @@ int tcsInterface::getCatData()
 
    m_catRA = (h + m/60. + s/3600.)*15.;
    
-   if(parse_xms(h,m,s,  cdat[1] ) != 0)
+   if(TCS::parseXms(h,m,s,  cdat[1] ) != 0)
    {
       log<text_log>("Error parsing catalog Dec", logPrio::LOG_WARNING);
       return -1;
@@ -1481,33 +1390,24 @@ int tcsInterface::getCatData()
    
    m_catDec = h + m/60. + s/3600.;
 
-   m_catEp = strtod(cdat[2].c_str(),0);
+   m_catEp = strtod(cdat[2],0);
 
-   m_catRo = strtod(cdat[3].c_str(),0);
+   m_catRo = strtod(cdat[3],0);
 
    m_catRm = cdat[4];
 
    m_catObj = cdat[5];
    
    return 0;
-}//int tcsInterface::getCatData()
+}//int tcsInterface::parseCatData()
 
 inline
-int tcsInterface::getVaneData()
+int tcsInterface::parseVaneData( char * response )
 {
-   std::string xstr;
-   std::vector<std::string> vedat;
+   TCS::statusFields vedat;
+   vedat.split(response);
 
-   if(getMagTelStatus(xstr,"vedata") < 0)
-   {
-      state(stateCodes::NOTCONNECTED);
-      log<text_log>("Error getting telescope secondary positions (vedata)",logPrio::LOG_ERROR);
-      return -1;
-   }
-
-   vedat = parse_teldata(xstr);
-
-   if(vedat[0] == "-1")
+   if(vedat.isError())
    {
       state(stateCodes::ERROR);
       log<text_log>("Error getting telescope secondary positions (vedata): TCS returned -1",logPrio::LOG_WARNING);
@@ -1522,16 +1422,16 @@ int tcsInterface::getVaneData()
    }
 
 
-   m_telSecZ = strtod(vedat[0].c_str(),0);
-   m_telEncZ = strtod(vedat[1].c_str(),0);
-   m_telSecX = strtod(vedat[2].c_str(),0);
-   m_telEncX = strtod(vedat[3].c_str(),0);
-   m_telSecY = strtod(vedat[4].c_str(),0);
-   m_telEncY = strtod(vedat[5].c_str(),0);
-   m_telSecH = strtod(vedat[6].c_str(),0);
-   m_telEncH = strtod(vedat[7].c_str(),0);
-   m_telSecV = strtod(vedat[8].c_str(),0);
-   m_telEncV = strtod(vedat[9].c_str(),0);
+   m_telSecZ = strtod(vedat[0],0);
+   m_telEncZ = strtod(vedat[1],0);
+   m_telSecX = strtod(vedat[2],0);
+   m_telEncX = strtod(vedat[3],0);
+   m_telSecY = strtod(vedat[4],0);
+   m_telEncY = strtod(vedat[5],0);
+   m_telSecH = strtod(vedat[6],0);
+   m_telEncH = strtod(vedat[7],0);
+   m_telSecV = strtod(vedat[8],0);
+   m_telEncV = strtod(vedat[9],0);
    
    if( recordTelVane() < 0)
    {
@@ -1539,24 +1439,15 @@ int tcsInterface::getVaneData()
    }
    
    return 0;
-}//int tcsInterface::getVaneData()
+}//int tcsInterface::parseVaneData()
 
 inline
-int tcsInterface::getEnvData()
+int tcsInterface::parseEnvData( char * response )
 {
-   std::string estr;
-   std::vector<std::string> edat;
-
-   if(getMagTelStatus(estr,"telenv") < 0)
-   {
-      state(stateCodes::NOTCONNECTED);
-      log<text_log>("Error getting telescope environment data (telenv)",logPrio::LOG_ERROR);
-      return -1;
-   }
-   
-   edat = parse_teldata(estr);
+   TCS::statusFields edat;
+   edat.split(response);
 
-   if(edat[0] == "-1")
+   if(edat.isError())
    {
       state(stateCodes::NOTCONNECTED);
       log<text_log>("Error getting telescope environment data (telenv): TCS returned -1",logPrio::LOG_WARNING);
@@ -1570,16 +1461,16 @@ int tcsInterface::getEnvData()
       return -1;      
    }
 
-   m_wxtemp = strtod(edat[0].c_str(), 0);
-   m_wxpres = strtod(edat[1].c_str(), 0);
-   m_wxhumid = strtod(edat[2].c_str(), 0);
-   m_wxwind = strtod(edat[3].c_str(), 0);
-   m_wxwdir = strtod(edat[4].c_str(), 0);
-   m_ttruss = strtod(edat[5].c_str(), 0);
-   m_tcell = strtod(edat[6].c_str(), 0);
-   m_tseccell = strtod(edat[7].c_str(), 0);
-   m_tambient = strtod(edat[8].c_str(), 0);
-   m_wxdewpoint = strtod(edat[9].c_str(),0);
+   m_wxtemp = strtod(edat[0], 0);
+   m_wxpres = strtod(edat[1], 0);
+   m_wxhumid = strtod(edat[2], 0);
+   m_wxwind = strtod(edat[3], 0);
+   m_wxwdir = strtod(edat[4], 0);
+   m_ttruss = strtod(edat[5], 0);
+   m_tcell = strtod(edat[6], 0);
+   m_tseccell = strtod(edat[7], 0);
+   m_tambient = strtod(edat[8], 0);
+   m_wxdewpoint = strtod(edat[9],0);
    
    if( recordTelEnv() < 0)
    {
@@ -1587,7 +1478,7 @@ int tcsInterface::getEnvData()
    }
    
    return 0;
-} //int tcsInterface::getEnvData()
+} //int tcsInterface::parseEnvData()
 
 inline
 int tcsInterface::getSeeing()
@@ -2158,32 +2049,8 @@ int tcsInterface::recordTelem( const telem_telsee * )
 inline
 int tcsInterface::recordTelPos(bool force)
 {
-   static double lastEpoch = 0;
-   static double lastRA = 0;
-   static double lastDec = 0;
-   static double lastEl = 0;
-   static double lastHA = 0;
-   static double lastAM = 0;
-   static double lastRotOff = 0;
-   
-   if( force || lastEpoch != m_telEpoch ||
-                lastRA != m_telRA || 
-                lastDec != m_telDec ||
-                lastEl != m_telEl ||
-                lastHA != m_telHA ||
-                lastAM != m_telAM ||
-                lastRotOff != m_telRotOff )
-   {
-      telem<telem_telpos>({m_telEpoch, m_telRA, m_telDec, m_telEl, m_telHA, m_telAM, m_telRotOff});
-      
-      lastEpoch = m_telEpoch;
-      lastRA = m_telRA;
-      lastDec = m_telDec;
-      lastEl = m_telEl;
-      lastHA = m_telHA;
-      lastAM = m_telAM;
-      lastRotOff = m_telRotOff;
-   }
+   //changes are checked by the telpos policy, which force bypasses
+   telem<telem_telpos>({m_telEpoch, m_telRA, m_telDec, m_telEl, m_telHA, m_telAM, m_telRotOff}, force);
    
    return 0;
 }
@@ -2191,41 +2058,8 @@ int tcsInterface::recordTelPos(bool force)
 inline
 int tcsInterface::recordTelData(bool force)
 {
-   static int lastROI = -999;
-   static int lastTracking = -999;
-   static int lastGuiding = -999;
-   static int lastSlewing = -999;
-   static int lastGuiderMoving = -999;
-   static double lastAz = 0;
-   static double lastZd = 0;
-   static double lastPA = 0;
-   static double lastDomeAz = 0;
-   static int lastDomeStat = -999;
-   
-   if( force || lastROI != m_telROI || 
-                lastTracking != m_telTracking || 
-                lastGuiding != m_telGuiding ||
-                lastSlewing != m_telSlewing ||
-                lastGuiderMoving != m_telGuiderMoving ||
-                lastAz != m_telAz ||
-                lastZd != m_telZd ||
-                lastPA != m_telPA ||
-                lastDomeAz != m_telDomeAz ||
-                lastDomeStat != m_telDomeStat )
-   {
-      telem<telem_teldata>({m_telROI,m_telTracking,m_telGuiding,m_telSlewing,m_telGuiderMoving,m_telAz, m_telZd, m_telPA,m_telDomeAz,m_telDomeStat});
-      
-      lastROI = m_telROI;
-      lastTracking = m_telTracking;
-      lastGuiding = m_telGuiding;
-      lastSlewing = m_telSlewing;
-      lastGuiderMoving = m_telGuiderMoving;
-      lastAz = m_telAz;
-      lastZd = m_telZd;
-      lastPA = m_telPA;
-      lastDomeAz = m_telDomeAz;
-      lastDomeStat = m_telDomeStat;
-   }
+   //changes are checked by the teldata policy, which force bypasses
+   telem<telem_teldata>({m_telROI,m_telTracking,m_telGuiding,m_telSlewing,m_telGuiderMoving,m_telAz, m_telZd, m_telPA,m_telDomeAz,m_telDomeStat}, force);
    
    return 0;
 }
@@ -2476,6 +2310,35 @@ int tcsInterface::acquireFromGuider()
    return 0;
 }
 
+inline
+void tcsInterface::statusThreadStart( tcsInterface * t )
+{
+   t->statusThreadExec();
+}
+
+inline
+void tcsInterface::statusThreadExec( )
+{
+   //Get the thread PID immediately so the caller can return.
+   m_statusThreadID = syscall(SYS_gettid);
+
+   while( m_statusThreadInit == true && shutdown() == 0)
+   {
+      sleep(1);
+   }
+
+   while(shutdown() == 0)
+   {
+      //appLogic handles (re)connecting
+      if(state() == stateCodes::CONNECTED)
+      {
+         pollStatus();
+      }
+
+      std::this_thread::sleep_for(std::chrono::duration<double>(m_statusPollPeriod));
+   }
+}
+
 void tcsInterface::offloadThreadStart( tcsInterface * t )
 {
    t->offloadThreadExec();
@@ -0,0 +1,228 @@
+/** \file tcsSimulator.hpp
+  * \brief A loopback simulator of the Clay TCS, for testing and benchmarking the MagAO-X TCS Interface
+  *
+  * \ingroup tcsInterface_files
+  */
+
+#ifndef tcsSimulator_hpp
+#define tcsSimulator_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+namespace MagAOX
+{
+namespace app
+{
+namespace TCS
+{
+
+/// A loopback simulator of the TCS line protocol
+/** Listens on 127.0.0.1 and answers each newline terminated request with one newline terminated response.  The
+  * responses are looked up in m_responses, and unknown requests are answered with "-1" as the TCS does.  Requests
+  * are answered in order, so pipelined requests work as they do with the TCS.
+  *
+  * The network round trip is simulated with m_latency, which is waited once for each read of requests before
+  * the responses to all complete requests in it are sent.
+  *
+  * Only one connection is served at a time.  Set the responses and latency before calling start().
+  */
+class simulator
+{
+public:
+
+   std::map<std::string, std::string> m_responses; ///< The response to each request.
+
+   int m_latency {0}; ///< The simulated round trip time [usec].
+
+protected:
+
+   int m_listenfd {-1};
+   int m_port {0};
+
+   std::thread m_thread;
+   std::atomic<bool> m_stop {false};
+   std::atomic<uint64_t> m_nRequests {0};
+
+public:
+
+   /// Default c'tor, sets typical responses to the status requests
+   simulator()
+   {
+      m_responses["datetime"] = "2023-11-10 03:21:45 05:12:33.5";
+      m_responses["telpos"] = "12:20:50.26 -22:30:48.87 2000.0 -01:12:20.5 1.052 45.000";
+      m_responses["teldata"] = "1 11 00 0 123.456 60.211 29.789 -45.123 123.000 1";
+      m_responses["catdata"] = "12:20:50.20 -22:30:48.80 2000.0 0.000 EQU target";
+      m_responses["vedata"] = "-1235.20 -1235.21 12.50 12.51 -20.40 -20.41 1.20 1.21 -3.40 -3.41";
+      m_responses["telenv"] = "12.3 770.1 21.5 8.2 310.0 11.9 12.1 11.5 12.4 -9.8";
+   }
+
+   /// D'tor, stops the server
+   ~simulator()
+   {
+      stop();
+   }
+
+   /// Start listening on an ephemeral port on 127.0.0.1
+   /**
+     * \returns 0 on success
+     * \returns -1 on an error
+     */
+   int start()
+   {
+      m_listenfd = socket(AF_INET, SOCK_STREAM, 0);
+      if(m_listenfd < 0) return -1;
+
+      int one = 1;
+      setsockopt(m_listenfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+      struct sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      addr.sin_port = 0;
+
+      socklen_t alen = sizeof(addr);
+      if( bind(m_listenfd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+          listen(m_listenfd, 1) < 0 ||
+          getsockname(m_listenfd, (struct sockaddr *) &addr, &alen) < 0 )
+      {
+         close(m_listenfd);
+         m_listenfd = -1;
+         return -1;
+      }
+
+      m_port = ntohs(addr.sin_port);
+
+      m_stop = false;
+      m_thread = std::thread([this](){ run(); });
+
+      return 0;
+   }
+
+   /// Stop the server and close the socket
+   void stop()
+   {
+      m_stop = true;
+
+      if(m_thread.joinable()) m_thread.join();
+
+      if(m_listenfd >= 0)
+      {
+         close(m_listenfd);
+         m_listenfd = -1;
+      }
+   }
+
+   /// Get the port the simulator is listening on
+   int port() const
+   {
+      return m_port;
+   }
+
+   /// Get the number of requests answered
+   uint64_t nRequests() const
+   {
+      return m_nRequests;
+   }
+
+protected:
+
+   /// Wait for a socket to be readable, checking for stop every 50 msec
+   /**
+     * \returns true if readable, false if stopped
+     */
+   bool waitReadable( int fd )
+   {
+      while(!m_stop)
+      {
+         struct pollfd pfd;
+         pfd.fd = fd;
+         pfd.events = POLLIN;
+
+         int rv = poll(&pfd, 1, 50);
+         if(rv > 0) return true;
+         if(rv < 0 && errno != EINTR) return false;
+      }
+
+      return false;
+   }
+
+   /// The server thread
+   void run()
+   {
+      std::string rx;
+      std::string tx;
+      char buf[4096];
+
+      while(!m_stop)
+      {
+         if(!waitReadable(m_listenfd)) break;
+
+         int fd = accept(m_listenfd, nullptr, nullptr);
+         if(fd < 0) continue;
+
+         rx.clear();
+
+         while(waitReadable(fd))
+         {
+            ssize_t nr = recv(fd, buf, sizeof(buf), 0);
+            if(nr <= 0) break;
+
+            rx.append(buf, nr);
+
+            if(rx.find('\n') == std::string::npos) continue;
+
+            if(m_latency > 0) std::this_thread::sleep_for(std::chrono::microseconds(m_latency));
+
+            tx.clear();
+
+            size_t st = 0;
+            size_t nl;
+            while((nl = rx.find('\n', st)) != std::string::npos)
+            {
+               size_t en = nl;
+               if(en > st && rx[en-1] == '\r') --en;
+
+               auto it = m_responses.find(rx.substr(st, en - st));
+               if(it != m_responses.end()) tx += it->second;
+               else tx += "-1";
+               tx += '\n';
+
+               ++m_nRequests;
+               st = nl + 1;
+            }
+
+            rx.erase(0, st);
+
+            size_t ns = 0;
+            while(ns < tx.size())
+            {
+               ssize_t rv = send(fd, tx.data() + ns, tx.size() - ns, MSG_NOSIGNAL);
+               if(rv <= 0) break;
+               ns += rv;
+            }
+         }
+
+         close(fd);
+      }
+   }
+};
+
+} //namespace TCS
+} //namespace app
+} //namespace MagAOX
+
+#endif //tcsSimulator_hpp
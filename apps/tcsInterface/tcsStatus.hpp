@@ -0,0 +1,351 @@
+/** \file tcsStatus.hpp
+  * \brief Status polling and parsing for the MagAO-X TCS Interface
+  *
+  * \ingroup tcsInterface_files
+  */
+
+#ifndef tcsStatus_hpp
+#define tcsStatus_hpp
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../../libMagAOX/tty/netSerial.hpp"
+
+namespace MagAOX
+{
+namespace app
+{
+namespace TCS
+{
+
+/// The space separated fields of a TCS status response
+/** The response is split in place, so no memory is allocated.  This reproduces the splitting of the original
+  * parse_teldata: leading and repeated spaces are skipped, and a trailing '\\r' or '\\n' ends the response.
+  */
+struct statusFields
+{
+   static constexpr int maxFields {16}; ///< The maximum number of fields which are stored.
+
+   const char * m_fields[maxFields]; ///< Pointers to the start of each field in the response.
+
+   int m_n {0}; ///< The number of fields found, which can be more than maxFields.
+
+   /// Split a response into fields
+   /** Each separating space, and the end of the response, is replaced with '\\0'.
+     *
+     * \returns the number of fields.  If this is more than maxFields only the first maxFields are stored.
+     */
+   int split( char * str /**< [in.out] the response, which is modified */)
+   {
+      m_n = 0;
+
+      while(*str != '\0')
+      {
+         while(*str == ' ') ++str;
+
+         if(*str == '\0' || *str == '\r' || *str == '\n') break;
+
+         if(m_n < maxFields) m_fields[m_n] = str;
+         ++m_n;
+
+         while(*str != ' ' && *str != '\0' && *str != '\r' && *str != '\n') ++str;
+
+         if(*str == ' ')
+         {
+            *str = '\0';
+            ++str;
+         }
+         else
+         {
+            *str = '\0';
+            break;
+         }
+      }
+
+      return m_n;
+   }
+
+   /// Get the number of fields
+   int size() const
+   {
+      return m_n;
+   }
+
+   /// Get a field.  No bounds checking is done.
+   const char * operator[]( int n ) const
+   {
+      return m_fields[n];
+   }
+
+   /// Check if the TCS returned an error, which it indicates with a first field of "-1"
+   bool isError() const
+   {
+      return (m_n > 0 && strcmp(m_fields[0], "-1") == 0);
+   }
+};
+
+/// Parse a number in a fixed length field, without allocating
+/** This has the same acceptance as std::stod on the field.
+  *
+  * \returns 0 on success
+  * \returns -1 if no number was found or it is out of range
+  */
+inline
+int parseField( double & val,      ///< [out] the value
+                const char * str,  ///< [in] the start of the field
+                size_t len         ///< [in] the length of the field
+              )
+{
+   char buf[64];
+
+   if(len >= sizeof(buf)) return -1;
+
+   memcpy(buf, str, len);
+   buf[len] = '\0';
+
+   char * end;
+   errno = 0;
+   val = strtod(buf, &end);
+
+   if(end == buf || errno == ERANGE) return -1;
+
+   return 0;
+}
+
+/// Parse a sexagesimal x:m:s string, without allocating
+/** The x and m fields must be at least 2 characters long, as must the s field.  A negative x, including -0, makes
+  * m and s negative too.
+  *
+  * \returns 0 on success
+  * \returns -1 on a parsing error
+  */
+inline
+int parseXms( double & x,       ///< [out] the x (hours or degrees) value
+              double & m,       ///< [out] the minutes value
+              double & s,       ///< [out] the seconds value
+              const char * str  ///< [in] the x:m:s string
+            )
+{
+   const char * en = strchr(str, ':');
+
+   if(en == nullptr || en - str < 2) return -1;
+
+   if(parseField(x, str, en - str) < 0) return -1;
+
+   int sgn = 1;
+   if(std::signbit(x) || str[0] == '-') sgn = -1;
+
+   const char * st = en + 1;
+   en = strchr(st, ':');
+
+   if(en == nullptr || en - st < 2) return -1;
+
+   if(parseField(m, st, en - st) < 0) return -1;
+   m *= sgn;
+
+   st = en + 1;
+   size_t len = strlen(st);
+
+   if(len < 2) return -1;
+
+   if(parseField(s, st, len) < 0) return -1;
+   s *= sgn;
+
+   return 0;
+}
+
+/// A status request which is polled by statusPoller
+struct statusQuery
+{
+   std::string m_request; ///< The request sent to the TCS, e.g. "telpos".
+
+   double m_period {0}; ///< The minimum time between polls of this request [sec].  If 0 it is sent on every poll.
+
+   double m_lastSent {-1e30}; ///< The time this request was last sent [sec].
+
+   bool m_fresh {false}; ///< True if m_response was received in the most recent poll.
+
+   char m_response[512]; ///< The most recent response, with the newline removed.
+};
+
+/// Poll the TCS for status, with each request at its own rate
+/** On each call to poll() every request which is due is sent.  When pipelining, all due requests are sent in one
+  * write and then the responses are read back in order, so the TCS sees them back-to-back and the cost is a single
+  * network round trip.  Otherwise each request waits for its response before the next is sent, which is how the
+  * TCS was originally polled.
+  *
+  * The requests and responses go through tty::netSerial::serialQuery.  No memory is allocated once the requests are
+  * added.
+  */
+class statusPoller
+{
+public:
+
+   /// Error codes returned by poll()
+   enum errors { E_COMM = -1,    ///< sending or receiving failed, or the connection was closed
+                 E_TIMEOUT = -2  ///< a response was not received in time
+               };
+
+protected:
+
+   std::vector<statusQuery> m_queries;
+
+   bool m_pipeline {true};
+
+   std::string m_batch; ///< The requests to send on this poll
+
+   std::vector<size_t> m_sent; ///< The index of each request sent on this poll, in order
+
+   std::vector<char *> m_responses; ///< The response buffer of each request sent on this poll, in order
+
+   int m_failed {-1}; ///< The index of the request whose response was not received on the last poll
+
+public:
+
+   /// Add a request
+   /**
+     * \returns the index of the request, in the order added
+     */
+   size_t addQuery( const std::string & request, ///< [in] the request, without a newline
+                    double period                ///< [in] the minimum time between polls of this request [sec]
+                  )
+   {
+      m_queries.emplace_back();
+      m_queries.back().m_request = request;
+      m_queries.back().m_period = period;
+      m_queries.back().m_response[0] = '\0';
+
+      size_t len = 0;
+      for(auto & q : m_queries) len += q.m_request.size() + 1;
+      m_batch.reserve(len);
+      m_sent.reserve(m_queries.size());
+      m_responses.reserve(m_queries.size());
+
+      return m_queries.size() - 1;
+   }
+
+   /// Set whether or not the requests are pipelined
+   void pipeline( bool pl /**< [in] true to send all due requests before reading the responses*/)
+   {
+      m_pipeline = pl;
+   }
+
+   /// Get whether or not the requests are pipelined
+   bool pipeline() const
+   {
+      return m_pipeline;
+   }
+
+   /// Get the number of requests
+   size_t size() const
+   {
+      return m_queries.size();
+   }
+
+   /// Access a request and its latest response
+   statusQuery & operator[]( size_t n )
+   {
+      return m_queries[n];
+   }
+
+   /// Get the index of the request whose response was not received on the last poll, or -1.
+   int failed() const
+   {
+      return m_failed;
+   }
+
+   /// Make all requests due.  Call this after reconnecting.
+   void reset()
+   {
+      for(auto & q : m_queries)
+      {
+         q.m_lastSent = -1e30;
+         q.m_fresh = false;
+      }
+   }
+
+   /// Get the current time for the request periods
+   static double now()
+   {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   }
+
+   /// Send each request which is due and read the responses
+   /** On return m_fresh is set for each request with a new response.
+     *
+     * \returns the number of responses received, which is 0 if nothing was due
+     * \returns a value from errors on an error, in which case the connection should be reset
+     */
+   int poll( tty::netSerial & sock, ///< [in] the connection to the TCS
+             int timeout            ///< [in] the time to wait for each response [msec]
+           )
+   {
+      double tnow = now();
+
+      m_failed = -1;
+      m_sent.clear();
+      m_responses.clear();
+
+      for(size_t n = 0; n < m_queries.size(); ++n)
+      {
+         m_queries[n].m_fresh = false;
+
+         if(tnow - m_queries[n].m_lastSent >= m_queries[n].m_period)
+         {
+            m_sent.push_back(n);
+            m_responses.push_back(m_queries[n].m_response);
+         }
+      }
+
+      if(m_sent.size() == 0) return 0;
+
+      size_t nSent = m_sent.size();
+      size_t nRecv = 0;
+
+      while(nRecv < nSent)
+      {
+         //When pipelining all requests go at once, otherwise one at a time
+         size_t nReq = m_pipeline ? nSent : 1;
+
+         m_batch.clear();
+         for(size_t k = nRecv; k < nRecv + nReq; ++k)
+         {
+            m_batch += m_queries[m_sent[k]].m_request;
+            m_batch += '\n';
+         }
+
+         int rv = sock.serialQuery( m_batch.c_str(), m_batch.size(), m_responses.data() + nRecv, nReq,
+                                    sizeof(statusQuery::m_response), timeout, '\n' );
+
+         if(rv < 0) return E_COMM;
+
+         for(size_t k = nRecv; k < nRecv + rv; ++k)
+         {
+            m_queries[m_sent[k]].m_lastSent = tnow;
+            m_queries[m_sent[k]].m_fresh = true;
+         }
+
+         nRecv += rv;
+
+         if((size_t) rv < nReq)
+         {
+            m_failed = m_sent[nRecv];
+            return E_TIMEOUT;
+         }
+      }
+
+      return nSent;
+   }
+};
+
+} //namespace TCS
+} //namespace app
+} //namespace MagAOX
+
+#endif //tcsStatus_hpp
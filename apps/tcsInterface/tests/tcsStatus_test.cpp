@@ -0,0 +1,248 @@
+/** \file tcsStatus_test.cpp
+  * \brief Catch2 tests for the TCS status polling and parsing, using the TCS simulator.
+  *
+  * History:
+  */
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../tests/catch2/catch.hpp"
+
+#include <cstring>
+
+#include "../tcsStatus.hpp"
+#include "../tcsSimulator.hpp"
+
+using namespace MagAOX::app;
+
+namespace tcsStatus_test
+{
+
+SCENARIO( "Splitting TCS responses into fields", "[tcsInterface::tcsStatus]" )
+{
+   GIVEN("a response with repeated, leading, and trailing spaces")
+   {
+      char str[] = "  1 11  00 0 123.456\r";
+
+      TCS::statusFields fields;
+      fields.split(str);
+
+      THEN("the fields are found")
+      {
+         REQUIRE(fields.size() == 5);
+         REQUIRE(strcmp(fields[0], "1") == 0);
+         REQUIRE(strcmp(fields[1], "11") == 0);
+         REQUIRE(strcmp(fields[2], "00") == 0);
+         REQUIRE(strcmp(fields[3], "0") == 0);
+         REQUIRE(strcmp(fields[4], "123.456") == 0);
+         REQUIRE(fields.isError() == false);
+      }
+   }
+
+   GIVEN("an error response")
+   {
+      char str[] = "-1";
+
+      TCS::statusFields fields;
+      fields.split(str);
+
+      THEN("it is an error")
+      {
+         REQUIRE(fields.size() == 1);
+         REQUIRE(fields.isError() == true);
+      }
+   }
+
+   GIVEN("an empty response")
+   {
+      char str[] = "";
+
+      TCS::statusFields fields;
+
+      THEN("there are no fields")
+      {
+         REQUIRE(fields.split(str) == 0);
+         REQUIRE(fields.isError() == false);
+      }
+   }
+
+   GIVEN("a response with too many fields")
+   {
+      char str[] = "0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17";
+
+      TCS::statusFields fields;
+
+      THEN("they are all counted")
+      {
+         REQUIRE(fields.split(str) == 18);
+         REQUIRE(strcmp(fields[15], "15") == 0);
+      }
+   }
+}
+
+SCENARIO( "Parsing x:m:s without allocating", "[tcsInterface::tcsStatus]" )
+{
+   double x, m, s;
+
+   GIVEN("valid strings")
+   {
+      REQUIRE(TCS::parseXms(x, m, s, "12:20:50") == 0);
+      REQUIRE(x == 12);
+      REQUIRE(m == 20);
+      REQUIRE(s == 50);
+
+      REQUIRE(TCS::parseXms(x, m, s, "-22:30:48.8771819") == 0);
+      REQUIRE(x == -22);
+      REQUIRE(m == -30);
+      REQUIRE(s == Approx(-48.8771819));
+
+      REQUIRE(TCS::parseXms(x, m, s, "-00:30:48.5") == 0);
+      REQUIRE(m == -30);
+      REQUIRE(s == -48.5);
+   }
+
+   GIVEN("invalid strings, as for tcsInterface::parse_xms")
+   {
+      REQUIRE(TCS::parseXms(x, m, s, "") == -1);
+      REQUIRE(TCS::parseXms(x, m, s, "12-20-50") == -1);
+      REQUIRE(TCS::parseXms(x, m, s, "12:20-50") == -1);
+      REQUIRE(TCS::parseXms(x, m, s, ":12:20") == -1);
+      REQUIRE(TCS::parseXms(x, m, s, "12::20") == -1);
+      REQUIRE(TCS::parseXms(x, m, s, "12:20:") == -1);
+      REQUIRE(TCS::parseXms(x, m, s, "x:20:80") == -1);
+      REQUIRE(TCS::parseXms(x, m, s, "-x:20:80") == -1);
+      REQUIRE(TCS::parseXms(x, m, s, "20:m:80") == -1);
+      REQUIRE(TCS::parseXms(x, m, s, "-12:m:80") == -1);
+      REQUIRE(TCS::parseXms(x, m, s, "20:23:s.ssy") == -1);
+      REQUIRE(TCS::parseXms(x, m, s, "-12:23:s.sye") == -1);
+   }
+}
+
+SCENARIO( "Polling the TCS simulator", "[tcsInterface::tcsStatus]" )
+{
+   GIVEN("a simulator and a poller with the status requests")
+   {
+      TCS::simulator sim;
+      sim.m_responses["slow"] = "1 2 3";
+      REQUIRE(sim.start() == 0);
+
+      MagAOX::tty::netSerial sock;
+      REQUIRE(sock.serialInit("localhost", sim.port()) == NETSERIAL_E_NOERROR);
+
+      TCS::statusPoller poller;
+      size_t qDatetime = poller.addQuery("datetime", 0);
+      size_t qTelpos = poller.addQuery("telpos", 0);
+      size_t qTeldata = poller.addQuery("teldata", 0);
+      size_t qBad = poller.addQuery("notarequest", 0);
+      size_t qSlow = poller.addQuery("slow", 1000);
+
+      WHEN("pipelining")
+      {
+         poller.pipeline(true);
+
+         REQUIRE(poller.poll(sock, 1000) == 5);
+
+         THEN("every response is received in order")
+         {
+            REQUIRE(std::string(poller[qDatetime].m_response) == sim.m_responses["datetime"]);
+            REQUIRE(std::string(poller[qTelpos].m_response) == sim.m_responses["telpos"]);
+            REQUIRE(std::string(poller[qTeldata].m_response) == sim.m_responses["teldata"]);
+            REQUIRE(std::string(poller[qBad].m_response) == "-1");
+            REQUIRE(std::string(poller[qSlow].m_response) == "1 2 3");
+            for(size_t n = 0; n < poller.size(); ++n) REQUIRE(poller[n].m_fresh == true);
+         }
+
+         THEN("the next poll only sends the requests which are due")
+         {
+            REQUIRE(poller.poll(sock, 1000) == 4);
+            REQUIRE(poller[qSlow].m_fresh == false);
+            REQUIRE(poller[qTelpos].m_fresh == true);
+            REQUIRE(std::string(poller[qSlow].m_response) == "1 2 3");
+            REQUIRE(sim.nRequests() == 9);
+         }
+      }
+
+      WHEN("not pipelining")
+      {
+         poller.pipeline(false);
+
+         REQUIRE(poller.poll(sock, 1000) == 5);
+
+         THEN("every response is received")
+         {
+            REQUIRE(std::string(poller[qDatetime].m_response) == sim.m_responses["datetime"]);
+            REQUIRE(std::string(poller[qTeldata].m_response) == sim.m_responses["teldata"]);
+            REQUIRE(std::string(poller[qSlow].m_response) == "1 2 3");
+         }
+      }
+
+      sock.serialClose();
+   }
+
+   GIVEN("a simulator slower than the timeout")
+   {
+      TCS::simulator sim;
+      sim.m_latency = 200000;
+      REQUIRE(sim.start() == 0);
+
+      MagAOX::tty::netSerial sock;
+      REQUIRE(sock.serialInit("localhost", sim.port()) == NETSERIAL_E_NOERROR);
+
+      TCS::statusPoller poller;
+      poller.addQuery("datetime", 0);
+      size_t qTelpos = poller.addQuery("telpos", 0);
+
+      THEN("the poll times out on the first request")
+      {
+         REQUIRE(poller.poll(sock, 20) == TCS::statusPoller::E_TIMEOUT);
+         REQUIRE(poller.failed() == 0);
+         REQUIRE(poller[qTelpos].m_fresh == false);
+      }
+
+      sock.serialClose();
+   }
+}
+
+TEST_CASE( "Benchmark TCS status polling", "[.benchmark][tcsInterface::tcsStatus]" )
+{
+   for(int latency : {0, 500, 2000})
+   {
+      TCS::simulator sim;
+      sim.m_latency = latency;
+      REQUIRE(sim.start() == 0);
+
+      MagAOX::tty::netSerial sock;
+      REQUIRE(sock.serialInit("localhost", sim.port()) == NETSERIAL_E_NOERROR);
+
+      TCS::statusPoller poller;
+      for(auto req : {"datetime", "telpos", "teldata", "catdata", "vedata", "telenv"}) poller.addQuery(req, 0);
+
+      std::string lat = " latency=" + std::to_string(latency) + "us";
+
+      poller.pipeline(false);
+      BENCHMARK("sequential" + lat)
+      {
+         return poller.poll(sock, 1000);
+      };
+
+      poller.pipeline(true);
+      BENCHMARK("pipelined" + lat)
+      {
+         return poller.poll(sock, 1000);
+      };
+
+      BENCHMARK("parse telpos")
+      {
+         char str[512];
+         strcpy(str, poller[1].m_response);
+         TCS::statusFields fields;
+         fields.split(str);
+         double x = 0, m = 0, s = 0;
+         if(TCS::parseXms(x, m, s, fields[0]) != 0) return -1.0;
+         return x + strtod(fields[4], 0);
+      };
+
+      sock.serialClose();
+   }
+}
+
+} //namespace tcsStatus_test
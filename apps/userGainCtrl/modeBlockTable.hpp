@@ -0,0 +1,202 @@
+/** \file modeBlockTable.hpp
+  * \brief The mode to block table and block reduction kernels for the user gain control app
+  *
+  * \ingroup userGainCtrl_files
+  */
+
+#ifndef modeBlockTable_hpp
+#define modeBlockTable_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace MagAOX
+{
+namespace app
+{
+
+/// The block of each mode, and the range of modes in each block
+/** Built once from the block structure whenever it changes.  The ranges are clipped to the number of modes in the
+  * gain vector, so the kernels below do no bounds checking.
+  *
+  * \ingroup userGainCtrl
+  */
+struct modeBlockTable
+{
+    std::vector<uint16_t> m_block; ///< The block of each mode.  Modes after the last block are assigned to it.
+
+    std::vector<uint32_t> m_start; ///< The first mode in each block.
+
+    std::vector<uint32_t> m_n; ///< The number of modes in each block, which can be 0 after clipping.
+
+    /// Build the table
+    /**
+      * \returns 0 on success
+      * \returns -1 if there are no blocks, in which case the table is empty
+      */
+    int build( const std::vector<uint16_t> & blockN, ///< [in] the number of modes in each block
+               size_t nModes                         ///< [in] the number of modes in the gain vector
+             )
+    {
+        m_block.clear();
+        m_start.clear();
+        m_n.clear();
+
+        if(blockN.size() == 0)
+        {
+            return -1;
+        }
+
+        m_block.resize(nModes);
+        m_start.resize(blockN.size());
+        m_n.resize(blockN.size());
+
+        size_t st = 0;
+        for(size_t b = 0; b < blockN.size(); ++b)
+        {
+            m_start[b] = (st < nModes) ? st : nModes;
+            m_n[b] = (st + blockN[b] <= nModes) ? blockN[b] : nModes - m_start[b];
+
+            for(size_t m = m_start[b]; m < m_start[b] + m_n[b]; ++m)
+            {
+                m_block[m] = b;
+            }
+
+            st += blockN[b];
+        }
+
+        for(size_t m = st; m < nModes; ++m)
+        {
+            m_block[m] = blockN.size() - 1;
+        }
+
+        return 0;
+    }
+
+    /// Get the number of blocks
+    size_t nBlocks() const
+    {
+        return m_start.size();
+    }
+
+    /// Get the number of modes
+    size_t nModes() const
+    {
+        return m_block.size();
+    }
+};
+
+/// Calculate the average of the values in one block, and whether they are all the same
+/** The sum is accumulated in double, so for the block sizes used the average of identical values is exact, and
+  * the block is constant exactly when its minimum equals its maximum.
+  *
+  * \returns the average, or 0 if the block is empty
+  *
+  * \ingroup userGainCtrl
+  */
+template<typename realT>
+realT blockAverage( uint8_t & constant,           ///< [out] 1 if every value in the block is the same, 0 otherwise
+                    const realT * vals,           ///< [in] the per-mode values
+                    const modeBlockTable & table, ///< [in] the mode to block table
+                    size_t b                      ///< [in] the block
+                  )
+{
+    const size_t st = table.m_start[b];
+    const size_t N = table.m_n[b];
+
+    if(N == 0)
+    {
+        constant = 1;
+        return 0;
+    }
+
+    double sum = 0;
+    realT mn = vals[st];
+    realT mx = vals[st];
+
+    #pragma omp simd reduction(+:sum) reduction(min:mn) reduction(max:mx)
+    for(size_t m = st; m < st + N; ++m)
+    {
+        sum += vals[m];
+        mn = (vals[m] < mn) ? vals[m] : mn;
+        mx = (vals[m] > mx) ? vals[m] : mx;
+    }
+
+    constant = (mn == mx);
+
+    return sum / N;
+}
+
+/// Flag the blocks in which a new value vector differs from the current one
+/** \returns the number of blocks which changed
+  *
+  * \ingroup userGainCtrl
+  */
+template<typename realT>
+size_t changedBlocks( std::vector<uint8_t> & changed, ///< [out] 1 for each block which changed, 0 otherwise
+                      const realT * current,          ///< [in] the current values
+                      const realT * next,             ///< [in] the new values
+                      const modeBlockTable & table    ///< [in] the mode to block table
+                    )
+{
+    changed.resize(table.nBlocks());
+
+    size_t nch = 0;
+    for(size_t b = 0; b < table.nBlocks(); ++b)
+    {
+        changed[b] = (memcmp(current + table.m_start[b], next + table.m_start[b], table.m_n[b]*sizeof(realT)) != 0);
+        nch += changed[b];
+    }
+
+    return nch;
+}
+
+/// Shift the values in one block by a delta, preserving the differences within the block
+/**
+  * \ingroup userGainCtrl
+  */
+template<typename realT>
+void applyBlockDelta( realT * target,               ///< [out] the target values, only the block is written
+                      const realT * current,        ///< [in] the current values
+                      realT delta,                  ///< [in] the change to apply
+                      const modeBlockTable & table, ///< [in] the mode to block table
+                      size_t b                      ///< [in] the block
+                    )
+{
+    const size_t st = table.m_start[b];
+    const size_t N = table.m_n[b];
+
+    #pragma omp simd
+    for(size_t m = st; m < st + N; ++m)
+    {
+        target[m] = current[m] + delta;
+    }
+}
+
+/// Shift the values in every block by that block's delta, in one pass over the modes
+/** The delta of each mode is gathered through the table.  Blocks which are not changing should have a delta of 0.
+  *
+  * \ingroup userGainCtrl
+  */
+template<typename realT>
+void applyBlockDeltas( realT * target,               ///< [out] the target values
+                       const realT * current,        ///< [in] the current values
+                       const realT * deltas,         ///< [in] the change to apply to each block
+                       const modeBlockTable & table  ///< [in] the mode to block table
+                     )
+{
+    const uint16_t * block = table.m_block.data();
+    const size_t N = table.nModes();
+
+    #pragma omp simd
+    for(size_t m = 0; m < N; ++m)
+    {
+        target[m] = current[m] + deltas[block[m]];
+    }
+}
+
+} //namespace app
+} //namespace MagAOX
+
+#endif //modeBlockTable_hpp
@@ -0,0 +1,309 @@
+/** \file modeBlockTable_test.cpp
+  * \brief Catch2 tests for the mode block kernels of the userGainCtrl app.
+  *
+  * History:
+  */
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../tests/catch2/catch.hpp"
+
+#include <random>
+#include <vector>
+
+#include "../modeBlockTable.hpp"
+
+using namespace MagAOX::app;
+
+namespace modeBlockTable_test
+{
+
+/// Block sizes like those of blockModes: 2 single modes, then rings of growing size, for nModes modes
+std::vector<uint16_t> makeBlocks( size_t nModes )
+{
+   std::vector<uint16_t> blockN({1,1});
+   size_t tot = 2;
+   size_t b = 0;
+   while(tot < nModes)
+   {
+      size_t N = 2*(2*b+2);
+      size_t n = (N+1)*(N+1) - 1 - tot;
+      if(n > 2*N) n = 2*N;
+      if(tot + n > nModes) n = nModes - tot;
+      blockN.push_back(n);
+      tot += n;
+      ++b;
+   }
+
+   return blockN;
+}
+
+/// The original block loop of userGainCtrl::processImage
+void referenceBlocks( std::vector<float> & avgs,
+                      std::vector<uint8_t> & constant,
+                      const std::vector<float> & vals,
+                      const std::vector<uint16_t> & blockStart,
+                      const std::vector<uint16_t> & blockN
+                    )
+{
+   for(size_t n =0; n < blockStart.size(); ++n)
+   {
+      double mng = 0;
+      int NN = 0;
+      for(int m =0; m < blockN[n]; ++m)
+      {
+         if(blockStart[n] + m >= (int) vals.size()) break;
+         mng += vals[blockStart[n] + m];
+         ++NN;
+      }
+
+      avgs[n] = mng / NN;
+
+      bool c = true;
+      for(int m =0; m < blockN[n]; ++m)
+      {
+         if(blockStart[n] + m >= (int) vals.size()) break;
+         if(vals[blockStart[n] + m] != avgs[n])
+         {
+            c = false;
+            break;
+         }
+      }
+      constant[n] = c;
+   }
+}
+
+std::vector<uint16_t> blockStarts( const std::vector<uint16_t> & blockN )
+{
+   std::vector<uint16_t> blockStart(blockN.size(), 0);
+   for(size_t n = 1; n < blockN.size(); ++n)
+   {
+      blockStart[n] = blockStart[n-1] + blockN[n-1];
+   }
+   return blockStart;
+}
+
+SCENARIO( "Building the mode block table", "[userGainCtrl::modeBlockTable]" )
+{
+   GIVEN("blocks which cover the modes exactly")
+   {
+      std::vector<uint16_t> blockN({1,1,3,5});
+      modeBlockTable table;
+      REQUIRE(table.build(blockN, 10) == 0);
+
+      REQUIRE(table.nBlocks() == 4);
+      REQUIRE(table.nModes() == 10);
+      REQUIRE(table.m_block == std::vector<uint16_t>({0,1,2,2,2,3,3,3,3,3}));
+      REQUIRE(table.m_start == std::vector<uint32_t>({0,1,2,5}));
+      REQUIRE(table.m_n == std::vector<uint32_t>({1,1,3,5}));
+   }
+
+   GIVEN("blocks which cover more modes than there are")
+   {
+      std::vector<uint16_t> blockN({1,1,3,5});
+      modeBlockTable table;
+      REQUIRE(table.build(blockN, 4) == 0);
+
+      THEN("the ranges are clipped")
+      {
+         REQUIRE(table.m_start == std::vector<uint32_t>({0,1,2,4}));
+         REQUIRE(table.m_n == std::vector<uint32_t>({1,1,2,0}));
+         REQUIRE(table.m_block == std::vector<uint16_t>({0,1,2,2}));
+      }
+   }
+
+   GIVEN("blocks which cover fewer modes than there are")
+   {
+      std::vector<uint16_t> blockN({1,2});
+      modeBlockTable table;
+      REQUIRE(table.build(blockN, 5) == 0);
+
+      THEN("the extra modes are in the last block, but not in its range")
+      {
+         REQUIRE(table.m_block == std::vector<uint16_t>({0,1,1,1,1}));
+         REQUIRE(table.m_n == std::vector<uint32_t>({1,2}));
+      }
+   }
+
+   GIVEN("no blocks")
+   {
+      modeBlockTable table;
+      REQUIRE(table.build(std::vector<uint16_t>(), 5) == -1);
+      REQUIRE(table.nBlocks() == 0);
+      REQUIRE(table.nModes() == 0);
+   }
+}
+
+SCENARIO( "Block kernels", "[userGainCtrl::modeBlockTable]" )
+{
+   GIVEN("2400 modes with random gains, and some constant blocks")
+   {
+      const size_t nModes = 2400;
+      std::vector<uint16_t> blockN = makeBlocks(nModes);
+      std::vector<uint16_t> blockStart = blockStarts(blockN);
+
+      modeBlockTable table;
+      table.build(blockN, nModes);
+
+      std::mt19937 gen(1);
+      std::uniform_real_distribution<float> dist(0, 1);
+
+      std::vector<float> vals(nModes);
+      for(auto & v : vals) v = dist(gen);
+
+      for(size_t m = blockStart[3]; m < blockStart[3] + blockN[3]; ++m) vals[m] = 0.3;
+      for(size_t m = blockStart[7]; m < blockStart[7] + blockN[7]; ++m) vals[m] = 0.1;
+
+      WHEN("the block averages are calculated")
+      {
+         std::vector<float> avgs(blockN.size()), ref(blockN.size());
+         std::vector<uint8_t> constant(blockN.size()), refConstant(blockN.size());
+
+         referenceBlocks(ref, refConstant, vals, blockStart, blockN);
+
+         for(size_t b = 0; b < table.nBlocks(); ++b)
+         {
+            avgs[b] = blockAverage(constant[b], vals.data(), table, b);
+         }
+
+         THEN("they match the original loop")
+         {
+            for(size_t b = 0; b < table.nBlocks(); ++b)
+            {
+               REQUIRE(avgs[b] == Approx(ref[b]));
+            }
+            REQUIRE(constant == refConstant);
+            REQUIRE(constant[3] == 1);
+            REQUIRE(constant[7] == 1);
+            REQUIRE(avgs[3] == 0.3f);
+         }
+      }
+
+      WHEN("two blocks of a new vector differ")
+      {
+         std::vector<float> next = vals;
+         next[blockStart[2]] += 1;
+         next[blockStart[10] + blockN[10] - 1] += 1;
+
+         std::vector<uint8_t> changed;
+         size_t nch = changedBlocks(changed, vals.data(), next.data(), table);
+
+         THEN("only those blocks are flagged")
+         {
+            REQUIRE(nch == 2);
+            for(size_t b = 0; b < table.nBlocks(); ++b)
+            {
+               REQUIRE(changed[b] == (b == 2 || b == 10));
+            }
+         }
+      }
+
+      WHEN("a delta is applied to one block")
+      {
+         std::vector<float> target = vals;
+         applyBlockDelta(target.data(), vals.data(), 0.5f, table, 5);
+
+         THEN("only that block changes, by the delta")
+         {
+            for(size_t m = 0; m < nModes; ++m)
+            {
+               if(table.m_block[m] == 5) REQUIRE(target[m] == vals[m] + 0.5f);
+               else REQUIRE(target[m] == vals[m]);
+            }
+         }
+      }
+
+      WHEN("a delta is applied to every block")
+      {
+         std::vector<float> deltas(table.nBlocks());
+         for(auto & d : deltas) d = dist(gen);
+         deltas[0] = 0;
+
+         std::vector<float> target(nModes);
+         applyBlockDeltas(target.data(), vals.data(), deltas.data(), table);
+
+         THEN("it is the same as applying each block's delta in turn")
+         {
+            std::vector<float> ref = vals;
+            for(size_t b = 0; b < table.nBlocks(); ++b)
+            {
+               applyBlockDelta(ref.data(), vals.data(), deltas[b], table, b);
+            }
+            REQUIRE(target == ref);
+         }
+      }
+   }
+}
+
+TEST_CASE( "Benchmark block gain updates", "[.benchmark][userGainCtrl::modeBlockTable]" )
+{
+   const size_t nModes = 2400;
+   std::vector<uint16_t> blockN = makeBlocks(nModes);
+   std::vector<uint16_t> blockStart = blockStarts(blockN);
+
+   modeBlockTable table;
+   table.build(blockN, nModes);
+
+   std::mt19937 gen(2);
+   std::uniform_real_distribution<float> dist(0, 1);
+
+   std::vector<float> vals(nModes);
+   for(auto & v : vals) v = dist(gen);
+
+   std::vector<float> avgs(blockN.size());
+   std::vector<uint8_t> constant(blockN.size());
+   std::vector<uint8_t> changed;
+
+   std::vector<float> next = vals;
+   next[blockStart[5]] += 1;
+
+   BENCHMARK("original: all block averages")
+   {
+      referenceBlocks(avgs, constant, vals, blockStart, blockN);
+      return avgs[0];
+   };
+
+   BENCHMARK("kernels: all block averages")
+   {
+      for(size_t b = 0; b < table.nBlocks(); ++b)
+      {
+         avgs[b] = blockAverage(constant[b], vals.data(), table, b);
+      }
+      return avgs[0];
+   };
+
+   BENCHMARK("kernels: one block changed")
+   {
+      changedBlocks(changed, vals.data(), next.data(), table);
+      for(size_t b = 0; b < table.nBlocks(); ++b)
+      {
+         if(changed[b]) avgs[b] = blockAverage(constant[b], next.data(), table, b);
+      }
+      return avgs[0];
+   };
+
+   std::vector<float> target(nModes);
+   std::vector<float> deltas(table.nBlocks());
+   for(auto & d : deltas) d = dist(gen);
+
+   BENCHMARK("original: set every block")
+   {
+      for(size_t n = 0; n < blockN.size(); ++n)
+      {
+         target = vals;
+         for(int m =0; m < blockN[n]; ++m)
+         {
+            if(blockStart[n] + m > (int) target.size() -1) break;
+            target[blockStart[n] + m] = vals[blockStart[n] + m] + deltas[n];
+         }
+      }
+      return target[0];
+   };
+
+   BENCHMARK("kernels: set every block")
+   {
+      applyBlockDeltas(target.data(), vals.data(), deltas.data(), table);
+      return target[0];
+   };
+}
+
+} //namespace modeBlockTable_test
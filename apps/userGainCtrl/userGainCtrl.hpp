@@ -16,6 +16,8 @@
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#include "modeBlockTable.hpp"
+
 namespace MagAOX
 {
 namespace app
@@ -271,17 +273,17 @@ protected:
     mx::improc::eigenImage<realT> m_gainsCurrent; ///< The current gains.
     mx::improc::eigenImage<realT> m_gainsTarget; ///< The target gains.
     
-    realT (*pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
+    void (*pixcopy)(realT *, void *, size_t) {nullptr}; ///< Pointer to a function to copy the image data as our desired type realT.
     
     mx::improc::eigenImage<realT> m_mcsCurrent; ///< The current gains.
     mx::improc::eigenImage<realT> m_mcsTarget; ///< The target gains.
  
-    realT (*mc_pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
+    void (*mc_pixcopy)(realT *, void *, size_t) {nullptr}; ///< Pointer to a function to copy the image data as our desired type realT.
  
     mx::improc::eigenImage<realT> m_limitsCurrent; ///< The current gains.
     mx::improc::eigenImage<realT> m_limitsTarget; ///< The target gains.
  
-    realT (*limit_pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
+    void (*limit_pixcopy)(realT *, void *, size_t) {nullptr}; ///< Pointer to a function to copy the image data as our desired type realT.
  
     std::vector<uint16_t> m_modeBlockStart;
     std::vector<uint16_t> m_modeBlockN;
@@ -298,6 +300,16 @@ protected:
     std::vector<float> m_modeBlockLims;
     std::vector<uint8_t> m_modeBlockLimsConstant;
  
+    modeBlockTable m_modeBlockTable; ///< The block of each mode, and the modes in each block, for the block kernels.
+
+    std::vector<realT> m_modeScratch; ///< Holds a new frame while it is compared to the current values.
+
+    std::vector<uint8_t> m_blockChanged; ///< Flags for the blocks which changed in the last frame.
+
+    bool m_gainBlocksValid {false}; ///< False if the gain block averages must be recalculated for every block.
+    bool m_mcBlocksValid {false}; ///< False if the mult. coeff. block averages must be recalculated for every block.
+    bool m_limitBlocksValid {false}; ///< False if the limit block averages must be recalculated for every block.
+
     std::mutex m_modeBlockMutex;
  
     mx::fits::fitsFile<float> m_ff;
@@ -351,6 +363,20 @@ protected:
  
     int getModeBlocks();
  
+    /// Copy a new frame into the current values, and update the averages of the blocks which changed
+    /** Must be called with m_modeBlockMutex locked.  Only the INDI properties of the changed blocks are updated.
+      *
+      * \returns the number of blocks which changed
+      */
+    size_t updateBlocks( mx::improc::eigenImage<realT> & current,         ///< [in.out] the current values, updated from the frame
+                         std::vector<float> & blockAvgs,                  ///< [in.out] the block averages
+                         std::vector<uint8_t> & blockConstant,            ///< [in.out] whether each block is constant
+                         bool & blocksValid,                              ///< [in.out] if false, all blocks are updated.  Set to true on return.
+                         std::vector<pcf::IndiProperty> & indiP_blocks,   ///< [in] the INDI properties for the blocks
+                         void (*copy)(realT *, void *, size_t),           ///< [in] the function to copy the frame
+                         void * curr_src                                  ///< [in] the frame
+                       );
+
     int allocate( const gainShmimT & dummy /**< [in] tag to differentiate shmimMonitor parents.*/);
     
     int processImage( void * curr_src,          ///< [in] pointer to start of current frame.
@@ -734,6 +760,11 @@ int userGainCtrl::getModeBlocks()
     m_modeBlockLims.resize(Nb);
     m_modeBlockLimsConstant.resize(Nb);
 
+    m_modeBlockTable.build(m_modeBlockN, m_gainsCurrent.rows());
+    m_gainBlocksValid = false;
+    m_mcBlocksValid = false;
+    m_limitBlocksValid = false;
+
     //-- modify INDI vars --
     std::unique_lock<std::mutex> indilock(m_indiMutex);
       
@@ -826,6 +857,64 @@ int userGainCtrl::getModeBlocks()
     return 0;
 }
 
+inline
+size_t userGainCtrl::updateBlocks( mx::improc::eigenImage<realT> & current,
+                                   std::vector<float> & blockAvgs,
+                                   std::vector<uint8_t> & blockConstant,
+                                   bool & blocksValid,
+                                   std::vector<pcf::IndiProperty> & indiP_blocks,
+                                   void (*copy)(realT *, void *, size_t),
+                                   void * curr_src
+                                 )
+{
+   size_t N = current.rows()*current.cols();
+
+   if(m_modeBlockTable.nModes() > N)
+   {
+      //The block table is for a different size stream, which is being reallocated, so just copy
+      copy(current.data(), curr_src, N);
+      blocksValid = false;
+      return 0;
+   }
+
+   if(m_modeScratch.size() < N) m_modeScratch.resize(N);
+
+   copy(m_modeScratch.data(), curr_src, N);
+
+   size_t nch;
+   if(blocksValid)
+   {
+      nch = changedBlocks(m_blockChanged, current.data(), m_modeScratch.data(), m_modeBlockTable);
+   }
+   else
+   {
+      m_blockChanged.assign(m_modeBlockTable.nBlocks(), 1);
+      nch = m_modeBlockTable.nBlocks();
+   }
+
+   memcpy(current.data(), m_modeScratch.data(), N*sizeof(realT));
+
+   size_t nb = m_modeBlockTable.nBlocks();
+   if(blockAvgs.size() < nb) nb = blockAvgs.size();
+   if(blockConstant.size() < nb) nb = blockConstant.size();
+
+   for(size_t n = 0; n < nb; ++n)
+   {
+      if(!m_blockChanged[n]) continue;
+
+      blockAvgs[n] = blockAverage(blockConstant[n], current.data(), m_modeBlockTable, n);
+
+      if(n < indiP_blocks.size())
+      {
+         updateIfChanged(indiP_blocks[n], "current", blockAvgs[n]);
+      }
+   }
+
+   blocksValid = true;
+
+   return nch;
+}
+
 inline
 int userGainCtrl::allocate(const gainShmimT & dummy)
 {
@@ -838,7 +927,7 @@ int userGainCtrl::allocate(const gainShmimT & dummy)
    
     getModeBlocks();
 
-    pixget = getPixPointer<realT>(shmimMonitorT::m_dataType);
+    pixcopy = getPixelsPointer<realT>(shmimMonitorT::m_dataType);
 
     return 0;
 }
@@ -854,50 +943,7 @@ int userGainCtrl::processImage( void * curr_src,
 
    std::unique_lock<std::mutex> lock(m_modeBlockMutex);
 
-   realT * data = m_gainsCurrent.data();
-      
-   for(unsigned nn=0; nn < shmimMonitorT::m_width*shmimMonitorT::m_height; ++nn)
-   {
-      data[nn] = pixget(curr_src, nn);
-   }
-   
-   //update blocks here.
-
-   for(size_t n =0; n < m_modeBlockStart.size(); ++n)
-   {
-      double mng = 0;
-
-      int NN = 0;
-      
-      for(int m =0; m < m_modeBlockN[n]; ++m)
-      {
-         if(m_modeBlockStart[n] + m >= m_gainsCurrent.rows()) break;
-         mng += m_gainsCurrent(m_modeBlockStart[n] + m,0);
-         ++NN;
-      }
-
-      m_modeBlockGains[n] = mng / NN; 
-
-      bool constant = true;
-      
-      for(int m =0; m < m_modeBlockN[n]; ++m)
-      {
-         if(m_modeBlockStart[n] + m >= m_gainsCurrent.rows()) break;
-         if(m_gainsCurrent(m_modeBlockStart[n] + m,0) != m_modeBlockGains[n])
-         {
-            constant = false;
-            break;
-         }
-      }
-
-      m_modeBlockGainsConstant[n] = constant;
-
-   }
-
-   for(size_t n=0; n < m_indiP_blockGains.size(); ++n)
-   {
-      updateIfChanged(m_indiP_blockGains[n], "current", m_modeBlockGains[n]);
-   }
+   updateBlocks(m_gainsCurrent, m_modeBlockGains, m_modeBlockGainsConstant, m_gainBlocksValid, m_indiP_blockGains, pixcopy, curr_src);
 
    lock.unlock();
 
@@ -936,15 +982,13 @@ int userGainCtrl::setBlockGain( int n,
 {
    std::unique_lock<std::mutex> lock(m_modeBlockMutex);
 
+   if(n < 0 || (size_t) n >= m_modeBlockTable.nBlocks() || (size_t) n >= m_modeBlockGains.size()) return -1;
+
    m_gainsTarget = m_gainsCurrent;
 
    //Apply a delta to each mode in the block
    //to preserve intra-block differences
-   for(int m =0; m < m_modeBlockN[n]; ++m)
-   {
-      if(m_modeBlockStart[n] + m > m_gainsTarget.rows() -1) break;
-      m_gainsTarget(m_modeBlockStart[n] + m,0) = m_gainsCurrent(m_modeBlockStart[n] + m,0) + (g - m_modeBlockGains[n]);
-   }
+   applyBlockDelta(m_gainsTarget.data(), m_gainsCurrent.data(), (realT) (g - m_modeBlockGains[n]), m_modeBlockTable, n);
    //lock.unlock();
    recordBlockGains(true);
    writeGains();
@@ -974,7 +1018,8 @@ int userGainCtrl::allocate(const multcoeffShmimT & dummy)
     m_mcsCurrent.resize(mcShmimMonitorT::m_width, mcShmimMonitorT::m_height);
     m_mcsTarget.resize(mcShmimMonitorT::m_width, mcShmimMonitorT::m_height);
    
-    mc_pixget = getPixPointer<realT>(mcShmimMonitorT::m_dataType);
+    mc_pixcopy = getPixelsPointer<realT>(mcShmimMonitorT::m_dataType);
+    m_mcBlocksValid = false;
 
     return 0;
 }
@@ -990,49 +1035,7 @@ int userGainCtrl::processImage( void * curr_src,
 
    std::unique_lock<std::mutex> lock(m_modeBlockMutex);
 
-   realT * data = m_mcsCurrent.data();
-      
-   for(unsigned nn=0; nn < mcShmimMonitorT::m_width*mcShmimMonitorT::m_height; ++nn)
-   {
-      data[nn] = mc_pixget(curr_src, nn);
-   }
-   
-   //update blocks here.
-
-   for(size_t n =0; n < m_modeBlockStart.size(); ++n)
-   {
-      double mng = 0;
-
-      int NN = 0;
-      for(int m =0; m < m_modeBlockN[n]; ++m)
-      {
-         if(m_modeBlockStart[n] + m >= m_mcsCurrent.rows()) break;
-         mng += m_mcsCurrent(m_modeBlockStart[n] + m,0);
-         ++NN;
-      }
-
-      m_modeBlockMCs[n] = mng / NN; 
-   
-
-      bool constant = true;
-      
-      for(int m =0; m < m_modeBlockN[n]; ++m)
-      {
-         if(m_modeBlockStart[n] + m >= m_mcsCurrent.rows()) break;
-         if(m_mcsCurrent(m_modeBlockStart[n] + m,0) != m_modeBlockMCs[n])
-         {
-            constant = false;
-            break;
-         }
-      }
-
-      m_modeBlockMCsConstant[n] = constant;
-   }
-
-   for(size_t n=0; n < m_indiP_blockMCs.size(); ++n)
-   {
-      updateIfChanged(m_indiP_blockMCs[n], "current", m_modeBlockMCs[n]);
-   }
+   updateBlocks(m_mcsCurrent, m_modeBlockMCs, m_modeBlockMCsConstant, m_mcBlocksValid, m_indiP_blockMCs, mc_pixcopy, curr_src);
 
    lock.unlock();
 
@@ -1071,15 +1074,14 @@ int userGainCtrl::setBlockMC( int n,
 {
    std::unique_lock<std::mutex> lock(m_modeBlockMutex);
 
+   if(n < 0 || (size_t) n >= m_modeBlockTable.nBlocks() || (size_t) n >= m_modeBlockMCs.size()) return -1;
+   if((size_t) m_mcsCurrent.rows() < m_modeBlockTable.nModes()) return -1;
+
    m_mcsTarget = m_mcsCurrent;
 
    //Apply a delta to each mode in the block
    //to preserve intra-block differences
-   for(int m =0; m < m_modeBlockN[n]; ++m)
-   {
-      if(m_modeBlockStart[n] + m > m_mcsTarget.rows() -1) break;
-      m_mcsTarget(m_modeBlockStart[n] + m,0) = m_mcsCurrent(m_modeBlockStart[n] + m,0) + (mc- m_modeBlockMCs[n]);
-   }
+   applyBlockDelta(m_mcsTarget.data(), m_mcsCurrent.data(), (realT) (mc - m_modeBlockMCs[n]), m_modeBlockTable, n);
    lock.unlock();
    recordBlockGains(true);
    writeMCs();
@@ -1109,7 +1111,8 @@ int userGainCtrl::allocate(const limitShmimT & dummy)
     m_limitsCurrent.resize(limitShmimMonitorT::m_width, limitShmimMonitorT::m_height);
     m_limitsTarget.resize(limitShmimMonitorT::m_width, limitShmimMonitorT::m_height);
    
-    limit_pixget = getPixPointer<realT>(limitShmimMonitorT::m_dataType);
+    limit_pixcopy = getPixelsPointer<realT>(limitShmimMonitorT::m_dataType);
+    m_limitBlocksValid = false;
 
     return 0;
 }
@@ -1125,48 +1128,7 @@ int userGainCtrl::processImage( void * curr_src,
 
    std::unique_lock<std::mutex> lock(m_modeBlockMutex);
 
-   realT * data = m_limitsCurrent.data();
-      
-   for(unsigned nn=0; nn < limitShmimMonitorT::m_width*limitShmimMonitorT::m_height; ++nn)
-   {
-      data[nn] = limit_pixget(curr_src, nn);
-   }
-   
-   //update blocks here.
-   
-   for(size_t n =0; n < m_modeBlockStart.size(); ++n)
-   {
-      double mng = 0;
-
-      int NN = 0;
-      for(int m =0; m < m_modeBlockN[n]; ++m)
-      {
-         if(m_modeBlockStart[n] + m >= m_limitsCurrent.rows()) break;
-         mng += m_limitsCurrent(m_modeBlockStart[n] + m,0);
-         ++NN;
-      }
-
-      m_modeBlockLims[n] = mng / NN; 
-
-      bool constant = true;
-      
-      for(int m =0; m < m_modeBlockN[n]; ++m)
-      {
-         if(m_modeBlockStart[n] + m >= m_limitsCurrent.rows()) break;
-         if(m_limitsCurrent(m_modeBlockStart[n] + m,0) != m_modeBlockLims[n])
-         {
-            constant = false;
-            break;
-         }
-      }
-
-      m_modeBlockLimsConstant[n] = constant;
-   }
-
-   for(size_t n=0; n < m_indiP_blockLimits.size(); ++n)
-   {
-      updateIfChanged(m_indiP_blockLimits[n], "current", m_modeBlockLims[n]);
-   }
+   updateBlocks(m_limitsCurrent, m_modeBlockLims, m_modeBlockLimsConstant, m_limitBlocksValid, m_indiP_blockLimits, limit_pixcopy, curr_src);
 
    lock.unlock();
 
@@ -1205,15 +1167,14 @@ int userGainCtrl::setBlockLimit( int n,
 {
    std::unique_lock<std::mutex> lock(m_modeBlockMutex);
 
+   if(n < 0 || (size_t) n >= m_modeBlockTable.nBlocks() || (size_t) n >= m_modeBlockLims.size()) return -1;
+   if((size_t) m_limitsCurrent.rows() < m_modeBlockTable.nModes()) return -1;
+
    m_limitsTarget = m_limitsCurrent;
 
    //Apply a delta to each mode in the block
    //to preserve intra-block differences
-   for(int m =0; m < m_modeBlockN[n]; ++m)
-   {
-      if(m_modeBlockStart[n] + m > m_limitsTarget.rows() -1) break;
-      m_limitsTarget(m_modeBlockStart[n] + m,0) = m_limitsCurrent(m_modeBlockStart[n] + m,0) + (l- m_modeBlockLims[n]);
-   }
+   applyBlockDelta(m_limitsTarget.data(), m_limitsCurrent.data(), (realT) (l - m_modeBlockLims[n]), m_modeBlockTable, n);
    lock.unlock();
    recordBlockGains(true);
    writeLimits();
@@ -1343,9 +1304,21 @@ void userGainCtrl::powerLawSet()
         m_powerLawIndex = 0;
     }
 
+    recordBlockGains();
+
+    std::unique_lock<std::mutex> lock(m_modeBlockMutex);
+
+    if(block0 >= m_modeBlockTable.nBlocks() || m_modeBlockTable.nBlocks() > m_modeBlockGains.size())
+    {
+        return;
+    }
+
+    //Set all the blocks in one pass, so we don't have to wait for each update before the next
+    std::vector<realT> deltas(m_modeBlockTable.nBlocks(), 0);
+
     float mode0 = m_modeBlockStart[block0] + 0.5*m_modeBlockN[block0];
     float gain0 = m_modeBlockGains[block0];
-    for(size_t n=block0+1; n < m_modeBlockStart.size(); ++n)
+    for(size_t n=block0+1; n < m_modeBlockTable.nBlocks(); ++n)
     {
         float mode = m_modeBlockStart[n] + 0.5*m_modeBlockN[n];
 
@@ -1355,17 +1328,17 @@ void userGainCtrl::powerLawSet()
 
         if(gain < 0) gain = 0;
 
-        setBlockGain(n, gain);
-
-        //Now wait on the update, otherwise the next command can overwrite from m_gainsCurrent
-        int nt = 0;
-        while(fabs(m_modeBlockGains[n] - gain) > 1e-5 && nt < 100)
-        {
-            mx::sys::milliSleep(5);
-            ++nt;
-        }
+        deltas[n] = gain - m_modeBlockGains[n];
     }
 
+    m_gainsTarget = m_gainsCurrent;
+    applyBlockDeltas(m_gainsTarget.data(), m_gainsCurrent.data(), deltas.data(), m_modeBlockTable);
+
+    lock.unlock();
+
+    recordBlockGains(true);
+    writeGains();
+
     log<text_log>("Set power law: " + std::to_string(m_powerLawIndex) + " " + std::to_string(m_powerLawFloor) + 
                     " starting from block " + std::to_string(block0) + " " + std::to_string(gain0));
 
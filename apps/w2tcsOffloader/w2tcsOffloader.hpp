@@ -7,6 +7,7 @@
 #ifndef w2tcsOffloader_hpp
 #define w2tcsOffloader_hpp
 
+#include <atomic>
 #include <limits>
 
 #include <mx/improc/eigenCube.hpp>
@@ -65,6 +66,7 @@ protected:
    float m_gain {0.1};
    int m_nModes {2};
    float m_norm {1.0};
+   int m_nAvg {1}; ///< The number of frames to average the coefficients over.
    
    ///@}
 
@@ -72,6 +74,36 @@ protected:
    mx::improc::eigenImage<realT> m_woofer;
    mx::improc::eigenImage<realT> m_wMask;
    
+   /** \name Projection
+     * Each frame is projected onto the modes with a single matrix-vector product over the pupil pixels.
+     * @{
+     */
+   std::vector<size_t> m_pupilIdx; ///< The linear index of each pixel in the mask
+   
+   Eigen::Matrix<realT, Eigen::Dynamic, Eigen::Dynamic> m_projector; ///< The masked and normalized modes, one row per mode, one column per pupil pixel
+   
+   Eigen::Matrix<realT, Eigen::Dynamic, 1> m_pupilVals; ///< The pupil pixels of the current frame
+   
+   Eigen::Matrix<realT, Eigen::Dynamic, 1> m_coeffs; ///< The coefficients of the current frame
+   
+   ///@}
+   
+   /** \name Averaging
+     * The last m_nAvg coefficient vectors are kept in a ring, with a running sum.
+     * @{
+     */
+   Eigen::Matrix<realT, Eigen::Dynamic, Eigen::Dynamic> m_avgRing; ///< The coefficient ring, one column per frame
+   
+   Eigen::Matrix<realT, Eigen::Dynamic, 1> m_avgSum; ///< The sum of the columns of the ring
+   
+   int m_avgNext {0}; ///< The next column of the ring to fill
+   
+   int m_avgN {0}; ///< The number of frames in the ring
+   
+   std::atomic<bool> m_avgReset {true}; ///< Flag to clear the ring on the next frame
+   
+   ///@}
+   
 public:
    /// Default c'tor.
    w2tcsOffloader();
@@ -108,8 +140,13 @@ public:
      */
    virtual int appShutdown();
 
-   
-   
+   /// Build the projection matrix from the modes and the mask
+   /** Called once the modes and mask are loaded.
+     *
+     * \returns 0 on success
+     * \returns -1 on an error, which is logged
+     */
+   int makeProjector();
    
    int allocate( const dev::shmimT & dummy /**< [in] tag to differentiate shmimMonitor parents.*/);
    
@@ -147,6 +184,7 @@ void w2tcsOffloader::setupConfig()
    config.add("offload.wMaskPath", "", "offload.wMaskPath", argType::Required, "offload", "wMaskPath", false, "string", "Path to the woofer Zernike mode mask.");
    config.add("offload.gain", "", "offload.gain", argType::Required, "offload", "gain", false, "float", "The starting offload gain.  Default is 0.1.");
    config.add("offload.nModes", "", "offload.nModes", argType::Required, "offload", "nModes", false, "int", "Number of modes to offload to the TCS.");
+   config.add("offload.nAvg", "", "offload.nAvg", argType::Required, "offload", "nAvg", false, "int", "Number of frames to average the coefficients over.  Default is 1.");
 }
 
 inline
@@ -159,6 +197,9 @@ int w2tcsOffloader::loadConfigImpl( mx::app::appConfigurator & _config )
    _config(m_wMaskPath, "offload.wMaskPath");
    _config(m_gain, "offload.gain");
    _config(m_nModes, "offload.nModes");
+   _config(m_nAvg, "offload.nAvg");
+   
+   if(m_nAvg < 1) m_nAvg = 1;
    
    return 0;
 }
@@ -185,7 +226,10 @@ int w2tcsOffloader::appStartup(){
      return log<text_log,-1>("Could not open mode mask file", logPrio::LOG_ERROR);
    }
 
-   m_norm = m_wMask.sum();
+   if(makeProjector() < 0)
+   {
+      return log<software_critical,-1>({__FILE__,__LINE__});
+   }
 
    createStandardIndiNumber<unsigned>( m_indiP_gain, "gain", 0, 1, 0, "%0.2f");
    m_indiP_gain["current"] = m_gain;
@@ -266,14 +310,62 @@ int w2tcsOffloader::appShutdown()
    return 0;
 }
 
+inline
+int w2tcsOffloader::makeProjector()
+{
+   if(m_wMask.rows() != m_wZModes.rows() || m_wMask.cols() != m_wZModes.cols())
+   {
+      return log<text_log,-1>("Mode and mask sizes do not match", logPrio::LOG_ERROR);
+   }
+   
+   m_norm = m_wMask.sum();
+   
+   if(m_norm == 0)
+   {
+      return log<text_log,-1>("Mode mask is empty", logPrio::LOG_ERROR);
+   }
+   
+   m_pupilIdx.clear();
+   for(size_t p = 0; p < (size_t) m_wMask.size(); ++p)
+   {
+      if(m_wMask.data()[p] != 0) m_pupilIdx.push_back(p);
+   }
+   
+   m_projector.resize(m_wZModes.planes(), m_pupilIdx.size());
+   for(size_t k = 0; k < m_pupilIdx.size(); ++k)
+   {
+      realT w = m_wMask.data()[m_pupilIdx[k]] / m_norm;
+      for(int i = 0; i < m_wZModes.planes(); ++i)
+      {
+         m_projector(i,k) = m_wZModes.image(i).data()[m_pupilIdx[k]] * w;
+      }
+   }
+   
+   m_pupilVals.resize(m_pupilIdx.size());
+   m_coeffs.resize(m_wZModes.planes());
+   
+   m_avgRing.resize(m_wZModes.planes(), m_nAvg);
+   m_avgSum.resize(m_wZModes.planes());
+   m_avgReset = true;
+   
+   return 0;
+}
+
 inline
 int w2tcsOffloader::allocate(const dev::shmimT & dummy)
 {
    static_cast<void>(dummy); //be unused
    
    //std::unique_lock<std::mutex> lock(m_indiMutex);
-      
+   
+   if(shmimMonitorT::m_width != (uint32_t) m_wMask.rows() || shmimMonitorT::m_height != (uint32_t) m_wMask.cols())
+   {
+      return log<software_error,-1>({__FILE__,__LINE__, "shmim size does not match the modes"});
+   }
+   
    m_woofer.resize(shmimMonitorT::m_width, shmimMonitorT::m_height);
+   
+   m_avgReset = true;
 
    //state(stateCodes::OPERATING);
    
@@ -287,36 +379,53 @@ int w2tcsOffloader::processImage( void * curr_src,
 {
    static_cast<void>(dummy); //be unused (what is this?)
    
-   // Replace this:
-   // project zernikes onto avg image
+   size_t nModes = std::min<size_t>(m_nModes, m_zCoeffs.size());
+   
+   // project the pupil pixels onto the modes
+   realT * src = (realT *) curr_src;
+   for(size_t k = 0; k < m_pupilIdx.size(); ++k)
+   {
+      m_pupilVals[k] = src[m_pupilIdx[k]];
+   }
+   
+   m_coeffs.head(nModes).noalias() = m_projector.topRows(nModes) * m_pupilVals;
+   
+   /* explicitly zero out any modes that shouldn't be offloaded (but might have been
+      previously set)
+   */
+   m_coeffs.tail(m_coeffs.size() - nModes).setZero();
+   
+   // average in the ring
+   if(m_avgReset)
+   {
+      m_avgRing.setZero();
+      m_avgSum.setZero();
+      m_avgNext = 0;
+      m_avgN = 0;
+      m_avgReset = false;
+   }
+   
+   m_avgSum += m_coeffs - m_avgRing.col(m_avgNext);
+   m_avgRing.col(m_avgNext) = m_coeffs;
+   
+   if(m_avgN < m_nAvg) ++m_avgN;
+   
+   if(++m_avgNext >= m_nAvg) 
+   {
+      m_avgNext = 0;
+      m_avgSum = m_avgRing.rowwise().sum(); //limit round-off
+   }
+   
    // update INDI properties with coeffs
-
    for(size_t i=0; i < m_zCoeffs.size(); ++i)
    {
-    /* update requested nModes and explicitly zero out any
-    modes that shouldn't be offloaded (but might have been
-    previously set)
-    */
-    if(i < m_nModes)
-    {
-       float coeff;
-       coeff = ( Eigen::Map<mx::improc::eigenImage<realT>>((float *)curr_src, shmimMonitorT::m_width, shmimMonitorT::m_height) * m_wZModes.image(i) * m_wMask).sum() / m_norm;
-       m_indiP_zCoeffs[m_elNames[i]] = m_gain * coeff;
-    }
-    else
-    {
-      m_indiP_zCoeffs[m_elNames[i]] = 0.;
-    }
+      if(i < nModes) m_indiP_zCoeffs[m_elNames[i]] = m_gain * m_avgSum[i] / m_avgN;
+      else m_indiP_zCoeffs[m_elNames[i]] = 0.;
    }
 
    m_indiP_zCoeffs.setState (pcf::IndiProperty::Ok);
    m_indiDriver->sendSetProperty (m_indiP_zCoeffs);
 
-
-   // loop over something like this
-   //z0 = (im * basis.image(0)*mask).sum()/norm;
-
-
    return 0;
 }
 
@@ -394,6 +503,7 @@ INDI_NEWCALLBACK_DEFN(w2tcsOffloader, m_indiP_zero)(const pcf::IndiProperty &ipR
     if( ipRecv["toggle"].getSwitchState() == pcf::IndiElement::On)
     {
         m_woofer.setZero();
+        m_avgReset = true;
         log<text_log>("set zero", logPrio::LOG_NOTICE);
     }
     return 0;
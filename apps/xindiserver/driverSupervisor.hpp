@@ -0,0 +1,631 @@
+/** \file driverSupervisor.hpp
+  * \brief Process supervision for xindiserver, using pidfds and exponential backoff.
+  *
+  * \ingroup xindiserver_files
+  */
+
+#ifndef driverSupervisor_hpp
+#define driverSupervisor_hpp
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace MagAOX
+{
+namespace app
+{
+
+/// Open a pidfd for a process
+/** The pidfd becomes readable when the process exits, for children and non-children alike.
+  *
+  * \returns the pidfd on success
+  * \returns -1 on error, with errno set.  ENOSYS if the kernel is older than 5.3.
+  */
+inline
+int pidfdOpen( pid_t pid /**< [in] the process */)
+{
+#ifdef SYS_pidfd_open
+   return syscall(SYS_pidfd_open, pid, 0);
+#else
+   static_cast<void>(pid);
+   errno = ENOSYS;
+   return -1;
+#endif
+}
+
+/// Get the monotonic time in seconds
+inline
+double supervisorTime()
+{
+   timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+/// Get the pids of all children of a process
+/** Reads /proc/[pid]/task/[tid]/children for every thread, since a multi-threaded parent like indiserver can fork
+  * from any of them.
+  *
+  * \returns the child pids, empty if there are none or on error
+  */
+inline
+std::vector<pid_t> childPids( pid_t pid /**< [in] the parent process */)
+{
+   std::vector<pid_t> children;
+
+   std::string taskDir = "/proc/" + std::to_string(pid) + "/task";
+
+   DIR * dir = opendir(taskDir.c_str());
+   if(dir == nullptr) return children;
+
+   dirent * de;
+   while( (de = readdir(dir)) != nullptr )
+   {
+      if(de->d_name[0] == '.') continue;
+
+      std::ifstream fin(taskDir + "/" + de->d_name + "/children");
+
+      pid_t c;
+      while(fin >> c)
+      {
+         children.push_back(c);
+      }
+   }
+
+   closedir(dir);
+
+   return children;
+}
+
+/// Get the command line of a process
+/** The whole argv is returned, as exec'd, so drivers which share a program (e.g. the xindidriver symlinks) are told
+  * apart by their full path.
+  *
+  * \returns the arguments, empty on error or if the process is a zombie
+  */
+inline
+std::vector<std::string> processCmdline( pid_t pid /**< [in] the process */)
+{
+   std::vector<std::string> argv;
+
+   std::ifstream fin("/proc/" + std::to_string(pid) + "/cmdline");
+
+   std::string arg;
+   while(std::getline(fin, arg, '\0'))
+   {
+      argv.push_back(arg);
+   }
+
+   return argv;
+}
+
+/// The state and metrics of one supervised process
+/**
+  * \ingroup xindiserver
+  */
+struct supervisedProcess
+{
+   std::string m_name; ///< The name of the process, used to find it.
+
+   std::vector<std::string> m_argv; ///< The command to spawn the process.  If empty the process is watched but not spawned.
+
+   std::vector<std::string> m_cmdline; ///< The command line a watched process is found by in attachChildren().
+
+   std::function<int(pid_t)> m_restart; ///< Asks the parent of a watched process to restart it, given the pid which exited.
+
+   int m_stderrFd {-1}; ///< If >= 0 the spawned process's stderr is redirected here.
+
+   pid_t m_pid {-1}; ///< The current pid, -1 if not running.
+
+   pid_t m_lastPid {-1}; ///< The pid which last exited.
+
+   int m_pidfd {-1}; ///< The pidfd of the current process, -1 if not running or if pidfds are not available.
+
+   double m_started {0}; ///< The time the current process started.
+
+   double m_exited {0}; ///< The time the last process exited, 0 if it has since been restarted.
+
+   double m_restartAt {0}; ///< The time at which to restart, 0 if no restart is pending.
+
+   double m_backoff {0}; ///< The current restart delay [sec].
+
+   uint64_t m_restarts {0}; ///< The number of times the process has been restarted.
+
+   int m_lastStatus {0}; ///< The wait status of the last exit, -1 if unknown because the process was not our child.
+
+   double m_lastRecovery {-1}; ///< The time from the last exit to the restart [sec], -1 if never restarted.
+
+   double m_maxRecovery {0}; ///< The longest time from an exit to a restart [sec].
+
+   std::vector<int> m_fifoFds; ///< The pre-spawned FIFOs, held open by the supervisor.
+};
+
+/// Supervise a set of processes, restarting them with exponential backoff
+/** Each spawned or watched process is tracked with a pidfd, so an exit is seen as soon as it happens rather than
+  * at the next poll of waitpid.  A spawned process which exits is restarted after m_backoffMin, and each further exit
+  * within m_stableTime of its start doubles the delay, up to m_backoffMax.  Watched processes are started by someone
+  * else (e.g. drivers started by indiserver).  If a watched process has a restart function it is called on the same
+  * backoff schedule, so the supervisor decides when its parent restarts it.  attach() or attachChildren() records the
+  * new pid.
+  *
+  * Not thread safe.  Normally one thread calls poll() in a loop.
+  *
+  * \ingroup xindiserver
+  */
+class driverSupervisor
+{
+public:
+   typedef supervisedProcess processT;
+
+protected:
+   double m_backoffMin {0.01}; ///< The restart delay after a first failure [sec]
+   double m_backoffMax {10}; ///< The maximum restart delay [sec]
+   double m_stableTime {10}; ///< A process which runs this long before exiting restarts at m_backoffMin [sec]
+
+   std::vector<processT> m_procs; ///< The processes
+
+public:
+
+   /// D'tor, closes the pidfds and FIFOs but does not signal the processes.
+   ~driverSupervisor() noexcept
+   {
+      for(auto & p : m_procs)
+      {
+         if(p.m_pidfd >= 0) close(p.m_pidfd);
+         for(auto fd : p.m_fifoFds) close(fd);
+      }
+   }
+
+   /// Set the backoff parameters
+   void backoff( double backoffMin, ///< [in] the restart delay after a first failure [sec]
+                 double backoffMax, ///< [in] the maximum restart delay [sec]
+                 double stableTime  ///< [in] the run time after which the delay resets [sec]
+               )
+   {
+      m_backoffMin = backoffMin;
+      m_backoffMax = backoffMax;
+      m_stableTime = stableTime;
+   }
+
+   /// Get the number of processes
+   size_t size() const
+   {
+      return m_procs.size();
+   }
+
+   /// Get a process
+   const processT & process( size_t n /**< [in] the index of the process*/) const
+   {
+      return m_procs[n];
+   }
+
+   /// Find a process by name
+   /**
+     * \returns the index of the process
+     * \returns -1 if not found
+     */
+   int find( const std::string & name /**< [in] the name of the process*/) const
+   {
+      for(size_t n = 0; n < m_procs.size(); ++n)
+      {
+         if(m_procs[n].m_name == name) return n;
+      }
+
+      return -1;
+   }
+
+   /// Add a process to spawn.  Call start() to spawn it the first time.
+   /**
+     * \returns the index of the process
+     */
+   int add( const std::string & name,              ///< [in] the name of the process
+            const std::vector<std::string> & argv, ///< [in] the command, argv[0] is found on the PATH
+            int stderrFd = -1                      ///< [in] [optional] if >= 0, the process's stderr is redirected here
+          )
+   {
+      m_procs.emplace_back();
+      m_procs.back().m_name = name;
+      m_procs.back().m_argv = argv;
+      m_procs.back().m_stderrFd = stderrFd;
+
+      return m_procs.size() - 1;
+   }
+
+   /// Add a process which is started by someone else.  Call attach() or attachChildren() when its pid is known.
+   /**
+     * \returns the index of the process
+     */
+   int watch( const std::string & name,                                ///< [in] the name of the process
+              const std::vector<std::string> & cmdline = {},           ///< [in] [optional] the full command line to find it by in attachChildren()
+              const std::function<int(pid_t)> & restart = nullptr      ///< [in] [optional] asks the parent to restart it, given the pid which exited.  Returns 0 on success, -1 on error.
+            )
+   {
+      m_procs.emplace_back();
+      m_procs.back().m_name = name;
+      m_procs.back().m_cmdline = cmdline;
+      m_procs.back().m_restart = restart;
+
+      return m_procs.size() - 1;
+   }
+
+   /// Spawn a process, either the first time or on restart
+   /** A watched process with a restart function is restarted by its parent instead, and its new pid is recorded
+     * when it is attached.
+     *
+     * \returns 0 on success
+     * \returns -1 on error, with errno set.  A failed fork or restart is retried after the next backoff.
+     */
+   int start( size_t n /**< [in] the index of the process*/)
+   {
+      processT & p = m_procs[n];
+
+      if(p.m_argv.size() == 0)
+      {
+         if(!p.m_restart)
+         {
+            errno = EINVAL;
+            return -1;
+         }
+
+         p.m_restartAt = 0;
+
+         if(p.m_restart(p.m_lastPid) < 0)
+         {
+            int en = errno;
+            exited(p, -1, supervisorTime());
+            errno = en;
+            return -1;
+         }
+
+         return 0;
+      }
+
+      std::vector<char *> argv;
+      for(auto & a : p.m_argv) argv.push_back(const_cast<char *>(a.c_str()));
+      argv.push_back(nullptr);
+
+      pid_t pid = fork();
+
+      if(pid < 0)
+      {
+         int en = errno;
+         exited(p, -1, supervisorTime());
+         errno = en;
+         return -1;
+      }
+
+      if(pid == 0)
+      {
+         if(p.m_stderrFd >= 0)
+         {
+            while( dup2(p.m_stderrFd, STDERR_FILENO) == -1 && errno == EINTR) {}
+         }
+
+         execvp(argv[0], argv.data());
+
+         _exit(127);
+      }
+
+      //A child which has already exited is a zombie until reaped, so the pidfd is still valid.
+      p.m_pid = pid;
+      p.m_pidfd = pidfdOpen(pid);
+      p.m_restartAt = 0;
+
+      started(p, supervisorTime());
+
+      return 0;
+   }
+
+   /// Attach a watched process to its pid
+   /**
+     * \returns 0 on success
+     * \returns -1 on error, with errno set.
+     */
+   int attach( size_t n, ///< [in] the index of the process
+               pid_t pid ///< [in] the pid of the process
+             )
+   {
+      processT & p = m_procs[n];
+
+      if(p.m_pidfd >= 0) close(p.m_pidfd);
+
+      p.m_pid = pid;
+      p.m_pidfd = pidfdOpen(pid);
+
+      if(p.m_pidfd < 0 && errno == ESRCH)
+      {
+         //Already gone
+         p.m_pid = -1;
+         return -1;
+      }
+
+      p.m_restartAt = 0; //Its parent got there first
+
+      started(p, supervisorTime());
+
+      return 0;
+   }
+
+   /// Attach every watched process which is not running to its pid, by finding its command line among the children of a process
+   /** A match must be the whole command line, and unique among the children, so a process is never attached to a
+     * driver of the same program with a different path, or to one of two copies.  Children which have not exec'd yet
+     * still have the parent's command line, so they are found on a later call.
+     *
+     * \returns the indices of the processes attached
+     */
+   std::vector<size_t> attachChildren( pid_t parent /**< [in] the parent process */)
+   {
+      std::vector<size_t> attached;
+
+      std::vector<pid_t> children = childPids(parent);
+      std::vector<std::vector<std::string>> cmdlines;
+      for(size_t c = 0; c < children.size(); ++c)
+      {
+         cmdlines.push_back(processCmdline(children[c]));
+      }
+
+      for(size_t n = 0; n < m_procs.size(); ++n)
+      {
+         processT & p = m_procs[n];
+
+         if(p.m_pid > 0 || p.m_cmdline.size() == 0) continue;
+
+         pid_t pid = -1;
+         int nmatch = 0;
+         for(size_t c = 0; c < children.size(); ++c)
+         {
+            if(cmdlines[c] != p.m_cmdline) continue;
+
+            bool taken = false;
+            for(auto & q : m_procs)
+            {
+               if(q.m_pid == children[c]) taken = true;
+            }
+            if(taken) continue;
+
+            pid = children[c];
+            ++nmatch;
+         }
+
+         if(nmatch != 1) continue;
+
+         if(attach(n, pid) == 0) attached.push_back(n);
+      }
+
+      return attached;
+   }
+
+   /// Wait for processes to exit, and restart any which are due
+   /** Waits at most timeout ms, less if a restart is due sooner.
+     *
+     * \returns the number of exits and restarts handled
+     * \returns -1 on an error from poll
+     */
+   int poll( int timeout /**< [in] the maximum time to wait [msec] */)
+   {
+      double now = supervisorTime();
+
+      std::vector<pollfd> pfds;
+      std::vector<size_t> idx;
+
+      bool noPidfd = false;
+
+      for(size_t n = 0; n < m_procs.size(); ++n)
+      {
+         processT & p = m_procs[n];
+
+         if(p.m_pidfd >= 0)
+         {
+            pfds.push_back({p.m_pidfd, POLLIN, 0});
+            idx.push_back(n);
+         }
+         else if(p.m_pid > 0)
+         {
+            noPidfd = true;
+         }
+
+         if(p.m_restartAt > 0)
+         {
+            int ms = (p.m_restartAt - now)*1000 + 1;
+            if(ms < 0) ms = 0;
+            if(ms < timeout) timeout = ms;
+         }
+      }
+
+      //Without pidfds we fall back to checking each pid on a short timeout
+      if(noPidfd && timeout > 10) timeout = 10;
+
+      int rv = ::poll(pfds.data(), pfds.size(), timeout);
+
+      if(rv < 0 && errno != EINTR) return -1;
+
+      now = supervisorTime();
+
+      int nev = 0;
+
+      for(size_t k = 0; rv > 0 && k < pfds.size(); ++k)
+      {
+         if(pfds[k].revents == 0) continue;
+
+         processT & p = m_procs[idx[k]];
+
+         close(p.m_pidfd);
+         p.m_pidfd = -1;
+
+         exited(p, reap(p), now);
+         ++nev;
+      }
+
+      for(size_t n = 0; noPidfd && n < m_procs.size(); ++n)
+      {
+         processT & p = m_procs[n];
+
+         if(p.m_pidfd >= 0 || p.m_pid <= 0) continue;
+
+         int status = -1;
+         bool gone;
+         if(p.m_argv.size() > 0) gone = (waitpid(p.m_pid, &status, WNOHANG) == p.m_pid);
+         else gone = (kill(p.m_pid, 0) < 0 && errno == ESRCH);
+
+         if(gone)
+         {
+            exited(p, status, now);
+            ++nev;
+         }
+      }
+
+      for(size_t n = 0; n < m_procs.size(); ++n)
+      {
+         if(m_procs[n].m_restartAt > 0 && m_procs[n].m_restartAt <= now)
+         {
+            start(n);
+            ++nev;
+         }
+      }
+
+      return nev;
+   }
+
+   /// Send a signal to every running process, and stop restarting them
+   void stopAll( int sig /**< [in] the signal to send */)
+   {
+      for(auto & p : m_procs)
+      {
+         p.m_restartAt = 0;
+         if(p.m_pid > 0) kill(p.m_pid, sig);
+      }
+   }
+
+   /// Create the .in, .out, and .ctrl driver FIFOs for a process, and hold them open
+   /** Holding the FIFOs open means they exist before the driver and its relay start, so neither waits for the other
+     * to create them, and lets the supervisor measure the depth of their queues.
+     *
+     * \returns 0 on success
+     * \returns -1 on error, with errno set
+     */
+   int prespawnFIFOs( size_t n,                 ///< [in] the index of the process
+                      const std::string & dir   ///< [in] the directory for the FIFOs
+                    )
+   {
+      processT & p = m_procs[n];
+
+      for(auto fd : p.m_fifoFds) close(fd);
+      p.m_fifoFds.clear();
+
+      for(const char * ext : {".in", ".out", ".ctrl"})
+      {
+         std::string fn = dir + "/" + p.m_name + ext;
+
+         if(mkfifo(fn.c_str(), S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP) != 0 && errno != EEXIST)
+         {
+            return -1;
+         }
+
+         //O_RDWR never blocks on a FIFO, and we never read, so we don't take data from the driver
+         int fd = open(fn.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+         if(fd < 0)
+         {
+            return -1;
+         }
+
+         p.m_fifoFds.push_back(fd);
+      }
+
+      return 0;
+   }
+
+   /// Get the number of bytes waiting in one of a process's pre-spawned FIFOs
+   /**
+     * \returns the number of bytes
+     * \returns -1 if the FIFO is not open
+     */
+   int queueDepth( size_t n,   ///< [in] the index of the process
+                   size_t fifo ///< [in] the FIFO: 0 for .in, 1 for .out, 2 for .ctrl
+                 ) const
+   {
+      const processT & p = m_procs[n];
+
+      if(fifo >= p.m_fifoFds.size()) return -1;
+
+      int nb = 0;
+      if(ioctl(p.m_fifoFds[fifo], FIONREAD, &nb) < 0) return -1;
+
+      return nb;
+   }
+
+protected:
+
+   /// Reap a process which has exited, if it is our child
+   /**
+     * \returns the wait status, or -1 if the process is not our child
+     */
+   int reap( processT & p )
+   {
+      int status = -1;
+      if(p.m_argv.size() > 0)
+      {
+         if(waitpid(p.m_pid, &status, 0) != p.m_pid) status = -1;
+      }
+      return status;
+   }
+
+   /// Update the metrics and the backoff after a process exits
+   void exited( processT & p,
+                int status,
+                double now
+              )
+   {
+      if(p.m_backoff <= 0 || now - p.m_started >= m_stableTime)
+      {
+         p.m_backoff = m_backoffMin;
+      }
+      else
+      {
+         p.m_backoff *= 2;
+         if(p.m_backoff > m_backoffMax) p.m_backoff = m_backoffMax;
+      }
+
+      if(p.m_pid > 0) p.m_lastPid = p.m_pid;
+      p.m_pid = -1;
+      p.m_lastStatus = status;
+      if(p.m_exited == 0) p.m_exited = now; //Keep the first exit if a restart fails
+
+      if(p.m_argv.size() > 0 || p.m_restart) p.m_restartAt = now + p.m_backoff;
+   }
+
+   /// Update the metrics after a process starts
+   void started( processT & p,
+                 double now
+               )
+   {
+      if(p.m_exited > 0)
+      {
+         ++p.m_restarts;
+         p.m_lastRecovery = now - p.m_exited;
+         if(p.m_lastRecovery > p.m_maxRecovery) p.m_maxRecovery = p.m_lastRecovery;
+         p.m_exited = 0;
+      }
+
+      p.m_started = now;
+   }
+};
+
+} //namespace app
+} //namespace MagAOX
+
+#endif //driverSupervisor_hpp
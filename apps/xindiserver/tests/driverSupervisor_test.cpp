@@ -0,0 +1,394 @@
+/** \file driverSupervisor_test.cpp
+  * \brief Catch2 tests for the xindiserver driver supervisor, using synthetic crashing drivers.
+  *
+  * History:
+  */
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../tests/catch2/catch.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "../driverSupervisor.hpp"
+
+using namespace MagAOX::app;
+
+namespace driverSupervisor_test
+{
+
+/// Poll until a process has restarted n times, or timeout seconds pass
+bool pollUntilRestarts( driverSupervisor & sup,
+                        size_t idx,
+                        uint64_t n,
+                        double timeout
+                      )
+{
+   double t0 = supervisorTime();
+   while(sup.process(idx).m_restarts < n)
+   {
+      if(supervisorTime() - t0 > timeout) return false;
+      sup.poll(100);
+   }
+   return true;
+}
+
+/// A driver which runs until killed
+std::vector<std::string> sleeper()
+{
+   return std::vector<std::string>({"sh", "-c", "exec sleep 100"});
+}
+
+SCENARIO( "Restarting a crashed driver", "[xindiserver::driverSupervisor]" )
+{
+   GIVEN("a supervisor with two drivers, with a 10 ms minimum backoff")
+   {
+      driverSupervisor sup;
+      sup.backoff(0.01, 1.0, 10);
+
+      int a = sup.add("drvA", sleeper());
+      int b = sup.add("drvB", sleeper());
+
+      REQUIRE(sup.start(a) == 0);
+      REQUIRE(sup.start(b) == 0);
+
+      pid_t pidA = sup.process(a).m_pid;
+      pid_t pidB = sup.process(b).m_pid;
+      REQUIRE(pidA > 0);
+      REQUIRE(pidB > 0);
+
+      WHEN("one driver is killed")
+      {
+         kill(pidA, SIGKILL);
+
+         REQUIRE(pollUntilRestarts(sup, a, 1, 2.0));
+
+         THEN("it is restarted within milliseconds, and the other is undisturbed")
+         {
+            REQUIRE(sup.process(a).m_pid > 0);
+            REQUIRE(sup.process(a).m_pid != pidA);
+            REQUIRE(WIFSIGNALED(sup.process(a).m_lastStatus));
+            REQUIRE(WTERMSIG(sup.process(a).m_lastStatus) == SIGKILL);
+            REQUIRE(sup.process(a).m_lastRecovery >= 0.01);
+            REQUIRE(sup.process(a).m_lastRecovery < 0.1);
+
+            REQUIRE(sup.process(b).m_pid == pidB);
+            REQUIRE(sup.process(b).m_restarts == 0);
+         }
+      }
+
+      sup.stopAll(SIGKILL);
+      sup.poll(0);
+   }
+}
+
+SCENARIO( "Backing off a crash-looping driver", "[xindiserver::driverSupervisor]" )
+{
+   GIVEN("a driver which exits as soon as it starts")
+   {
+      driverSupervisor sup;
+      sup.backoff(0.01, 0.08, 10);
+
+      int a = sup.add("crasher", std::vector<std::string>({"sh", "-c", "exit 3"}));
+      REQUIRE(sup.start(a) == 0);
+
+      WHEN("it is supervised for 0.5 seconds")
+      {
+         double t0 = supervisorTime();
+         while(supervisorTime() - t0 < 0.5)
+         {
+            sup.poll(100);
+         }
+
+         THEN("the delay doubles up to the maximum, bounding the restarts")
+         {
+            REQUIRE(sup.process(a).m_backoff == Approx(0.08));
+
+            //delays of 10, 20, 40, then 80 ms give about 8 restarts in 0.5 s
+            REQUIRE(sup.process(a).m_restarts >= 4);
+            REQUIRE(sup.process(a).m_restarts <= 12);
+            REQUIRE(sup.process(a).m_maxRecovery >= 0.08);
+         }
+
+         THEN("the exit status is recorded")
+         {
+            REQUIRE(WIFEXITED(sup.process(a).m_lastStatus));
+            REQUIRE(WEXITSTATUS(sup.process(a).m_lastStatus) == 3);
+         }
+      }
+
+      sup.stopAll(SIGKILL);
+      sup.poll(0);
+   }
+}
+
+SCENARIO( "Pre-spawned driver FIFOs", "[xindiserver::driverSupervisor]" )
+{
+   GIVEN("two drivers with pre-spawned FIFOs")
+   {
+      char tmpl[] = "/tmp/driverSupervisor_testXXXXXX";
+      REQUIRE(mkdtemp(tmpl) != nullptr);
+      std::string dir = tmpl;
+
+      driverSupervisor sup;
+      sup.backoff(0.01, 1.0, 10);
+
+      int a = sup.add("drvA", sleeper());
+      int b = sup.add("drvB", sleeper());
+
+      REQUIRE(sup.prespawnFIFOs(a, dir) == 0);
+      REQUIRE(sup.prespawnFIFOs(b, dir) == 0);
+
+      REQUIRE(sup.start(a) == 0);
+      REQUIRE(sup.start(b) == 0);
+
+      WHEN("messages are waiting for driver B, and driver A crashes")
+      {
+         std::string msg = "<getProperties version='1.7'/>\n";
+
+         int fd = open((dir + "/drvB.in").c_str(), O_WRONLY | O_NONBLOCK);
+         REQUIRE(fd >= 0);
+         REQUIRE(write(fd, msg.data(), msg.size()) == (ssize_t) msg.size());
+         close(fd);
+
+         REQUIRE(sup.queueDepth(b, 0) == (int) msg.size());
+         REQUIRE(sup.queueDepth(a, 0) == 0);
+
+         kill(sup.process(a).m_pid, SIGKILL);
+         REQUIRE(pollUntilRestarts(sup, a, 1, 2.0));
+
+         THEN("driver B's queue is intact, and driver A's FIFOs are still there for the restarted driver")
+         {
+            REQUIRE(sup.queueDepth(b, 0) == (int) msg.size());
+
+            struct stat st;
+            REQUIRE(stat((dir + "/drvA.in").c_str(), &st) == 0);
+            REQUIRE(S_ISFIFO(st.st_mode));
+
+            fd = open((dir + "/drvA.out").c_str(), O_RDONLY | O_NONBLOCK);
+            REQUIRE(fd >= 0);
+            close(fd);
+         }
+      }
+
+      sup.stopAll(SIGKILL);
+      sup.poll(0);
+
+      for(const char * fn : {"drvA.in", "drvA.out", "drvA.ctrl", "drvB.in", "drvB.out", "drvB.ctrl"})
+      {
+         unlink((dir + "/" + fn).c_str());
+      }
+      rmdir(dir.c_str());
+   }
+}
+
+/// Fork and exec sleep, as indiserver forks a driver
+pid_t forkSleep( const char * secs )
+{
+   pid_t pid = fork();
+   if(pid == 0)
+   {
+      execlp("sleep", "sleep", secs, (char *) nullptr);
+      _exit(127);
+   }
+   return pid;
+}
+
+/// Wait for a forked process to exec, so its command line is right
+bool waitForExec( pid_t pid,
+                  const std::vector<std::string> & cmdline
+                )
+{
+   double t0 = supervisorTime();
+   while(processCmdline(pid) != cmdline)
+   {
+      if(supervisorTime() - t0 > 2) return false;
+      usleep(1000);
+   }
+   return true;
+}
+
+/// Kill and reap a forked process
+void killSleep( pid_t pid )
+{
+   if(pid > 0 && kill(pid, SIGKILL) == 0) waitpid(pid, nullptr, 0);
+}
+
+SCENARIO( "Watching a driver started by someone else", "[xindiserver::driverSupervisor]" )
+{
+   GIVEN("a driver forked outside the supervisor, as indiserver forks them")
+   {
+      std::vector<std::string> cmdline({"sleep", "100"});
+
+      pid_t pid = forkSleep("100");
+      REQUIRE(pid > 0);
+
+      driverSupervisor sup;
+      int w = sup.watch("sleep", cmdline);
+
+      REQUIRE(waitForExec(pid, cmdline));
+
+      THEN("it is found and attached as a child by its command line")
+      {
+         std::vector<pid_t> children = childPids(getpid());
+         REQUIRE(std::find(children.begin(), children.end(), pid) != children.end());
+
+         std::vector<size_t> attached = sup.attachChildren(getpid());
+         REQUIRE(attached.size() == 1);
+         REQUIRE(attached[0] == (size_t) w);
+         REQUIRE(sup.process(w).m_pid == pid);
+      }
+
+      WHEN("it dies and a replacement is attached")
+      {
+         REQUIRE(sup.attachChildren(getpid()).size() == 1);
+
+         kill(pid, SIGKILL);
+
+         double t0 = supervisorTime();
+         while(sup.process(w).m_pid > 0 && supervisorTime() - t0 < 2)
+         {
+            sup.poll(100);
+         }
+         waitpid(pid, nullptr, 0);
+
+         REQUIRE(sup.process(w).m_pid == -1);
+         REQUIRE(sup.process(w).m_exited > 0);
+         REQUIRE(sup.process(w).m_lastPid == pid);
+         REQUIRE(sup.process(w).m_restartAt == 0); //no restart function, so the parent restarts it
+
+         pid_t pid2 = forkSleep("100");
+         REQUIRE(pid2 > 0);
+         REQUIRE(waitForExec(pid2, cmdline));
+
+         REQUIRE(sup.attachChildren(getpid()).size() == 1);
+
+         THEN("the restart and the recovery time are recorded")
+         {
+            REQUIRE(sup.process(w).m_pid == pid2);
+            REQUIRE(sup.process(w).m_restarts == 1);
+            REQUIRE(sup.process(w).m_lastRecovery >= 0);
+            REQUIRE(sup.process(w).m_lastRecovery < 1.0);
+         }
+
+         killSleep(pid2);
+      }
+
+      killSleep(pid);
+   }
+}
+
+SCENARIO( "Restarting a watched driver through its parent", "[xindiserver::driverSupervisor]" )
+{
+   GIVEN("a watched driver with a restart function, as xindiserver asks indiserver to restart a driver")
+   {
+      std::vector<std::string> cmdline({"sleep", "100"});
+
+      pid_t pid = forkSleep("100");
+      REQUIRE(pid > 0);
+      REQUIRE(waitForExec(pid, cmdline));
+
+      pid_t asked = 0;
+      pid_t pid2 = -1;
+
+      driverSupervisor sup;
+      sup.backoff(0.01, 1.0, 10);
+
+      int w = sup.watch("sleep", cmdline, [&](pid_t old){ asked = old; pid2 = forkSleep("100"); return (pid2 > 0) ? 0 : -1; });
+
+      REQUIRE(sup.attachChildren(getpid()).size() == 1);
+
+      WHEN("it is killed")
+      {
+         kill(pid, SIGKILL);
+         waitpid(pid, nullptr, 0);
+
+         double t0 = supervisorTime();
+         while(sup.process(w).m_restarts == 0 && supervisorTime() - t0 < 2)
+         {
+            sup.poll(5);
+            sup.attachChildren(getpid());
+         }
+
+         THEN("the supervisor asks for the restart after the backoff, naming the pid which exited, and attaches the new driver")
+         {
+            REQUIRE(asked == pid);
+            REQUIRE(pid2 > 0);
+            REQUIRE(sup.process(w).m_pid == pid2);
+            REQUIRE(sup.process(w).m_restarts == 1);
+            REQUIRE(sup.process(w).m_lastRecovery >= 0.01);
+            REQUIRE(sup.process(w).m_lastRecovery < 0.5);
+         }
+      }
+
+      killSleep(pid2);
+      killSleep(pid);
+   }
+}
+
+SCENARIO( "Telling apart drivers which run the same program", "[xindiserver::driverSupervisor]" )
+{
+   GIVEN("two drivers of the same program with different arguments, and two copies of a third")
+   {
+      std::vector<std::string> cmdA({"sleep", "101"});
+      std::vector<std::string> cmdB({"sleep", "102"});
+      std::vector<std::string> cmdC({"sleep", "103"});
+
+      pid_t pidA = forkSleep("101");
+      pid_t pidB = forkSleep("102");
+      pid_t pidC1 = forkSleep("103");
+      pid_t pidC2 = forkSleep("103");
+
+      REQUIRE(waitForExec(pidA, cmdA));
+      REQUIRE(waitForExec(pidB, cmdB));
+      REQUIRE(waitForExec(pidC1, cmdC));
+      REQUIRE(waitForExec(pidC2, cmdC));
+
+      driverSupervisor sup;
+      int b = sup.watch("drvB", cmdB);
+      int a = sup.watch("drvA", cmdA);
+      int c = sup.watch("drvC", cmdC);
+
+      WHEN("they are attached")
+      {
+         std::vector<size_t> attached = sup.attachChildren(getpid());
+
+         THEN("each is attached to its own process, and the ambiguous one is not attached")
+         {
+            REQUIRE(attached.size() == 2);
+            REQUIRE(sup.process(a).m_pid == pidA);
+            REQUIRE(sup.process(b).m_pid == pidB);
+            REQUIRE(sup.process(c).m_pid == -1);
+         }
+      }
+
+      killSleep(pidA);
+      killSleep(pidB);
+      killSleep(pidC1);
+      killSleep(pidC2);
+   }
+}
+
+TEST_CASE( "Benchmark driver time-to-recovery", "[.benchmark][xindiserver::driverSupervisor]" )
+{
+   driverSupervisor sup;
+   sup.backoff(0.001, 1.0, 0); //Reset the backoff every time, so each iteration measures the minimum
+
+   int a = sup.add("drvA", sleeper());
+   sup.start(a);
+
+   uint64_t n = 0;
+
+   BENCHMARK("kill and recover, 1 ms backoff")
+   {
+      kill(sup.process(a).m_pid, SIGKILL);
+      ++n;
+      pollUntilRestarts(sup, a, n, 5.0);
+      return sup.process(a).m_lastRecovery;
+   };
+
+   sup.stopAll(SIGKILL);
+   sup.poll(0);
+}
+
+} //namespace driverSupervisor_test
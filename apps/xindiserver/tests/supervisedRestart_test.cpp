@@ -0,0 +1,295 @@
+/** \file supervisedRestart_test.cpp
+  * \brief Catch2 end-to-end test of supervised driver restarts, using the real indiserver and xindidriver.
+  *
+  * The supervisor is set up the way xindiserver sets it up in supervisor mode: indiserver is run with -s, each
+  * local driver is an xindidriver symlink relaying pre-spawned FIFOs, and the relays are attached by their command
+  * line and restarted by asking indiserver through the supervisor FIFO.  The xindiserver app itself is not run.
+  *
+  * Needs INDI/INDI/indiserver and INDI/xindidriver/xindidriver to be built, and is skipped if they are not.  Run
+  * from the tests directory.
+  *
+  * History:
+  */
+
+#include "../../../tests/catch2/catch.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "../driverSupervisor.hpp"
+
+using namespace MagAOX::app;
+
+namespace supervisedRestart_test
+{
+
+/// A stand-in for a MagAO-X app on the far side of the driver FIFOs
+/** Answers every getProperties with a def of one property.
+  */
+struct fakeDevice
+{
+   std::string m_name;
+   int m_in {-1};
+   int m_out {-1};
+   std::atomic<bool> m_stop {false};
+   std::thread m_thread;
+
+   fakeDevice( const std::string & dir,
+               const std::string & name
+             ) : m_name(name)
+   {
+      //Opened O_RDWR like indiDriver, so they never block
+      m_in = open((dir + "/" + name + ".in").c_str(), O_RDWR | O_NONBLOCK);
+      m_out = open((dir + "/" + name + ".out").c_str(), O_RDWR | O_NONBLOCK);
+
+      m_thread = std::thread([this](){ run(); });
+   }
+
+   ~fakeDevice()
+   {
+      m_stop = true;
+      if(m_thread.joinable()) m_thread.join();
+      if(m_in >= 0) close(m_in);
+      if(m_out >= 0) close(m_out);
+   }
+
+   void run()
+   {
+      std::string def = "<defNumberVector device='" + m_name + "' name='p' state='Idle' perm='ro'>"
+                        "<defNumber name='v' format='%g' min='0' max='1' step='0'>1</defNumber></defNumberVector>\n";
+      std::string recvd;
+
+      while(!m_stop)
+      {
+         pollfd pfd {m_in, POLLIN, 0};
+         if(::poll(&pfd, 1, 20) <= 0) continue;
+
+         char buf[1024];
+         ssize_t n = read(m_in, buf, sizeof(buf));
+         if(n <= 0) continue;
+
+         recvd.append(buf, n);
+
+         size_t p;
+         while( (p = recvd.find("getProperties")) != std::string::npos)
+         {
+            recvd.erase(0, p + 13);
+            if(write(m_out, def.data(), def.size()) < 0) return;
+         }
+
+         if(recvd.size() > 64) recvd.erase(0, recvd.size() - 64);
+      }
+   }
+};
+
+/// An INDI client connection
+struct client
+{
+   int m_fd {-1};
+
+   ~client()
+   {
+      if(m_fd >= 0) close(m_fd);
+   }
+
+   /// Connect, retrying while indiserver starts
+   bool connectTo( int port )
+   {
+      double t0 = supervisorTime();
+      while(supervisorTime() - t0 < 5)
+      {
+         m_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+         sockaddr_in sa {};
+         sa.sin_family = AF_INET;
+         sa.sin_port = htons(port);
+         sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+         if(connect(m_fd, (sockaddr *) &sa, sizeof(sa)) == 0) return true;
+
+         close(m_fd);
+         m_fd = -1;
+         usleep(10000);
+      }
+      return false;
+   }
+
+   /// Send getProperties and wait for the defs of all the named devices
+   bool seesDevices( const std::vector<std::string> & devices,
+                     double timeout
+                   )
+   {
+      std::string gp = "<getProperties version='1.7'/>\n";
+      if(write(m_fd, gp.data(), gp.size()) != (ssize_t) gp.size()) return false;
+
+      std::string recvd;
+      double t0 = supervisorTime();
+      while(supervisorTime() - t0 < timeout)
+      {
+         bool all = true;
+         for(auto & d : devices)
+         {
+            if(recvd.find("device='" + d + "'") == std::string::npos) all = false;
+         }
+         if(all) return true;
+
+         pollfd pfd {m_fd, POLLIN, 0};
+         if(::poll(&pfd, 1, 20) <= 0) continue;
+
+         char buf[4096];
+         ssize_t n = read(m_fd, buf, sizeof(buf));
+         if(n <= 0) return false;
+         recvd.append(buf, n);
+      }
+      return false;
+   }
+};
+
+/// Find a built program, relative to the tests directory
+std::string findProgram( const std::string & relPath )
+{
+   char rp[PATH_MAX];
+   if(realpath(relPath.c_str(), rp) == nullptr) return "";
+   if(access(rp, X_OK) != 0) return "";
+   return rp;
+}
+
+/// Poll the supervisor, attaching relays, until a condition is met or timeout seconds pass
+template<class condT>
+bool superviseUntil( driverSupervisor & sup,
+                     pid_t isPid,
+                     condT cond,
+                     double timeout
+                   )
+{
+   double t0 = supervisorTime();
+   while(!cond())
+   {
+      if(supervisorTime() - t0 > timeout) return false;
+      sup.poll(5);
+      sup.attachChildren(isPid);
+   }
+   return true;
+}
+
+SCENARIO( "Recovering a crashed driver relay under indiserver", "[xindiserver::supervisedRestart]" )
+{
+   std::string indiserver = findProgram("../INDI/INDI/indiserver");
+   std::string xindidriver = findProgram("../INDI/xindidriver/xindidriver");
+
+   if(indiserver == "" || xindidriver == "")
+   {
+      std::cerr << "indiserver or xindidriver not built, moving on\n";
+      SUCCEED("indiserver or xindidriver not built, moving on");
+      return;
+   }
+
+   GIVEN("indiserver with two xindidriver relays, supervised as in xindiserver's supervisor mode")
+   {
+      char tmpl[] = "/tmp/supervisedRestart_testXXXXXX";
+      REQUIRE(mkdtemp(tmpl) != nullptr);
+      std::string dir = tmpl;
+
+      std::vector<std::string> names({"drvA", "drvB"});
+
+      std::string supFIFOPath = dir + "/indiserver.supervisor";
+      REQUIRE(mkfifo(supFIFOPath.c_str(), S_IRUSR | S_IWUSR) == 0);
+      int supFIFO = open(supFIFOPath.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+      REQUIRE(supFIFO >= 0);
+
+      driverSupervisor sup;
+      sup.backoff(0.01, 1.0, 10);
+
+      std::vector<int> idx;
+      for(auto & name : names)
+      {
+         std::string dname = dir + "/" + name;
+         REQUIRE(symlink(xindidriver.c_str(), dname.c_str()) == 0);
+
+         idx.push_back(sup.watch(name, {dname}, [supFIFO, dname](pid_t pid)
+                                                {
+                                                   std::string req = "start " + dname + " " + std::to_string(pid) + "\n";
+                                                   return (write(supFIFO, req.data(), req.size()) == (ssize_t) req.size()) ? 0 : -1;
+                                                }));
+         REQUIRE(sup.prespawnFIFOs(idx.back(), dir) == 0);
+      }
+
+      //Inherited by the relays through indiserver
+      setenv("XINDID_FIFODIR", dir.c_str(), 1);
+      setenv("XINDID_FASTSTART", "1", 1);
+
+      std::vector<std::unique_ptr<fakeDevice>> devices;
+      for(auto & name : names) devices.emplace_back(new fakeDevice(dir, name));
+
+      int port = 17000 + getpid() % 10000;
+
+      int isLog = open((dir + "/indiserver.log").c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+      REQUIRE(isLog >= 0);
+
+      int is = sup.add("indiserver", {indiserver, "-n", "-s", supFIFOPath, "-p", std::to_string(port), dir + "/drvA", dir + "/drvB"}, isLog);
+      REQUIRE(sup.start(is) == 0);
+      pid_t isPid = sup.process(is).m_pid;
+
+      REQUIRE(superviseUntil(sup, isPid, [&](){ return sup.process(idx[0]).m_pid > 0 && sup.process(idx[1]).m_pid > 0; }, 5));
+
+      client cl;
+      REQUIRE(cl.connectTo(port));
+      REQUIRE(cl.seesDevices(names, 5));
+
+      WHEN("one relay is killed")
+      {
+         pid_t pidA = sup.process(idx[0]).m_pid;
+         pid_t pidB = sup.process(idx[1]).m_pid;
+
+         kill(pidA, SIGKILL);
+
+         REQUIRE(superviseUntil(sup, isPid, [&](){ return sup.process(idx[0]).m_restarts == 1; }, 5));
+
+         THEN("indiserver restarts it when the supervisor asks, the other is undisturbed, and clients see it again")
+         {
+            REQUIRE(sup.process(idx[0]).m_pid > 0);
+            REQUIRE(sup.process(idx[0]).m_pid != pidA);
+            REQUIRE(sup.process(idx[0]).m_lastPid == pidA);
+            REQUIRE(sup.process(idx[0]).m_lastRecovery >= 0.01);
+            REQUIRE(sup.process(idx[0]).m_lastRecovery < 0.5);
+
+            REQUIRE(sup.process(idx[1]).m_pid == pidB);
+            REQUIRE(sup.process(idx[1]).m_restarts == 0);
+
+            REQUIRE(sup.process(is).m_pid == isPid);
+            REQUIRE(sup.process(is).m_restarts == 0);
+
+            REQUIRE(cl.seesDevices({"drvA"}, 5));
+         }
+      }
+
+      sup.stopAll(SIGKILL);
+      sup.poll(0);
+      waitpid(isPid, nullptr, 0);
+
+      devices.clear();
+      close(isLog);
+      close(supFIFO);
+
+      unsetenv("XINDID_FIFODIR");
+      unsetenv("XINDID_FASTSTART");
+
+      for(auto & name : names)
+      {
+         for(const char * ext : {"", ".in", ".out", ".ctrl"}) unlink((dir + "/" + name + ext).c_str());
+      }
+      unlink(supFIFOPath.c_str());
+      unlink((dir + "/indiserver.log").c_str());
+      rmdir(dir.c_str());
+   }
+}
+
+} //namespace supervisedRestart_test
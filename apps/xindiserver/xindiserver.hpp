@@ -14,12 +14,17 @@
 #include <string>
 #include <map>
 #include <unordered_set>
+#include <atomic>
+#include <algorithm>
+#include <limits>
 
 #include <mx/ioutils/fileUtils.hpp>
 
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#include "driverSupervisor.hpp"
+
 /** \defgroup xindiserver INDI Server wrapper.
   * \brief Manages INDI server in the MagAO-X context.
   *
@@ -138,7 +143,7 @@ protected:
    
    std::vector<std::string> m_indiserverCommand; ///< The command line arguments to indiserver
       
-   pid_t m_isPID {0}; ///< The PID of the indiserver process
+   std::atomic<pid_t> m_isPID {0}; ///< The PID of the indiserver process.  Changed by the supervisor thread on a restart.
    
    int m_isSTDERR {-1}; ///< The output of stderr of the indiserver process
    int m_isSTDERR_input {-1}; ///< The input end of stderr, used to wake up the log thread on shutdown.
@@ -147,6 +152,41 @@ protected:
    
    std::thread m_isLogThread; ///< A separate thread for capturing indiserver logs
    
+   /** \name Supervisor Mode
+     * In supervisor mode indiserver is run and restarted by a driverSupervisor, and the local driver FIFOs are
+     * pre-spawned and held open.  The local driver relays are tracked by pidfd, and when one exits the supervisor
+     * tells indiserver when to restart it, with exponential backoff, through the FIFO given to indiserver's -s option.
+     * The driver restarts and queue depths are logged, and published as INDI properties through a driver of our own,
+     * which is added to the local drivers.
+     * @{
+     */
+   bool m_supervise {false}; ///< Flag to enable supervisor mode.
+   int m_supBackoffMin {10}; ///< The restart delay after a crash [msec].
+   int m_supBackoffMax {10000}; ///< The maximum restart delay [msec].
+   double m_supStableTime {10}; ///< The time a process must run before its restart delay resets [sec].
+   int m_supQueueWarn {32768}; ///< A warning is logged when a driver FIFO has more than this many bytes waiting.
+
+   std::string m_supFIFOPath; ///< The FIFO indiserver reads restart requests from.
+   int m_supFIFO {-1}; ///< The restart request FIFO, held open for writing.
+
+   driverSupervisor m_supervisor; ///< The supervisor.  Only accessed by the supervisor thread once it starts.
+   int m_isIdx {-1}; ///< The index of indiserver in m_supervisor.
+   std::vector<int> m_relayIdx; ///< The indices of the local driver relays in m_supervisor.
+   std::vector<uint8_t> m_relayUp; ///< Whether each relay was running at the last check.
+   std::vector<uint8_t> m_queueWarned; ///< Whether a queue warning is active for each relay.
+
+   std::atomic<bool> m_isRunning {false}; ///< Whether indiserver is running, set by the supervisor thread.
+
+   std::thread m_supThread; ///< The supervisor thread.
+
+   indiDriver<xindiserver> * m_supIndiDriver {nullptr}; ///< Publishes the supervisor's metrics, since MagAOXApp<false> has no INDI driver.
+   int m_selfRelay {-1}; ///< The index in m_relayIdx of the relay for our own driver.
+   pid_t m_selfRelayPid {0}; ///< The pid of our relay when the properties were last defined.
+
+   pcf::IndiProperty m_indiP_indiserver; ///< indiserver's pid, restarts, and recovery times.
+   std::vector<pcf::IndiProperty> m_indiP_drivers; ///< Each local driver's pid, restarts, recovery times, and queue depths, indexed as m_relayIdx.
+   ///@}
+
 public:
    /// Default c'tor.
    xindiserver();
@@ -203,6 +243,59 @@ public:
      */
    int forkIndiserver();
       
+   ///Pre-spawn the local driver FIFOs and set up the supervisor, for supervisor mode.
+   /**
+     * \returns 0 on success
+     * \returns -1 on error (fatal)
+     */
+   int setupSupervisor();
+
+   ///Thread starter, called by supThreadStart on thread construction.  Calls supThreadExec.
+   static void _supThreadStart( xindiserver * l /**< [in] a pointer to a xindiserver instance (normally this) */);
+
+   /// Start the supervisor thread.
+   int supThreadStart();
+
+   /// Execute the supervisor.
+   void supThreadExec();
+
+   /// Ask indiserver to restart a local driver.  Called by the supervisor.
+   /**
+     * \returns 0 on success, including if indiserver is not running, since it then starts all drivers itself
+     * \returns -1 on error
+     */
+   int requestRestart( const std::string & driver, ///< [in] the driver's full path, as indiserver knows it
+                       pid_t pid                   ///< [in] the pid of the relay which exited
+                     );
+
+   /// Look for restarted driver relays among indiserver's children, and attach them.
+   /**
+     * \returns the number of relays attached
+     */
+   int attachRelays();
+
+   /// Log a warning for driver FIFOs with too many bytes waiting.
+   void checkQueues();
+
+   /// Create the supervisor INDI properties, and start the INDI driver which publishes them.
+   /**
+     * \returns 0 on success
+     * \returns -1 on error (fatal)
+     */
+   int startSupervisorINDI();
+
+   /// Update the supervisor INDI properties.  Called by the supervisor thread.
+   void updateSupervisorINDI();
+
+   /// Stop the INDI driver which publishes the supervisor properties.
+   void stopSupervisorINDI();
+
+   /// Handler for the get INDI properties request, which sends the supervisor properties.
+   /** Hides MagAOXApp::handleGetProperties, which does nothing without INDI.  Called by m_supIndiDriver.
+     */
+   void handleGetProperties( const pcf::IndiProperty &ipRecv /**< [in] The property being requested. */ );
+
+
    ///Thread starter, called by isLogThreadStart on thread construction.  Calls isLogThreadExec.
    static void _isLogThreadStart( xindiserver * l /**< [in] a pointer to a xindiserver instance (normally this) */);
 
@@ -253,6 +346,11 @@ void xindiserver::setupConfig()
 
    config.add("remote.servers","", "remote.servers" , argType::Required, "remote", "servers", false,  "vector string", "List of servers to load remote drivers for, in the form of name@tunnel.  Name is used to load the name.conf configuration file, and tunnel is the name of a tunnel specified in sshTunnels.conf.");
    
+   config.add("supervisor.enable","", "supervisor.enable" , argType::Required, "supervisor", "enable", false,  "bool", "Supervise indiserver and the local drivers: pre-spawn the driver FIFOs, track the drivers by pidfd, restart with exponential backoff, and log restarts and queue depths.  Default false.");
+   config.add("supervisor.backoffMin","", "supervisor.backoffMin" , argType::Required, "supervisor", "backoffMin", false,  "int", "The restart delay after a crash [msec], doubling on each further crash.  Default 10.");
+   config.add("supervisor.backoffMax","", "supervisor.backoffMax" , argType::Required, "supervisor", "backoffMax", false,  "int", "The maximum restart delay [msec].  indiserver restarts a driver anyway after 60 sec.  Default 10000.");
+   config.add("supervisor.stableTime","", "supervisor.stableTime" , argType::Required, "supervisor", "stableTime", false,  "float", "The time a process must run before its restart delay resets [sec].  Default 10.");
+   config.add("supervisor.queueWarn","", "supervisor.queueWarn" , argType::Required, "supervisor", "queueWarn", false,  "int", "Log a warning when a driver FIFO has more than this many bytes waiting.  Default 32768.");
 }
 
 
@@ -273,6 +371,12 @@ void xindiserver::loadConfig()
    config(m_remote, "remote.drivers");
    config(m_remoteServers, "remote.servers");
    
+   config(m_supervise, "supervisor.enable");
+   config(m_supBackoffMin, "supervisor.backoffMin");
+   config(m_supBackoffMax, "supervisor.backoffMax");
+   config(m_supStableTime, "supervisor.stableTime");
+   config(m_supQueueWarn, "supervisor.queueWarn");
+   
    loadSSHTunnelConfigs(m_tunnels, config);
 }
 
@@ -304,6 +408,17 @@ int xindiserver::constructIndiserverCommand( std::vector<std::string> & indiserv
       if(indiserver_v >= 3) indiserverCommand.push_back("-vvv");
       
       if(indiserver_x == true) indiserverCommand.push_back("-x");
+
+      if(m_supervise == true)
+      {
+         m_supFIFOPath = MAGAOX_path;
+         m_supFIFOPath += "/";
+         m_supFIFOPath += MAGAOX_driverFIFORelPath;
+         m_supFIFOPath += "/" + configName() + ".supervisor";
+
+         indiserverCommand.push_back("-s");
+         indiserverCommand.push_back(m_supFIFOPath);
+      }
    }
    catch(...)
    {
@@ -523,6 +638,31 @@ int xindiserver::forkIndiserver()
    }
 
 
+   if(m_supervise)
+   {
+      //The supervisor's child only keeps the write end, as its stderr
+      fcntl(filedes[0], F_SETFD, FD_CLOEXEC);
+      fcntl(filedes[1], F_SETFD, FD_CLOEXEC);
+
+      m_isIdx = m_supervisor.add("indiserver", m_indiserverCommand, filedes[1]);
+
+      if(m_supervisor.start(m_isIdx) < 0)
+      {
+         log<software_error>({__FILE__, __LINE__, errno, "fork failed"});
+         return -1;
+      }
+
+      m_isPID = m_supervisor.process(m_isIdx).m_pid;
+      m_isRunning = true;
+
+      m_isSTDERR = filedes[0];
+      m_isSTDERR_input = filedes[1];
+
+      log<text_log>("indiserver started under supervisor with PID " + mx::ioutils::convertToString(m_isPID.load()));
+
+      return 0;
+   }
+
    m_isPID = fork();
    
    if(m_isPID < 0)
@@ -562,7 +702,7 @@ int xindiserver::forkIndiserver()
    
    if(m_log.logLevel() <= logPrio::LOG_INFO)
    {
-      std::string coml = "indiserver started with PID " + mx::ioutils::convertToString(m_isPID);   
+      std::string coml = "indiserver started with PID " + mx::ioutils::convertToString(m_isPID.load());   
       log<text_log>(coml);
    }
    
@@ -659,6 +799,401 @@ void xindiserver::isLogThreadExec()
 
 }
 
+inline
+int xindiserver::setupSupervisor()
+{
+   m_supervisor.backoff(0.001*m_supBackoffMin, 0.001*m_supBackoffMax, m_supStableTime);
+
+   std::string driverFIFOPath = MAGAOX_path;
+   driverFIFOPath += "/";
+   driverFIFOPath += MAGAOX_driverFIFORelPath;
+
+   {
+      elevatedPrivileges elPriv(this);
+
+      mode_t prev = umask(0);
+      int rv = mkfifo(m_supFIFOPath.c_str(), S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+      umask(prev);
+
+      if(rv < 0 && errno != EEXIST)
+      {
+         log<software_error>({__FILE__, __LINE__, errno});
+         log<software_error>({__FILE__, __LINE__, "Failed to create supervisor FIFO: " + m_supFIFOPath});
+         return -1;
+      }
+
+      //O_RDWR never blocks on a FIFO.  Held open so requests made while indiserver restarts wait for it.
+      m_supFIFO = open(m_supFIFOPath.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+      if(m_supFIFO < 0)
+      {
+         log<software_error>({__FILE__, __LINE__, errno});
+         log<software_error>({__FILE__, __LINE__, "Failed to open supervisor FIFO: " + m_supFIFOPath});
+         return -1;
+      }
+   }
+
+   for(size_t i=0; i < m_local.size(); ++i)
+   {
+      //indiserver runs the driver by its full path, and knows it by that
+      std::string dname = m_driverPath + m_local[i];
+
+      int n = m_supervisor.watch(m_local[i], {dname}, [this, dname](pid_t pid){ return requestRestart(dname, pid); });
+
+      elevatedPrivileges elPriv(this);
+
+      //Same permissions as MagAOXApp::createINDIFIFOS
+      mode_t prev = umask(0);
+      int rv = m_supervisor.prespawnFIFOs(n, driverFIFOPath);
+      umask(prev);
+
+      if(rv < 0)
+      {
+         log<software_error>({__FILE__, __LINE__, errno});
+         log<software_error>({__FILE__, __LINE__, "Failed to pre-spawn FIFOs for driver: " + m_local[i] + ". Continuing."});
+      }
+
+      m_relayIdx.push_back(n);
+   }
+
+   m_relayUp.resize(m_relayIdx.size(), 0);
+   m_queueWarned.resize(m_relayIdx.size(), 0);
+
+   //Inherited by xindidriver through indiserver, so it doesn't wait for FIFOs which we have already created
+   if(setenv("XINDID_FASTSTART", "1", 1) < 0)
+   {
+      log<software_error>({__FILE__, __LINE__, errno});
+      return -1;
+   }
+
+   return 0;
+}
+
+inline
+void xindiserver::_supThreadStart( xindiserver * l)
+{
+   l->supThreadExec();
+}
+
+inline
+int xindiserver::supThreadStart()
+{
+   try
+   {
+      m_supThread  = std::thread( _supThreadStart, this);
+   }
+   catch( const std::exception & e )
+   {
+      log<software_error>({__FILE__,__LINE__, std::string("Exception on supervisor thread start: ") + e.what()});
+      return -1;
+   }
+   catch( ... )
+   {
+      log<software_error>({__FILE__,__LINE__, "Unkown exception on supervisor thread start"});
+      return -1;
+   }
+   
+   if(!m_supThread.joinable())
+   {
+      log<software_error>({__FILE__, __LINE__, "supervisor thread did not start"});
+      return -1;
+   }
+   
+   return 0;
+}
+
+inline
+void xindiserver::supThreadExec()
+{
+   double lastQueueCheck = 0;
+   double lastScan = 0;
+   bool missing = false;
+
+   while(m_shutdown == 0)
+   {
+      //Scan for restarted relays more often while some are missing
+      bool changed = (m_supervisor.poll(missing ? 5 : 20) > 0);
+
+      double now = supervisorTime();
+
+      //-- indiserver
+      const driverSupervisor::processT & isp = m_supervisor.process(m_isIdx);
+
+      if(isp.m_pid > 0 && !m_isRunning)
+      {
+         m_isPID = isp.m_pid;
+         m_isRunning = true;
+         log<text_log>("indiserver restarted with PID " + mx::ioutils::convertToString(m_isPID.load()) + " (restart " 
+                          + std::to_string(isp.m_restarts) + ") after " + std::to_string(isp.m_lastRecovery*1000) + " ms", logPrio::LOG_WARNING);
+      }
+      else if(isp.m_pid <= 0 && m_isRunning)
+      {
+         m_isRunning = false;
+         log<text_log>("indiserver exited with status " + std::to_string(isp.m_lastStatus) + ", restarting in " 
+                          + std::to_string(isp.m_backoff*1000) + " ms", logPrio::LOG_ERROR);
+      }
+
+      //-- driver relays
+      missing = false;
+      for(size_t i=0; i < m_relayIdx.size(); ++i)
+      {
+         const driverSupervisor::processT & p = m_supervisor.process(m_relayIdx[i]);
+
+         if(p.m_pid <= 0)
+         {
+            if(m_relayUp[i])
+            {
+               log<text_log>("driver " + p.m_name + " exited", logPrio::LOG_NOTICE);
+               m_relayUp[i] = 0;
+            }
+            missing = true;
+         }
+      }
+
+      if(missing && m_isRunning && now - lastScan > 0.005)
+      {
+         if(attachRelays() > 0) changed = true;
+         lastScan = now;
+      }
+
+      //-- queues
+      if(now - lastQueueCheck > 1.0)
+      {
+         checkQueues();
+         lastQueueCheck = now;
+         changed = true;
+      }
+
+      if(changed) updateSupervisorINDI();
+   }
+}
+
+inline
+int xindiserver::requestRestart( const std::string & driver,
+                                 pid_t pid
+                               )
+{
+   //A new indiserver starts all of its drivers itself
+   if(!m_isRunning) return 0;
+
+   std::string req = "start " + driver + " " + std::to_string(pid) + "\n";
+
+   //Shorter than PIPE_BUF, so written whole or not at all
+   if(write(m_supFIFO, req.data(), req.size()) != (ssize_t) req.size())
+   {
+      log<software_error>({__FILE__, __LINE__, errno, "Failed to request restart of driver: " + driver});
+      return -1;
+   }
+
+   return 0;
+}
+
+inline
+int xindiserver::attachRelays()
+{
+   std::vector<size_t> attached = m_supervisor.attachChildren(m_isPID);
+
+   for(size_t a = 0; a < attached.size(); ++a)
+   {
+      int n = attached[a];
+
+      for(size_t i=0; i < m_relayIdx.size(); ++i)
+      {
+         if(m_relayIdx[i] == n) m_relayUp[i] = 1;
+      }
+
+      const driverSupervisor::processT & p = m_supervisor.process(n);
+      if(p.m_restarts > 0)
+      {
+         log<text_log>("driver " + p.m_name + " restarted (restart " + std::to_string(p.m_restarts) + ") after " 
+                          + std::to_string(p.m_lastRecovery*1000) + " ms, max " + std::to_string(p.m_maxRecovery*1000) + " ms. Queued: in " 
+                            + std::to_string(m_supervisor.queueDepth(n,0)) + " out " + std::to_string(m_supervisor.queueDepth(n,1)) + " bytes", logPrio::LOG_NOTICE);
+      }
+   }
+
+   return attached.size();
+}
+
+inline
+void xindiserver::checkQueues()
+{
+   for(size_t i=0; i < m_relayIdx.size(); ++i)
+   {
+      int qin = m_supervisor.queueDepth(m_relayIdx[i], 0);
+      int qout = m_supervisor.queueDepth(m_relayIdx[i], 1);
+
+      bool over = (qin > m_supQueueWarn || qout > m_supQueueWarn);
+
+      if(over && !m_queueWarned[i])
+      {
+         log<text_log>("driver " + m_supervisor.process(m_relayIdx[i]).m_name + " is behind. Queued: in " 
+                           + std::to_string(qin) + " out " + std::to_string(qout) + " bytes", logPrio::LOG_WARNING);
+      }
+      else if(!over && m_queueWarned[i])
+      {
+         log<text_log>("driver " + m_supervisor.process(m_relayIdx[i]).m_name + " has caught up", logPrio::LOG_INFO);
+      }
+
+      m_queueWarned[i] = over;
+   }
+}
+
+inline
+int xindiserver::startSupervisorINDI()
+{
+   std::string driverFIFOPath = MAGAOX_path;
+   driverFIFOPath += "/";
+   driverFIFOPath += MAGAOX_driverFIFORelPath;
+
+   //The FIFOs were pre-spawned by setupSupervisor, since we are one of the local drivers
+   m_driverInName = driverFIFOPath + "/" + configName() + ".in";
+   m_driverOutName = driverFIFOPath + "/" + configName() + ".out";
+   m_driverCtrlName = driverFIFOPath + "/" + configName() + ".ctrl";
+
+   createROIndiNumber( m_indiP_indiserver, "indiserver", "indiserver", "Supervisor");
+   indi::addNumberElement<double>( m_indiP_indiserver, "pid", 0, std::numeric_limits<double>::max(), 1, "%0.0f", "PID");
+   indi::addNumberElement<double>( m_indiP_indiserver, "restarts", 0, std::numeric_limits<double>::max(), 1, "%0.0f", "restarts");
+   indi::addNumberElement<double>( m_indiP_indiserver, "last_recovery", -1, std::numeric_limits<double>::max(), 0, "%0.3f", "last recovery [ms]");
+   indi::addNumberElement<double>( m_indiP_indiserver, "max_recovery", 0, std::numeric_limits<double>::max(), 0, "%0.3f", "max recovery [ms]");
+
+   m_indiP_drivers.resize(m_relayIdx.size());
+   for(size_t i=0; i < m_relayIdx.size(); ++i)
+   {
+      const std::string & name = m_supervisor.process(m_relayIdx[i]).m_name;
+
+      if(name == configName()) m_selfRelay = i;
+
+      createROIndiNumber( m_indiP_drivers[i], "driver_" + name, name, "Supervisor");
+      indi::addNumberElement<double>( m_indiP_drivers[i], "pid", -1, std::numeric_limits<double>::max(), 1, "%0.0f", "PID");
+      indi::addNumberElement<double>( m_indiP_drivers[i], "restarts", 0, std::numeric_limits<double>::max(), 1, "%0.0f", "restarts");
+      indi::addNumberElement<double>( m_indiP_drivers[i], "last_recovery", -1, std::numeric_limits<double>::max(), 0, "%0.3f", "last recovery [ms]");
+      indi::addNumberElement<double>( m_indiP_drivers[i], "max_recovery", 0, std::numeric_limits<double>::max(), 0, "%0.3f", "max recovery [ms]");
+      indi::addNumberElement<double>( m_indiP_drivers[i], "queue_in", -1, std::numeric_limits<double>::max(), 1, "%0.0f", "queued in [bytes]");
+      indi::addNumberElement<double>( m_indiP_drivers[i], "queue_out", -1, std::numeric_limits<double>::max(), 1, "%0.0f", "queued out [bytes]");
+   }
+
+   try
+   {
+      m_supIndiDriver = new indiDriver<xindiserver>(this, configName(), "0", "0");
+   }
+   catch(...)
+   {
+      log<software_critical>({__FILE__, __LINE__, 0, 0, "INDI Driver construction exception."});
+      return -1;
+   }
+
+   if(m_supIndiDriver->good() == false)
+   {
+      log<software_critical>({__FILE__, __LINE__, 0, 0, "INDI Driver failed to open FIFOs."});
+      delete m_supIndiDriver;
+      m_supIndiDriver = nullptr;
+      return -1;
+   }
+
+   m_supIndiDriver->activate();
+   log<indidriver_start>();
+
+   return 0;
+}
+
+inline
+void xindiserver::updateSupervisorINDI()
+{
+   if(m_supIndiDriver == nullptr || m_selfRelay < 0) return;
+
+   //Only while our relay is up to read them, so a stalled FIFO never blocks the supervisor
+   pid_t selfPid = m_supervisor.process(m_relayIdx[m_selfRelay]).m_pid;
+   if(!m_isRunning || selfPid <= 0) return;
+
+   std::lock_guard<std::mutex> guard(m_indiMutex);
+
+   //A restarted relay means indiserver has forgotten our properties
+   if(selfPid != m_selfRelayPid)
+   {
+      m_selfRelayPid = selfPid;
+
+      m_supIndiDriver->sendDefProperty(m_indiP_indiserver);
+      for(size_t i=0; i < m_indiP_drivers.size(); ++i) m_supIndiDriver->sendDefProperty(m_indiP_drivers[i]);
+   }
+
+   const driverSupervisor::processT & isp = m_supervisor.process(m_isIdx);
+
+   indi::updateIfChanged( m_indiP_indiserver, std::vector<std::string>({"pid", "restarts", "last_recovery", "max_recovery"}),
+                          std::vector<double>({(double) isp.m_pid, (double) isp.m_restarts, isp.m_lastRecovery*1000, isp.m_maxRecovery*1000}),
+                          m_supIndiDriver, (isp.m_pid > 0) ? INDI_OK : INDI_ALERT);
+
+   for(size_t i=0; i < m_relayIdx.size(); ++i)
+   {
+      const driverSupervisor::processT & p = m_supervisor.process(m_relayIdx[i]);
+
+      pcf::IndiProperty::PropertyStateType st = INDI_OK;
+      if(p.m_pid <= 0) st = INDI_ALERT;
+      else if(m_queueWarned[i]) st = INDI_BUSY;
+
+      indi::updateIfChanged( m_indiP_drivers[i], std::vector<std::string>({"pid", "restarts", "last_recovery", "max_recovery", "queue_in", "queue_out"}),
+                             std::vector<double>({(double) p.m_pid, (double) p.m_restarts, p.m_lastRecovery*1000, p.m_maxRecovery*1000, 
+                                                     (double) m_supervisor.queueDepth(m_relayIdx[i], 0), (double) m_supervisor.queueDepth(m_relayIdx[i], 1)}),
+                             m_supIndiDriver, st);
+   }
+}
+
+inline
+void xindiserver::stopSupervisorINDI()
+{
+   if(m_supIndiDriver == nullptr) return;
+
+   pcf::IndiProperty ipSend;
+   ipSend.setDevice(configName());
+   try 
+   {
+      m_supIndiDriver->sendDelProperty(ipSend);
+   }
+   catch(const std::exception & e)
+   {
+      log<software_error>({__FILE__, __LINE__, std::string("exception caught from sendDelProperty: ") + e.what()}); 
+   }
+
+   m_supIndiDriver->quitProcess();
+   m_supIndiDriver->deactivate();
+   log<indidriver_stop>();
+
+   delete m_supIndiDriver;
+   m_supIndiDriver = nullptr;
+}
+
+inline
+void xindiserver::handleGetProperties( const pcf::IndiProperty &ipRecv )
+{
+   if(m_supIndiDriver == nullptr) return;
+
+   //Ignore if not our device
+   if (ipRecv.hasValidDevice() && ipRecv.getDevice() != m_supIndiDriver->getName())
+   {
+      return;
+   }
+
+   std::lock_guard<std::mutex> guard(m_indiMutex);
+
+   try
+   {
+      if( !ipRecv.hasValidName() || ipRecv.getName() == m_indiP_indiserver.getName()) 
+      {
+         m_supIndiDriver->sendDefProperty(m_indiP_indiserver);
+      }
+
+      for(size_t i=0; i < m_indiP_drivers.size(); ++i)
+      {
+         if( !ipRecv.hasValidName() || ipRecv.getName() == m_indiP_drivers[i].getName()) 
+         {
+            m_supIndiDriver->sendDefProperty(m_indiP_drivers[i]);
+         }
+      }
+   }
+   catch(const std::exception & e)
+   {
+      log<software_error>({__FILE__, __LINE__, std::string("exception caught from sendDefProperty: ") + e.what()}); 
+   }
+}
+
 inline
 int xindiserver::processISLog( std::string logs )
 {
@@ -735,6 +1270,12 @@ int xindiserver::processISLog( std::string logs )
 inline
 int xindiserver::appStartup()
 {
+   //In supervisor mode we are a local driver too, publishing the supervisor's metrics
+   if(m_supervise && std::find(m_local.begin(), m_local.end(), configName()) == m_local.end())
+   {
+      m_local.push_back(configName());
+   }
+
    if( constructIndiserverCommand(m_indiserverCommand) < 0)
    {
       log<software_critical>({__FILE__, __LINE__});
@@ -778,6 +1319,21 @@ int xindiserver::appStartup()
       }
    }
 
+   if(m_supervise)
+   {
+      if(setupSupervisor() < 0)
+      {
+         log<software_critical>({__FILE__, __LINE__});
+         return -1;
+      }
+
+      if(startSupervisorINDI() < 0)
+      {
+         log<software_critical>({__FILE__, __LINE__});
+         return -1;
+      }
+   }
+
    m_local.clear();
    m_remote.clear();
    m_tunnels.clear();
@@ -797,12 +1353,30 @@ int xindiserver::appStartup()
       return -1;
    }  
    
+   if(m_supervise)
+   {
+      if(supThreadStart() < 0)
+      {
+         log<software_critical>({__FILE__, __LINE__});
+         return -1;
+      }
+   }
+   
    return 0;
 }
 
 inline
 int xindiserver::appLogic()
 {
+   if(m_supervise)
+   {
+      //The supervisor restarts indiserver, so not running is not fatal
+      if(m_isRunning) state(stateCodes::CONNECTED);
+      else state(stateCodes::NOTCONNECTED);
+
+      return 0;
+   }
+
    int status;
    pid_t result = waitpid(m_isPID, &status, WNOHANG);
    if (result == 0) 
@@ -825,8 +1399,17 @@ int xindiserver::appLogic()
 inline
 int xindiserver::appShutdown()
 {
-    
-   if(m_isPID > 0)
+   if(m_supervise)
+   {
+      //Stop the supervisor first so it doesn't restart indiserver
+      if(m_supThread.joinable()) m_supThread.join();
+      stopSupervisorINDI();
+      m_supervisor.stopAll(SIGTERM);
+
+      if(m_supFIFO >= 0) close(m_supFIFO);
+      m_supFIFO = -1;
+   }
+   else if(m_isPID > 0)
    {
       kill(m_isPID, SIGTERM);
    }
@@ -353,6 +353,23 @@ public:
                          const typename logT::messageT & msg, ///< [in] the message to log (could be of type emptyMessage) 
                          const logPrioT & level              ///< [in] the level (verbosity) of this log
                        );
+
+   /// Create a formatted log entry, filling in a buffer from an allocator.
+   /** This version has the timestamp provided, and gets the buffer by calling `alloc(size)`, which must return
+     * a bufferPtrT of at least `size` bytes.
+     *
+     * \tparam logT is a log entry type
+     * \tparam allocT is the type of the allocating callable
+     *
+     * \returns 0 on success, -1 on error.
+     */
+   template<typename logT, typename allocT>
+   static int createLog( bufferPtrT & logBuffer,              ///< [out] a shared_ptr\<logBuffer\>, which will be allocated and populated with the log entry 
+                         const timespecX & ts,          ///< [in] the timestamp of this log entry.
+                         const typename logT::messageT & msg, ///< [in] the message to log (could be of type emptyMessage) 
+                         const logPrioT & level,             ///< [in] the level (verbosity) of this log
+                         allocT && alloc                     ///< [in] callable which allocates the buffer, given its size
+                       );
    
    ///Extract the basic details of a log entry
    /** Convenience wrapper for the other extraction functions.
@@ -636,6 +653,20 @@ int logHeader::createLog( bufferPtrT & logBuffer,
                           const typename logT::messageT & msg,
                           const logPrioT & level
                         )
+{
+   return createLog<logT>(logBuffer, ts, msg, level, [](size_t sz)
+                                                     {
+                                                        return bufferPtrT( (char *) ::operator new(sz*sizeof(char)) );
+                                                     });
+}
+
+template<typename logT, typename allocT>
+int logHeader::createLog( bufferPtrT & logBuffer,
+                          const timespecX & ts,
+                          const typename logT::messageT & msg,
+                          const logPrioT & level,
+                          allocT && alloc
+                        )
 {
    logPrioT lvl;
    if(level == logPrio::LOG_DEFAULT) 
@@ -646,7 +677,7 @@ int logHeader::createLog( bufferPtrT & logBuffer,
    
    //We first allocate the buffer.
    msgLenT len = logT::length(msg);
-   logBuffer = bufferPtrT( (char *) ::operator new(totalSize(len)*sizeof(char)) );
+   logBuffer = alloc(totalSize(len));
 
    //Now load the basics.
    logLevel(logBuffer, lvl);
@@ -5,6 +5,9 @@
 #ifndef pixaccess_h
 #define pixaccess_h
 
+#include <cstring>
+#include <type_traits>
+
 #include "ImageStruct.hpp"
 
 ///Function to cast the data type to float.
@@ -60,6 +63,70 @@ returnT (*getPixPointer(int imageStructDataT))(void*, size_t)
          return nullptr;
    }
 }
+
+///Function to copy a contiguous run of pixels, casting each to returnT.
+/** This is the bulk version of getPix, for copying a whole image without a function call per pixel.
+  *
+  * 	param dataT the type of the image data.
+  */
+template<typename returnT, typename dataT>
+void getPixels( returnT * dest, ///< [out] The destination, at least n long
+                void *imdata,   ///< [in] Pointer to the image data
+                size_t n        ///< [in] The number of pixels to copy
+              )
+{
+   if(std::is_same<returnT, dataT>::value)
+   {
+      memcpy(dest, imdata, n*sizeof(returnT));
+      return;
+   }
+
+   const dataT * src = (const dataT *) imdata;
+
+   #pragma omp simd
+   for(size_t idx = 0; idx < n; ++idx)
+   {
+      dest[idx] = (returnT) src[idx];
+   }
+}
+
+///Get the function pointer for getPixels for the type
+template<typename returnT, int imageStructDataT>
+void (*getPixelsPointer())(returnT*, void*, size_t)
+{
+   return &getPixels<returnT, typename imageStructDataType<imageStructDataT>::type>;
+}
+
+template<typename returnT>
+void (*getPixelsPointer(int imageStructDataT))(returnT*, void*, size_t)
+{
+   switch(imageStructDataT)
+   {
+      case IMAGESTRUCT_UINT8:
+         return getPixelsPointer<returnT, IMAGESTRUCT_UINT8>();
+      case IMAGESTRUCT_INT8:
+         return getPixelsPointer<returnT, IMAGESTRUCT_INT8>();
+      case IMAGESTRUCT_UINT16:
+         return getPixelsPointer<returnT, IMAGESTRUCT_UINT16>();
+      case IMAGESTRUCT_INT16:
+         return getPixelsPointer<returnT, IMAGESTRUCT_INT16>();
+      case IMAGESTRUCT_UINT32:
+         return getPixelsPointer<returnT, IMAGESTRUCT_UINT32>();
+      case IMAGESTRUCT_INT32:
+         return getPixelsPointer<returnT, IMAGESTRUCT_INT32>();
+      case IMAGESTRUCT_UINT64:
+         return getPixelsPointer<returnT, IMAGESTRUCT_UINT64>();
+      case IMAGESTRUCT_INT64:
+         return getPixelsPointer<returnT, IMAGESTRUCT_INT64>();
+      case IMAGESTRUCT_FLOAT:
+         return getPixelsPointer<returnT, IMAGESTRUCT_FLOAT>();
+      case IMAGESTRUCT_DOUBLE:
+         return getPixelsPointer<returnT, IMAGESTRUCT_DOUBLE>();
+      default:
+         std::cerr << "getPixelsPointer: Unknown or unsupported data type. " << __FILE__ << " " << __LINE__ << "\n";
+         return nullptr;
+   }
+}
 #endif
 
 
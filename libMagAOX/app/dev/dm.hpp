@@ -20,6 +20,10 @@
 
 #include "../../ImageStreamIO/ImageStruct.hpp"
 
+#include "dmKernels.hpp"
+#include "dmSatMask.hpp"
+#include "dmCombine.hpp"
+
 namespace MagAOX
 {
 namespace app
@@ -102,6 +106,8 @@ protected:
     std::vector<std::string> m_satTriggerDevice;
     std::vector<std::string> m_satTriggerProperty;
 
+    bool m_combine{false}; ///< If true the channels are combined in this process, rather than by an external dmcomb.
+
     ///@}
 
     std::string m_calibRelDir; ///< The directory relative to the calibPath.  Set this before calling dm<derivedT,realT>::loadConfig().
@@ -225,10 +231,15 @@ public:
      */
     int allocate(const dev::shmimT &sp);
 
-    /// Called by shmimMonitor when a new DM command is available.  This is just a pass-through to derivedT::commandDM(char*).
+    /// Called by shmimMonitor when a new DM command is available.  This is just a pass-through to sendCommand.
+    /** When combining the channels in this process dmXXdisp is only written by the combiner, so this does nothing.
+     */
     int processImage(void *curr_src,
                      const dev::shmimT &sp);
 
+    /// Send a command to the DM with derivedT::commandDM, and hand off the saturation map.
+    int sendCommand(void *curr_src /**< [in] the command, of size m_dmWidth x m_dmHeight */);
+
     /// Calls derived()->releaseDM() and then 0s all channels and the sat map.
     /** This is called by the relevant INDI callback
      *
@@ -311,6 +322,7 @@ public:
 
 protected:
     mx::improc::eigenImage<uint8_t> m_instSatMap;   ///< The instantaneous saturation map, 0/1, set by the commandDM() function of the derived class.
+    dmSatMaskRing m_satMasks;                       ///< The bit-packed instantaneous saturation maps, handed off from processImage to the saturation thread.
     mx::improc::eigenImage<uint16_t> m_accumSatMap; ///< The accumulated saturation map, which acccumulates for m_satAvgInt then is publised as a 0/1 image.
     mx::improc::eigenImage<float> m_satPercMap;     ///< Map of the percentage of time each actator was saturated during the avg. interval.
 
@@ -373,6 +385,79 @@ protected:
 
     ///@}
 
+    /** \name Channel Combiner
+     * When dm.combine is true the dmXXdispNN channels are summed here and sendCommand is called with the total,
+     * instead of waiting for an external dmcomb to write dmXXdisp.  Each channel has a waiter thread blocked on one of
+     * its semaphores.  The waiter which wakes takes m_combMutex and folds in every channel whose cnt0 has changed, so
+     * simultaneous updates to several channels result in a single command.  The waiters are started by the combiner
+     * thread, and so inherit its priority and cpuset.
+     * @{
+     */
+
+    dmChannelSum<realT> m_combSum; ///< The running sum of the channels.
+
+    std::vector<IMAGE> m_combStreams; ///< The channel streams.
+
+    std::vector<sem_t *> m_combSems; ///< The semaphore waited on in each channel stream.
+
+    std::vector<uint64_t> m_combCnt0; ///< The cnt0 of each channel when it was last summed.
+
+    std::vector<realT> m_combCopy; ///< A copy of a channel, checked for a concurrent write before it is summed.
+
+    IMAGE m_combDispStream;      ///< The dmXXdisp stream, where the total is published for other processes.
+    bool m_combDispOpen{false}; ///< Whether m_combDispStream is open.
+
+    std::mutex m_combMutex; ///< Serializes the waiters, and protects the statistics.
+
+    std::vector<std::thread> m_combWaiters; ///< The channel waiter threads.
+
+    std::atomic<bool> m_combRestart{false}; ///< Flag telling the waiters to exit, so the channels can be re-opened.
+
+    std::vector<uint64_t> m_combUpdates; ///< The number of updates of each channel since the statistics were last published.
+    uint64_t m_combCommands{0};          ///< The number of commands since the statistics were last published.
+    double m_combTimeSum{0};             ///< The total combine latency since the statistics were last published [sec].
+    double m_combTimeMax{0};             ///< The maximum combine latency since the statistics were last published [sec].
+    double m_combStatsTime{0};           ///< The time the statistics were last published.
+
+    bool m_combThreadInit{true}; ///< Synchronizer for thread startup, to allow priority setting to finish.
+
+    pid_t m_combThreadID{0}; ///< The ID of the combiner thread.
+
+    pcf::IndiProperty m_combThreadProp; ///< The property to hold the combiner thread details.
+
+    std::thread m_combThread; ///< The combiner thread, which opens the channels and runs the waiters.
+
+    /// Thread starter, called by MagAOXApp::threadStart on thread construction.  Calls combThreadExec.
+    static void combThreadStart(dm *d /**< [in] a pointer to a dm instance (normally this) */);
+
+    /// Execute the channel combiner
+    void combThreadExec();
+
+    /// Wait on one channel, and combine when it is updated
+    void combWaiterExec(size_t ch /**< [in] the channel to wait on */);
+
+    /// Open the channel streams and size the sum
+    /**
+     * \returns 0 on success
+     * \returns -1 on error, in which case no streams are open
+     */
+    int combOpen();
+
+    /// Close the channel streams
+    void combClose();
+
+    /// Sum the changed channels and command the DM.  Must be called with m_combMutex locked.
+    /**
+     * \returns 0 if nothing changed, or on success
+     * \returns \<0 on an error from sendCommand
+     */
+    int combineChannels(bool all = false /**< [in] [optional] if true every channel is summed, changed or not */);
+
+    /// Publish the per-channel update rates and the combine latency
+    int combStats();
+
+    ///@}
+
 protected:
     /** \name INDI
      *
@@ -397,6 +482,8 @@ protected:
 
     pcf::IndiProperty m_indiP_zeroAll;
 
+    pcf::IndiProperty m_indiP_combine; ///< The channel update rates and combine latency, when combining in this process.
+
 public:
     /// The static callback function to be registered for initializing the DM.
     /**
@@ -581,6 +668,8 @@ int dm<derivedT, realT>::setupConfig(mx::app::appConfigurator &config)
     config.add("dm.intervalSatCountThreshold", "", "dm.intervalSatCountThreshold", argType::Required, "dm", "intervalSatCountThreshold", false, "float", "Threshold one number of consecutive intervals the intervalSatThreshold is exceeded.  Default is 10.");
 
     config.add("dm.satTriggerDevice", "", "dm.satTriggerDevice", argType::Required, "dm", "satTriggerDevice", false, "vector<string>", "Device(s) with a toggle switch to toggle on saturation trigger.");
+    config.add("dm.combine", "", "dm.combine", argType::Required, "dm", "combine", false, "bool", "If true, sum the dmXXdispNN channels in this process and command the DM directly, rather than waiting for an external dmcomb to write dmXXdisp.  The external dmcomb must not be running.  Default is false.");
+
     config.add("dm.satTriggerProperty", "", "dm.satTriggerProperty", argType::Required, "dm", "satTriggerProperty", false, "vector<string>", "Property with a toggle switch to toggle on saturation trigger, one per entry in satTriggerDevice.");
 
     return 0;
@@ -655,6 +744,7 @@ int dm<derivedT, realT>::loadConfig(mx::app::appConfigurator &config)
     config(m_intervalSatCountThreshold, "dm.intervalSatCountThreshold");
     config(m_satTriggerDevice, "dm.satTriggerDevice");
     config(m_satTriggerProperty, "dm.satTriggerProperty");
+    config(m_combine, "dm.combine");
 
     return 0;
 }
@@ -788,6 +878,15 @@ int dm<derivedT, realT>::appStartup()
         return -1;
     }
 
+    if (m_combine)
+    {
+        if (derived().threadStart(m_combThread, m_combThreadInit, m_combThreadID, m_combThreadProp, derived().m_smThreadPrio, derived().m_smCpuset, "dmcomb", this, combThreadStart) < 0)
+        {
+            derivedT::template log<software_error, -1>({__FILE__, __LINE__});
+            return -1;
+        }
+    }
+
     return 0;
 }
 
@@ -802,6 +901,18 @@ int dm<derivedT, realT>::appLogic()
         return -1;
     }
 
+    if (m_combine)
+    {
+        if (pthread_tryjoin_np(m_combThread.native_handle(), 0) == 0)
+        {
+            derivedT::template log<software_error>({__FILE__, __LINE__, "dmcomb thread has exited"});
+
+            return -1;
+        }
+
+        combStats();
+    }
+
     checkFlats();
     checkTests();
 
@@ -829,6 +940,19 @@ int dm<derivedT, realT>::appShutdown()
         }
     }
 
+    if (m_combThread.joinable())
+    {
+        m_combRestart = true;
+        pthread_kill(m_combThread.native_handle(), SIGUSR1);
+        try
+        {
+            m_combThread.join(); // this will throw if it was already joined
+        }
+        catch (...)
+        {
+        }
+    }
+
     return 0;
 }
 
@@ -918,6 +1042,8 @@ int dm<derivedT, realT>::allocate(const dev::shmimT &sp)
     m_accumSatMap.resize(m_dmWidth, m_dmHeight);
     m_accumSatMap.setZero();
 
+    m_satMasks.resize(m_dmWidth * m_dmHeight);
+
     m_satPercMap.resize(m_dmWidth, m_dmHeight);
     m_satPercMap.setZero();
 
@@ -928,6 +1054,9 @@ int dm<derivedT, realT>::allocate(const dev::shmimT &sp)
         return -1;
     }
 
+    // Have the combiner re-open the channels, which may have changed.
+    m_combRestart = true;
+
     return 0;
 }
 
@@ -937,6 +1066,15 @@ int dm<derivedT, realT>::processImage(void *curr_src,
 {
     static_cast<void>(sp); // be unused
 
+    if (m_combine)
+        return 0;
+
+    return sendCommand(curr_src);
+}
+
+template <class derivedT, typename realT>
+int dm<derivedT, realT>::sendCommand(void *curr_src)
+{
     int rv = derived().commandDM(curr_src);
 
     if (rv < 0)
@@ -944,6 +1082,10 @@ int dm<derivedT, realT>::processImage(void *curr_src,
         derivedT::template log<software_critical>({__FILE__, __LINE__, errno, rv, "Error from commandDM"});
         return rv;
     }
+
+    // Hand off the saturation map.  If the sat thread is far behind this one is dropped, and counted.
+    m_satMasks.push(m_instSatMap.data());
+
     // Tell the sat thread to get going
     if (sem_post(&m_satSemaphore) < 0)
     {
@@ -1812,6 +1954,7 @@ void dm<derivedT, realT>::satThreadExec()
 
     int naccum = 0;
     double t_accumst = mx::sys::get_curr_time();
+    uint64_t lastDropped = m_satMasks.dropped();
 
     // This is the main image grabbing loop.
     while (!derived().shutdown())
@@ -1828,31 +1971,30 @@ void dm<derivedT, realT>::satThreadExec()
         // Wait on semaphore
         if (sem_timedwait(&m_satSemaphore, &ts) == 0)
         {
-            // not a timeout -->accumulate
-            for (int rr = 0; rr < m_instSatMap.rows(); ++rr)
-            {
-                for (int cc = 0; cc < m_instSatMap.cols(); ++cc)
-                {
-                    m_accumSatMap(rr, cc) += m_instSatMap(rr, cc);
-                }
-            }
-            ++naccum;
+            // not a timeout -->accumulate every mask handed off since the last time
+            naccum += m_satMasks.accumulate(m_accumSatMap.data());
 
             // If less than avg int --> go back and wait again
             if (mx::sys::get_curr_time(ts) - t_accumst < m_satAvgInt / 1000.0)
                 continue;
 
             // If greater than avg int --> calc stats, write to streams.
-            m_overSatAct = 0;
-            for (int rr = 0; rr < m_instSatMap.rows(); ++rr)
+            if (naccum > 0)
             {
-                for (int cc = 0; cc < m_instSatMap.cols(); ++cc)
-                {
-                    m_satPercMap(rr, cc) = m_accumSatMap(rr, cc) / naccum;
-                    if (m_satPercMap(rr, cc) >= m_percThreshold)
-                        ++m_overSatAct;
-                    satmap(rr, cc) = (m_accumSatMap(rr, cc) > 0); // it's  1/0 map
-                }
+                m_satPercMap = m_accumSatMap.template cast<float>() / naccum;
+            }
+            else
+            {
+                m_satPercMap.setZero();
+            }
+
+            m_overSatAct = (m_satPercMap >= m_percThreshold).count();
+            satmap = (m_accumSatMap > 0).template cast<uint8_t>(); // it's  1/0 map
+
+            if (m_satMasks.dropped() != lastDropped)
+            {
+                derivedT::template log<text_log>("saturation thread fell behind, dropped " + std::to_string(m_satMasks.dropped() - lastDropped) + " saturation maps", logPrio::LOG_WARNING);
+                lastDropped = m_satMasks.dropped();
             }
 
             // Check of the number of actuators saturated above the percent threshold is greater than the number threshold
@@ -1931,6 +2073,357 @@ void dm<derivedT, realT>::satThreadExec()
     }
 }
 
+template <class derivedT, typename realT>
+void dm<derivedT, realT>::combThreadStart(dm *d)
+{
+    d->combThreadExec();
+}
+
+template <class derivedT, typename realT>
+void dm<derivedT, realT>::combThreadExec()
+{
+    // Get the thread PID immediately so the caller can return.
+    m_combThreadID = syscall(SYS_gettid);
+
+    // Wait for the thread starter to finish initializing this thread.
+    while (m_combThreadInit == true && derived().shutdown() == 0)
+    {
+        sleep(1);
+    }
+
+    while (!derived().shutdown())
+    {
+        // Wait for allocation, which finds the channels, and for the DM to be operating.
+        while ((m_channels <= 0 || m_instSatMap.rows() == 0 || derived().state() != stateCodes::OPERATING) && !derived().shutdown())
+        {
+            sleep(1);
+        }
+        if (derived().shutdown())
+            break;
+
+        m_combRestart = false;
+
+        if (combOpen() < 0)
+        {
+            sleep(1);
+            continue;
+        }
+
+        derivedT::template log<text_log>("combining " + std::to_string(m_channels) + " channels for " + derived().m_shmimName);
+
+        // Start from the current total
+        {
+            std::lock_guard<std::mutex> lock(m_combMutex);
+            combineChannels(true);
+        }
+
+        // The waiters inherit the scheduling of this thread
+        for (size_t ch = 0; ch < m_combStreams.size(); ++ch)
+        {
+            m_combWaiters.emplace_back(&dm::combWaiterExec, this, ch);
+        }
+
+        while (!derived().shutdown() && !m_combRestart && derived().state() == stateCodes::OPERATING)
+        {
+            sleep(1);
+        }
+
+        m_combRestart = true;
+
+        for (auto &w : m_combWaiters)
+        {
+            if (w.joinable())
+                w.join();
+        }
+        m_combWaiters.clear();
+
+        combClose();
+    }
+}
+
+template <class derivedT, typename realT>
+void dm<derivedT, realT>::combWaiterExec(size_t ch)
+{
+    sem_t *sem = m_combSems[ch];
+
+    while (!derived().shutdown() && !m_combRestart)
+    {
+        timespec ts;
+        if (clock_gettime(CLOCK_REALTIME, &ts) < 0)
+        {
+            derivedT::template log<software_critical>({__FILE__, __LINE__, errno, 0, "clock_gettime"});
+            m_combRestart = true;
+            return;
+        }
+        ts.tv_sec += 1;
+
+        if (sem_timedwait(sem, &ts) == 0)
+        {
+            std::lock_guard<std::mutex> lock(m_combMutex);
+
+            if (combineChannels() < 0)
+            {
+                derivedT::template log<software_error>({__FILE__, __LINE__});
+            }
+        }
+        else
+        {
+            if (m_combStreams[ch].md[0].sem <= 0)
+            {
+                // Indicates that the server has cleaned up.
+                m_combRestart = true;
+                return;
+            }
+
+            // ETIMEDOUT and EINTR just mean we check the flags and wait more.
+            if (errno != ETIMEDOUT && errno != EINTR)
+            {
+                derivedT::template log<software_error>({__FILE__, __LINE__, errno, "sem_timedwait"});
+                m_combRestart = true;
+                return;
+            }
+        }
+    }
+}
+
+template <class derivedT, typename realT>
+int dm<derivedT, realT>::combOpen()
+{
+    m_combStreams.resize(m_channels);
+    m_combSems.resize(m_channels);
+
+    for (int n = 0; n < m_channels; ++n)
+    {
+        char nstr[16];
+        snprintf(nstr, sizeof(nstr), "%02d", n);
+        std::string shmimN = derived().m_shmimName + nstr;
+
+        std::string err;
+
+        if (ImageStreamIO_openIm(&m_combStreams[n], shmimN.c_str()) != 0)
+        {
+            m_combStreams.resize(n);
+            combClose();
+            derivedT::template log<text_log>("could not connect to channel " + shmimN, logPrio::LOG_WARNING);
+            return -1;
+        }
+
+        if (m_combStreams[n].md->size[0] != m_dmWidth)
+        {
+            err = "width mismatch between " + shmimN + " and configured DM";
+        }
+        else if (m_combStreams[n].md->size[1] != m_dmHeight)
+        {
+            err = "height mismatch between " + shmimN + " and configured DM";
+        }
+        else if (m_combStreams[n].md->datatype != m_dmDataType)
+        {
+            err = "data type mismatch between " + shmimN + " and configured DM";
+        }
+        else
+        {
+            int semNum = ImageStreamIO_getsemwaitindex(&m_combStreams[n], -1);
+            if (semNum < 0)
+            {
+                err = "no valid semaphore found for " + shmimN;
+            }
+            else
+            {
+                ImageStreamIO_semflush(&m_combStreams[n], semNum);
+                m_combSems[n] = m_combStreams[n].semptr[semNum];
+            }
+        }
+
+        if (err != "")
+        {
+            m_combStreams.resize(n + 1);
+            combClose();
+            derivedT::template log<text_log>(err, logPrio::LOG_ERROR);
+            return -1;
+        }
+    }
+
+    // The total is published to dmXXdisp for anything else watching the DM.  It is not fatal if this fails.
+    m_combDispOpen = (ImageStreamIO_openIm(&m_combDispStream, derived().m_shmimName.c_str()) == 0);
+    if (!m_combDispOpen)
+    {
+        derivedT::template log<text_log>("could not connect to " + derived().m_shmimName + ", the total will not be published", logPrio::LOG_WARNING);
+    }
+
+    std::lock_guard<std::mutex> lock(m_combMutex);
+
+    m_combSum.resize(m_channels, m_dmWidth * m_dmHeight);
+    m_combCnt0.assign(m_channels, 0);
+    m_combCopy.resize(m_dmWidth * m_dmHeight);
+    m_combUpdates.assign(m_channels, 0);
+    m_combCommands = 0;
+    m_combTimeSum = 0;
+    m_combTimeMax = 0;
+    m_combStatsTime = mx::sys::get_curr_time();
+
+    return 0;
+}
+
+template <class derivedT, typename realT>
+void dm<derivedT, realT>::combClose()
+{
+    for (size_t n = 0; n < m_combStreams.size(); ++n)
+    {
+        ImageStreamIO_closeIm(&m_combStreams[n]);
+    }
+    m_combStreams.clear();
+    m_combSems.clear();
+
+    if (m_combDispOpen)
+    {
+        ImageStreamIO_closeIm(&m_combDispStream);
+        m_combDispOpen = false;
+    }
+}
+
+template <class derivedT, typename realT>
+int dm<derivedT, realT>::combineChannels(bool all)
+{
+    double t0 = mx::sys::get_curr_time();
+
+    bool changed = false;
+
+    for (size_t ch = 0; ch < m_combStreams.size(); ++ch)
+    {
+        const volatile IMAGE_METADATA *md = m_combStreams[ch].md;
+
+        uint64_t cnt0 = md->cnt0;
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (!all && cnt0 == m_combCnt0[ch])
+            continue;
+
+        // The write flag and cnt0 form a seqlock.  A channel being written, or written during the copy, is skipped
+        // rather than summed torn.  Its writer posts the semaphore when done, and the channel is summed then.
+        if (md->write)
+            continue;
+
+        memcpy(m_combCopy.data(), m_combStreams[ch].array.raw, m_combCopy.size() * sizeof(realT));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (md->write || md->cnt0 != cnt0)
+            continue;
+
+        m_combSum.update(ch, m_combCopy.data());
+        m_combCnt0[ch] = cnt0;
+        ++m_combUpdates[ch];
+        changed = true;
+    }
+
+    // Another waiter already handled this update
+    if (!changed)
+        return 0;
+
+    int rv = sendCommand(const_cast<realT *>(m_combSum.total()));
+
+    double dt = mx::sys::get_curr_time() - t0;
+
+    ++m_combCommands;
+    m_combTimeSum += dt;
+    if (dt > m_combTimeMax)
+        m_combTimeMax = dt;
+
+    // Publish the total after the DM is commanded.  The semaphores are not posted, there being no need to wake
+    // shmimMonitor.
+    if (m_combDispOpen)
+    {
+        m_combDispStream.md->write = 1;
+        memcpy(m_combDispStream.array.raw, m_combSum.total(), m_dmWidth * m_dmHeight * sizeof(realT));
+        clock_gettime(CLOCK_REALTIME, &m_combDispStream.md->writetime);
+        m_combDispStream.md->atime = m_combDispStream.md->writetime;
+        m_combDispStream.md->cnt0++;
+        m_combDispStream.md->write = 0;
+    }
+
+    return rv;
+}
+
+template <class derivedT, typename realT>
+int dm<derivedT, realT>::combStats()
+{
+    std::vector<double> rates;
+    double cmdRate, latAvg, latMax;
+
+    {
+        std::lock_guard<std::mutex> lock(m_combMutex);
+
+        // Not combining yet, so there is no interval to average over
+        if (m_combStatsTime == 0)
+            return 0;
+
+        double tnow = mx::sys::get_curr_time();
+        double dt = tnow - m_combStatsTime;
+
+        rates.resize(m_combUpdates.size());
+        for (size_t n = 0; n < m_combUpdates.size(); ++n)
+        {
+            rates[n] = m_combUpdates[n] / dt;
+            m_combUpdates[n] = 0;
+        }
+
+        cmdRate = m_combCommands / dt;
+        latAvg = (m_combCommands > 0) ? m_combTimeSum / m_combCommands * 1e6 : 0;
+        latMax = m_combTimeMax * 1e6;
+
+        m_combCommands = 0;
+        m_combTimeSum = 0;
+        m_combTimeMax = 0;
+        m_combStatsTime = tnow;
+    }
+
+    if (!derived().m_indiDriver)
+        return 0;
+
+    std::vector<std::string> els = {"cmd_rate", "latency_avg", "latency_max"};
+    std::vector<double> vals = {cmdRate, latAvg, latMax};
+
+    for (size_t n = 0; n < rates.size(); ++n)
+    {
+        char nstr[16];
+        snprintf(nstr, sizeof(nstr), "ch%02d_rate", (int)n);
+        els.push_back(nstr);
+        vals.push_back(rates[n]);
+    }
+
+    // The channels are only known after allocation, so the property is (re)built when their number changes.
+    if (m_indiP_combine.getNumElements() != els.size())
+    {
+        // The INDI thread reads the properties and callbacks, so they are only changed while it is locked out.
+        std::lock_guard<std::mutex> lock(derived().m_indiMutex);
+
+        derived().m_indiDriver->sendDelProperty(m_indiP_combine);
+        derived().m_indiNewCallBacks.erase(m_indiP_combine.createUniqueKey());
+
+        m_indiP_combine = pcf::IndiProperty(pcf::IndiProperty::Number);
+        m_indiP_combine.setDevice(derived().configName());
+        m_indiP_combine.setName("dmcomb");
+        m_indiP_combine.setPerm(pcf::IndiProperty::ReadOnly);
+        m_indiP_combine.setState(pcf::IndiProperty::Idle);
+
+        for (size_t n = 0; n < els.size(); ++n)
+        {
+            m_indiP_combine.add(pcf::IndiElement(els[n]));
+        }
+
+        if (derived().registerIndiPropertyReadOnly(m_indiP_combine) < 0)
+        {
+            derivedT::template log<software_error>({__FILE__, __LINE__});
+            return -1;
+        }
+
+        derived().m_indiDriver->sendDefProperty(m_indiP_combine);
+    }
+
+    derived().updateIfChanged(m_indiP_combine, els, vals);
+
+    return 0;
+}
+
 template <class derivedT, typename realT>
 int dm<derivedT, realT>::updateINDI()
 {
@@ -0,0 +1,147 @@
+/** \file dmCombine.hpp
+ * \brief Incremental summation of the DM channels into the total displacement.
+ *
+ * \ingroup app_files
+ */
+
+#ifndef dmCombine_hpp
+#define dmCombine_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace MagAOX
+{
+namespace app
+{
+namespace dev
+{
+
+/// The running sum of the dmXXdispNN channels
+/** A copy of the last value of each channel is kept, so that when a channel changes the total is updated by
+ * subtracting the old value and adding the new one.  The cost of an update is then independent of the number of
+ * channels.  To bound the round-off which accumulates in the total, it is recomputed from the stored channels after
+ * every m_resumInterval updates.
+ *
+ * \ingroup appdev
+ */
+template <typename realT>
+class dmChannelSum
+{
+protected:
+    size_t m_nChannels{0}; ///< The number of channels
+    size_t m_nActs{0};     ///< The number of elements in each channel
+
+    std::vector<realT> m_last;  ///< The last value of each channel, m_nChannels*m_nActs
+    std::vector<realT> m_total; ///< The sum of the channels, m_nActs
+
+    uint32_t m_resumInterval{1024}; ///< The number of incremental updates between full sums
+    uint32_t m_sinceResum{0};       ///< The number of incremental updates since the last full sum
+
+public:
+    /// Size for the channels, and zero everything
+    void resize(size_t nChannels, ///< [in] the number of channels
+                size_t nActs      ///< [in] the number of elements in each channel
+    )
+    {
+        m_nChannels = nChannels;
+        m_nActs = nActs;
+        m_last.assign(nChannels * nActs, 0);
+        m_total.assign(nActs, 0);
+        m_sinceResum = 0;
+    }
+
+    /// Get the number of channels
+    size_t nChannels() const
+    {
+        return m_nChannels;
+    }
+
+    /// Get the number of elements in each channel
+    size_t nActs() const
+    {
+        return m_nActs;
+    }
+
+    /// Set the number of incremental updates between full sums.  0 means never.
+    void resumInterval(uint32_t ri /**< [in] the new interval*/)
+    {
+        m_resumInterval = ri;
+    }
+
+    /// Get the number of incremental updates between full sums
+    uint32_t resumInterval() const
+    {
+        return m_resumInterval;
+    }
+
+    /// Get the current total
+    const realT *total() const
+    {
+        return m_total.data();
+    }
+
+    /// Get the last value of a channel
+    const realT *channel(size_t ch /**< [in] the channel*/) const
+    {
+        return m_last.data() + ch * m_nActs;
+    }
+
+    /// Update a channel with its new value, and update the total
+    /** No bounds checking is done on ch.
+     */
+    void update(size_t ch,        ///< [in] the channel which changed
+                const realT *data ///< [in] the new value of the channel, m_nActs long
+    )
+    {
+        realT *last = m_last.data() + ch * m_nActs;
+        realT *total = m_total.data();
+        const size_t nActs = m_nActs;
+
+        #pragma omp simd
+        for (size_t k = 0; k < nActs; ++k)
+        {
+            realT v = data[k];
+            total[k] += v - last[k];
+            last[k] = v;
+        }
+
+        ++m_sinceResum;
+        if (m_resumInterval > 0 && m_sinceResum >= m_resumInterval)
+        {
+            resum();
+        }
+    }
+
+    /// Recompute the total from the stored channels
+    void resum()
+    {
+        realT *total = m_total.data();
+        const size_t nActs = m_nActs;
+
+        for (size_t k = 0; k < nActs; ++k)
+        {
+            total[k] = 0;
+        }
+
+        for (size_t ch = 0; ch < m_nChannels; ++ch)
+        {
+            const realT *last = m_last.data() + ch * nActs;
+
+            #pragma omp simd
+            for (size_t k = 0; k < nActs; ++k)
+            {
+                total[k] += last[k];
+            }
+        }
+
+        m_sinceResum = 0;
+    }
+};
+
+} // namespace dev
+} // namespace app
+} // namespace MagAOX
+
+#endif // dmCombine_hpp
@@ -0,0 +1,210 @@
+/** \file dmKernels.hpp
+ * \brief Conversion kernels from a DM shmim command to the vector sent to the DM electronics.
+ *
+ * \ingroup app_files
+ */
+
+#ifndef dmKernels_hpp
+#define dmKernels_hpp
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace MagAOX
+{
+namespace app
+{
+namespace dev
+{
+
+/// The index plan for gathering a DM command from the 2D shmim into the 1D vector of actuators.
+/** The actuator mapping used by the drivers gives, for each actuator in the command vector, its address in the
+ * shmim, or -1 if the actuator is addressable but not used.  The plan keeps the mapped actuators as two dense
+ * index lists, so the conversion kernels loop over them without checking for unmapped actuators.
+ *
+ * Build the plan once, whenever the mapping is loaded.
+ *
+ * \ingroup appdev
+ */
+struct dmCommandPlan
+{
+    uint32_t m_nbAct{0}; ///< The number of actuators in the command vector
+
+    std::vector<uint32_t> m_cmdIdx; ///< The index in the command vector of each mapped actuator
+
+    std::vector<uint32_t> m_srcIdx; ///< The address in the shmim of each mapped actuator
+
+    std::vector<uint32_t> m_unmapped; ///< The index in the command vector of each unmapped actuator
+
+    /// Build the plan from an actuator mapping
+    /**
+     * \returns 0 on success
+     * \returns -1 if an address is less than -1, in which case the plan is empty
+     */
+    int build( const int *mapping, ///< [in] the address in the shmim of each actuator, -1 if it is not used
+               uint32_t nbAct      ///< [in] the number of actuators, the length of mapping
+    )
+    {
+        clear();
+
+        m_cmdIdx.reserve(nbAct);
+        m_srcIdx.reserve(nbAct);
+
+        for (uint32_t idx = 0; idx < nbAct; ++idx)
+        {
+            if (mapping[idx] < -1)
+            {
+                clear();
+                return -1;
+            }
+
+            if (mapping[idx] == -1)
+            {
+                m_unmapped.push_back(idx);
+            }
+            else
+            {
+                m_cmdIdx.push_back(idx);
+                m_srcIdx.push_back(mapping[idx]);
+            }
+        }
+
+        m_nbAct = nbAct;
+
+        return 0;
+    }
+
+    /// Clear the plan
+    void clear()
+    {
+        m_nbAct = 0;
+        m_cmdIdx.clear();
+        m_srcIdx.clear();
+        m_unmapped.clear();
+    }
+
+    /// Get the number of mapped actuators
+    size_t nMapped() const
+    {
+        return m_cmdIdx.size();
+    }
+};
+
+/// Convert a command to squared fractional voltage, as used by the BMC DMs
+/** In one pass over the mapped actuators this gathers from the shmim, scales, clips to [0,1], takes the square root
+ * to approximate the voltage-displacement curve, counts the actuators which were clipped, and updates the
+ * instantaneous saturation map.  An actuator is flagged in the map if its output is 0 or 1.  Unmapped actuators are
+ * set to 0.
+ *
+ * \returns the number of actuators which were clipped
+ *
+ * \ingroup appdev
+ */
+template <typename outT, typename inT>
+uint32_t dmCommandSqrt( outT *out,                   ///< [out] the command vector, of length plan.m_nbAct
+                        const inT *in,               ///< [in] the shmim command
+                        const dmCommandPlan &plan,   ///< [in] the index plan
+                        outT scale,                  ///< [in] the scale from shmim units to fractional displacement
+                        uint8_t *satMap              ///< [out] the instantaneous saturation map, the size of the shmim
+)
+{
+    const uint32_t *cmdIdx = plan.m_cmdIdx.data();
+    const uint32_t *srcIdx = plan.m_srcIdx.data();
+    const size_t nMapped = plan.m_cmdIdx.size();
+
+    uint32_t nsat = 0;
+
+    #pragma omp simd reduction(+:nsat)
+    for (size_t k = 0; k < nMapped; ++k)
+    {
+        outT v = static_cast<outT>(in[srcIdx[k]]) * scale;
+
+        nsat += (v > 1) + (v < 0);
+        satMap[srcIdx[k]] = (v >= 1) | (v <= 0);
+
+        v = (v > 1) ? 1 : v;
+        v = (v < 0) ? 0 : v;
+
+        out[cmdIdx[k]] = std::sqrt(v);
+    }
+
+    for (size_t k = 0; k < plan.m_unmapped.size(); ++k)
+    {
+        out[plan.m_unmapped[k]] = 0;
+    }
+
+    return nsat;
+}
+
+/// Convert a command to mean-removed fractional stroke, as used by the ALPAO DMs
+/** The first pass over the mapped actuators gathers from the shmim, scales, and sums.  The second removes the mean
+ * over all actuators (unmapped actuators count as 0), clips to [-1,1], counts the actuators which were clipped, and
+ * updates the instantaneous saturation map.  An actuator is flagged in the map if its output is -1 or 1.  Unmapped
+ * actuators are set to minus the mean, and are clipped but not counted.
+ *
+ * \returns the number of mapped actuators which were clipped
+ *
+ * \ingroup appdev
+ */
+template <typename outT, typename inT>
+uint32_t dmCommandMeanClip( outT *out,                   ///< [out] the command vector, of length plan.m_nbAct
+                            const inT *in,               ///< [in] the shmim command
+                            const dmCommandPlan &plan,   ///< [in] the index plan
+                            outT scale,                  ///< [in] the scale from shmim units to fractional stroke
+                            uint8_t *satMap              ///< [out] the instantaneous saturation map, the size of the shmim
+)
+{
+    const uint32_t *cmdIdx = plan.m_cmdIdx.data();
+    const uint32_t *srcIdx = plan.m_srcIdx.data();
+    const size_t nMapped = plan.m_cmdIdx.size();
+
+    if (plan.m_nbAct == 0)
+    {
+        return 0;
+    }
+
+    outT mean = 0;
+
+    #pragma omp simd reduction(+:mean)
+    for (size_t k = 0; k < nMapped; ++k)
+    {
+        outT v = static_cast<outT>(in[srcIdx[k]]) * scale;
+        out[cmdIdx[k]] = v;
+        mean += v;
+    }
+
+    mean /= plan.m_nbAct;
+
+    uint32_t nsat = 0;
+
+    #pragma omp simd reduction(+:nsat)
+    for (size_t k = 0; k < nMapped; ++k)
+    {
+        outT v = out[cmdIdx[k]] - mean;
+
+        nsat += (v > 1) + (v < -1);
+        satMap[srcIdx[k]] = (v >= 1) | (v <= -1);
+
+        v = (v > 1) ? 1 : v;
+        v = (v < -1) ? -1 : v;
+
+        out[cmdIdx[k]] = v;
+    }
+
+    for (size_t k = 0; k < plan.m_unmapped.size(); ++k)
+    {
+        outT v = -mean;
+        v = (v > 1) ? 1 : v;
+        v = (v < -1) ? -1 : v;
+        out[plan.m_unmapped[k]] = v;
+    }
+
+    return nsat;
+}
+
+} // namespace dev
+} // namespace app
+} // namespace MagAOX
+
+#endif // dmKernels_hpp
@@ -0,0 +1,172 @@
+/** \file dmSatMask.hpp
+ * \brief Bit-packed saturation masks, handed off from the DM command thread to the saturation thread.
+ *
+ * \ingroup app_files
+ */
+
+#ifndef dmSatMask_hpp
+#define dmSatMask_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace MagAOX
+{
+namespace app
+{
+namespace dev
+{
+
+/// A lock-free ring of bit-packed saturation masks, from one producer to one consumer
+/** The DM command thread packs each instantaneous saturation map into the next free slot and publishes it, and the
+ * saturation thread accumulates every published mask in order.  Each slot is owned by exactly one side at a time,
+ * so the consumer never reads a partially written mask.  The producer never waits: if all slots are full the new
+ * mask is dropped and counted.
+ *
+ * Call resize() before either thread uses the ring.
+ *
+ * \ingroup appdev
+ */
+class dmSatMaskRing
+{
+  public:
+    static constexpr size_t depth{8}; ///< The number of masks which can be waiting for the consumer
+
+  protected:
+    size_t m_nbits{0};  ///< The number of actuators in each mask
+    size_t m_nwords{0}; ///< The number of 64-bit words in each mask
+
+    std::vector<uint64_t> m_masks; ///< The masks, depth*m_nwords words
+
+    alignas(64) std::atomic<uint64_t> m_head{0}; ///< The number of masks published by the producer
+    alignas(64) std::atomic<uint64_t> m_tail{0}; ///< The number of masks consumed by the consumer
+
+    std::atomic<uint64_t> m_dropped{0}; ///< The number of masks dropped because the ring was full
+
+  public:
+    /// Size the ring for a map, and empty it
+    void resize(size_t nbits /**< [in] the number of actuators in the map*/)
+    {
+        m_nbits = nbits;
+        m_nwords = (nbits + 63) / 64;
+        m_masks.assign(depth * m_nwords, 0);
+        m_head = 0;
+        m_tail = 0;
+        m_dropped = 0;
+    }
+
+    /// Get the number of actuators in each mask
+    size_t nbits() const
+    {
+        return m_nbits;
+    }
+
+    /// Get the number of masks dropped because the ring was full
+    uint64_t dropped() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+    /// Pack a 0/1 saturation map and publish it.  Producer only.
+    /**
+     * \returns true if the mask was published
+     * \returns false if the ring was full and the mask was dropped
+     */
+    bool push(const uint8_t *map /**< [in] the map, m_nbits bytes each 0 or 1 */)
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+
+        if (head - m_tail.load(std::memory_order_acquire) >= depth)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        pack(m_masks.data() + (head % depth) * m_nwords, map, m_nbits);
+
+        m_head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /// Add every published mask to an accumulated count map.  Consumer only.
+    /**
+     * \returns the number of masks accumulated
+     */
+    template <typename countT>
+    int accumulate(countT *accum /**< [in.out] the count for each actuator, m_nbits long */)
+    {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        uint64_t head = m_head.load(std::memory_order_acquire);
+
+        int n = 0;
+
+        for (; tail != head; ++tail, ++n)
+        {
+            const uint64_t *mask = m_masks.data() + (tail % depth) * m_nwords;
+
+            for (size_t w = 0; w < m_nwords; ++w)
+            {
+                uint64_t bits = mask[w];
+
+                // Visit only the set bits, so the cost follows the number of saturated actuators
+                while (bits)
+                {
+                    accum[w * 64 + __builtin_ctzll(bits)] += 1;
+                    bits &= bits - 1;
+                }
+            }
+
+            m_tail.store(tail + 1, std::memory_order_release);
+        }
+
+        return n;
+    }
+
+    /// Pack a 0/1 byte map into bits
+    /** Bit b of word w is map[64*w + b].  Bytes are taken 8 at a time and their low bits gathered with one
+     * multiply, which needs the bytes to be exactly 0 or 1.
+     */
+    static void pack(uint64_t *mask,      ///< [out] the packed mask, (nbits+63)/64 words
+                     const uint8_t *map,  ///< [in] the map, each byte 0 or 1
+                     size_t nbits         ///< [in] the length of map
+    )
+    {
+        size_t nwords = (nbits + 63) / 64;
+
+        for (size_t w = 0; w < nwords; ++w)
+        {
+            uint64_t bits = 0;
+
+            if (64 * w + 64 <= nbits)
+            {
+                for (size_t k = 0; k < 8; ++k)
+                {
+                    uint64_t x;
+                    __builtin_memcpy(&x, map + 64 * w + 8 * k, 8);
+
+                    // byte j (little endian) lands in bit 56+j, then shift down
+                    x &= 0x0101010101010101ULL;
+                    bits |= ((x * 0x0102040810204080ULL) >> 56) << (8 * k);
+                }
+            }
+            else
+            {
+                for (size_t b = 0; 64 * w + b < nbits; ++b)
+                {
+                    bits |= static_cast<uint64_t>(map[64 * w + b] & 1) << b;
+                }
+            }
+
+            mask[w] = bits;
+        }
+    }
+};
+
+} // namespace dev
+} // namespace app
+} // namespace MagAOX
+
+#endif // dmSatMask_hpp
@@ -19,6 +19,11 @@
 #include <ImageStreamIO/ImageStreamIO.h>
 
 #include "../../common/paths.hpp"
+#include "../../utils/latencyHistogram.hpp"
+#include "../../utils/runningStats.hpp"
+#include "../../ImageStreamIO/pixaccess.hpp"
+
+#include "frameKernels.hpp"
 
 
 namespace MagAOX
@@ -69,6 +74,11 @@ namespace dev
   * \endcode
   * which determines whether or not the images can be flipped programatically.
   *
+  * If the derived class loads images with `loadImageIntoStreamCopy`, uint16, int16, and float images are copied and
+  * flipped with the frameKernels, using non-temporal stores when the circular buffer is large.  These images can
+  * also be written to an optional second stream, flipped, cropped to a region, and dark subtracted, from the same
+  * read of the camera buffer.  See the "Fused Output" parameters.
+  *
   * Calls to this class's `setupConfig`, `loadConfig`, `appStartup`, `appLogic` and `appShutdown`
   * functions must be placed in the derived class's functions of the same name.
   *
@@ -94,9 +104,13 @@ protected:
        
    uint16_t m_latencyCircBuffMaxLength {3600}; ///< Maximum length of the latency measurement circular buffers
    float m_latencyCircBuffMaxTime {5}; ///< Maximum time of the latency meaurement circular buffers
+
+   float m_latencyHistInterval {5}; ///< Interval, in seconds, over which latency percentiles are calculated.  0 turns the histograms off.
    
    int m_defaultFlip {fgFlipNone};
    
+   size_t m_streamBytes {c_frameStreamBytes}; ///< Circular buffers of at least this many bytes are written with non-temporal stores.  0 turns them off.
+
    ///@}
    
    int m_currentFlip {fgFlipNone};
@@ -107,6 +121,8 @@ protected:
    uint8_t m_dataType{0}; ///< The ImageStreamIO type code.
    size_t m_typeSize {0}; ///< The size of the type, in bytes.  Result of sizeof.
    
+   bool m_streamStores {false}; ///< Whether loadImageIntoStreamCopy uses non-temporal stores, set on each configuration.
+   
    int m_xbinning {0}; ///< The x-binning according to the framegrabber
    int m_ybinning {0}; ///< The y-binning according to the framegrabber
    
@@ -119,25 +135,109 @@ protected:
    
    typedef uint16_t cbIndexT;
    
-   mx::sigproc::circularBufferIndex<timespec, cbIndexT> m_atimes;
-   mx::sigproc::circularBufferIndex<timespec, cbIndexT> m_wtimes;
-   
-   std::vector<double> m_atimesD;
-   std::vector<double> m_wtimesD;
-   std::vector<double> m_watimesD;
+   utils::runningStats<double> m_atimes;  ///< Running statistics of the acquisition interval, updated by the framegrabber thread
+   utils::runningStats<double> m_wtimes;  ///< Running statistics of the write interval, updated by the framegrabber thread
+   utils::runningStats<double> m_watimes; ///< Running statistics of write-minus-acquisition, updated by the framegrabber thread
+
+   utils::frameTimingStats m_fgTimings; ///< The timing statistics, published by the framegrabber thread.  Protected by m_timingsMutex.
+
+   std::mutex m_timingsMutex; ///< Mutex protecting m_fgTimings.
+
+   bool m_timingsValid {false}; ///< Whether m_mna etc. are valid.  Copied from m_fgTimings by appLogic.
    
    timespec m_dummy_ts {0,0};
    uint64_t m_dummy_cnt {0};
    char m_dummy_c {0};
    
-   double m_mna;
-   double m_vara;  
+   //The timing statistics as last copied from m_fgTimings by appLogic, for updateINDI and recordFGTimings.
+   double m_mna {0};
+   double m_vara {0};
          
-   double m_mnw;   
-   double m_varw;  
+   double m_mnw {0};
+   double m_varw {0};
          
-   double m_mnwa;  
-   double m_varwa; 
+   double m_mnwa {0};
+   double m_varwa {0};
+   
+   /** \name Latency Histograms
+     * The framegrabber thread records the acquisition interval, the write interval, and the write-minus-acquisition
+     * delay of every frame in lock-free histograms.  The histogram thread calculates their percentiles every
+     * m_latencyHistInterval seconds, starting a new interval each time, and the results are published by
+     * updateINDI and recordFGTimings.
+     * @{
+     */
+
+   utils::latencyHistogram m_acqHist; ///< Histogram of the acquisition time deltas
+   utils::latencyHistogram m_writeHist; ///< Histogram of the write time deltas
+   utils::latencyHistogram m_awHist; ///< Histogram of the write minus acquisition times
+
+   utils::latencyStats m_acqStats; ///< Percentiles of m_acqHist over the last interval.  Protected by m_histMutex.
+   utils::latencyStats m_writeStats; ///< Percentiles of m_writeHist over the last interval.  Protected by m_histMutex.
+   utils::latencyStats m_awStats; ///< Percentiles of m_awHist over the last interval.  Protected by m_histMutex.
+
+   uint64_t m_histSeq {0}; ///< Incremented each time the percentiles are updated.  Protected by m_histMutex.
+
+   std::mutex m_histMutex; ///< Mutex protecting the percentile statistics.
+
+   std::atomic<bool> m_histResetRequest {false}; ///< Set to request that the histogram thread start a new interval.
+
+   std::thread m_histThread; ///< The histogram thread
+
+   /// Execute the histogram thread
+   void histThreadExec();
+
+   ///@}
+   
+   /** \name Fused Output
+     * Optionally, each uint16, int16, or float frame loaded with loadImageIntoStreamCopy is also written to a second,
+     * float, stream, flipped, cropped to a region, and with a dark subtracted.  This is done from the same read of
+     * the camera buffer as the main stream, so consumers which want the processed region do not each make another
+     * pass over the full frame.  The region is specified in the flipped frame.  The dark is read from a stream the
+     * size of the region, and is reloaded whenever that stream is updated.
+     * @{
+     */
+
+   std::string m_fusedShmimName; ///< The name of the fused output stream.  Not used if empty, the default.
+   uint32_t m_fusedX0 {0}; ///< The first column of the region, in the flipped frame.
+   uint32_t m_fusedY0 {0}; ///< The first row of the region, in the flipped frame.
+   uint32_t m_fusedWidth {0}; ///< The width of the region.  0, the default, means the rest of the frame.
+   uint32_t m_fusedHeight {0}; ///< The height of the region.  0, the default, means the rest of the frame.
+   std::string m_fusedDarkName; ///< The name of the stream holding the dark.  Not used if empty, the default.
+
+   IMAGE * m_fusedStream {nullptr}; ///< The fused output stream, nullptr when not in use.
+   uint32_t m_fusedW {0}; ///< The width of the region, after clipping to the frame.
+   uint32_t m_fusedH {0}; ///< The height of the region, after clipping to the frame.
+   bool m_fusedLoaded {false}; ///< Set by loadImageIntoStreamCopy when the fused stream has a new frame to post.
+
+   IMAGE m_fusedDarkStream; ///< The dark stream, when m_fusedDarkOpen is true.
+   bool m_fusedDarkOpen {false}; ///< Whether the dark stream is open.
+   uint64_t m_fusedDarkCnt0 {0}; ///< The cnt0 of the dark stream when the dark was last loaded.
+   std::vector<float> m_fusedDark; ///< The dark, empty if there is none.
+
+   /// Create the fused output stream, if configured, and open the dark stream.
+   /** Called by the framegrabber thread after each configuration.
+     *
+     * \returns 0 on success, or if there is no fused output.
+     * \returns -1 on error, which is logged, in which case there is no fused output.
+     */
+   int fusedSetup();
+
+   /// Reload the dark if its stream has been updated.
+   void fusedDarkUpdate();
+
+   /// Write the fused output for a frame, without posting it.
+   void fusedLoad( void * src,    ///< [in] the camera frame
+                   size_t width,  ///< [in] the width of the camera frame
+                   size_t height  ///< [in] the height of the camera frame
+                 );
+
+   /// Post the fused output, if a frame was loaded.
+   void fusedPost();
+
+   /// Destroy the fused output stream and close the dark stream.
+   void fusedDestroy();
+
+   ///@}
    
    
    
@@ -201,6 +301,12 @@ public:
      */
    int onPowerOff();
    
+   /// Request a new latency histogram interval
+   /** The histogram thread discards the values recorded so far in the current interval, and the next percentiles
+     * published cover only the values recorded after this call.
+     */
+   void resetLatencyHistograms();
+
    /// Shuts down the framegrabber thread
    /** This should be called in `derivedT::appShutdown` as
      * \code
@@ -258,6 +364,8 @@ protected:
    pcf::IndiProperty m_indiP_frameSize; ///< Property used to report the current frame size
 
    pcf::IndiProperty m_indiP_timing;
+
+   pcf::IndiProperty m_indiP_latency; ///< Property used to report the latency percentiles
 public:
 
    /// Update the INDI properties for this device controller
@@ -301,6 +409,22 @@ void frameGrabber<derivedT>::setupConfig(mx::app::appConfigurator & config)
 
    config.add("framegrabber.latencySize", "", "framegrabber.latencySize", argType::Required, "framegrabber", "latencySize", false, "float", "The maximum length of the buffer used to measure latency timings. Sets  m_latencyCircBuffMaxLength, default is 3600.");
 
+   config.add("framegrabber.latencyHistInterval", "", "framegrabber.latencyHistInterval", argType::Required, "framegrabber", "latencyHistInterval", false, "float", "The interval in seconds over which latency percentiles are calculated.  0 turns the latency histograms off. Sets m_latencyHistInterval, default is 5.");
+
+   config.add("framegrabber.streamBytes", "", "framegrabber.streamBytes", argType::Required, "framegrabber", "streamBytes", false, "size_t", "Circular buffers of at least this many bytes are written with non-temporal stores, for frames of at least 256 kB.  0 turns them off.  Sets m_streamBytes, default is 8 MiB.");
+
+   config.add("framegrabber.fusedShmimName", "", "framegrabber.fusedShmimName", argType::Required, "framegrabber", "fusedShmimName", false, "string", "The name of the fused output stream, a flipped, cropped, and dark subtracted float copy of each frame.  Not used if empty, the default.");
+
+   config.add("framegrabber.fusedX0", "", "framegrabber.fusedX0", argType::Required, "framegrabber", "fusedX0", false, "int", "The first column of the fused output region, in the flipped frame.  Default is 0.");
+
+   config.add("framegrabber.fusedY0", "", "framegrabber.fusedY0", argType::Required, "framegrabber", "fusedY0", false, "int", "The first row of the fused output region, in the flipped frame.  Default is 0.");
+
+   config.add("framegrabber.fusedWidth", "", "framegrabber.fusedWidth", argType::Required, "framegrabber", "fusedWidth", false, "int", "The width of the fused output region.  Default is 0, the rest of the frame.");
+
+   config.add("framegrabber.fusedHeight", "", "framegrabber.fusedHeight", argType::Required, "framegrabber", "fusedHeight", false, "int", "The height of the fused output region.  Default is 0, the rest of the frame.");
+
+   config.add("framegrabber.fusedDarkName", "", "framegrabber.fusedDarkName", argType::Required, "framegrabber", "fusedDarkName", false, "string", "The name of the stream holding the dark to subtract from the fused output, which must be the size of the region.  Not used if empty, the default.");
+
 
    if(derivedT::c_frameGrabber_flippable)
    {
@@ -332,6 +456,18 @@ void frameGrabber<derivedT>::loadConfig(mx::app::appConfigurator & config)
    }
 
    config(m_latencyCircBuffMaxLength, "framegrabber.latencySize");
+
+   config(m_latencyHistInterval, "framegrabber.latencyHistInterval");
+   if(m_latencyHistInterval < 0) m_latencyHistInterval = 0;
+   
+   config(m_streamBytes, "framegrabber.streamBytes");
+
+   config(m_fusedShmimName, "framegrabber.fusedShmimName");
+   config(m_fusedX0, "framegrabber.fusedX0");
+   config(m_fusedY0, "framegrabber.fusedY0");
+   config(m_fusedWidth, "framegrabber.fusedWidth");
+   config(m_fusedHeight, "framegrabber.fusedHeight");
+   config(m_fusedDarkName, "framegrabber.fusedDarkName");
    
 
    if(derivedT::c_frameGrabber_flippable)
@@ -419,6 +555,38 @@ int frameGrabber<derivedT>::appStartup()
       return -1;
    }
 
+   //Register the latency percentiles INDI property
+   derived().createROIndiNumber( m_indiP_latency, "fg_latency");
+   for(const char * h : {"acq", "write", "delta_aw"})
+   {
+      for(const char * p : {"_p50", "_p99", "_p999", "_max"})
+      {
+         m_indiP_latency.add(pcf::IndiElement(std::string(h) + p));
+      }
+   }
+
+   if( derived().registerIndiPropertyReadOnly( m_indiP_latency ) < 0)
+   {
+      #ifndef STDCAMERA_TEST_NOLOG
+      derivedT::template log<software_error>({__FILE__,__LINE__});
+      #endif
+      return -1;
+   }
+
+   //Start the histogram thread.  This is not real-time, and only wakes up a few times a second.
+   if(m_latencyHistInterval > 0)
+   {
+      try
+      {
+         m_histThread = std::thread(&frameGrabber<derivedT>::histThreadExec, this);
+      }
+      catch(const std::exception & e)
+      {
+         derivedT::template log<software_error>({__FILE__,__LINE__, std::string("exception starting histogram thread: ") + e.what()});
+         return -1;
+      }
+   }
+
    //Start the f.g. thread
    if(derived().threadStart( m_fgThread, m_fgThreadInit, m_fgThreadID, m_fgThreadProp, m_fgThreadPrio, m_fgCpuset, "framegrabber", this, fgThreadStart) < 0)
    {
@@ -441,49 +609,23 @@ int frameGrabber<derivedT>::appLogic()
       return -1;
    }
    
-   if( derived().state() == stateCodes::OPERATING && m_atimes.size() > 0 )
+   //The timing statistics are updated by the framegrabber thread for each frame
+   utils::frameTimingStats fgt;
    {
-      if(m_atimes.size() >= m_atimes.maxEntries())
-      {
-         cbIndexT refEntry = m_atimes.earliest();
-         
-         m_atimesD.resize(m_atimes.maxEntries()-1);
-         m_wtimesD.resize(m_wtimes.maxEntries()-1);
-         m_watimesD.resize(m_wtimes.maxEntries()-1);
-         
-         double a0 = m_atimes.at(refEntry, 0).tv_sec + ((double) m_atimes.at(refEntry, 0).tv_nsec)/1e9;
-         double w0 = m_wtimes.at(refEntry, 0).tv_sec + ((double) m_wtimes.at(refEntry, 0).tv_nsec)/1e9;
-         for(size_t n=1; n <= m_atimesD.size(); ++n)
-         {
-            double a = m_atimes.at(refEntry, n).tv_sec + ((double) m_atimes.at(refEntry, n).tv_nsec)/1e9;
-            double w = m_wtimes.at(refEntry, n).tv_sec + ((double) m_wtimes.at(refEntry, n).tv_nsec)/1e9;
-            m_atimesD[n-1] = a - a0;
-            m_wtimesD[n-1] = w - w0;
-            m_watimesD[n-1] = w - a;
-            a0 = a;
-            w0 = w;
-         }
-         
-         m_mna = mx::math::vectorMean(m_atimesD);
-         m_vara = mx::math::vectorVariance(m_atimesD, m_mna);
-         
-         m_mnw = mx::math::vectorMean(m_wtimesD);
-         m_varw = mx::math::vectorVariance(m_wtimesD, m_mnw);
-         
-         m_mnwa = mx::math::vectorMean(m_watimesD);
-         m_varwa = mx::math::vectorVariance(m_watimesD, m_mnwa);
-         
-         recordFGTimings();
-      }
-      else
-      {
-         m_mna = 0;
-         m_vara = 0;
-         m_mnw = 0;
-         m_varw = 0;
-         m_mnwa = 0;
-         m_varwa = 0;
-      }
+      std::lock_guard<std::mutex> lock(m_timingsMutex);
+      fgt = m_fgTimings;
+   }
+
+   m_timingsValid = fgt.valid;
+
+   if( derived().state() == stateCodes::OPERATING && m_timingsValid )
+   {
+      m_mna = fgt.mna;
+      m_vara = fgt.vara;
+      m_mnw = fgt.mnw;
+      m_varw = fgt.varw;
+      m_mnwa = fgt.mnwa;
+      m_varwa = fgt.varwa;
    }
    else
    {
@@ -495,6 +637,13 @@ int frameGrabber<derivedT>::appLogic()
       m_varwa = 0;
    }
 
+   //Record timings once the timing statistics are full, or whenever the latency percentiles are being calculated.
+   //recordFGTimings only records if something has changed.
+   if( derived().state() == stateCodes::OPERATING && ( m_timingsValid || m_latencyHistInterval > 0) )
+   {
+      recordFGTimings();
+   }
+
    return 0;
 
 }
@@ -509,6 +658,14 @@ int frameGrabber<derivedT>::onPowerOff()
    m_mnwa = 0;
    m_varwa = 0;
 
+   {
+      std::lock_guard<std::mutex> lock(m_histMutex);
+      m_acqStats = utils::latencyStats();
+      m_writeStats = utils::latencyStats();
+      m_awStats = utils::latencyStats();
+   }
+   resetLatencyHistograms();
+
    m_width = 0;
    m_height = 0;
 
@@ -521,6 +678,12 @@ int frameGrabber<derivedT>::onPowerOff()
 }
    
 
+template<class derivedT>
+void frameGrabber<derivedT>::resetLatencyHistograms()
+{
+   m_histResetRequest = true;
+}
+
 template<class derivedT>
 int frameGrabber<derivedT>::appShutdown()
 {
@@ -534,6 +697,17 @@ int frameGrabber<derivedT>::appShutdown()
       {
       }
    }
+
+   if(m_histThread.joinable())
+   {
+      try
+      {
+         m_histThread.join(); //this will throw if it was already joined
+      }
+      catch(...)
+      {
+      }
+   }
    
    
    
@@ -580,23 +754,33 @@ void frameGrabber<derivedT>::fgThreadExec()
          //At the end of this, must have m_width, m_height, m_dataType set, and derived()->fps must be valid.
          if(derived().configureAcquisition() < 0) continue;        
          
+         {
+            std::lock_guard<std::mutex> lock(m_timingsMutex);
+            m_fgTimings.valid = false;
+         }
+
          if(m_latencyCircBuffMaxLength == 0 || m_latencyCircBuffMaxTime == 0)
          {
-            m_atimes.maxEntries(0);
-            m_wtimes.maxEntries(0);
+            m_atimes.windows(std::vector<size_t>());
+            m_wtimes.windows(std::vector<size_t>());
+            m_watimes.windows(std::vector<size_t>());
          }
          else 
          {
-            //Set up the latency circ. buffs
+            //Set up the timing statistics, over the intervals between cbSz frames
             cbIndexT cbSz = m_latencyCircBuffMaxTime * derived().fps();
             if(cbSz > m_latencyCircBuffMaxLength) cbSz = m_latencyCircBuffMaxLength;
             if(cbSz < 3) cbSz = 3; //Make variance meaningful
-            m_atimes.maxEntries(cbSz);
-            m_wtimes.maxEntries(cbSz);
+            m_atimes.windows(cbSz-1);
+            m_wtimes.windows(cbSz-1);
+            m_watimes.windows(cbSz-1);
          }
             
          m_typeSize = ImageStreamIO_typesize(m_dataType);
          
+         //Each frame goes to the next slot of the circular buffer, which is cold if the buffer does not fit in cache
+         size_t frameBytes = ((size_t) m_width) * m_height * m_typeSize;
+         m_streamStores = (m_streamBytes > 0 && frameBytes >= c_frameStreamMinBytes && frameBytes * m_circBuffLength >= m_streamBytes);
 
          //Here we resolve currentFlip somehow.
          m_currentFlip = m_defaultFlip;
@@ -632,6 +816,8 @@ void frameGrabber<derivedT>::fgThreadExec()
          std::cerr << "Not creating . . .\n";
       }
      
+      fusedSetup();
+
       //This completes the reconfiguration.
       m_reconfig = false;
                   
@@ -642,6 +828,17 @@ void frameGrabber<derivedT>::fgThreadExec()
       timespec * next_wtimearr = &m_imageStream->writetimearray[0];
       timespec * next_atimearr = &m_imageStream->atimearray[0];
       uint64_t * next_cntarr = &m_imageStream->cntarray[0];
+
+      //The previous frame's times, for the latency histograms
+      timespec last_atime {0,0};
+      timespec last_wtime {0,0};
+      bool haveLast = false;
+      bool recordHist = (m_latencyHistInterval > 0);
+
+      //The previous frame's times, for the timing statistics
+      timespec stats_atime {0,0};
+      timespec stats_wtime {0,0};
+      bool haveStats = false;
       
       //This is the main image grabbing loop.      
       while(!derived().shutdown() && !m_reconfig && derived().powerState() > 0)
@@ -693,11 +890,55 @@ void frameGrabber<derivedT>::fgThreadExec()
          m_imageStream->md->write=0;
          ImageStreamIO_sempost(m_imageStream,-1);
  
-         //Update the latency circ. buffs
-         if(m_atimes.maxEntries()  >  0)
+         fusedPost();
+
+         //Update the timing statistics
+         if(m_atimes.nWindows() > 0)
          {
-            m_atimes.nextEntry(m_imageStream->md->atime);
-            m_wtimes.nextEntry(m_imageStream->md->writetime);
+            const timespec & at = m_imageStream->md->atime;
+            const timespec & wt = m_imageStream->md->writetime;
+
+            if(haveStats)
+            {
+               m_atimes.add( (at.tv_sec - stats_atime.tv_sec) + ((double) (at.tv_nsec - stats_atime.tv_nsec))/1e9 );
+               m_wtimes.add( (wt.tv_sec - stats_wtime.tv_sec) + ((double) (wt.tv_nsec - stats_wtime.tv_nsec))/1e9 );
+               m_watimes.add( (wt.tv_sec - at.tv_sec) + ((double) (wt.tv_nsec - at.tv_nsec))/1e9 );
+
+               //Publish for appLogic.  If it holds the lock, the next frame publishes instead of this thread waiting.
+               if(m_atimes.full(0))
+               {
+                  std::unique_lock<std::mutex> lock(m_timingsMutex, std::try_to_lock);
+                  if(lock.owns_lock())
+                  {
+                     m_fgTimings.mna = m_atimes.mean(0);
+                     m_fgTimings.vara = m_atimes.variance(0);
+                     m_fgTimings.mnw = m_wtimes.mean(0);
+                     m_fgTimings.varw = m_wtimes.variance(0);
+                     m_fgTimings.mnwa = m_watimes.mean(0);
+                     m_fgTimings.varwa = m_watimes.variance(0);
+                     m_fgTimings.valid = true;
+                  }
+               }
+            }
+
+            stats_atime = at;
+            stats_wtime = wt;
+            haveStats = true;
+         }
+
+         //And the latency histograms
+         if(recordHist)
+         {
+            if(haveLast)
+            {
+               m_acqHist.record(m_currImageTimestamp, last_atime);
+               m_writeHist.record(m_imageStream->md->writetime, last_wtime);
+            }
+            m_awHist.record(m_imageStream->md->writetime, m_currImageTimestamp);
+
+            last_atime = m_currImageTimestamp;
+            last_wtime = m_imageStream->md->writetime;
+            haveLast = true;
          }
          
          //Now we increment pointers outside the time-critical part of the loop.
@@ -728,6 +969,45 @@ void frameGrabber<derivedT>::fgThreadExec()
       free(m_imageStream);
       m_imageStream = nullptr;
    }
+
+   fusedDestroy();
+}
+
+template<class derivedT>
+void frameGrabber<derivedT>::histThreadExec()
+{
+   timespec last;
+   clock_gettime(CLOCK_MONOTONIC, &last);
+
+   while(derived().shutdown() == 0)
+   {
+      mx::sys::milliSleep(100);
+
+      if(m_histResetRequest.exchange(false))
+      {
+         m_acqHist.reset();
+         m_writeHist.reset();
+         m_awHist.reset();
+         clock_gettime(CLOCK_MONOTONIC, &last);
+         continue;
+      }
+
+      timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if( (now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec)/1e9 < m_latencyHistInterval) continue;
+      last = now;
+
+      utils::latencyStats acq, write, aw;
+      m_acqHist.stats(acq, true);
+      m_writeHist.stats(write, true);
+      m_awHist.stats(aw, true);
+
+      std::lock_guard<std::mutex> lock(m_histMutex);
+      m_acqStats = acq;
+      m_writeStats = write;
+      m_awStats = aw;
+      ++m_histSeq;
+   }
 }
 
 template<class derivedT>
@@ -738,29 +1018,261 @@ void * frameGrabber<derivedT>::loadImageIntoStreamCopy( void * dest,
                                                         size_t szof
                                                       )
 {
-   if(!derivedT::c_frameGrabber_flippable)
+   bool flipUD = false;
+   bool flipLR = false;
+   
+   if(derivedT::c_frameGrabber_flippable)
+   {
+      flipUD = (m_currentFlip == fgFlipUD || m_currentFlip == fgFlipUDLR);
+      flipLR = (m_currentFlip == fgFlipLR || m_currentFlip == fgFlipUDLR);
+   }
+
+   void * rv = nullptr;
+   
+   if(szof == m_typeSize && m_dataType == _DATATYPE_UINT16)
+   {
+      flipCopy( (uint16_t *) dest, (const uint16_t *) src, width, height, flipUD, flipLR, m_streamStores);
+      rv = dest;
+   }
+   else if(szof == m_typeSize && m_dataType == _DATATYPE_INT16)
    {
-      return memcpy(dest, src, width*height*szof);
+      flipCopy( (int16_t *) dest, (const int16_t *) src, width, height, flipUD, flipLR, m_streamStores);
+      rv = dest;
+   }
+   else if(szof == m_typeSize && m_dataType == _DATATYPE_FLOAT)
+   {
+      flipCopy( (float *) dest, (const float *) src, width, height, flipUD, flipLR, m_streamStores);
+      rv = dest;
+   }
+   else if(!derivedT::c_frameGrabber_flippable)
+   {
+      rv = memcpy(dest, src, width*height*szof);
    }
    else
    {
       switch(m_currentFlip)
       {
          case fgFlipNone:
-            return mx::improc::imcpy(dest, src, width, height, szof);
+            rv = mx::improc::imcpy(dest, src, width, height, szof);
+            break;
          case fgFlipUD:
-            return mx::improc::imcpy_flipUD(dest, src, width, height, szof);
+            rv = mx::improc::imcpy_flipUD(dest, src, width, height, szof);
+            break;
          case fgFlipLR:
-            return mx::improc::imcpy_flipLR(dest, src, width, height, szof);  
+            rv = mx::improc::imcpy_flipLR(dest, src, width, height, szof);  
+            break;
          case fgFlipUDLR:
-            return mx::improc::imcpy_flipUDLR(dest, src, width, height, szof);
+            rv = mx::improc::imcpy_flipUDLR(dest, src, width, height, szof);
+            break;
          default:
             return nullptr;
       }
    }
+
+   if(m_fusedStream != nullptr)
+   {
+      fusedLoad(src, width, height);
+   }
+
+   return rv;
+}
+
+template<class derivedT>
+int frameGrabber<derivedT>::fusedSetup()
+{
+   if(m_fusedShmimName == "")
+   {
+      fusedDestroy();
+      return 0;
+   }
+
+   if(m_dataType != _DATATYPE_UINT16 && m_dataType != _DATATYPE_INT16 && m_dataType != _DATATYPE_FLOAT)
+   {
+      fusedDestroy();
+      derivedT::template log<text_log>("fused output is only supported for uint16, int16, and float images", logPrio::LOG_ERROR);
+      return -1;
+   }
+
+   if(m_fusedX0 >= m_width || m_fusedY0 >= m_height)
+   {
+      fusedDestroy();
+      derivedT::template log<text_log>("fused output region is outside the frame", logPrio::LOG_ERROR);
+      return -1;
+   }
+
+   uint32_t w = m_fusedWidth;
+   if(w == 0 || m_fusedX0 + w > m_width) w = m_width - m_fusedX0;
+
+   uint32_t h = m_fusedHeight;
+   if(h == 0 || m_fusedY0 + h > m_height) h = m_height - m_fusedY0;
+
+   if(m_fusedStream == nullptr || w != m_fusedW || h != m_fusedH)
+   {
+      fusedDestroy();
+
+      m_fusedStream = (IMAGE *) malloc(sizeof(IMAGE));
+
+      uint32_t imsize[3] = {w, h, 1};
+
+      if(ImageStreamIO_createIm_gpu(m_fusedStream, m_fusedShmimName.c_str(), 3, imsize, _DATATYPE_FLOAT, -1, 1, IMAGE_NB_SEMAPHORE, 0, CIRCULAR_BUFFER | ZAXIS_TEMPORAL, 0) != 0)
+      {
+         free(m_fusedStream);
+         m_fusedStream = nullptr;
+         derivedT::template log<text_log>("could not create fused output stream " + m_fusedShmimName, logPrio::LOG_ERROR);
+         return -1;
+      }
+
+      m_fusedW = w;
+      m_fusedH = h;
+   }
+
+   //In case acquisition stopped between loading and posting a frame
+   m_fusedStream->md->write=0;
+   m_fusedLoaded = false;
+
+   if(m_fusedDarkOpen)
+   {
+      ImageStreamIO_closeIm(&m_fusedDarkStream);
+      m_fusedDarkOpen = false;
+   }
+   m_fusedDark.clear();
+
+   if(m_fusedDarkName != "")
+   {
+      if(ImageStreamIO_openIm(&m_fusedDarkStream, m_fusedDarkName.c_str()) != 0)
+      {
+         derivedT::template log<text_log>("could not connect to fused output dark " + m_fusedDarkName, logPrio::LOG_WARNING);
+      }
+      else
+      {
+         m_fusedDarkOpen = true;
+         m_fusedDarkCnt0 = m_fusedDarkStream.md->cnt0 - 1; //so it is loaded now
+         m_fusedDark.reserve(m_fusedW*m_fusedH);
+         fusedDarkUpdate();
+      }
+   }
+
+   return 0;
+}
+
+template<class derivedT>
+void frameGrabber<derivedT>::fusedDarkUpdate()
+{
+   if(!m_fusedDarkOpen) return;
+
+   uint64_t cnt0 = m_fusedDarkStream.md->cnt0;
+   if(cnt0 == m_fusedDarkCnt0) return;
+   m_fusedDarkCnt0 = cnt0;
+
+   if(m_fusedDarkStream.md->size[0] != m_fusedW || m_fusedDarkStream.md->size[1] != m_fusedH)
+   {
+      m_fusedDark.clear();
+      derivedT::template log<text_log>("fused output dark " + m_fusedDarkName + " is not the size of the region", logPrio::LOG_WARNING);
+      return;
+   }
+
+   void (*pixcopy)(float *, void *, size_t) = getPixelsPointer<float>(m_fusedDarkStream.md->datatype);
+   if(pixcopy == nullptr)
+   {
+      m_fusedDark.clear();
+      derivedT::template log<text_log>("fused output dark " + m_fusedDarkName + " has an unsupported type", logPrio::LOG_WARNING);
+      return;
+   }
+
+   size_t slot = 0;
+   if(m_fusedDarkStream.md->naxis > 2 && m_fusedDarkStream.md->size[2] > 1)
+   {
+      slot = m_fusedDarkStream.md->cnt1;
+   }
+
+   m_fusedDark.resize(m_fusedW*m_fusedH);
+   pixcopy(m_fusedDark.data(), (char *) m_fusedDarkStream.array.raw + slot*m_fusedW*m_fusedH*ImageStreamIO_typesize(m_fusedDarkStream.md->datatype), m_fusedDark.size());
+}
+
+template<class derivedT>
+void frameGrabber<derivedT>::fusedLoad( void * src,
+                                        size_t width,
+                                        size_t height
+                                      )
+{
+   if(m_fusedX0 + m_fusedW > width || m_fusedY0 + m_fusedH > height) return;
+
+   fusedDarkUpdate();
+
+   bool flipUD = false;
+   bool flipLR = false;
+   
+   if(derivedT::c_frameGrabber_flippable)
+   {
+      flipUD = (m_currentFlip == fgFlipUD || m_currentFlip == fgFlipUDLR);
+      flipLR = (m_currentFlip == fgFlipLR || m_currentFlip == fgFlipUDLR);
+   }
+
+   const float * dark = (m_fusedDark.size() > 0) ? m_fusedDark.data() : nullptr;
+
+   m_fusedStream->md->write=1;
+
+   switch(m_dataType)
+   {
+      case _DATATYPE_UINT16:
+         flipCropDark(m_fusedStream->array.F, (const uint16_t *) src, width, height, flipUD, flipLR, m_fusedX0, m_fusedY0, m_fusedW, m_fusedH, dark);
+         break;
+      case _DATATYPE_INT16:
+         flipCropDark(m_fusedStream->array.F, (const int16_t *) src, width, height, flipUD, flipLR, m_fusedX0, m_fusedY0, m_fusedW, m_fusedH, dark);
+         break;
+      case _DATATYPE_FLOAT:
+         flipCropDark(m_fusedStream->array.F, (const float *) src, width, height, flipUD, flipLR, m_fusedX0, m_fusedY0, m_fusedW, m_fusedH, dark);
+         break;
+      default:
+         m_fusedStream->md->write=0;
+         return;
+   }
+
+   m_fusedLoaded = true;
 }
 
+template<class derivedT>
+void frameGrabber<derivedT>::fusedPost()
+{
+   if(!m_fusedLoaded) return;
+
+   //The fused output carries the times and frame count of the main stream, so consumers can match them
+   m_fusedStream->md->writetime = m_imageStream->md->writetime;
+   m_fusedStream->md->atime = m_imageStream->md->atime;
+   m_fusedStream->md->cnt1 = 0;
+   m_fusedStream->md->cnt0 = m_imageStream->md->cnt0;
+
+   m_fusedStream->writetimearray[0] = m_fusedStream->md->writetime;
+   m_fusedStream->atimearray[0] = m_fusedStream->md->atime;
+   m_fusedStream->cntarray[0] = m_fusedStream->md->cnt0;
 
+   m_fusedStream->md->write=0;
+   ImageStreamIO_sempost(m_fusedStream,-1);
+
+   m_fusedLoaded = false;
+}
+
+template<class derivedT>
+void frameGrabber<derivedT>::fusedDestroy()
+{
+   if(m_fusedDarkOpen)
+   {
+      ImageStreamIO_closeIm(&m_fusedDarkStream);
+      m_fusedDarkOpen = false;
+   }
+   m_fusedDark.clear();
+
+   if(m_fusedStream != nullptr)
+   {
+      ImageStreamIO_destroyIm(m_fusedStream);
+      free(m_fusedStream);
+      m_fusedStream = nullptr;
+   }
+
+   m_fusedW = 0;
+   m_fusedH = 0;
+   m_fusedLoaded = false;
+}
 
 template<class derivedT>
 int frameGrabber<derivedT>::updateINDI()
@@ -778,6 +1290,24 @@ int frameGrabber<derivedT>::updateINDI()
 
    indi::updateIfChanged<double>(m_indiP_timing, {"acq_fps","acq_jitter","write_fps","write_jitter","delta_aw","delta_aw_jitter"}, 
                         {fpsa, sqrt(m_vara), fpsw, sqrt(m_varw), m_mnwa, sqrt(m_varwa)},derived().m_indiDriver);
+
+   if(m_latencyHistInterval > 0)
+   {
+      utils::latencyStats acq, write, aw;
+      {
+         std::lock_guard<std::mutex> lock(m_histMutex);
+         acq = m_acqStats;
+         write = m_writeStats;
+         aw = m_awStats;
+      }
+
+      indi::updateIfChanged<double>(m_indiP_latency, {"acq_p50", "acq_p99", "acq_p999", "acq_max",
+                                                      "write_p50", "write_p99", "write_p999", "write_max",
+                                                      "delta_aw_p50", "delta_aw_p99", "delta_aw_p999", "delta_aw_max"},
+                                    {acq.p50, acq.p99, acq.p999, acq.max,
+                                     write.p50, write.p99, write.p999, write.max,
+                                     aw.p50, aw.p99, aw.p999, aw.max}, derived().m_indiDriver);
+   }
    
    return 0;
 }
@@ -794,11 +1324,28 @@ int frameGrabber<derivedT>::recordFGTimings( bool force )
    static double last_mnwa = 0;
    static double last_varwa = 0;
 
+   static uint64_t last_histSeq = 0;
+
+   utils::latencyStats acq, write, aw;
+   uint64_t histSeq;
+   {
+      std::lock_guard<std::mutex> lock(m_histMutex);
+      acq = m_acqStats;
+      write = m_writeStats;
+      aw = m_awStats;
+      histSeq = m_histSeq;
+   }
+
    if(force || m_mna != last_mna || m_vara != last_vara ||
                  m_mnw != last_mnw || m_varw != last_varw ||
-                   m_mnwa != last_mnwa || m_varwa != last_varwa )
+                   m_mnwa != last_mnwa || m_varwa != last_varwa || histSeq != last_histSeq )
    {
-      derived().template telem<telem_fgtimings>({m_mna, sqrt(m_vara), m_mnw, sqrt(m_varw), m_mnwa, sqrt(m_varwa)});
+      derived().template telem<telem_fgtimings>({m_mna, sqrt(m_vara), m_mnw, sqrt(m_varw), m_mnwa, sqrt(m_varwa),
+                                                 acq.p50, acq.p99, acq.p999, acq.max,
+                                                 write.p50, write.p99, write.p999, write.max,
+                                                 aw.p50, aw.p99, aw.p999, aw.max});
+
+      last_histSeq = histSeq;
 
       last_mna = m_mna;
       last_vara = m_vara;
@@ -0,0 +1,318 @@
+/** \file frameKernels.hpp
+ * \brief Flip, copy, crop and dark subtraction kernels for loading camera frames into the framegrabber stream.
+ *
+ * \ingroup app_files
+ */
+
+#ifndef frameKernels_hpp
+#define frameKernels_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace MagAOX
+{
+namespace app
+{
+namespace dev
+{
+
+/// The size, in bytes, of a stream's circular buffer at and above which frames are written with non-temporal stores.
+/** Each frame is written to the next slot of the circular buffer.  If the whole buffer fits in cache, the slot is
+ * still cached from its last write and normal stores are faster.  If it does not, normal stores first read each
+ * destination line from memory for nothing, and evict the rest of the working set.
+ *
+ * \ingroup appdev
+ */
+constexpr size_t c_frameStreamBytes = 8388608;
+
+/// The frame size, in bytes, below which frames are always written with normal stores.
+/** Small frames have short rows, and the stores needed to align each row to a cache line for the non-temporal
+ * stores cost more than they save.
+ *
+ * \ingroup appdev
+ */
+constexpr size_t c_frameStreamMinBytes = 262144;
+
+#ifdef __SSE2__
+
+/// Reverse the order of the pixels in a 16 byte vector
+template <size_t szof>
+inline __m128i frameReverse128(__m128i v /**< [in] the vector to reverse*/)
+{
+    static_assert(szof == 2 || szof == 4, "frameReverse128: pixels must be 2 or 4 bytes");
+
+    v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+
+    //Swap the halves of each 32 bit word with shifts, which do not compete with the shuffle for its port
+    if constexpr (szof == 2)
+    {
+        v = _mm_or_si128(_mm_slli_epi32(v, 16), _mm_srli_epi32(v, 16));
+    }
+
+    return v;
+}
+
+#endif
+
+/// Copy a row of pixels, optionally with non-temporal stores
+/** Without SSE2 the stores are always normal.
+ *
+ * \ingroup appdev
+ */
+template <typename pixelT>
+void frameCopyRow( pixelT *__restrict dest,      ///< [out] the destination, n pixels
+                   const pixelT *__restrict src, ///< [in] the source, n pixels
+                   size_t n,                     ///< [in] the number of pixels
+                   bool stream                   ///< [in] if true, use non-temporal stores
+)
+{
+#ifdef __SSE2__
+    if (stream)
+    {
+        constexpr size_t V = 16 / sizeof(pixelT);
+
+        size_t i = 0;
+        while (i < n && (reinterpret_cast<uintptr_t>(dest + i) & 63))
+        {
+            dest[i] = src[i];
+            ++i;
+        }
+
+        for (; i + 4 * V <= n; i += 4 * V)
+        {
+            const __m128i *s = reinterpret_cast<const __m128i *>(src + i);
+            __m128i *d = reinterpret_cast<__m128i *>(dest + i);
+            _mm_stream_si128(d, _mm_loadu_si128(s));
+            _mm_stream_si128(d + 1, _mm_loadu_si128(s + 1));
+            _mm_stream_si128(d + 2, _mm_loadu_si128(s + 2));
+            _mm_stream_si128(d + 3, _mm_loadu_si128(s + 3));
+        }
+
+        for (; i < n; ++i)
+        {
+            dest[i] = src[i];
+        }
+
+        return;
+    }
+#else
+    static_cast<void>(stream);
+#endif
+
+    memcpy(dest, src, n * sizeof(pixelT));
+}
+
+/// Copy a row of pixels in reverse order, optionally with non-temporal stores
+/** Without SSE2 the stores are always normal.
+ *
+ * \ingroup appdev
+ */
+template <typename pixelT>
+void frameReverseRow( pixelT *__restrict dest,      ///< [out] the destination, n pixels
+                      const pixelT *__restrict src, ///< [in] the source, n pixels
+                      size_t n,                     ///< [in] the number of pixels
+                      bool stream                   ///< [in] if true, use non-temporal stores
+)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    constexpr size_t V = 16 / sizeof(pixelT);
+
+    //Non-temporal stores must only write whole cache lines, or they are mixed with normal stores to the same line
+    const uintptr_t align = (stream ? 63 : 15);
+
+    while (i < n && (reinterpret_cast<uintptr_t>(dest + i) & align))
+    {
+        dest[i] = src[n - 1 - i];
+        ++i;
+    }
+
+    if (stream)
+    {
+        for (; i + 4 * V <= n; i += 4 * V)
+        {
+            const __m128i *s = reinterpret_cast<const __m128i *>(src + n - i - 4 * V);
+            __m128i *d = reinterpret_cast<__m128i *>(dest + i);
+            _mm_stream_si128(d, frameReverse128<sizeof(pixelT)>(_mm_loadu_si128(s + 3)));
+            _mm_stream_si128(d + 1, frameReverse128<sizeof(pixelT)>(_mm_loadu_si128(s + 2)));
+            _mm_stream_si128(d + 2, frameReverse128<sizeof(pixelT)>(_mm_loadu_si128(s + 1)));
+            _mm_stream_si128(d + 3, frameReverse128<sizeof(pixelT)>(_mm_loadu_si128(s)));
+        }
+    }
+    else
+    {
+        for (; i + 4 * V <= n; i += 4 * V)
+        {
+            const __m128i *s = reinterpret_cast<const __m128i *>(src + n - i - 4 * V);
+            __m128i *d = reinterpret_cast<__m128i *>(dest + i);
+            _mm_store_si128(d, frameReverse128<sizeof(pixelT)>(_mm_loadu_si128(s + 3)));
+            _mm_store_si128(d + 1, frameReverse128<sizeof(pixelT)>(_mm_loadu_si128(s + 2)));
+            _mm_store_si128(d + 2, frameReverse128<sizeof(pixelT)>(_mm_loadu_si128(s + 1)));
+            _mm_store_si128(d + 3, frameReverse128<sizeof(pixelT)>(_mm_loadu_si128(s)));
+        }
+
+        for (; i + V <= n; i += V)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + n - i - V));
+            _mm_store_si128(reinterpret_cast<__m128i *>(dest + i), frameReverse128<sizeof(pixelT)>(v));
+        }
+    }
+#else
+    static_cast<void>(stream);
+#endif
+
+    for (; i < n; ++i)
+    {
+        dest[i] = src[n - 1 - i];
+    }
+}
+
+/// Copy a frame, flipping it up-down and/or left-right
+/** Rows are width pixels long and contiguous.  flipUD reverses the order of the rows, and flipLR reverses the order
+ * of the pixels within each row, as mx::improc::imcpy_flipUD and imcpy_flipLR do.  Each row is copied with at most
+ * one pass, and nothing is allocated.
+ *
+ * With stream true the frame is written with non-temporal stores, which are fenced before returning so the frame is
+ * visible to other processes once the stream semaphores are posted.  Use it when the circular buffer is at least
+ * c_frameStreamBytes.
+ *
+ * \ingroup appdev
+ */
+template <typename pixelT>
+void flipCopy( pixelT *__restrict dest,      ///< [out] the destination, width*height pixels
+               const pixelT *__restrict src, ///< [in] the source, width*height pixels
+               size_t width,                 ///< [in] the number of pixels in a row
+               size_t height,                ///< [in] the number of rows
+               bool flipUD,                  ///< [in] if true, reverse the order of the rows
+               bool flipLR,                  ///< [in] if true, reverse the order of the pixels in each row
+               bool stream                   ///< [in] if true, use non-temporal stores
+)
+{
+    static_assert(sizeof(pixelT) == 2 || sizeof(pixelT) == 4, "flipCopy: pixels must be 2 or 4 bytes");
+
+    if (!flipUD && !flipLR)
+    {
+        frameCopyRow(dest, src, width * height, stream);
+    }
+    else
+    {
+        for (size_t rr = 0; rr < height; ++rr)
+        {
+            const pixelT *s = src + (flipUD ? height - 1 - rr : rr) * width;
+            pixelT *d = dest + rr * width;
+
+            if (flipLR)
+            {
+                frameReverseRow(d, s, width, stream);
+            }
+            else
+            {
+                frameCopyRow(d, s, width, stream);
+            }
+        }
+    }
+
+#ifdef __SSE2__
+    if (stream)
+    {
+        _mm_sfence();
+    }
+#endif
+}
+
+/// Convert a row of pixels to float, optionally subtracting a dark
+/**
+ * \ingroup appdev
+ */
+template <typename pixelT>
+void frameDarkRow( float *__restrict dest,      ///< [out] the destination, n pixels
+                   const pixelT *__restrict src, ///< [in] the source, n pixels
+                   const float *__restrict dark, ///< [in] the dark to subtract, n pixels.  May be nullptr.
+                   size_t n                      ///< [in] the number of pixels
+)
+{
+    if (dark)
+    {
+        #pragma omp simd
+        for (size_t cc = 0; cc < n; ++cc)
+        {
+            dest[cc] = static_cast<float>(src[cc]) - dark[cc];
+        }
+    }
+    else
+    {
+        #pragma omp simd
+        for (size_t cc = 0; cc < n; ++cc)
+        {
+            dest[cc] = static_cast<float>(src[cc]);
+        }
+    }
+}
+
+/// Flip a frame, crop a region from it, and subtract a dark, producing a float image
+/** The region is specified in the flipped frame, so the output is the same as cropping the output of flipCopy.  The
+ * source is read once, straight from the camera buffer, so this can feed a second stream from the same read as the
+ * main one.  With flipLR, each row is reversed in pieces into a buffer on the stack, so the conversion always runs
+ * forwards.
+ *
+ * The caller must ensure that the region is within the frame.
+ *
+ * \ingroup appdev
+ */
+template <typename pixelT>
+void flipCropDark( float *__restrict dest,       ///< [out] the destination, w*h pixels
+                   const pixelT *__restrict src, ///< [in] the source frame, width*height pixels
+                   size_t width,                 ///< [in] the number of pixels in a row of the source
+                   size_t height,                ///< [in] the number of rows in the source
+                   bool flipUD,                  ///< [in] if true, reverse the order of the rows
+                   bool flipLR,                  ///< [in] if true, reverse the order of the pixels in each row
+                   size_t x0,                    ///< [in] the first column of the region, in the flipped frame
+                   size_t y0,                    ///< [in] the first row of the region, in the flipped frame
+                   size_t w,                     ///< [in] the number of columns in the region
+                   size_t h,                     ///< [in] the number of rows in the region
+                   const float *__restrict dark  ///< [in] the dark to subtract, w*h pixels.  May be nullptr.
+)
+{
+    constexpr size_t chunk = 512;
+
+    alignas(64) pixelT rev[chunk];
+
+    for (size_t rr = 0; rr < h; ++rr)
+    {
+        size_t sy = (flipUD ? height - 1 - (y0 + rr) : y0 + rr);
+
+        float *d = dest + rr * w;
+        const float *dk = (dark ? dark + rr * w : nullptr);
+
+        if (flipLR)
+        {
+            //Output column cc comes from source column width - 1 - x0 - cc
+            const pixelT *s = src + sy * width + (width - x0);
+
+            for (size_t c0 = 0; c0 < w; c0 += chunk)
+            {
+                size_t n = (w - c0 < chunk ? w - c0 : chunk);
+
+                frameReverseRow(rev, s - c0 - n, n, false);
+                frameDarkRow(d + c0, rev, (dk ? dk + c0 : nullptr), n);
+            }
+        }
+        else
+        {
+            frameDarkRow(d, src + sy * width + x0, dk, w);
+        }
+    }
+}
+
+} // namespace dev
+} // namespace app
+} // namespace MagAOX
+
+#endif // frameKernels_hpp
@@ -9,6 +9,9 @@
 #ifndef app_telemeter_hpp
 #define app_telemeter_hpp
 
+#include <functional>
+#include <cmath>
+
 namespace MagAOX
 {
 namespace app
@@ -16,6 +19,98 @@ namespace app
 namespace dev
 {
 
+/// A deadband on one field of a telemetry message.
+/** A change in the field is significant if it exceeds either the absolute or the relative deadband.
+  * With both set to 0 any change is significant.
+  *
+  * \ingroup appdev
+  */
+struct telemDeadband
+{
+    std::string m_field; ///< The name of the field, used for configuration.
+
+    std::function<double(void *)> m_accessor; ///< Accessor for the field in the flatbuffer message, e.g. telem_telpos::ra
+
+    double m_absolute{0}; ///< The absolute deadband.
+
+    double m_relative{0}; ///< The relative deadband, as a fraction of the last recorded value.
+
+    telemDeadband()
+    {
+    }
+
+    /// Construct from an accessor of any arithmetic type.
+    template <typename valT>
+    telemDeadband( const std::string &field,   ///< [in] the name of the field
+                   valT (*accessor)(void *),   ///< [in] the message accessor, e.g. telem_teldata::tracking
+                   double absolute,            ///< [in] the absolute deadband
+                   double relative = 0         ///< [in] [optional] the relative deadband
+                 ) : m_field(field), m_absolute(absolute), m_relative(relative)
+    {
+        m_accessor = [accessor](void *msgBuffer) { return static_cast<double>(accessor(msgBuffer)); };
+    }
+
+    /// Check if the change in this field between two messages exceeds the deadband
+    /**
+     * \returns true if the change is significant
+     * \returns false otherwise
+     */
+    bool exceeded( void *newMsg, ///< [in] the new flatbuffer message
+                   void *oldMsg  ///< [in] the last recorded flatbuffer message
+                 ) const
+    {
+        double nv = m_accessor(newMsg);
+        double ov = m_accessor(oldMsg);
+
+        double d = fabs(nv - ov);
+
+        if (d == 0)
+            return false;
+
+        if (m_absolute == 0 && m_relative == 0)
+            return true;
+
+        if (m_absolute > 0 && d > m_absolute)
+            return true;
+
+        if (m_relative > 0 && d > m_relative * fabs(ov))
+            return true;
+
+        return false;
+    }
+};
+
+/// The recording policy for one telemetry type.
+/** Calls to telemeter::telem for a type with a policy are suppressed if they occur within minInterval of
+  * the last record, or if no field changed by more than its deadband.  Forced records, which recordTelem makes
+  * when checkRecordTimes finds maxInterval has elapsed, are never suppressed.
+  *
+  * \ingroup appdev
+  */
+struct telemPolicy
+{
+    bool m_active{false}; ///< Whether this policy has been set.  If false, every record is made.
+
+    std::string m_name; ///< The name of the policy, also the config section "telem_<name>".
+
+    double m_minInterval{0}; ///< The minimum interval, in seconds, between records.
+
+    double m_maxInterval{0}; ///< The maximum interval, in seconds, between records.  If 0, telemeter::m_maxInterval is used.
+
+    std::vector<telemDeadband> m_deadbands; ///< The deadbands for each field.  If empty, any record is significant.
+
+    std::vector<uint8_t> m_lastMsg; ///< Copy of the last recorded flatbuffer message.
+
+    /** \name Statistics
+     * @{
+     */
+    uint64_t m_nRecorded{0};          ///< The number of records made.
+    uint64_t m_nForced{0};            ///< The number of records made due to maxInterval.
+    uint64_t m_nSuppressedMin{0};     ///< The number of records suppressed by minInterval.
+    uint64_t m_nSuppressedDeadband{0}; ///< The number of records suppressed by the deadbands.
+    ///@}
+};
+
 /// A device base class which saves telemetry.
 /**
   * CRTP class `derivedT` has the following requirements:
@@ -50,6 +145,16 @@ namespace dev
   *   You MUST NOT use the pointer argument, it is for type resolution only -- you 
   *   should fill in the telemetry log message using internal values. Note that calls to this function should result 
   *   in a telemetry log entry every time -- it is called when the minimum interval has elapsed since the last entry.
+  *   For a type with a recording policy, pass `force = true` to telem here so the policy does not suppress the entry.
+  *
+  * - May declare a recording policy for any telemetry type, in its constructor, with
+  *   \code
+  *       telemeterT::template setTelemPolicy<telem_type1>("type1", minInterval, maxInterval, {{"field", &telem_type1::field, absolute, relative}, ...});
+  *   \endcode
+  *   Calls to telem for that type are then suppressed if within minInterval of the last record, or if no field changed
+  *   by more than its deadband, so the derived class need not check for changes itself.  Calls with `force = true` are
+  *   always recorded.  The intervals and deadbands
+  *   can be overridden in the config section "telem_type1".
   *
   * - Must call this class's setupConfig(), loadConfig(), appStartup(), appLogic(), and appShutdown() 
   *   in the corresponding function of `derivedT`, with error checking. 
@@ -74,20 +179,52 @@ struct telemeter
 
     double m_maxInterval{10.0}; ///< The maximum interval, in seconds, between telemetry records. Default is 10.0 seconds.
 
+    double m_statsInterval{3600.0}; ///< The interval, in seconds, at which policy statistics are logged.  0 disables.  Default is 3600 seconds.
+
+    std::vector<telemPolicy *> m_policies; ///< The policies which have been set, for configuration and statistics.
+
+    timespec m_lastStats{0, 0}; ///< The time statistics were last logged.
+
     telemeter();
 
+    /// Get the recording policy for a telemetry type
+    template <typename telT>
+    telemPolicy &policy();
+
+    /// Set the recording policy for a telemetry type
+    /** This should be called in the `derivedT` constructor, so that the policy is configurable.
+     *
+     * \returns 0 on success
+     */
+    template <typename telT>
+    int setTelemPolicy( const std::string &name,                     ///< [in] the name of the policy, used for config and statistics
+                        double minInterval,                          ///< [in] the minimum interval between records [sec]
+                        double maxInterval,                          ///< [in] the maximum interval between records [sec].  0 uses telemeter.maxInterval.
+                        const std::vector<telemDeadband> &deadbands = {} ///< [in] [optional] the field deadbands
+                      );
+
+    /// Log the policy statistics for each telemetry type with a policy.
+    /**
+     * \returns 0 on success
+     */
+    int logPolicyStats();
+
     /// Make a telemetry recording
-    /** Wrapper for logManager::log, which updates telT::lastRecord.
+    /** Wrapper for logManager::log, which updates telT::lastRecord.  If telT has a policy the record may be
+     * suppressed, unless force is true.
      *
      * \tparam logT the log entry type
      * \tparam retval the value returned by this method.
      *
      */
     template <typename telT>
-    int telem(const typename telT::messageT &msg /**< [in] the data to log */);
+    int telem( const typename telT::messageT &msg, ///< [in] the data to log
+               bool force = false                  ///< [in] [optional] if true, the policy for telT is bypassed
+             );
 
     /// Make a telemetry recording, for an empty record
-    /** Wrapper for logManager::log, which updates telT::lastRecord.
+    /** Wrapper for logManager::log, which updates telT::lastRecord.  If telT has a policy the record is suppressed
+     * within its minInterval of the last one, but never once the maximum interval has elapsed.
      *
      * \tparam logT the log entry type
      * \tparam retval the value returned by this method.
@@ -183,13 +320,97 @@ telemeter<derivedT>::telemeter()
 
 template <class derivedT>
 template <typename telT>
-int telemeter<derivedT>::telem(const typename telT::messageT &msg)
+telemPolicy &telemeter<derivedT>::policy()
 {
+    static telemPolicy pol;
+    return pol;
+}
+
+template <class derivedT>
+template <typename telT>
+int telemeter<derivedT>::setTelemPolicy( const std::string &name,
+                                         double minInterval,
+                                         double maxInterval,
+                                         const std::vector<telemDeadband> &deadbands
+                                       )
+{
+    telemPolicy &pol = policy<telT>();
+
+    pol.m_name = name;
+    pol.m_minInterval = minInterval;
+    pol.m_maxInterval = maxInterval;
+    pol.m_deadbands = deadbands;
+
+    if (!pol.m_active)
+    {
+        pol.m_active = true;
+        m_policies.push_back(&pol);
+    }
+
+    return 0;
+}
+
+template <class derivedT>
+template <typename telT>
+int telemeter<derivedT>::telem( const typename telT::messageT &msg,
+                                bool force
+                              )
+{
+    telemPolicy &pol = policy<telT>();
+
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    if (pol.m_active)
+    {
+        void *newMsg = const_cast<uint8_t *>(msg.builder.GetBufferPointer());
+
+        if (!force)
+        {
+            double dt = ((double)ts.tv_sec + ((double)ts.tv_nsec) / 1e9) - ((double)telT::lastRecord.tv_sec + ((double)telT::lastRecord.tv_nsec) / 1e9);
+
+            if (dt < pol.m_minInterval)
+            {
+                ++pol.m_nSuppressedMin;
+                return 0;
+            }
+
+            if (pol.m_deadbands.size() > 0 && pol.m_lastMsg.size() > 0)
+            {
+                bool changed = false;
+                for (size_t n = 0; n < pol.m_deadbands.size(); ++n)
+                {
+                    if (pol.m_deadbands[n].exceeded(newMsg, pol.m_lastMsg.data()))
+                    {
+                        changed = true;
+                        break;
+                    }
+                }
+
+                if (!changed)
+                {
+                    ++pol.m_nSuppressedDeadband;
+                    return 0;
+                }
+            }
+        }
+        else
+        {
+            ++pol.m_nForced;
+        }
+
+        if (pol.m_deadbands.size() > 0)
+        {
+            pol.m_lastMsg.assign(msg.builder.GetBufferPointer(), msg.builder.GetBufferPointer() + msg.builder.GetSize());
+        }
+
+        ++pol.m_nRecorded;
+    }
 
     m_tel.template log<telT>(msg, logPrio::LOG_TELEM);
 
     // Set timestamp
-    clock_gettime(CLOCK_REALTIME, &telT::lastRecord);
+    telT::lastRecord = ts;
 
     return 0;
 }
@@ -198,11 +419,62 @@ template <class derivedT>
 template <typename telT>
 int telemeter<derivedT>::telem()
 {
+    telemPolicy &pol = policy<telT>();
+
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    if (pol.m_active)
+    {
+        // No fields, so only minInterval applies, and a record due at the maximum interval is always made
+        double dt = ((double)ts.tv_sec + ((double)ts.tv_nsec) / 1e9) - ((double)telT::lastRecord.tv_sec + ((double)telT::lastRecord.tv_nsec) / 1e9);
+
+        double maxInterval = (pol.m_maxInterval > 0) ? pol.m_maxInterval : m_maxInterval;
+
+        if (dt < maxInterval - ((double)derived().m_loopPause) / 1e9)
+        {
+            if (dt < pol.m_minInterval)
+            {
+                ++pol.m_nSuppressedMin;
+                return 0;
+            }
+        }
+        else
+        {
+            ++pol.m_nForced;
+        }
+
+        ++pol.m_nRecorded;
+    }
 
     m_tel.template log<telT>(logPrio::LOG_TELEM);
 
     // Set timestamp
-    clock_gettime(CLOCK_REALTIME, &telT::lastRecord);
+    telT::lastRecord = ts;
+
+    return 0;
+}
+
+template <class derivedT>
+int telemeter<derivedT>::logPolicyStats()
+{
+    for (size_t n = 0; n < m_policies.size(); ++n)
+    {
+        telemPolicy &pol = *m_policies[n];
+
+        uint64_t total = pol.m_nRecorded + pol.m_nSuppressedMin + pol.m_nSuppressedDeadband;
+
+        std::string msg = "telem policy " + pol.m_name + ": recorded " + std::to_string(pol.m_nRecorded);
+        msg += " (" + std::to_string(pol.m_nForced) + " at maxInterval)";
+        msg += ", suppressed " + std::to_string(pol.m_nSuppressedMin) + " by minInterval";
+        msg += " and " + std::to_string(pol.m_nSuppressedDeadband) + " by deadband";
+        if (total > 0)
+        {
+            msg += ", " + std::to_string((int)(100.0 * (pol.m_nSuppressedMin + pol.m_nSuppressedDeadband) / total + 0.5)) + "% suppressed";
+        }
+
+        derivedT::template log<text_log>(msg, logPrio::LOG_INFO);
+    }
 
     return 0;
 }
@@ -216,6 +488,23 @@ int telemeter<derivedT>::setupConfig(mx::app::appConfigurator &config)
 
     config.add("telemeter.maxInterval", "", "telemeter.maxInterval", argType::Required, "telemeter", "maxInterval", false, "double", "The maximum interval, in seconds, between telemetry records. Default is 10.0 seconds.");
 
+    config.add("telemeter.statsInterval", "", "telemeter.statsInterval", argType::Required, "telemeter", "statsInterval", false, "double", "The interval, in seconds, at which telemetry policy statistics are logged.  0 disables. Default is 3600 seconds.");
+
+    for (size_t n = 0; n < m_policies.size(); ++n)
+    {
+        std::string sect = "telem_" + m_policies[n]->m_name;
+
+        config.add(sect + ".minInterval", "", sect + ".minInterval", argType::Required, sect, "minInterval", false, "double", "The minimum interval, in seconds, between " + m_policies[n]->m_name + " records.");
+        config.add(sect + ".maxInterval", "", sect + ".maxInterval", argType::Required, sect, "maxInterval", false, "double", "The maximum interval, in seconds, between " + m_policies[n]->m_name + " records. 0 uses telemeter.maxInterval.");
+
+        for (size_t m = 0; m < m_policies[n]->m_deadbands.size(); ++m)
+        {
+            std::string fld = m_policies[n]->m_deadbands[m].m_field;
+            config.add(sect + "." + fld + "Abs", "", sect + "." + fld + "Abs", argType::Required, sect, fld + "Abs", false, "double", "The absolute deadband for " + fld + ".");
+            config.add(sect + "." + fld + "Rel", "", sect + "." + fld + "Rel", argType::Required, sect, fld + "Rel", false, "double", "The relative deadband for " + fld + ".");
+        }
+    }
+
     return 0;
 }
 
@@ -234,6 +523,23 @@ int telemeter<derivedT>::loadConfig(mx::app::appConfigurator &config)
 
     config(m_maxInterval, "telemeter.maxInterval");
 
+    config(m_statsInterval, "telemeter.statsInterval");
+
+    for (size_t n = 0; n < m_policies.size(); ++n)
+    {
+        std::string sect = "telem_" + m_policies[n]->m_name;
+
+        config(m_policies[n]->m_minInterval, sect + ".minInterval");
+        config(m_policies[n]->m_maxInterval, sect + ".maxInterval");
+
+        for (size_t m = 0; m < m_policies[n]->m_deadbands.size(); ++m)
+        {
+            std::string fld = m_policies[n]->m_deadbands[m].m_field;
+            config(m_policies[n]->m_deadbands[m].m_absolute, sect + "." + fld + "Abs");
+            config(m_policies[n]->m_deadbands[m].m_relative, sect + "." + fld + "Rel");
+        }
+    }
+
     return 0;
 }
 
@@ -261,18 +567,37 @@ int telemeter<derivedT>::appStartup()
         return -1;
     }
 
+    clock_gettime(CLOCK_REALTIME, &m_lastStats);
+
     return 0;
 }
 
 template <class derivedT>
 int telemeter<derivedT>::appLogic()
 {
+    if (m_statsInterval > 0 && m_policies.size() > 0)
+    {
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+
+        if (ts.tv_sec - m_lastStats.tv_sec >= m_statsInterval)
+        {
+            logPolicyStats();
+            m_lastStats = ts;
+        }
+    }
+
     return derived().checkRecordTimes();
 }
 
 template <class derivedT>
 int telemeter<derivedT>::appShutdown()
 {
+    if (m_policies.size() > 0)
+    {
+        logPolicyStats();
+    }
+
     return 0;
 }
 
@@ -290,8 +615,16 @@ template <class derivedT>
 template <class telT, class... telTs>
 int telemeter<derivedT>::checkRecordTimes(timespec &ts, const telT &tel, telTs... tels)
 {
+    double maxInterval = m_maxInterval;
+
+    telemPolicy &pol = policy<telT>();
+    if (pol.m_active && pol.m_maxInterval > 0)
+    {
+        maxInterval = pol.m_maxInterval;
+    }
+
     // Check if it's been more than maxInterval seconds since the last record.  This is corrected for the pause of the main loop.
-    if (((double)ts.tv_sec - ((double)ts.tv_nsec) / 1e9) - ((double)telT::lastRecord.tv_sec - ((double)telT::lastRecord.tv_nsec) / 1e9) > m_maxInterval - ((double)derived().m_loopPause) / 1e9)
+    if (((double)ts.tv_sec - ((double)ts.tv_nsec) / 1e9) - ((double)telT::lastRecord.tv_sec - ((double)telT::lastRecord.tv_nsec) / 1e9) > maxInterval - ((double)derived().m_loopPause) / 1e9)
     {
         derived().recordTelem(&tel);
     }
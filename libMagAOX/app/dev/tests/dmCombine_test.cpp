@@ -0,0 +1,189 @@
+//#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../../tests/catch2/catch.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../dmCombine.hpp"
+
+namespace dmCombine_test
+{
+
+using namespace MagAOX::app::dev;
+
+/// Sum the channels directly, as the external combiner does
+template <typename realT>
+void referenceSum(std::vector<realT> &total,
+                  const std::vector<std::vector<realT>> &channels)
+{
+    for (size_t k = 0; k < total.size(); ++k)
+    {
+        total[k] = 0;
+    }
+
+    for (size_t ch = 0; ch < channels.size(); ++ch)
+    {
+        for (size_t k = 0; k < total.size(); ++k)
+        {
+            total[k] += channels[ch][k];
+        }
+    }
+}
+
+SCENARIO("Combining DM channels incrementally", "[libMagAOX::app::dev::dmCombine]")
+{
+    GIVEN("12 channels on a 50x50 DM")
+    {
+        const size_t nch = 12;
+        const size_t nacts = 50 * 50;
+
+        std::mt19937 gen(1);
+        std::normal_distribution<float> dist(0, 1);
+
+        std::vector<std::vector<float>> channels(nch, std::vector<float>(nacts, 0));
+        std::vector<float> ref(nacts);
+
+        dmChannelSum<float> sum;
+        sum.resize(nch, nacts);
+
+        WHEN("each channel is set once")
+        {
+            for (size_t ch = 0; ch < nch; ++ch)
+            {
+                for (auto &v : channels[ch])
+                    v = dist(gen);
+                sum.update(ch, channels[ch].data());
+            }
+
+            referenceSum(ref, channels);
+
+            THEN("the total is the sum")
+            {
+                for (size_t k = 0; k < nacts; ++k)
+                {
+                    REQUIRE(sum.total()[k] == Approx(ref[k]).margin(1e-5));
+                }
+            }
+        }
+
+        WHEN("one channel is updated many times, without full sums")
+        {
+            sum.resumInterval(0);
+
+            for (size_t ch = 0; ch < nch; ++ch)
+            {
+                for (auto &v : channels[ch])
+                    v = dist(gen);
+                sum.update(ch, channels[ch].data());
+            }
+
+            for (int n = 0; n < 1000; ++n)
+            {
+                for (auto &v : channels[3])
+                    v = 100 * dist(gen);
+                sum.update(3, channels[3].data());
+            }
+
+            referenceSum(ref, channels);
+
+            THEN("the total is the sum, within round-off")
+            {
+                for (size_t k = 0; k < nacts; ++k)
+                {
+                    REQUIRE(sum.total()[k] == Approx(ref[k]).margin(1e-2));
+                }
+            }
+
+            THEN("a full sum removes the round-off")
+            {
+                sum.resum();
+                for (size_t k = 0; k < nacts; ++k)
+                {
+                    REQUIRE(sum.total()[k] == Approx(ref[k]).margin(1e-5));
+                }
+            }
+        }
+
+        WHEN("the total is recomputed periodically")
+        {
+            sum.resumInterval(16);
+
+            for (int n = 0; n < 1000; ++n)
+            {
+                size_t ch = n % nch;
+                for (auto &v : channels[ch])
+                    v = 100 * dist(gen);
+                sum.update(ch, channels[ch].data());
+            }
+
+            // 1000 % 16 == 8, so the last 8 updates were incremental
+            referenceSum(ref, channels);
+
+            THEN("the round-off stays small")
+            {
+                for (size_t k = 0; k < nacts; ++k)
+                {
+                    REQUIRE(sum.total()[k] == Approx(ref[k]).margin(1e-3));
+                }
+            }
+        }
+
+        WHEN("a channel is zeroed")
+        {
+            for (auto &v : channels[5])
+                v = dist(gen);
+            sum.update(5, channels[5].data());
+
+            std::vector<float> zero(nacts, 0);
+            sum.update(5, zero.data());
+
+            THEN("its contribution is removed, and its copy is zero")
+            {
+                for (size_t k = 0; k < nacts; ++k)
+                {
+                    REQUIRE(sum.total()[k] == 0);
+                    REQUIRE(sum.channel(5)[k] == 0);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Benchmark DM channel combination", "[.benchmark][libMagAOX::app::dev::dmCombine]")
+{
+    const size_t nacts = 50 * 50;
+
+    std::mt19937 gen(2);
+    std::normal_distribution<float> dist(0, 1);
+
+    for (size_t nch : {4, 12})
+    {
+        std::vector<std::vector<float>> channels(nch, std::vector<float>(nacts));
+        for (auto &c : channels)
+            for (auto &v : c)
+                v = dist(gen);
+
+        std::vector<float> total(nacts);
+
+        dmChannelSum<float> sum;
+        sum.resize(nch, nacts);
+
+        std::string sz = " channels=" + std::to_string(nch);
+
+        BENCHMARK("full sum" + sz)
+        {
+            referenceSum(total, channels);
+            return total[0];
+        };
+
+        BENCHMARK("incremental update of one channel" + sz)
+        {
+            sum.update(1, channels[1].data());
+            return sum.total()[0];
+        };
+    }
+}
+
+} // namespace dmCombine_test
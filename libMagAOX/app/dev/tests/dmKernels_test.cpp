@@ -0,0 +1,227 @@
+//#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../../tests/catch2/catch.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../dmKernels.hpp"
+
+namespace dmKernels_test
+{
+
+using namespace MagAOX::app::dev;
+
+/// A BMC-like mapping: the actuators inside a circle on an n x n grid, with a few addressable but unused.
+std::vector<int> circleMapping( int n,
+                                int nUnused
+                              )
+{
+   std::vector<int> mapping;
+   for(int rr = 0; rr < n; ++rr)
+   {
+      for(int cc = 0; cc < n; ++cc)
+      {
+         double x = rr - 0.5*(n-1);
+         double y = cc - 0.5*(n-1);
+         if(x*x + y*y <= 0.25*n*n) mapping.push_back(rr*n + cc);
+      }
+   }
+
+   for(int k = 0; k < nUnused; ++k) mapping.push_back(-1);
+
+   return mapping;
+}
+
+/// The three loops of the original bmcCtrl::commandDM
+long referenceSqrt( std::vector<double> & dminputs,
+                    const std::vector<float> & src,
+                    const std::vector<int> & mapping,
+                    double volume_factor,
+                    double act_gain,
+                    std::vector<uint8_t> & satMap
+                  )
+{
+   long nsat = 0;
+   for(size_t idx = 0; idx < mapping.size(); ++idx)
+   {
+      int address = mapping[idx];
+      if(address == -1) dminputs[idx] = 0.;
+      else dminputs[idx] = ((double) src[address]) * volume_factor/act_gain;
+   }
+
+   for(size_t idx = 0; idx < mapping.size(); ++idx)
+   {
+      if(dminputs[idx] > 1)
+      {
+         ++nsat;
+         dminputs[idx] = 1;
+      }
+      else if(dminputs[idx] < 0)
+      {
+         ++nsat;
+         dminputs[idx] = 0;
+      }
+      dminputs[idx] = sqrt(dminputs[idx]);
+   }
+
+   for(size_t idx = 0; idx < mapping.size(); ++idx)
+   {
+      int address = mapping[idx];
+      if(address == -1) continue;
+
+      if(dminputs[idx] >= 1 || dminputs[idx] <= 0) satMap[address] = 1;
+      else satMap[address] = 0;
+   }
+
+   return nsat;
+}
+
+SCENARIO( "Building a DM command plan", "[libMagAOX::app::dev::dmKernels]" )
+{
+   GIVEN("a mapping with unused actuators")
+   {
+      std::vector<int> mapping = {4, -1, 0, 7, -1, 2};
+
+      dmCommandPlan plan;
+      REQUIRE(plan.build(mapping.data(), mapping.size()) == 0);
+
+      THEN("the mapped and unmapped actuators are split")
+      {
+         REQUIRE(plan.m_nbAct == 6);
+         REQUIRE(plan.nMapped() == 4);
+         REQUIRE(plan.m_cmdIdx == std::vector<uint32_t>({0, 2, 3, 5}));
+         REQUIRE(plan.m_srcIdx == std::vector<uint32_t>({4, 0, 7, 2}));
+         REQUIRE(plan.m_unmapped == std::vector<uint32_t>({1, 4}));
+      }
+   }
+
+   GIVEN("a mapping with an invalid address")
+   {
+      std::vector<int> mapping = {4, -2, 0};
+
+      dmCommandPlan plan;
+
+      THEN("the build fails and the plan is empty")
+      {
+         REQUIRE(plan.build(mapping.data(), mapping.size()) == -1);
+         REQUIRE(plan.m_nbAct == 0);
+         REQUIRE(plan.nMapped() == 0);
+      }
+   }
+}
+
+SCENARIO( "Converting DM commands", "[libMagAOX::app::dev::dmKernels]" )
+{
+   GIVEN("a 50x50 BMC-like DM with some saturating actuators")
+   {
+      std::vector<int> mapping = circleMapping(50, 8);
+
+      std::mt19937 gen(3);
+      std::uniform_real_distribution<float> dist(-0.2, 1.3);
+
+      std::vector<float> src(50*50);
+      for(auto & v : src) v = dist(gen);
+      src[mapping[0]] = 0; //exactly at the limits
+      src[mapping[1]] = 2.0;
+      src[mapping[2]] = 4.0;
+
+      dmCommandPlan plan;
+      REQUIRE(plan.build(mapping.data(), mapping.size()) == 0);
+
+      WHEN("converting to squared fractional voltage")
+      {
+         std::vector<double> ref(mapping.size(), -99);
+         std::vector<uint8_t> refSat(src.size(), 9);
+         long refN = referenceSqrt(ref, src, mapping, 1.0, 2.0, refSat);
+
+         std::vector<double> out(mapping.size(), -99);
+         std::vector<uint8_t> sat(src.size(), 9);
+         long n = dmCommandSqrt(out.data(), src.data(), plan, 1.0/2.0, sat.data());
+
+         THEN("the result matches the original loops")
+         {
+            REQUIRE(n == refN);
+            REQUIRE(n > 0);
+            for(size_t k = 0; k < out.size(); ++k) REQUIRE(out[k] == Approx(ref[k]).epsilon(1e-14));
+            REQUIRE(sat == refSat);
+            REQUIRE(sat[mapping[0]] == 1);
+            REQUIRE(sat[mapping[2]] == 1);
+         }
+      }
+
+      WHEN("converting to mean-removed fractional stroke")
+      {
+         std::vector<double> out(mapping.size(), -99);
+         std::vector<uint8_t> sat(src.size(), 9);
+         uint32_t n = dmCommandMeanClip(out.data(), src.data(), plan, 1.5, sat.data());
+
+         THEN("the result matches a direct calculation")
+         {
+            double mean = 0;
+            for(size_t k = 0; k < mapping.size(); ++k)
+            {
+               if(mapping[k] >= 0) mean += src[mapping[k]]*1.5;
+            }
+            mean /= mapping.size();
+
+            uint32_t refN = 0;
+            for(size_t k = 0; k < mapping.size(); ++k)
+            {
+               double v = -mean;
+               if(mapping[k] >= 0) v += src[mapping[k]]*1.5;
+
+               if(v > 1 || v < -1)
+               {
+                  if(mapping[k] >= 0) ++refN;
+                  v = (v > 1) ? 1 : -1;
+               }
+
+               REQUIRE(out[k] == Approx(v).epsilon(1e-12));
+
+               if(mapping[k] >= 0) REQUIRE(sat[mapping[k]] == ((v >= 1 || v <= -1) ? 1 : 0));
+            }
+
+            REQUIRE(n == refN);
+            REQUIRE(n > 0);
+         }
+      }
+   }
+}
+
+TEST_CASE( "Benchmark DM command conversion", "[.benchmark][libMagAOX::app::dev::dmKernels]" )
+{
+   //The 2K: 2040 actuators in a 50x50 shmim
+   std::vector<int> mapping = circleMapping(50, 0);
+   mapping.resize(2040, -1);
+
+   std::mt19937 gen(4);
+   std::uniform_real_distribution<float> dist(-0.01, 1.01);
+
+   std::vector<float> src(50*50);
+   for(auto & v : src) v = dist(gen);
+
+   std::vector<double> out(mapping.size());
+   std::vector<uint8_t> sat(src.size());
+
+   dmCommandPlan plan;
+   plan.build(mapping.data(), mapping.size());
+
+   BENCHMARK("original loops")
+   {
+      return referenceSqrt(out, src, mapping, 1.0, 1.0, sat);
+   };
+
+   BENCHMARK("dmCommandSqrt")
+   {
+      return dmCommandSqrt(out.data(), src.data(), plan, 1.0, sat.data());
+   };
+
+   BENCHMARK("dmCommandMeanClip")
+   {
+      return dmCommandMeanClip(out.data(), src.data(), plan, 1.0, sat.data());
+   };
+}
+
+} //namespace dmKernels_test
@@ -0,0 +1,182 @@
+//#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../../tests/catch2/catch.hpp"
+
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../dmSatMask.hpp"
+
+namespace dmSatMask_test
+{
+
+using namespace MagAOX::app::dev;
+
+/// A random 0/1 map with about frac of the actuators set
+std::vector<uint8_t> randomMap(size_t n,
+                               double frac,
+                               std::mt19937 &gen)
+{
+    std::uniform_real_distribution<double> dist(0, 1);
+
+    std::vector<uint8_t> map(n);
+    for (auto &v : map)
+        v = (dist(gen) < frac);
+
+    return map;
+}
+
+SCENARIO("Packing saturation maps", "[libMagAOX::app::dev::dmSatMask]")
+{
+    GIVEN("a map which is not a multiple of 64 long")
+    {
+        std::mt19937 gen(1);
+        std::vector<uint8_t> map = randomMap(50 * 50, 0.3, gen);
+
+        std::vector<uint64_t> mask((map.size() + 63) / 64, 0xFFFF);
+        dmSatMaskRing::pack(mask.data(), map.data(), map.size());
+
+        THEN("each bit matches its actuator, and the padding is 0")
+        {
+            for (size_t k = 0; k < map.size(); ++k)
+            {
+                REQUIRE(((mask[k / 64] >> (k % 64)) & 1) == map[k]);
+            }
+
+            REQUIRE((mask.back() >> (map.size() % 64)) == 0);
+        }
+    }
+}
+
+SCENARIO("Handing off saturation masks", "[libMagAOX::app::dev::dmSatMask]")
+{
+    GIVEN("a ring for a 2040 actuator DM")
+    {
+        dmSatMaskRing ring;
+        ring.resize(2040);
+
+        std::mt19937 gen(2);
+
+        WHEN("fewer masks than the depth are pushed")
+        {
+            std::vector<uint16_t> ref(2040, 0);
+            for (size_t n = 0; n < dmSatMaskRing::depth; ++n)
+            {
+                std::vector<uint8_t> map = randomMap(2040, 0.1, gen);
+                for (size_t k = 0; k < map.size(); ++k)
+                    ref[k] += map[k];
+                REQUIRE(ring.push(map.data()) == true);
+            }
+
+            std::vector<uint16_t> accum(2040, 0);
+
+            THEN("they are all accumulated")
+            {
+                REQUIRE(ring.accumulate(accum.data()) == (int)dmSatMaskRing::depth);
+                REQUIRE(accum == ref);
+                REQUIRE(ring.accumulate(accum.data()) == 0);
+                REQUIRE(ring.dropped() == 0);
+            }
+        }
+
+        WHEN("the ring is full")
+        {
+            std::vector<uint8_t> map = randomMap(2040, 0.1, gen);
+            for (size_t n = 0; n < dmSatMaskRing::depth; ++n)
+                ring.push(map.data());
+
+            THEN("the next mask is dropped")
+            {
+                REQUIRE(ring.push(map.data()) == false);
+                REQUIRE(ring.dropped() == 1);
+            }
+        }
+
+        WHEN("a producer and a consumer run at the same time")
+        {
+            // Every map has the same number of saturated actuators, so a torn read would show up in the total
+            const int nframes = 20000;
+            std::vector<std::vector<uint8_t>> maps;
+            for (int n = 0; n < 16; ++n)
+            {
+                std::vector<uint8_t> map(2040, 0);
+                for (int k = 0; k < 100; ++k)
+                    map[(n * 37 + k * 13) % 2040] = 1;
+                maps.push_back(map);
+            }
+
+            std::vector<uint32_t> accum(2040, 0);
+            std::atomic<bool> done{false};
+            int naccum = 0;
+
+            std::thread consumer([&]()
+                                 {
+                while(!done)
+                {
+                    naccum += ring.accumulate(accum.data());
+                }
+                naccum += ring.accumulate(accum.data()); });
+
+            int npushed = 0;
+            for (int n = 0; n < nframes; ++n)
+            {
+                npushed += ring.push(maps[n % 16].data());
+            }
+
+            done = true;
+            consumer.join();
+
+            THEN("every published mask is accumulated whole")
+            {
+                REQUIRE(naccum == npushed);
+                REQUIRE((uint64_t)(npushed + ring.dropped()) == (uint64_t)nframes);
+
+                uint64_t total = 0;
+                for (auto v : accum)
+                    total += v;
+                REQUIRE(total == 100 * (uint64_t)npushed);
+            }
+        }
+    }
+}
+
+TEST_CASE("Benchmark saturation map accumulation", "[.benchmark][libMagAOX::app::dev::dmSatMask]")
+{
+    // A 50x50 shmim, with 1% of the actuators saturated
+    std::mt19937 gen(3);
+    std::vector<uint8_t> map = randomMap(50 * 50, 0.01, gen);
+
+    std::vector<uint16_t> accum(50 * 50, 0);
+
+    BENCHMARK("original (rr,cc) loop")
+    {
+        for (int rr = 0; rr < 50; ++rr)
+        {
+            for (int cc = 0; cc < 50; ++cc)
+            {
+                accum[cc * 50 + rr] += map[cc * 50 + rr];
+            }
+        }
+        return accum[0];
+    };
+
+    dmSatMaskRing ring;
+    ring.resize(map.size());
+
+    std::vector<uint64_t> mask((map.size() + 63) / 64);
+
+    BENCHMARK("pack only")
+    {
+        dmSatMaskRing::pack(mask.data(), map.data(), map.size());
+        return mask[0];
+    };
+
+    BENCHMARK("push and accumulate")
+    {
+        ring.push(map.data());
+        return ring.accumulate(accum.data());
+    };
+}
+
+} // namespace dmSatMask_test
@@ -0,0 +1,320 @@
+//#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../../tests/catch2/catch.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../frameKernels.hpp"
+
+namespace frameKernels_test
+{
+
+using namespace MagAOX::app::dev;
+
+/// Flip a frame one pixel at a time, as the generic imcpy_flip functions do for any pixel size
+__attribute__((noinline)) void referenceFlip(void *dest, const void *src, size_t width, size_t height, bool flipUD, bool flipLR, size_t szof)
+{
+    for (size_t rr = 0; rr < height; ++rr)
+    {
+        size_t sr = flipUD ? height - 1 - rr : rr;
+        for (size_t cc = 0; cc < width; ++cc)
+        {
+            size_t sc = flipLR ? width - 1 - cc : cc;
+            memcpy((char *)dest + (rr * width + cc) * szof, (const char *)src + (sr * width + sc) * szof, szof);
+        }
+    }
+}
+
+template <typename pixelT>
+std::vector<pixelT> randomFrame(size_t n, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> dist(-1000, 30000);
+
+    std::vector<pixelT> frame(n);
+    for (auto &p : frame)
+    {
+        p = static_cast<pixelT>(dist(gen));
+    }
+    return frame;
+}
+
+template <typename pixelT>
+void testFlips(size_t width, size_t height)
+{
+    std::vector<pixelT> src = randomFrame<pixelT>(width * height, width + height);
+
+    //One extra pixel, so the destination can be made unaligned
+    std::vector<pixelT> dest(width * height + 1), ref(width * height);
+
+    for (int flip = 0; flip < 4; ++flip)
+    {
+        bool flipUD = (flip & 1);
+        bool flipLR = (flip & 2);
+
+        referenceFlip(ref.data(), src.data(), width, height, flipUD, flipLR, sizeof(pixelT));
+
+        for (size_t offset : {0, 1})
+        {
+            for (bool stream : {false, true})
+            {
+                flipCopy(dest.data() + offset, src.data(), width, height, flipUD, flipLR, stream);
+                REQUIRE(memcmp(dest.data() + offset, ref.data(), width * height * sizeof(pixelT)) == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Flipping frames", "[libMagAOX::app::dev::frameKernels]")
+{
+    GIVEN("frames with rows which are not a multiple of the vector length")
+    {
+        THEN("uint16 frames match the pixel by pixel flip")
+        {
+            testFlips<uint16_t>(37, 23);
+            testFlips<uint16_t>(1, 5);
+        }
+
+        THEN("int16 frames match the pixel by pixel flip")
+        {
+            testFlips<int16_t>(37, 23);
+        }
+
+        THEN("float frames match the pixel by pixel flip")
+        {
+            testFlips<float>(37, 23);
+            testFlips<float>(3, 2);
+        }
+    }
+
+    GIVEN("a 120x120 frame")
+    {
+        THEN("all types match the pixel by pixel flip")
+        {
+            testFlips<uint16_t>(120, 120);
+            testFlips<int16_t>(120, 120);
+            testFlips<float>(120, 120);
+        }
+    }
+}
+
+SCENARIO("Fused flip, crop and dark subtraction", "[libMagAOX::app::dev::frameKernels]")
+{
+    GIVEN("a uint16 frame and a region of it")
+    {
+        const size_t width = 64;
+        const size_t height = 48;
+        const size_t x0 = 5;
+        const size_t y0 = 7;
+        const size_t w = 19;
+        const size_t h = 30;
+
+        std::vector<uint16_t> src = randomFrame<uint16_t>(width * height, 3);
+
+        std::vector<float> dark(w * h);
+        for (size_t n = 0; n < dark.size(); ++n)
+        {
+            dark[n] = 0.25 * n;
+        }
+
+        std::vector<uint16_t> flipped(width * height);
+        std::vector<float> out(w * h);
+
+        for (int flip = 0; flip < 4; ++flip)
+        {
+            bool flipUD = (flip & 1);
+            bool flipLR = (flip & 2);
+
+            referenceFlip(flipped.data(), src.data(), width, height, flipUD, flipLR, sizeof(uint16_t));
+
+            WHEN("flip " + std::to_string(flip) + " is applied with a dark")
+            {
+                flipCropDark(out.data(), src.data(), width, height, flipUD, flipLR, x0, y0, w, h, dark.data());
+
+                THEN("it is the same as cropping the flipped frame and subtracting the dark")
+                {
+                    for (size_t rr = 0; rr < h; ++rr)
+                    {
+                        for (size_t cc = 0; cc < w; ++cc)
+                        {
+                            float r = static_cast<float>(flipped[(y0 + rr) * width + x0 + cc]) - dark[rr * w + cc];
+                            REQUIRE(out[rr * w + cc] == r);
+                        }
+                    }
+                }
+            }
+
+            WHEN("flip " + std::to_string(flip) + " is applied without a dark")
+            {
+                flipCropDark(out.data(), src.data(), width, height, flipUD, flipLR, x0, y0, w, h,
+                             static_cast<const float *>(nullptr));
+
+                THEN("it is the same as cropping the flipped frame")
+                {
+                    for (size_t rr = 0; rr < h; ++rr)
+                    {
+                        for (size_t cc = 0; cc < w; ++cc)
+                        {
+                            REQUIRE(out[rr * w + cc] == static_cast<float>(flipped[(y0 + rr) * width + x0 + cc]));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    GIVEN("a region wider than the row buffer")
+    {
+        const size_t width = 1300;
+        const size_t height = 4;
+        const size_t x0 = 3;
+        const size_t w = 1201;
+
+        std::vector<int16_t> src = randomFrame<int16_t>(width * height, 7);
+        std::vector<int16_t> flipped(width * height);
+        std::vector<float> dark(w * 2, 1.5);
+        std::vector<float> out(w * 2);
+
+        referenceFlip(flipped.data(), src.data(), width, height, false, true, sizeof(int16_t));
+        flipCropDark(out.data(), src.data(), width, height, false, true, x0, 1, w, 2, dark.data());
+
+        for (size_t rr = 0; rr < 2; ++rr)
+        {
+            for (size_t cc = 0; cc < w; ++cc)
+            {
+                REQUIRE(out[rr * w + cc] == static_cast<float>(flipped[(1 + rr) * width + x0 + cc]) - 1.5f);
+            }
+        }
+    }
+
+    GIVEN("a float frame and a region covering all of it")
+    {
+        std::vector<float> src = randomFrame<float>(32 * 16, 4);
+        std::vector<float> flipped(32 * 16), out(32 * 16);
+
+        referenceFlip(flipped.data(), src.data(), 32, 16, true, true, sizeof(float));
+        flipCropDark(out.data(), src.data(), 32, 16, true, true, 0, 0, 32, 16, static_cast<const float *>(nullptr));
+
+        REQUIRE(out == flipped);
+    }
+}
+
+/// Benchmark the flips of one frame size, writing each frame to the next slot of a circular buffer as the stream does
+template <typename pixelT>
+void benchmarkFlips(size_t width, size_t height, const std::string &type)
+{
+    const size_t frameSz = width * height;
+
+    //A buffer larger than the cache, so each slot is cold when it is written, as it is in a long stream buffer
+    size_t nFrames = (64 * 1048576) / (frameSz * sizeof(pixelT));
+    if (nFrames < 2)
+        nFrames = 2;
+
+    std::vector<pixelT> src = randomFrame<pixelT>(frameSz, 5);
+    std::vector<pixelT> ring(frameSz * nFrames);
+    size_t slot = 0;
+
+    auto next = [&]()
+    {
+        slot = (slot + 1) % nFrames;
+        return ring.data() + slot * frameSz;
+    };
+
+    std::string sz = " " + type + " " + std::to_string(width) + "x" + std::to_string(height);
+
+    BENCHMARK("pixel by pixel flipUDLR" + sz)
+    {
+        pixelT *dest = next();
+        referenceFlip(dest, src.data(), width, height, true, true, sizeof(pixelT));
+        return dest[0];
+    };
+
+    BENCHMARK("memcpy" + sz)
+    {
+        pixelT *dest = next();
+        memcpy(dest, src.data(), frameSz * sizeof(pixelT));
+        return dest[0];
+    };
+
+    for (bool stream : {false, true})
+    {
+        std::string st = stream ? ", non-temporal" : ", normal";
+
+        BENCHMARK("flipCopy none" + st + sz)
+        {
+            pixelT *dest = next();
+            flipCopy(dest, src.data(), width, height, false, false, stream);
+            return dest[0];
+        };
+
+        BENCHMARK("flipCopy flipUD" + st + sz)
+        {
+            pixelT *dest = next();
+            flipCopy(dest, src.data(), width, height, true, false, stream);
+            return dest[0];
+        };
+
+        BENCHMARK("flipCopy flipUDLR" + st + sz)
+        {
+            pixelT *dest = next();
+            flipCopy(dest, src.data(), width, height, true, true, stream);
+            return dest[0];
+        };
+    }
+}
+
+TEST_CASE("Benchmark frame flips", "[.benchmark][libMagAOX::app::dev::frameKernels]")
+{
+    //From a WFS camera to a large CMOS sensor
+    for (size_t sz : {120, 512, 1024, 2048})
+    {
+        benchmarkFlips<uint16_t>(sz, sz, "uint16");
+    }
+
+    for (size_t sz : {512, 1024})
+    {
+        benchmarkFlips<float>(sz, sz, "float");
+    }
+}
+
+TEST_CASE("Benchmark fused flip, crop and dark subtraction", "[.benchmark][libMagAOX::app::dev::frameKernels]")
+{
+    for (size_t sz : {120, 512, 1024, 2048})
+    {
+        std::vector<uint16_t> src = randomFrame<uint16_t>(sz * sz, 6);
+        std::vector<uint16_t> flipped(sz * sz);
+
+        size_t w = sz / 2;
+        size_t h = sz / 2;
+        size_t x0 = sz / 4;
+        size_t y0 = sz / 4;
+
+        std::vector<float> dark(w * h, 100);
+        std::vector<float> out(w * h);
+
+        std::string str = " uint16 " + std::to_string(sz) + "x" + std::to_string(sz) + " half-size region";
+
+        BENCHMARK("separate passes" + str)
+        {
+            flipCopy(flipped.data(), src.data(), sz, sz, true, true, false);
+            for (size_t rr = 0; rr < h; ++rr)
+            {
+                for (size_t cc = 0; cc < w; ++cc)
+                {
+                    out[rr * w + cc] = flipped[(y0 + rr) * sz + x0 + cc] - dark[rr * w + cc];
+                }
+            }
+            return out[0];
+        };
+
+        BENCHMARK("flipCropDark" + str)
+        {
+            flipCropDark(out.data(), src.data(), sz, sz, true, true, x0, y0, w, h, dark.data());
+            return out[0];
+        };
+    }
+}
+
+} // namespace frameKernels_test
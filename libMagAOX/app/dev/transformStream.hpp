@@ -0,0 +1,673 @@
+/** \file transformStream.hpp
+  * \brief The MagAO-X synchronous stream transformer.
+  *
+  * \ingroup app_files
+  */
+
+#ifndef transformStream_hpp
+#define transformStream_hpp
+
+
+#include <ImageStreamIO/ImageStruct.h>
+#include <ImageStreamIO/ImageStreamIO.h>
+
+#include "../../utils/latencyHistogram.hpp"
+#include "../../utils/runningStats.hpp"
+
+namespace MagAOX
+{
+namespace app
+{
+namespace dev
+{
+
+/** MagAO-X synchronous stream transformer
+  *
+  * Publishes a stream derived from a stream read by a shmimMonitor.  The transformation is done on the caller's
+  * thread, normally the shmimMonitor thread in `derivedT::processImage`, directly from the source slice into the next
+  * slice of the output stream.  This replaces the pattern of a shmimMonitor posting a semaphore to wake up a
+  * frameGrabber thread, which costs a thread hop and usually a copy of the source frame per frame.
+  *
+  * The output stream is a circular buffer.  For each frame cnt0, cnt1, and the writetime, atime and cnt timing arrays
+  * are updated, and all of the output semaphores are posted.  The acquisition time (atime) of the source frame is
+  * carried through to the output, so delta_aw is the latency from acquisition of the source frame.
+  *
+  * The configuration keys (`framegrabber.shmimName` and `framegrabber.circBuffLength`) and the INDI properties
+  * (`fg_shmimName`, `fg_frameSize`, `fg_timing` and `fg_latency`) are the same as those of frameGrabber, and the
+  * timings are recorded as telem_fgtimings, so an app can be switched from frameGrabber without changing its
+  * configuration or clients.
+  *
+  * The derived class `derivedT` must expose the following interface
+  * \code
+    //Configures the transformation, must set m_width, m_height, and m_dataType of the output
+    //so that the shared memory can be allocated.  Called on the calling thread of transform() when m_reconfig is true.
+    // returns 0 on success, < 0 on error, > 0 if not ready (the frame is skipped).
+    int derivedT::configureTransform();
+
+    //Gets the frames-per-second rate used to size the latency circular buffers.
+    float derivedT::fps();
+
+    //Transforms the source frame into the output slice.
+    int derivedT::transformImage( void * dest, ///< [out] the next slice of the output stream
+                                  void * src   ///< [in] the source frame passed to transform
+                                );
+  * \endcode
+  * configureTransform and transformImage should return 0 on success, and -1 on an error.
+  *
+  * Only one thread may call transform.  Set m_reconfig to true, e.g. in `derivedT::allocate` or when a parameter of
+  * the transformation changes, to have configureTransform called before the next frame is transformed.
+  *
+  * Calls to this class's `setupConfig`, `loadConfig`, `appStartup`, `appLogic`, `updateINDI` and `appShutdown`
+  * functions must be placed in the derived class's functions of the same name.  In `derivedT::appShutdown`,
+  * `transformStream<derivedT>::appShutdown` must be called after the thread calling transform has been joined,
+  * i.e. after `shmimMonitor<derivedT>::appShutdown`.
+  *
+  * \ingroup appdev
+  */
+template<class derivedT>
+class transformStream
+{
+protected:
+
+   /** \name Configurable Parameters
+    * @{
+    */
+   std::string m_shmimName {""}; ///< The name of the output shared memory image.  Derived classes should set a default.
+
+   uint32_t m_circBuffLength {1}; ///< Length of the circular buffer, in frames
+
+   uint16_t m_latencyCircBuffMaxLength {3600}; ///< Maximum length of the latency measurement circular buffers
+   float m_latencyCircBuffMaxTime {5}; ///< Maximum time of the latency meaurement circular buffers
+
+   float m_latencyHistInterval {5}; ///< Interval, in seconds, over which latency percentiles are calculated.  0 turns the histograms off.
+
+   ///@}
+
+   uint32_t m_width {0}; ///< The width of the output image.
+   uint32_t m_height {0}; ///< The height of the output image.
+
+   uint8_t m_dataType {0}; ///< The ImageStreamIO type code of the output image.
+   size_t m_typeSize {0}; ///< The size of the type, in bytes.  Result of sizeof.
+
+   bool m_reconfig {true}; ///< Flag to set if the output must be reconfigured before the next frame.
+
+   IMAGE * m_imageStream {nullptr}; ///< The ImageStreamIO shared memory buffer.
+
+   uint64_t m_next_cnt1 {0}; ///< The slice the next frame will be written to.
+
+   typedef uint16_t cbIndexT;
+
+   utils::runningStats<double> m_atimes;  ///< Running statistics of the acquisition interval, updated by transform()
+   utils::runningStats<double> m_wtimes;  ///< Running statistics of the write interval, updated by transform()
+   utils::runningStats<double> m_watimes; ///< Running statistics of write-minus-acquisition, updated by transform()
+
+   utils::frameTimingStats m_fgTimings; ///< The timing statistics, published by transform().  Protected by m_timingsMutex.
+
+   std::mutex m_timingsMutex; ///< Mutex protecting m_fgTimings.
+
+   bool m_timingsValid {false}; ///< Whether m_mna etc. are valid.  Copied from m_fgTimings by appLogic.
+
+   //The timing statistics as last copied from m_fgTimings by appLogic, for updateINDI and recordFGTimings.
+   double m_mna {0};
+   double m_vara {0};
+
+   double m_mnw {0};
+   double m_varw {0};
+
+   double m_mnwa {0};
+   double m_varwa {0};
+
+   /** \name Latency Histograms
+     * transform records the source acquisition interval, the write interval, and the write-minus-acquisition
+     * delay of every frame.  appLogic calculates their percentiles every m_latencyHistInterval seconds.
+     * @{
+     */
+
+   utils::latencyHistogram m_acqHist; ///< Histogram of the acquisition time deltas
+   utils::latencyHistogram m_writeHist; ///< Histogram of the write time deltas
+   utils::latencyHistogram m_awHist; ///< Histogram of the write minus acquisition times
+
+   utils::latencyStats m_acqStats; ///< Percentiles of m_acqHist over the last interval.
+   utils::latencyStats m_writeStats; ///< Percentiles of m_writeHist over the last interval.
+   utils::latencyStats m_awStats; ///< Percentiles of m_awHist over the last interval.
+
+   uint64_t m_histSeq {0}; ///< Incremented each time the percentiles are updated.
+
+   timespec m_lastHistTime {0,0}; ///< The time the percentiles were last updated.
+
+   timespec m_lastAtime {0,0}; ///< The atime of the previous frame, also used for the timing statistics.
+   timespec m_lastWtime {0,0}; ///< The writetime of the previous frame.
+   bool m_haveLast {false}; ///< Whether the previous frame times are valid.
+
+   ///@}
+
+public:
+
+   /// Setup the configuration system
+   /**
+     * This should be called in `derivedT::setupConfig` as
+     * \code
+       transformStream<derivedT>::setupConfig(config);
+       \endcode
+     * with appropriate error checking.
+     */
+   void setupConfig(mx::app::appConfigurator & config /**< [out] the derived classes configurator*/);
+
+   /// load the configuration system results
+   /**
+     * This should be called in `derivedT::loadConfig` as
+     * \code
+       transformStream<derivedT>::loadConfig(config);
+       \endcode
+     * with appropriate error checking.
+     */
+   void loadConfig(mx::app::appConfigurator & config /**< [in] the derived classes configurator*/);
+
+   /// Startup function
+   /** Registers the INDI properties.
+     * This should be called in `derivedT::appStartup` as
+     * \code
+       transformStream<derivedT>::appStartup();
+       \endcode
+     * with appropriate error checking.
+     *
+     * \returns 0 on success
+     * \returns -1 on error, which is logged.
+     */
+   int appStartup();
+
+   /// Calculates the timing statistics
+   /** This should be called in `derivedT::appLogic` as
+     * \code
+       transformStream<derivedT>::appLogic();
+       \endcode
+     * with appropriate error checking.
+     *
+     * \returns 0 on success
+     * \returns -1 on error, which is logged.
+     */
+   int appLogic();
+
+   /// Destroys the output stream
+   /** This should be called in `derivedT::appShutdown` as
+     * \code
+       transformStream<derivedT>::appShutdown();
+       \endcode
+     * after the thread calling transform has been joined.
+     *
+     * \returns 0 on success
+     * \returns -1 on error, which is logged.
+     */
+   int appShutdown();
+
+   /// Transform a source frame and publish it in the output stream
+   /** Calls derivedT::configureTransform first if m_reconfig is set, creating the output stream if needed.  Then
+     * calls derivedT::transformImage with the next slice of the output stream, and publishes it.
+     *
+     * \returns 0 on success, or if the frame was skipped because the transformation is not configured
+     * \returns -1 on error
+     */
+   int transform( void * src,            ///< [in] the source frame, normally curr_src in processImage
+                  const timespec & atime ///< [in] the acquisition time of the source frame, normally md->atime of the source
+                );
+
+protected:
+
+   /// Configure the transformation and (re)create the output stream if its size, type, or name have changed.
+   /**
+     * \returns 0 on success
+     * \returns < 0 on error
+     * \returns > 0 if the transformation is not ready
+     */
+   int reconfigure();
+
+    /** \name INDI
+      *
+      *@{
+      */
+protected:
+
+   pcf::IndiProperty m_indiP_shmimName; ///< Property used to report the shmim buffer name
+
+   pcf::IndiProperty m_indiP_frameSize; ///< Property used to report the current frame size
+
+   pcf::IndiProperty m_indiP_timing; ///< Property used to report the mean and jitter of the timings
+
+   pcf::IndiProperty m_indiP_latency; ///< Property used to report the latency percentiles
+
+public:
+
+   /// Update the INDI properties for this device controller
+   /** You should call this once per main loop.
+     * It is not called automatically.
+     *
+     * \returns 0 on success.
+     * \returns -1 on error.
+     */
+   int updateINDI();
+
+   ///@}
+
+   /** \name Telemeter Interface
+     * @{
+     */
+
+   int recordFGTimings( bool force = false );
+
+   /// @}
+
+private:
+   derivedT & derived()
+   {
+      return *static_cast<derivedT *>(this);
+   }
+};
+
+template<class derivedT>
+void transformStream<derivedT>::setupConfig(mx::app::appConfigurator & config)
+{
+   config.add("framegrabber.shmimName", "", "framegrabber.shmimName", argType::Required, "framegrabber", "shmimName", false, "string", "The name of the ImageStreamIO shared memory image. Will be used as /milk/shm/<shmimName>.im.shm.");
+
+   config.add("framegrabber.circBuffLength", "", "framegrabber.circBuffLength", argType::Required, "framegrabber", "circBuffLength", false, "size_t", "The length of the circular buffer. Sets m_circBuffLength, default is 1.");
+
+   config.add("framegrabber.latencyTime", "", "framegrabber.latencyTime", argType::Required, "framegrabber", "latencyTime", false, "float", "The maximum length of time to measure latency timings. Sets  m_latencyCircBuffMaxTime, default is 5.");
+
+   config.add("framegrabber.latencySize", "", "framegrabber.latencySize", argType::Required, "framegrabber", "latencySize", false, "float", "The maximum length of the buffer used to measure latency timings. Sets  m_latencyCircBuffMaxLength, default is 3600.");
+
+   config.add("framegrabber.latencyHistInterval", "", "framegrabber.latencyHistInterval", argType::Required, "framegrabber", "latencyHistInterval", false, "float", "The interval in seconds over which latency percentiles are calculated.  0 turns the latency histograms off. Sets m_latencyHistInterval, default is 5.");
+}
+
+template<class derivedT>
+void transformStream<derivedT>::loadConfig(mx::app::appConfigurator & config)
+{
+   if(m_shmimName == "") m_shmimName = derived().configName();
+   config(m_shmimName, "framegrabber.shmimName");
+
+   config(m_circBuffLength, "framegrabber.circBuffLength");
+
+   if(m_circBuffLength < 1)
+   {
+      m_circBuffLength = 1;
+      derivedT::template log<text_log>("circBuffLength set to 1");
+   }
+
+   config(m_latencyCircBuffMaxTime, "framegrabber.latencyTime");
+   if(m_latencyCircBuffMaxTime < 0)
+   {
+      m_latencyCircBuffMaxTime = 0;
+      derivedT::template log<text_log>("latencyTime set to 0 (off)");
+   }
+
+   config(m_latencyCircBuffMaxLength, "framegrabber.latencySize");
+
+   config(m_latencyHistInterval, "framegrabber.latencyHistInterval");
+   if(m_latencyHistInterval < 0) m_latencyHistInterval = 0;
+}
+
+template<class derivedT>
+int transformStream<derivedT>::appStartup()
+{
+   //Register the shmimName INDI property
+   m_indiP_shmimName = pcf::IndiProperty(pcf::IndiProperty::Text);
+   m_indiP_shmimName.setDevice(derived().configName());
+   m_indiP_shmimName.setName("fg_shmimName");
+   m_indiP_shmimName.setPerm(pcf::IndiProperty::ReadOnly);
+   m_indiP_shmimName.setState(pcf::IndiProperty::Idle);
+   m_indiP_shmimName.add(pcf::IndiElement("name"));
+   m_indiP_shmimName["name"] = m_shmimName;
+
+   if( derived().registerIndiPropertyNew( m_indiP_shmimName, nullptr) < 0)
+   {
+      derivedT::template log<software_error>({__FILE__,__LINE__});
+      return -1;
+   }
+
+   //Register the frameSize INDI property
+   m_indiP_frameSize = pcf::IndiProperty(pcf::IndiProperty::Number);
+   m_indiP_frameSize.setDevice(derived().configName());
+   m_indiP_frameSize.setName("fg_frameSize");
+   m_indiP_frameSize.setPerm(pcf::IndiProperty::ReadOnly);
+   m_indiP_frameSize.setState(pcf::IndiProperty::Idle);
+   m_indiP_frameSize.add(pcf::IndiElement("width"));
+   m_indiP_frameSize["width"] = 0;
+   m_indiP_frameSize.add(pcf::IndiElement("height"));
+   m_indiP_frameSize["height"] = 0;
+
+   if( derived().registerIndiPropertyNew( m_indiP_frameSize, nullptr) < 0)
+   {
+      derivedT::template log<software_error>({__FILE__,__LINE__});
+      return -1;
+   }
+
+   //Register the timing INDI property
+   derived().createROIndiNumber( m_indiP_timing, "fg_timing");
+   m_indiP_timing.add(pcf::IndiElement("acq_fps"));
+   m_indiP_timing.add(pcf::IndiElement("acq_jitter"));
+   m_indiP_timing.add(pcf::IndiElement("write_fps"));
+   m_indiP_timing.add(pcf::IndiElement("write_jitter"));
+   m_indiP_timing.add(pcf::IndiElement("delta_aw"));
+   m_indiP_timing.add(pcf::IndiElement("delta_aw_jitter"));
+
+   if( derived().registerIndiPropertyReadOnly( m_indiP_timing ) < 0)
+   {
+      derivedT::template log<software_error>({__FILE__,__LINE__});
+      return -1;
+   }
+
+   //Register the latency percentiles INDI property
+   derived().createROIndiNumber( m_indiP_latency, "fg_latency");
+   for(const char * h : {"acq", "write", "delta_aw"})
+   {
+      for(const char * p : {"_p50", "_p99", "_p999", "_max"})
+      {
+         m_indiP_latency.add(pcf::IndiElement(std::string(h) + p));
+      }
+   }
+
+   if( derived().registerIndiPropertyReadOnly( m_indiP_latency ) < 0)
+   {
+      derivedT::template log<software_error>({__FILE__,__LINE__});
+      return -1;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &m_lastHistTime);
+
+   return 0;
+}
+
+template<class derivedT>
+int transformStream<derivedT>::appLogic()
+{
+   //The timing statistics are updated by transform() for each frame
+   utils::frameTimingStats fgt;
+   {
+      std::lock_guard<std::mutex> lock(m_timingsMutex);
+      fgt = m_fgTimings;
+   }
+
+   m_timingsValid = fgt.valid;
+
+   if( derived().state() == stateCodes::OPERATING && m_timingsValid )
+   {
+      m_mna = fgt.mna;
+      m_vara = fgt.vara;
+      m_mnw = fgt.mnw;
+      m_varw = fgt.varw;
+      m_mnwa = fgt.mnwa;
+      m_varwa = fgt.varwa;
+   }
+   else
+   {
+      m_mna = 0;
+      m_vara = 0;
+      m_mnw = 0;
+      m_varw = 0;
+      m_mnwa = 0;
+      m_varwa = 0;
+   }
+
+   //appLogic is the only reader of the histograms, so the percentiles are calculated here.
+   if(m_latencyHistInterval > 0)
+   {
+      timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if( (now.tv_sec - m_lastHistTime.tv_sec) + (now.tv_nsec - m_lastHistTime.tv_nsec)/1e9 >= m_latencyHistInterval)
+      {
+         m_acqHist.stats(m_acqStats, true);
+         m_writeHist.stats(m_writeStats, true);
+         m_awHist.stats(m_awStats, true);
+         ++m_histSeq;
+         m_lastHistTime = now;
+      }
+   }
+
+   //Record timings once the timing statistics are full, or whenever the latency percentiles are being calculated.
+   //recordFGTimings only records if something has changed.
+   if( derived().state() == stateCodes::OPERATING && ( m_timingsValid || m_latencyHistInterval > 0) )
+   {
+      recordFGTimings();
+   }
+
+   return 0;
+}
+
+template<class derivedT>
+int transformStream<derivedT>::appShutdown()
+{
+   if(m_imageStream != nullptr)
+   {
+      ImageStreamIO_destroyIm( m_imageStream );
+      free(m_imageStream);
+      m_imageStream = nullptr;
+   }
+
+   return 0;
+}
+
+template<class derivedT>
+int transformStream<derivedT>::reconfigure()
+{
+   int rv = derived().configureTransform();
+   if(rv != 0) return rv;
+
+   {
+      std::lock_guard<std::mutex> lock(m_timingsMutex);
+      m_fgTimings.valid = false;
+   }
+
+   if(m_latencyCircBuffMaxLength == 0 || m_latencyCircBuffMaxTime == 0)
+   {
+      m_atimes.windows(std::vector<size_t>());
+      m_wtimes.windows(std::vector<size_t>());
+      m_watimes.windows(std::vector<size_t>());
+   }
+   else
+   {
+      //Set up the timing statistics, over the intervals between cbSz frames
+      cbIndexT cbSz = m_latencyCircBuffMaxTime * derived().fps();
+      if(cbSz > m_latencyCircBuffMaxLength) cbSz = m_latencyCircBuffMaxLength;
+      if(cbSz < 3) cbSz = 3; //Make variance meaningful
+      m_atimes.windows(cbSz-1);
+      m_wtimes.windows(cbSz-1);
+      m_watimes.windows(cbSz-1);
+   }
+
+   m_typeSize = ImageStreamIO_typesize(m_dataType);
+
+   if(m_shmimName == "") m_shmimName = derived().configName();
+
+   if( m_imageStream == nullptr || m_imageStream->md->datatype != m_dataType || m_imageStream->md->size[0] != m_width ||
+         m_imageStream->md->size[1] != m_height || m_imageStream->md->size[2] != m_circBuffLength ||
+           m_shmimName != m_imageStream->md->name )
+   {
+      if(m_imageStream != nullptr)
+      {
+         ImageStreamIO_destroyIm(m_imageStream);
+         free(m_imageStream);
+      }
+
+      m_imageStream = (IMAGE *) malloc(sizeof(IMAGE));
+
+      uint32_t imsize[3];
+      imsize[0] = m_width;
+      imsize[1] = m_height;
+      imsize[2] = m_circBuffLength;
+
+      if(ImageStreamIO_createIm_gpu(m_imageStream, m_shmimName.c_str(), 3, imsize, m_dataType, -1, 1, IMAGE_NB_SEMAPHORE, 0, CIRCULAR_BUFFER | ZAXIS_TEMPORAL, 0) != 0)
+      {
+         free(m_imageStream);
+         m_imageStream = nullptr;
+         derivedT::template log<software_error>({__FILE__, __LINE__, "error creating output stream " + m_shmimName});
+         return -1;
+      }
+
+      m_imageStream->md->cnt1 = m_circBuffLength - 1;
+      m_next_cnt1 = 0;
+   }
+
+   m_haveLast = false;
+
+   return 0;
+}
+
+template<class derivedT>
+int transformStream<derivedT>::transform( void * src,
+                                          const timespec & atime
+                                        )
+{
+   if(m_reconfig || m_imageStream == nullptr)
+   {
+      m_reconfig = false;
+
+      int rv = reconfigure();
+      if(rv != 0)
+      {
+         m_reconfig = true;
+         return (rv < 0) ? -1 : 0;
+      }
+   }
+
+   IMAGE * im = m_imageStream;
+   uint64_t cnt1 = m_next_cnt1;
+
+   im->md->write = 1;
+
+   if(derived().transformImage( (char *) im->array.raw + cnt1*m_width*m_height*m_typeSize, src) < 0)
+   {
+      im->md->write = 0;
+      return -1;
+   }
+
+   //Set the time of last write
+   clock_gettime(CLOCK_REALTIME, &im->md->writetime);
+
+   //Carry the source acquisition time through
+   im->md->atime = atime;
+
+   im->md->cnt1 = cnt1;
+   im->md->cnt0++;
+
+   im->writetimearray[cnt1] = im->md->writetime;
+   im->atimearray[cnt1] = atime;
+   im->cntarray[cnt1] = im->md->cnt0;
+
+   //And post
+   im->md->write = 0;
+   ImageStreamIO_sempost(im,-1);
+
+   //Now do the bookkeeping outside the time-critical part.
+   ++m_next_cnt1;
+   if(m_next_cnt1 >= m_circBuffLength) m_next_cnt1 = 0;
+
+   const timespec & wtime = im->md->writetime;
+
+   if(m_atimes.nWindows() > 0 && m_haveLast)
+   {
+      m_atimes.add( (atime.tv_sec - m_lastAtime.tv_sec) + ((double) (atime.tv_nsec - m_lastAtime.tv_nsec))/1e9 );
+      m_wtimes.add( (wtime.tv_sec - m_lastWtime.tv_sec) + ((double) (wtime.tv_nsec - m_lastWtime.tv_nsec))/1e9 );
+      m_watimes.add( (wtime.tv_sec - atime.tv_sec) + ((double) (wtime.tv_nsec - atime.tv_nsec))/1e9 );
+
+      //Publish for appLogic.  If it holds the lock, the next frame publishes instead of this thread waiting.
+      if(m_atimes.full(0))
+      {
+         std::unique_lock<std::mutex> lock(m_timingsMutex, std::try_to_lock);
+         if(lock.owns_lock())
+         {
+            m_fgTimings.mna = m_atimes.mean(0);
+            m_fgTimings.vara = m_atimes.variance(0);
+            m_fgTimings.mnw = m_wtimes.mean(0);
+            m_fgTimings.varw = m_wtimes.variance(0);
+            m_fgTimings.mnwa = m_watimes.mean(0);
+            m_fgTimings.varwa = m_watimes.variance(0);
+            m_fgTimings.valid = true;
+         }
+      }
+   }
+
+   if(m_latencyHistInterval > 0)
+   {
+      if(m_haveLast)
+      {
+         m_acqHist.record(atime, m_lastAtime);
+         m_writeHist.record(wtime, m_lastWtime);
+      }
+      m_awHist.record(wtime, atime);
+   }
+
+   m_lastAtime = atime;
+   m_lastWtime = wtime;
+   m_haveLast = true;
+
+   return 0;
+}
+
+template<class derivedT>
+int transformStream<derivedT>::updateINDI()
+{
+   if( !derived().m_indiDriver ) return 0;
+
+   indi::updateIfChanged(m_indiP_shmimName, "name", m_shmimName, derived().m_indiDriver);
+   indi::updateIfChanged(m_indiP_frameSize, "width", m_width, derived().m_indiDriver);
+   indi::updateIfChanged(m_indiP_frameSize, "height", m_height, derived().m_indiDriver);
+
+   double fpsa = 0;
+   double fpsw = 0;
+   if(m_mna != 0 ) fpsa = 1.0/m_mna;
+   if(m_mnw != 0 ) fpsw = 1.0/m_mnw;
+
+   indi::updateIfChanged<double>(m_indiP_timing, {"acq_fps","acq_jitter","write_fps","write_jitter","delta_aw","delta_aw_jitter"},
+                        {fpsa, sqrt(m_vara), fpsw, sqrt(m_varw), m_mnwa, sqrt(m_varwa)},derived().m_indiDriver);
+
+   if(m_latencyHistInterval > 0)
+   {
+      indi::updateIfChanged<double>(m_indiP_latency, {"acq_p50", "acq_p99", "acq_p999", "acq_max",
+                                                      "write_p50", "write_p99", "write_p999", "write_max",
+                                                      "delta_aw_p50", "delta_aw_p99", "delta_aw_p999", "delta_aw_max"},
+                                    {m_acqStats.p50, m_acqStats.p99, m_acqStats.p999, m_acqStats.max,
+                                     m_writeStats.p50, m_writeStats.p99, m_writeStats.p999, m_writeStats.max,
+                                     m_awStats.p50, m_awStats.p99, m_awStats.p999, m_awStats.max}, derived().m_indiDriver);
+   }
+
+   return 0;
+}
+
+template<class derivedT>
+int transformStream<derivedT>::recordFGTimings( bool force )
+{
+   static double last_mna = 0;
+   static double last_vara = 0;
+
+   static double last_mnw = 0;
+   static double last_varw = 0;
+
+   static double last_mnwa = 0;
+   static double last_varwa = 0;
+
+   static uint64_t last_histSeq = 0;
+
+   if(force || m_mna != last_mna || m_vara != last_vara ||
+                 m_mnw != last_mnw || m_varw != last_varw ||
+                   m_mnwa != last_mnwa || m_varwa != last_varwa || m_histSeq != last_histSeq )
+   {
+      derived().template telem<telem_fgtimings>({m_mna, sqrt(m_vara), m_mnw, sqrt(m_varw), m_mnwa, sqrt(m_varwa),
+                                                 m_acqStats.p50, m_acqStats.p99, m_acqStats.p999, m_acqStats.max,
+                                                 m_writeStats.p50, m_writeStats.p99, m_writeStats.p999, m_writeStats.max,
+                                                 m_awStats.p50, m_awStats.p99, m_awStats.p999, m_awStats.max});
+
+      last_histSeq = m_histSeq;
+
+      last_mna = m_mna;
+      last_vara = m_vara;
+      last_mnw = m_mnw;
+      last_varw = m_varw;
+      last_mnwa = m_mnwa;
+      last_varwa = m_varwa;
+   }
+
+   return 0;
+}
+
+} //namespace dev
+} //namespace app
+} //namespace MagAOX
+#endif //transformStream_hpp
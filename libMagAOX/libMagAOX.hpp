@@ -20,6 +20,7 @@
 #include "app/dev/ioDevice.hpp"
 #include "app/dev/stdMotionStage.hpp"
 #include "app/dev/frameGrabber.hpp"
+#include "app/dev/transformStream.hpp"
 #include "app/dev/stdCamera.hpp"
 #include "app/dev/edtCamera.hpp"
 #include "app/dev/dssShutter.hpp"
@@ -41,6 +42,7 @@
 #include "logger/logFileName.hpp"
 #include "logger/logMap.hpp"
 #include "logger/logMeta.hpp"
+#include "logger/logTimeline.hpp"
 #include "logger/logBinarySchemata.hpp"
 #include "logger/generated/logCodes.hpp"
 #include "logger/generated/logStdFormat.hpp"
@@ -0,0 +1,196 @@
+/** \file logBufferPool.hpp
+  * \brief A pool of recycled log entry buffers.
+  *
+  * \ingroup logger_files
+  *
+  */
+
+#ifndef logger_logBufferPool_hpp
+#define logger_logBufferPool_hpp
+
+#include <vector>
+#include <mutex>
+
+#include <flatlogs/flatlogs.hpp>
+
+namespace MagAOX
+{
+namespace logger
+{
+
+/// A pool of memory blocks for log entries, sorted into power-of-two size classes.
+/** Log entries are allocated when created, and released by the log thread after they are written.
+  * Released blocks are kept on a free list for their size class and handed out again, so once an
+  * application has warmed up making a log entry does not touch the heap.  Blocks larger than the
+  * largest size class are allocated and freed normally.
+  *
+  * There is one pool per process, which is never destroyed, so that log entries released during static
+  * destruction (e.g. the MagAOXApp log manager) are safe.
+  *
+  * \ingroup logger
+  */
+class logBufferPool
+{
+public:
+   static constexpr size_t minShift = 6; ///< The smallest size class is 2^minShift = 64 bytes.
+
+   static constexpr size_t nClasses = 11; ///< The number of size classes.  The largest is 64 kB.
+
+   static constexpr size_t maxFree = 1024; ///< The maximum number of free blocks retained in each size class.
+
+protected:
+   std::mutex m_mutex; ///< Mutex protecting the free lists.
+
+   std::vector<char *> m_free[nClasses]; ///< The free lists.
+
+   logBufferPool()
+   {
+      for(size_t n=0; n < nClasses; ++n) m_free[n].reserve(maxFree);
+   }
+
+public:
+
+   /// Get the process-wide pool.
+   static logBufferPool & instance()
+   {
+      static logBufferPool * pool = new logBufferPool; //Deliberately never deleted.
+      return *pool;
+   }
+
+   /// Get the size class for a block size
+   /**
+     * \returns the size class, which is >= nClasses if the block is too big for the pool.
+     */
+   static size_t sizeClass( size_t sz /**< [in] the block size */)
+   {
+      size_t c = 0;
+      while( (static_cast<size_t>(1) << (c+minShift)) < sz) ++c;
+      return c;
+   }
+
+   /// Get a block of at least sz bytes
+   /**
+     * \returns a pointer to the block.
+     */
+   char * allocateBlock( size_t sz /**< [in] the required size */)
+   {
+      size_t c = sizeClass(sz);
+
+      if(c >= nClasses) return static_cast<char *>(::operator new(sz));
+
+      {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         if(m_free[c].size() > 0)
+         {
+            char * p = m_free[c].back();
+            m_free[c].pop_back();
+            return p;
+         }
+      }
+
+      return static_cast<char *>(::operator new(static_cast<size_t>(1) << (c+minShift)));
+   }
+
+   /// Return a block to the pool.
+   void releaseBlock( char * p, ///< [in] the block, from allocateBlock
+                      size_t sz ///< [in] the size passed to allocateBlock
+                    )
+   {
+      size_t c = sizeClass(sz);
+
+      if(c < nClasses)
+      {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         if(m_free[c].size() < maxFree)
+         {
+            m_free[c].push_back(p);
+            return;
+         }
+      }
+
+      ::operator delete(p);
+   }
+
+   /// Get the number of free blocks in a size class.  Used for testing.
+   size_t nFree( size_t c /**< [in] the size class */)
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_free[c].size();
+   }
+};
+
+/// Deleter for a log buffer, which returns it to the pool.
+struct logBufferDeleter
+{
+   size_t m_size {0}; ///< The size of the block, needed to find its size class.
+
+   void operator()( char * p ) const
+   {
+      logBufferPool::instance().releaseBlock(p, m_size);
+   }
+};
+
+/// Allocator which takes blocks from the pool.
+/** Used for the shared_ptr control blocks of log buffers.
+  */
+template<typename T>
+struct logBufferPoolAllocator
+{
+   typedef T value_type;
+
+   logBufferPoolAllocator() noexcept
+   {
+   }
+
+   template<typename U>
+   logBufferPoolAllocator( const logBufferPoolAllocator<U> & ) noexcept
+   {
+   }
+
+   T * allocate( size_t n )
+   {
+      return reinterpret_cast<T *>(logBufferPool::instance().allocateBlock(n*sizeof(T)));
+   }
+
+   void deallocate( T * p,
+                    size_t n
+                  )
+   {
+      logBufferPool::instance().releaseBlock(reinterpret_cast<char *>(p), n*sizeof(T));
+   }
+};
+
+template<typename T, typename U>
+bool operator==( const logBufferPoolAllocator<T> &,
+                 const logBufferPoolAllocator<U> &
+               )
+{
+   return true;
+}
+
+template<typename T, typename U>
+bool operator!=( const logBufferPoolAllocator<T> &,
+                 const logBufferPoolAllocator<U> &
+               )
+{
+   return false;
+}
+
+/// Allocate a log buffer from the pool.
+/** Both the buffer and the shared_ptr control block come from the pool, and are returned to it
+  * when the last copy of the shared_ptr is released.
+  *
+  * \returns the buffer
+  */
+inline
+flatlogs::bufferPtrT allocateLogBuffer( size_t sz /**< [in] the size of the log entry */)
+{
+   char * p = logBufferPool::instance().allocateBlock(sz);
+
+   return flatlogs::bufferPtrT(p, logBufferDeleter{sz}, logBufferPoolAllocator<char>());
+}
+
+} //namespace logger
+} //namespace MagAOX
+
+#endif //logger_logBufferPool_hpp
@@ -12,7 +12,7 @@
 #define logger_logManager_hpp
 
 #include <memory>
-#include <list>
+#include <vector>
 
 #include <thread>
 
@@ -27,6 +27,8 @@ using namespace flatlogs;
 
 #include "../common/defaults.hpp"
 
+#include "logBufferPool.hpp"
+
 #include "generated/logTypes.hpp"
 #include "generated/logStdFormat.hpp"
 
@@ -39,12 +41,16 @@ namespace logger
 /** Manages the formatting and queueing of the log entries.
   *
   * A log entry is made using one of the standard log types.  These are formatted into a binary stream and
-  * stored in a std::list.  This occurs in the calling thread.  The insertion into the list is mutex-ed, so
+  * stored in a queue.  This occurs in the calling thread.  The insertion into the queue is mutex-ed, so
   * it is safe to make logs from different threads concurrently.
   *
   * Write-to-disk occurs in a separate thread, which
   * is normally set to the lowest priority so as not to interfere with higher-priority tasks.  The
-  * log thread cycles through pending log entries in the list, dispatching them to the logFile.
+  * log thread swaps out the pending log entries in the queue, dispatching them to the logFile.
+  *
+  * Log entry buffers come from the logBufferPool, and are returned to it once written.  Together with the
+  * recycled flatbuffer builder memory (see fbRecyclingAllocator) and the re-used queue storage, this means
+  * making a log entry does not normally allocate.
   *
   * The template parameter logFileT is one of the logFile types, which is used to actually write to disk.
   *
@@ -84,7 +90,9 @@ public:
    std::string m_configSection {"logger"}; ///<The configuration files section name.  Default is `logger`.
    
 protected:
-   std::list<bufferPtrT> m_logQueue; ///< Log entries are stored here, and writen to the file by the log thread.
+   std::vector<bufferPtrT> m_logQueue; ///< Log entries are stored here, and writen to the file by the log thread.
+
+   std::vector<bufferPtrT> m_writeQueue; ///< The log thread swaps m_logQueue into this, so that the storage of both is re-used.
 
    std::thread m_logThread; ///< A separate thread for actually writing to the file.
    std::mutex m_qMutex; ///< Mutex for accessing the m_logQueue.
@@ -200,7 +208,7 @@ public:
                        );
 
    /// Create a log formatted log entry, filling in a buffer.
-   /** This version has the timestamp provided.
+   /** This version has the timestamp provided.  The buffer is allocated from the logBufferPool.
      *
      * \tparam logT is a log entry type
      *
@@ -444,48 +452,40 @@ void logManager<parentT, logFileT>::logThreadExec()
 
    while(!m_logShutdown || !m_logQueue.empty())
    {
-      std::list<bufferPtrT>::iterator beg, it, er, end;
-
-      //Get begin and end once, so we only process logs in the list at this point.
-      //Do it locked so we don't have any collisions with new logs (maybe not necessary)
+      //Take all the logs in the queue at this point.  New logs go into the (now empty) queue while we write.
       lock.lock();
-      beg = m_logQueue.begin();
-      end = m_logQueue.end();
+      m_writeQueue.swap(m_logQueue);
       lock.unlock();
 
-      //Note: we're avoiding use of size() since that could be altered concurrently by a push_back.
-      if( beg != end )
+      for(size_t n = 0; n < m_writeQueue.size(); ++n)
       {
-         it = beg;
-         while( it != end )
+         //m_logFile.
+         if( this->writeLog( m_writeQueue[n] ) < 0) 
          {
-            //m_logFile.
-            if( this->writeLog( *it ) < 0) 
-            {
-               m_logThreadRunning = false;
-               return;
-            }
-        
-            if(m_parent)
-            {
-               m_parent->logMessage( *it );
-            }
-            else if( logHeader::logLevel( *it ) <= logPrio::LOG_NOTICE )
-            {
-               logStdFormat(std::cerr, *it);
-               std::cerr << "\n";
-            }
-            
-            er = it;
-            ++it;
-
-            //Erase while locked so we don't collide with a push_back.
+            //Put the unwritten logs back at the front of the queue
             lock.lock();
-            m_logQueue.erase(er);
+            m_logQueue.insert(m_logQueue.begin(), m_writeQueue.begin() + n, m_writeQueue.end());
             lock.unlock();
+            m_writeQueue.clear();
+
+            m_logThreadRunning = false;
+            return;
+         }
+     
+         if(m_parent)
+         {
+            m_parent->logMessage( m_writeQueue[n] );
+         }
+         else if( logHeader::logLevel( m_writeQueue[n] ) <= logPrio::LOG_NOTICE )
+         {
+            logStdFormat(std::cerr, m_writeQueue[n]);
+            std::cerr << "\n";
          }
       }
 
+      //Release the buffers back to the pool, keeping the queue's storage.
+      m_writeQueue.clear();
+
       //m_logFile.
       ///\todo must check this for errors, and investigate how `fsyncgate` impacts us
       this->flush();
@@ -508,7 +508,7 @@ int logManager<parentT, logFileT>::createLog( bufferPtrT & logBuffer,
    timespecX ts;
    ts.gettime();
 
-   return logHeader::createLog<logT>(logBuffer, ts, msg, level);
+   return createLog<logT>(logBuffer, ts, msg, level);
 }
 
 template<class parentT, class logFileT>
@@ -519,7 +519,7 @@ int logManager<parentT, logFileT>::createLog( bufferPtrT & logBuffer,
                                               const logPrioT & level
                                             )
 {
-   return logHeader::createLog<logT>(logBuffer, ts, msg, level);
+   return logHeader::createLog<logT>(logBuffer, ts, msg, level, allocateLogBuffer);
 }
 
 template<class parentT, class logFileT>
@@ -139,14 +139,30 @@ std::string logMeta::value( logMap & lm,
                           )
 {
    if(m_detail.accessor == nullptr) return "";
-         
+   
+   if(m_detail.metaType == metaTypes::State)
+   {
+      //Check if we are still inside the window over which the last value holds
+      if(m_windowEnd.time_s != 0 && stime >= m_windowStart && atime <= m_windowEnd)
+      {
+         return m_windowValue;
+      }
+      m_windowEnd = {0,0}; //invalidate, the getLogStateVal call sets it if a window is found
+   }
+   
    if(m_detail.valType == valTypes::String)
    {
       std::string vs = valueString( lm, stime, atime); 
       if(vs == m_invalidValue)
       {
          std::cerr << __FILE__ << " " << __LINE__ << " valueString returned invalid value\n";
+         m_windowEnd = {0,0};
       } 
+      else
+      {
+         m_windowStart = stime;
+         m_windowValue = vs;
+      }
       return vs;
    }
    else
@@ -155,7 +171,13 @@ std::string logMeta::value( logMap & lm,
       if(vn == m_invalidValue)
       {
          std::cerr << __FILE__ << " " << __LINE__ << " valueNumber returned invalid value\n";
+         m_windowEnd = {0,0};
       } 
+      else
+      {
+         m_windowStart = stime;
+         m_windowValue = vn;
+      }
       return vn;
    }
 }
@@ -174,14 +196,14 @@ std::string logMeta::valueNumber( logMap & lm,
          case valTypes::Bool:
          {
             bool val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<bool(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<bool(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
             snprintf(str, sizeof(str), m_spec.format.c_str(), val);
             return std::string(str);
          }
          case valTypes::Char:
          {
             char val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<char(*)(void*)>(m_detail.accessor), &m_hint) != 0) 
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<char(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) 
             {
                std::cerr << "getLogStateVal returned error: " << __FILE__ << " " << __LINE__ << "\n";
                return m_invalidValue;
@@ -192,84 +214,84 @@ std::string logMeta::valueNumber( logMap & lm,
          case valTypes::UChar:
          {
             unsigned char val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<unsigned char(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<unsigned char(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
             snprintf(str, sizeof(str), m_spec.format.c_str(), val);
             return std::string(str);
          }
          case valTypes::Short:
          {
             short val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<short(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<short(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
             snprintf(str, sizeof(str), m_spec.format.c_str(), val);
             return std::string(str);
          }
          case valTypes::UShort:
          {
             unsigned short val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<unsigned short(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<unsigned short(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
             snprintf(str, sizeof(str), m_spec.format.c_str(), val);
             return std::string(str);
          }
          case valTypes::Int:
          {
             int val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<int(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<int(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
             snprintf(str, sizeof(str), m_spec.format.c_str(), val);
             return std::string(str);
          }
          case valTypes::UInt:
          {
             unsigned int val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<unsigned int(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<unsigned int(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
             snprintf(str, sizeof(str), m_spec.format.c_str(), val);
             return std::string(str);
          }
          case valTypes::Long:
          {
             long val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<long(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<long(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
             snprintf(str, sizeof(str), m_spec.format.c_str(), val);
             return std::string(str);
          }
          case valTypes::ULong:
          {
             unsigned long val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<unsigned long(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<unsigned long(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
             snprintf(str, sizeof(str), m_spec.format.c_str(), val);
             return std::string(str);
          }
          case valTypes::LongLong:
          {
             long long val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<long long(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<long long(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
             snprintf(str, sizeof(str), m_spec.format.c_str(), val);
             return std::string(str);
          }
          case valTypes::ULongLong:
          {
             unsigned long long val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<unsigned long long(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<unsigned long long(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
             snprintf(str, sizeof(str), m_spec.format.c_str(), val);
             return std::string(str);
          }
          case valTypes::Float:
          {
             float val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<float(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<float(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
             snprintf(str, sizeof(str), m_spec.format.c_str(), val);
             return std::string(str);
          }
          case valTypes::Double:
          {
             double val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<double(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<double(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
             snprintf(str, sizeof(str), m_spec.format.c_str(), val);
             return std::string(str);
          }
          case valTypes::Vector_Bool:
          {
             std::vector<bool> val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<std::vector<bool>(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<std::vector<bool>(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
 
             if(val.size() == 0) return "";
 
@@ -290,7 +312,7 @@ std::string logMeta::valueNumber( logMap & lm,
          case valTypes::Vector_Float:
          {
             std::vector<float> val;
-            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<std::vector<float>(*)(void*)>(m_detail.accessor), &m_hint) != 0) return m_invalidValue;
+            if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<std::vector<float>(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0) return m_invalidValue;
 
             if(val.size() == 0) return "";
 
@@ -424,7 +446,7 @@ std::string logMeta::valueString( logMap & lm,
    std::string val;
    if(m_detail.metaType == metaTypes::State)
    {
-      if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<std::string(*)(void*)>(m_detail.accessor), &m_hint) != 0)
+      if( getLogStateVal(val,lm, m_spec.device,m_spec.eventCode,stime,atime,reinterpret_cast<std::string(*)(void*)>(m_detail.accessor), &m_hint, &m_windowEnd) != 0)
       {
          std::cerr << "getLogStateVal returned error " << __FILE__ << " " << __LINE__ << "\n";
 
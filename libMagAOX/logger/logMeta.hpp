@@ -131,7 +131,8 @@ int getLogStateVal( valT & val,
                     const flatlogs::timespecX & stime,
                     const flatlogs::timespecX & atime,
                     valT (*getter)(void *),
-                    char ** hint = 0
+                    char ** hint = 0,
+                    flatlogs::timespecX * validUntil = 0 ///< [out] [optional] if not null, set to the time of the next log entry if val is constant over [stime, atime], otherwise set to 0.
                   )
 {
    char * atprior = nullptr;
@@ -176,6 +177,7 @@ int getLogStateVal( valT & val,
       {
          val = atprV;
          if(hint) *hint = stprior;
+         if(validUntil) *validUntil = {0,0};
          return 0;
       }
       stprior = atprior;
@@ -189,6 +191,9 @@ int getLogStateVal( valT & val,
    val = stprV;
    
    if(hint) *hint = stprior;
+   
+   //No entry between stprior and atprior, so val holds for any later window ending before atprior.
+   if(validUntil) *validUntil = flatlogs::logHeader::timespec(atprior);
    return 0;
 }
 
@@ -300,6 +305,17 @@ protected:
    
    char * m_hint {nullptr};
    
+   /** \name State Window Cache
+     * A State value is constant from the stime at which it was looked up until the next log entry
+     * for the device.  Frames falling within that window re-use the cached value instead of
+     * searching the logs again.
+     * @{
+     */
+   flatlogs::timespecX m_windowStart {0,0}; ///< The stime at which the cached value was looked up
+   flatlogs::timespecX m_windowEnd {0,0}; ///< The time of the next log entry after the cached value.  0 if the cache is invalid.
+   std::string m_windowValue; ///< The cached value
+   ///@}
+   
 public:
    
    logMeta( const logMetaSpec & lms /**< [in] the specification of this meta data entry */ );
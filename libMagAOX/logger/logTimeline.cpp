@@ -0,0 +1,412 @@
+/** \file logTimeline.cpp
+  * \brief Defines the logTimeline class.
+  *
+  * \ingroup logger_files
+  *
+  */
+
+#include "logTimeline.hpp"
+
+#include <algorithm>
+#include <map>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <iomanip>
+
+#include <mx/ioutils/fileUtils.hpp>
+
+#include "generated/logStdFormat.hpp"
+
+using namespace flatlogs;
+
+namespace MagAOX
+{
+namespace logger
+{
+
+logFileMmap::logFileMmap()
+{
+}
+
+logFileMmap::logFileMmap( logFileMmap && lfm ) noexcept : m_data{lfm.m_data}, m_size{lfm.m_size}
+{
+   lfm.m_data = nullptr;
+   lfm.m_size = 0;
+}
+
+logFileMmap & logFileMmap::operator=( logFileMmap && lfm ) noexcept
+{
+   if(this != &lfm)
+   {
+      close();
+      m_data = lfm.m_data;
+      m_size = lfm.m_size;
+      lfm.m_data = nullptr;
+      lfm.m_size = 0;
+   }
+
+   return *this;
+}
+
+logFileMmap::~logFileMmap()
+{
+   close();
+}
+
+int logFileMmap::open( const std::string & fname )
+{
+   close();
+
+   int fd = ::open(fname.c_str(), O_RDONLY);
+   if(fd < 0)
+   {
+      std::cerr << __FILE__ << " " << __LINE__ << " error opening " << fname << ": " << strerror(errno) << "\n";
+      return -1;
+   }
+
+   struct stat st;
+   if(fstat(fd, &st) < 0)
+   {
+      std::cerr << __FILE__ << " " << __LINE__ << " error getting size of " << fname << ": " << strerror(errno) << "\n";
+      ::close(fd);
+      return -1;
+   }
+
+   //An empty file has nothing to map, and mmap would fail.
+   if(st.st_size == 0)
+   {
+      ::close(fd);
+      return 0;
+   }
+
+   void * addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+   ::close(fd); //the mapping stays valid
+
+   if(addr == MAP_FAILED)
+   {
+      std::cerr << __FILE__ << " " << __LINE__ << " error mapping " << fname << ": " << strerror(errno) << "\n";
+      return -1;
+   }
+
+   //Logs are read front to back exactly once.
+   madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+   m_data = static_cast<char *>(addr);
+   m_size = st.st_size;
+
+   return 0;
+}
+
+void logFileMmap::close()
+{
+   if(m_data)
+   {
+      munmap(m_data, m_size);
+   }
+
+   m_data = nullptr;
+   m_size = 0;
+}
+
+char * logFileMmap::data()
+{
+   return m_data;
+}
+
+size_t logFileMmap::size()
+{
+   return m_size;
+}
+
+void logTimeline::dir( const std::string & d )
+{
+   m_dir = d;
+}
+
+std::string logTimeline::dir()
+{
+   return m_dir;
+}
+
+void logTimeline::ext( const std::string & e )
+{
+   m_ext = e;
+}
+
+std::string logTimeline::ext()
+{
+   return m_ext;
+}
+
+void logTimeline::apps( const std::set<std::string> & a )
+{
+   m_apps = a;
+}
+
+std::set<std::string> logTimeline::apps()
+{
+   return m_apps;
+}
+
+void logTimeline::codes( const std::set<flatlogs::eventCodeT> & c )
+{
+   m_codes = c;
+}
+
+std::set<flatlogs::eventCodeT> logTimeline::codes()
+{
+   return m_codes;
+}
+
+void logTimeline::level( const flatlogs::logPrioT & l )
+{
+   m_level = l;
+}
+
+flatlogs::logPrioT logTimeline::level()
+{
+   return m_level;
+}
+
+void logTimeline::timeRange( const flatlogs::timespecX & st,
+                             const flatlogs::timespecX & et
+                           )
+{
+   m_startTime = st;
+   m_endTime = et;
+}
+
+flatlogs::timespecX logTimeline::startTime()
+{
+   return m_startTime;
+}
+
+flatlogs::timespecX logTimeline::endTime()
+{
+   return m_endTime;
+}
+
+size_t logTimeline::nFiles()
+{
+   return m_nFiles;
+}
+
+size_t logTimeline::nFilesOpened()
+{
+   return m_nFilesOpened;
+}
+
+size_t logTimeline::nEntries()
+{
+   return m_nEntries;
+}
+
+int logTimeline::selectFiles( std::vector<appCursor> & cursors )
+{
+   std::vector<std::string> flist = mx::ioutils::getFileNames(m_dir, "", "", m_ext);
+
+   //Sort the files by app, and by name (and so by time) within each app.
+   std::map<std::string, std::set<logFileName, compLogFileName>> appToFileMap;
+
+   for(size_t n = 0; n < flist.size(); ++n)
+   {
+      logFileName lfn(flist[n]);
+
+      if(!lfn.valid()) continue;
+
+      if(m_apps.size() > 0 && m_apps.count(lfn.appName()) == 0) continue;
+
+      appToFileMap[lfn.appName()].insert(lfn);
+   }
+
+   cursors.clear();
+   cursors.reserve(appToFileMap.size());
+
+   for(auto it = appToFileMap.begin(); it != appToFileMap.end(); ++it)
+   {
+      m_nFiles += it->second.size();
+
+      std::vector<logFileName> files(it->second.begin(), it->second.end());
+
+      appCursor cur;
+      cur.m_appName = it->first;
+
+      //A file holds the entries from its own timestamp up to the timestamp of the next file.
+      for(size_t n = 0; n < files.size(); ++n)
+      {
+         if(files[n].timestamp() > m_endTime) break;
+
+         if(n + 1 < files.size() && files[n+1].timestamp() < m_startTime) continue;
+
+         cur.m_files.push_back(files[n]);
+      }
+
+      if(cur.m_files.size() > 0) cursors.push_back(std::move(cur));
+   }
+
+   return 0;
+}
+
+bool logTimeline::passes( char * logBuffer )
+{
+   if(logHeader::logLevel(logBuffer) > m_level) return false;
+
+   if(m_codes.size() > 0 && m_codes.count(logHeader::eventCode(logBuffer)) == 0) return false;
+
+   return true;
+}
+
+int logTimeline::advance( appCursor & cur )
+{
+   bool step = (cur.m_map.data() != nullptr);
+
+   while(1)
+   {
+      if(cur.m_map.data() == nullptr)
+      {
+         if(cur.m_nextFile >= cur.m_files.size()) return 1;
+
+         //On error, a message is printed and we go on to the next file.
+         int rv = cur.m_map.open(cur.m_files[cur.m_nextFile].fullName());
+         ++cur.m_nextFile;
+         if(rv < 0 || cur.m_map.data() == nullptr) continue;
+
+         ++m_nFilesOpened;
+         cur.m_pos = 0;
+         step = false;
+      }
+
+      if(step)
+      {
+         cur.m_pos += logHeader::totalSize(cur.m_map.data() + cur.m_pos);
+      }
+      step = true;
+
+      if(cur.m_pos >= cur.m_map.size())
+      {
+         cur.m_map.close();
+         continue;
+      }
+
+      char * logBuffer = cur.m_map.data() + cur.m_pos;
+      size_t remaining = cur.m_map.size() - cur.m_pos;
+
+      //Check that the entry is complete, which it might not be if the file is still being written.
+      if( remaining < (size_t) logHeader::minHeadSize || remaining < logHeader::headerSize(logBuffer) || remaining < logHeader::totalSize(logBuffer) )
+      {
+         std::cerr << __FILE__ << " " << __LINE__ << " incomplete entry at byte " << cur.m_pos << " of " << cur.m_files[cur.m_nextFile-1].fullName() << "\n";
+         cur.m_map.close();
+         continue;
+      }
+
+      cur.m_ts = logHeader::timespec(logBuffer);
+
+      if(cur.m_ts > m_endTime)
+      {
+         //Nothing later in this app's logs can be in range.
+         cur.m_map.close();
+         cur.m_nextFile = cur.m_files.size();
+         return 1;
+      }
+
+      if(cur.m_ts < m_startTime) continue;
+
+      if(!passes(logBuffer)) continue;
+
+      return 0;
+   }
+}
+
+int logTimeline::query( callbackT callback )
+{
+   m_nFiles = 0;
+   m_nFilesOpened = 0;
+   m_nEntries = 0;
+
+   std::vector<appCursor> cursors;
+
+   if(selectFiles(cursors) < 0) return -1;
+
+   //The heap holds the indices of the cursors with an entry to deliver.  The top is the earliest entry,
+   //with ties going to the first app.
+   auto later = [&cursors](size_t a, size_t b)
+   {
+      if(cursors[a].m_ts == cursors[b].m_ts) return a > b;
+      return cursors[a].m_ts > cursors[b].m_ts;
+   };
+
+   std::vector<size_t> heap;
+   heap.reserve(cursors.size());
+
+   for(size_t n = 0; n < cursors.size(); ++n)
+   {
+      if(advance(cursors[n]) == 0) heap.push_back(n);
+   }
+
+   std::make_heap(heap.begin(), heap.end(), later);
+
+   while(heap.size() > 0)
+   {
+      std::pop_heap(heap.begin(), heap.end(), later);
+
+      appCursor & cur = cursors[heap.back()];
+
+      ++m_nEntries;
+      if(callback(cur.m_appName, cur.m_map.data() + cur.m_pos) != 0) return 0;
+
+      if(advance(cur) == 0)
+      {
+         std::push_heap(heap.begin(), heap.end(), later);
+      }
+      else
+      {
+         heap.pop_back();
+      }
+   }
+
+   return 0;
+}
+
+int logTimeline::query( std::ostream & out,
+                        bool json
+                      )
+{
+   //Entries are copied out of the mapping so that the formatters see an aligned buffer.
+   std::vector<char> copy;
+   std::ostringstream jsonStr;
+
+   return query( [&](const std::string & appName, char * logBuffer)
+   {
+      size_t sz = logHeader::totalSize(logBuffer);
+      if(copy.size() < sz) copy.resize(sz);
+      memcpy(copy.data(), logBuffer, sz);
+
+      bufferPtrT buffer(bufferPtrT(), copy.data()); //non-owning
+
+      if(json)
+      {
+         jsonStr.str("");
+         logJsonFormat(jsonStr, buffer);
+
+         //Add the app name as the first member
+         out << "{\"app\": \"" << appName << "\", " << jsonStr.str().substr(1) << "\n";
+      }
+      else
+      {
+         out << std::left << std::setw(16) << appName << " ";
+         logStdFormat(out, buffer);
+         out << "\n";
+      }
+
+      return 0;
+   });
+}
+
+} //namespace logger
+} //namespace MagAOX
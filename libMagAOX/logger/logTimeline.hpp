@@ -0,0 +1,225 @@
+/** \file logTimeline.hpp
+  * \brief Declares the logTimeline class, for time-ordered queries across many applications' logs.
+  *
+  * \ingroup logger_files
+  *
+  */
+
+#ifndef logger_logTimeline_hpp
+#define logger_logTimeline_hpp
+
+#include <vector>
+#include <set>
+#include <string>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <limits>
+
+#include <flatlogs/flatlogs.hpp>
+#include "logFileName.hpp"
+
+namespace MagAOX
+{
+namespace logger
+{
+
+/// A read-only memory map of a binary log file.
+/** The mapping is released on destruction.  Can be moved, but not copied.
+  */
+class logFileMmap
+{
+protected:
+   char * m_data {nullptr}; ///< Pointer to the first byte of the mapped file
+   size_t m_size {0}; ///< The size of the mapping, which is the size of the file when it was opened.
+
+public:
+   logFileMmap();
+
+   logFileMmap( logFileMmap && lfm ) noexcept;
+
+   logFileMmap & operator=( logFileMmap && lfm ) noexcept;
+
+   logFileMmap( const logFileMmap & ) = delete;
+
+   logFileMmap & operator=( const logFileMmap & ) = delete;
+
+   ~logFileMmap();
+
+   /// Map a file, releasing any current mapping.
+   /**
+     * \returns 0 on success
+     * \returns -1 on error, with a message printed to stderr.
+     */
+   int open( const std::string & fname /**< [in] the full path of the file to map*/);
+
+   /// Release the current mapping, if any.
+   void close();
+
+   /// Get the pointer to the first byte of the file
+   char * data();
+
+   /// Get the size of the mapped file
+   size_t size();
+};
+
+/// Merge the binary logs of many applications into a single time-ordered stream of entries.
+/** Answers "what were all of these apps doing between T1 and T2".  The log directory is scanned once, and
+  * the files of each requested app are sorted by the timestamp in their names.  Since each file holds the entries
+  * from its own timestamp up to the timestamp of the next file, files which can not contain entries in the
+  * requested time range are never opened.
+  *
+  * Each app is then read sequentially through a memory map, one file at a time, and the apps are merged with
+  * a k-way heap merge on the entry timestamps.  Memory use is therefore bounded by one mapped file per app no
+  * matter how large the time range or log directory, and entries are delivered as they are found.
+  *
+  * Entries with equal timestamps are delivered in app name order.
+  *
+  * Example:
+  * \code
+  * logTimeline ltl;
+  * ltl.dir("/opt/MagAOX/logs");
+  * ltl.apps({"camwfs", "dmtweeter"});
+  * ltl.timeRange(t0, t1);
+  * ltl.query(std::cout, false);
+  * \endcode
+  *
+  * \ingroup logger
+  */
+class logTimeline
+{
+public:
+
+   /// The callback type.
+   /** Called once per entry in time order with the app name and a pointer to the raw log entry.  The entry
+     * points into a file mapping, and is only valid until the callback returns.  The callback returns 0 to
+     * continue, and any other value to stop the query.
+     */
+   typedef std::function<int(const std::string & appName, char * logBuffer)> callbackT;
+
+protected:
+
+   std::string m_dir; ///< The directory to search for log files.
+
+   std::string m_ext {".binlog"}; ///< The extension of the log files.
+
+   std::set<std::string> m_apps; ///< The apps to include.  If empty all apps are included.
+
+   std::set<flatlogs::eventCodeT> m_codes; ///< The event codes to include.  If empty all codes are included.
+
+   flatlogs::logPrioT m_level {flatlogs::logPrio::LOG_DEFAULT}; ///< The maximum (least severe) log level to include.
+
+   flatlogs::timespecX m_startTime {0,0}; ///< The start of the time range, inclusive.
+
+   flatlogs::timespecX m_endTime {std::numeric_limits<flatlogs::secT>::max(), 0}; ///< The end of the time range, inclusive.
+
+   size_t m_nFiles {0}; ///< The number of log files found for the requested apps by the last query
+   size_t m_nFilesOpened {0}; ///< The number of log files opened by the last query
+   size_t m_nEntries {0}; ///< The number of entries delivered by the last query
+
+   /// The reading position in one app's logs.
+   struct appCursor
+   {
+      std::string m_appName; ///< The app name
+
+      std::vector<logFileName> m_files; ///< The files to read, in time order.
+
+      size_t m_nextFile {0}; ///< The next file in m_files to open.
+
+      logFileMmap m_map; ///< The currently open file.
+
+      size_t m_pos {0}; ///< Offset of the current entry in m_map.
+
+      flatlogs::timespecX m_ts {0,0}; ///< The timestamp of the current entry.
+   };
+
+   /// Advance a cursor to the next entry which passes the filters, opening files as needed.
+   /** If the cursor has an open file, it first steps past the current entry.
+     *
+     * \returns 0 if the cursor points at an entry to deliver
+     * \returns 1 if there are no more entries for this app in the time range
+     */
+   int advance( appCursor & cur /**< [in/out] the cursor to advance */);
+
+   /// Build the cursors for the requested apps, selecting the files in the time range by their names.
+   int selectFiles( std::vector<appCursor> & cursors /**< [out] one cursor per app with files in the time range */);
+
+   /// Check if an entry passes the level and event code filters
+   bool passes( char * logBuffer /**< [in] the raw log entry*/);
+
+public:
+
+   /// Set the directory to search for log files
+   void dir( const std::string & d /**< [in] the new directory */);
+
+   /// Get the directory to search for log files
+   std::string dir();
+
+   /// Set the extension of the log files, including the '.'
+   void ext( const std::string & e /**< [in] the new extension */);
+
+   /// Get the extension of the log files
+   std::string ext();
+
+   /// Set the apps to include.  An empty set, the default, includes all apps.
+   void apps( const std::set<std::string> & a /**< [in] the new set of app names */);
+
+   /// Get the apps to include
+   std::set<std::string> apps();
+
+   /// Set the event codes to include.  An empty set, the default, includes all codes.
+   void codes( const std::set<flatlogs::eventCodeT> & c /**< [in] the new set of event codes */);
+
+   /// Get the event codes to include
+   std::set<flatlogs::eventCodeT> codes();
+
+   /// Set the maximum log level to include.  Entries with a larger (less severe) level are skipped.
+   void level( const flatlogs::logPrioT & l /**< [in] the new level */);
+
+   /// Get the maximum log level to include
+   flatlogs::logPrioT level();
+
+   /// Set the time range.  Both ends are inclusive.
+   void timeRange( const flatlogs::timespecX & st, ///< [in] the start time
+                   const flatlogs::timespecX & et  ///< [in] the end time
+                 );
+
+   /// Get the start of the time range
+   flatlogs::timespecX startTime();
+
+   /// Get the end of the time range
+   flatlogs::timespecX endTime();
+
+   /// Get the number of log files found for the requested apps by the last query
+   size_t nFiles();
+
+   /// Get the number of log files opened by the last query
+   size_t nFilesOpened();
+
+   /// Get the number of entries delivered by the last query
+   size_t nEntries();
+
+   /// Run the query, delivering each entry in time order to a callback.
+   /**
+     * \returns 0 on success, including when the callback stops the query
+     * \returns -1 on error
+     */
+   int query( callbackT callback /**< [in] the function to call for each entry */);
+
+   /// Run the query, writing each entry in time order to a stream, one per line.
+   /** Text entries are the standard format prefixed with the app name.  JSON entries are
+     * the same as `logdump -J` with an "app" member added.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int query( std::ostream & out, ///< [out] the stream to write to
+              bool json           ///< [in] if true, write one JSON document per line instead of text.
+            );
+
+};
+
+} //namespace logger
+} //namespace MagAOX
+
+#endif //logger_logTimeline_hpp
@@ -0,0 +1,186 @@
+//#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../tests/catch2/catch.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#include "../logManager.hpp"
+#include "../logFileRaw.hpp"
+
+//Count every heap allocation made in this test program.
+static std::atomic<size_t> g_nAllocs {0};
+
+void * operator new( size_t sz )
+{
+   ++g_nAllocs;
+   void * p = malloc(sz);
+   if(p == nullptr) throw std::bad_alloc();
+   return p;
+}
+
+void operator delete( void * p ) noexcept
+{
+   free(p);
+}
+
+void operator delete( void * p, size_t ) noexcept
+{
+   free(p);
+}
+
+namespace logManager_test
+{
+
+using namespace MagAOX::logger;
+
+struct testParent
+{
+   void logMessage( bufferPtrT & )
+   {
+   }
+};
+
+typedef logManager<testParent, logFileRaw> logManagerT;
+
+/// Make N log entries of type logT, returning the mean number of heap allocations per entry.
+template<typename logT, typename... argTs>
+double allocsPerLog( size_t N,
+                     const argTs &... args
+                   )
+{
+   bufferPtrT logBuffer;
+
+   //Warm up the pool and the builder memory
+   for(size_t n = 0; n < 10; ++n)
+   {
+      logManagerT::createLog<logT>(logBuffer, typename logT::messageT(args...), logPrio::LOG_TELEM);
+   }
+   logBuffer.reset();
+
+   size_t n0 = g_nAllocs;
+   for(size_t n = 0; n < N; ++n)
+   {
+      logManagerT::createLog<logT>(logBuffer, typename logT::messageT(args...), logPrio::LOG_TELEM);
+      logBuffer.reset(); //As the log thread does after writing
+   }
+
+   return static_cast<double>(g_nAllocs - n0)/N;
+}
+
+SCENARIO( "Creating log entries without allocating", "[libMagAOX::logger]" ) 
+{
+   GIVEN("common telemetry types")
+   {
+      WHEN("telem_fgtimings")
+      {
+         REQUIRE(allocsPerLog<telem_fgtimings>(1000, 0.001, 1e-6, 0.001, 1e-6, 1e-5, 1e-7) == 0);
+      }
+
+      WHEN("telem_loopgain")
+      {
+         REQUIRE(allocsPerLog<telem_loopgain>(1000, (uint8_t) 1, 0.5f, 0.99f, 0.1f) == 0);
+      }
+
+      WHEN("telem_stdcam")
+      {
+         std::string mode = "full";
+         std::string status = "OK";
+         std::string shutter = "OPEN";
+         REQUIRE(allocsPerLog<telem_stdcam>(1000, mode, 256.f, 256.f, 512, 512, 1, 1, 0.001f, 1000.f, 1.f, 10.f, -40.f, -40.f, 
+                                                  (uint8_t) 1, (uint8_t) 1, status, shutter, (int8_t) 1, (uint8_t) 0, 0.f, (uint8_t) 0) == 0);
+      }
+
+      WHEN("text_log")
+      {
+         std::string msg = "a text log entry which is long enough to not fit in a small string buffer";
+         REQUIRE(allocsPerLog<text_log>(1000, msg) == 0);
+      }
+   }
+
+   GIVEN("a log entry from the pool")
+   {
+      WHEN("it is released")
+      {
+         bufferPtrT logBuffer;
+         logManagerT::createLog<telem_fgtimings>(logBuffer, telem_fgtimings::messageT(0.001, 1e-6, 0.001, 1e-6, 1e-5, 1e-7), logPrio::LOG_TELEM);
+
+         size_t c = logBufferPool::sizeClass(logHeader::totalSize(logBuffer));
+         size_t nFree = logBufferPool::instance().nFree(c);
+
+         logBuffer.reset();
+
+         THEN("the buffer is returned to the pool")
+         {
+            REQUIRE(logBufferPool::instance().nFree(c) >= nFree + 1);
+         }
+      }
+   }
+}
+
+SCENARIO( "Building flatbuffer messages in one thread and destroying them in another", "[libMagAOX::logger]" )
+{
+   GIVEN("messages built in a thread which then exits")
+   {
+      std::vector<telem_fgtimings::messageT *> msgs;
+
+      std::thread builder([&msgs]()
+      {
+         for(size_t n = 0; n < 10; ++n)
+         {
+            msgs.push_back(new telem_fgtimings::messageT(0.001, 1e-6, 0.001, 1e-6, 1e-5, 1e-7));
+         }
+      });
+      builder.join();
+
+      WHEN("they are logged and destroyed in another thread")
+      {
+         size_t c = logBufferPool::sizeClass(1024); //The initial builder size
+         size_t nFree = logBufferPool::instance().nFree(c);
+
+         std::thread destroyer([&msgs]()
+         {
+            bufferPtrT logBuffer;
+            for(size_t n = 0; n < msgs.size(); ++n)
+            {
+               logManagerT::createLog<telem_fgtimings>(logBuffer, *msgs[n], logPrio::LOG_TELEM);
+               delete msgs[n];
+            }
+         });
+         destroyer.join();
+
+         THEN("their builder memory is returned to the pool")
+         {
+            REQUIRE(logBufferPool::instance().nFree(c) >= nFree + msgs.size());
+         }
+      }
+   }
+}
+
+TEST_CASE( "Benchmark log entry creation", "[.benchmark][libMagAOX::logger]" )
+{
+   bufferPtrT logBuffer;
+
+   BENCHMARK("telem_fgtimings")
+   {
+      logManagerT::createLog<telem_fgtimings>(logBuffer, telem_fgtimings::messageT(0.001, 1e-6, 0.001, 1e-6, 1e-5, 1e-7), logPrio::LOG_TELEM);
+      return logBuffer.get();
+   };
+
+   BENCHMARK("telem_loopgain")
+   {
+      logManagerT::createLog<telem_loopgain>(logBuffer, telem_loopgain::messageT(1, 0.5f, 0.99f, 0.1f), logPrio::LOG_TELEM);
+      return logBuffer.get();
+   };
+
+   std::string msg = "a text log entry which is long enough to not fit in a small string buffer";
+   BENCHMARK("text_log")
+   {
+      logManagerT::createLog<text_log>(logBuffer, text_log::messageT(msg), logPrio::LOG_INFO);
+      return logBuffer.get();
+   };
+}
+
+} //namespace logManager_test
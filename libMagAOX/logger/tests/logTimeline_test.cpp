@@ -0,0 +1,207 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <unistd.h>
+
+#include "../logTimeline.hpp"
+#include "../generated/logTypes.hpp"
+
+namespace logTimeline_test
+{
+
+using namespace MagAOX::logger;
+
+//2024-01-01T00:00:00 UTC
+constexpr secT t0 = 1704067200;
+
+/// Append a log entry to a log file
+template<typename logT>
+void writeLog( FILE * fout,
+               secT dt,
+               const typename logT::messageT & msg
+             )
+{
+   bufferPtrT logBuffer;
+   logHeader::createLog<logT>(logBuffer, timespecX(t0 + dt, 0), msg, logT::defaultLevel);
+   fwrite(logBuffer.get(), 1, logHeader::totalSize(logBuffer), fout);
+}
+
+/// Create a log file named for the app and the time of its first entry
+FILE * openLog( const std::string & dir,
+                const std::string & appName,
+                secT dt
+              )
+{
+   char ts[32];
+   snprintf(ts, sizeof(ts), "202401010000%02d000000000", static_cast<int>(dt));
+
+   std::string fname = dir + "/" + appName + "_" + ts + ".binlog";
+
+   return fopen(fname.c_str(), "wb");
+}
+
+/// Write two apps' logs, each split across two files, to a temporary directory
+std::string writeLogs()
+{
+   char tmpl[] = "/tmp/logTimeline_testXXXXXX";
+   std::string dir = mkdtemp(tmpl);
+
+   FILE * fout = openLog(dir, "appA", 0);
+   writeLog<text_log>(fout, 0, "A0");
+   writeLog<text_log>(fout, 2, "A2");
+   writeLog<text_log>(fout, 4, "A4");
+   fclose(fout);
+
+   fout = openLog(dir, "appA", 10);
+   writeLog<text_log>(fout, 10, "A10");
+   writeLog<text_log>(fout, 12, "A12");
+   fclose(fout);
+
+   fout = openLog(dir, "appB", 1);
+   writeLog<text_log>(fout, 1, "B1");
+   writeLog<loop_closed>(fout, 3, loop_closed::messageT());
+   writeLog<text_log>(fout, 4, "B4");
+   fclose(fout);
+
+   fout = openLog(dir, "appB", 20);
+   writeLog<text_log>(fout, 20, "B20");
+   fclose(fout);
+
+   return dir;
+}
+
+/// Run a query, collecting the app name and time offset of each entry as "app:dt"
+std::vector<std::string> collect( logTimeline & ltl )
+{
+   std::vector<std::string> out;
+
+   ltl.query( [&out](const std::string & appName, char * logBuffer)
+   {
+      out.push_back(appName + ":" + std::to_string(logHeader::timespec(logBuffer).time_s - t0));
+      return 0;
+   });
+
+   return out;
+}
+
+SCENARIO( "Merging the logs of several apps into a timeline", "[libMagAOX::logger]" )
+{
+   std::string dir = writeLogs();
+
+   logTimeline ltl;
+   ltl.dir(dir);
+
+   GIVEN("no time range")
+   {
+      WHEN("querying all apps")
+      {
+         std::vector<std::string> tl = collect(ltl);
+
+         THEN("all entries are delivered in time order, with ties in app order")
+         {
+            std::vector<std::string> expected = {"appA:0", "appB:1", "appA:2", "appB:3", "appA:4", "appB:4", "appA:10", "appA:12", "appB:20"};
+            REQUIRE(tl == expected);
+            REQUIRE(ltl.nFiles() == 4);
+            REQUIRE(ltl.nFilesOpened() == 4);
+            REQUIRE(ltl.nEntries() == 9);
+         }
+      }
+
+      WHEN("querying one app")
+      {
+         ltl.apps({"appB"});
+         std::vector<std::string> tl = collect(ltl);
+
+         THEN("only that app's entries are delivered")
+         {
+            std::vector<std::string> expected = {"appB:1", "appB:3", "appB:4", "appB:20"};
+            REQUIRE(tl == expected);
+            REQUIRE(ltl.nFiles() == 2);
+         }
+      }
+
+      WHEN("querying one event code")
+      {
+         ltl.codes({loop_closed::eventCode});
+         std::vector<std::string> tl = collect(ltl);
+
+         THEN("only entries with that code are delivered")
+         {
+            std::vector<std::string> expected = {"appB:3"};
+            REQUIRE(tl == expected);
+         }
+      }
+
+      WHEN("the callback stops the query")
+      {
+         size_t n = 0;
+         ltl.query( [&n](const std::string &, char *)
+         {
+            ++n;
+            return (n == 3) ? 1 : 0;
+         });
+
+         THEN("no more entries are delivered")
+         {
+            REQUIRE(n == 3);
+            REQUIRE(ltl.nEntries() == 3);
+         }
+      }
+
+      WHEN("writing text")
+      {
+         std::stringstream ss;
+         REQUIRE(ltl.query(ss, false) == 0);
+
+         THEN("there is one line per entry, starting with the app name")
+         {
+            std::string line;
+            size_t nlines = 0;
+            while(std::getline(ss, line))
+            {
+               REQUIRE(line.substr(0,3) == "app");
+               ++nlines;
+            }
+            REQUIRE(nlines == 9);
+         }
+      }
+   }
+
+   GIVEN("a time range")
+   {
+      WHEN("the range is inside the second file of one app")
+      {
+         ltl.timeRange(timespecX(t0+11, 0), timespecX(t0+15,0));
+         std::vector<std::string> tl = collect(ltl);
+
+         THEN("only entries in range are delivered, and files out of range are not opened")
+         {
+            std::vector<std::string> expected = {"appA:12"};
+            REQUIRE(tl == expected);
+            REQUIRE(ltl.nFiles() == 4);
+            REQUIRE(ltl.nFilesOpened() == 2); //appA's second file, and appB's first which runs until 20.
+         }
+      }
+
+      WHEN("the range ends are on entries")
+      {
+         ltl.timeRange(timespecX(t0+2, 0), timespecX(t0+4,0));
+         std::vector<std::string> tl = collect(ltl);
+
+         THEN("the range is inclusive")
+         {
+            std::vector<std::string> expected = {"appA:2", "appB:3", "appA:4", "appB:4"};
+            REQUIRE(tl == expected);
+         }
+      }
+   }
+
+   std::vector<std::string> flist = mx::ioutils::getFileNames(dir, "", "", ".binlog");
+   for(size_t n = 0; n < flist.size(); ++n) remove(flist[n].c_str());
+   rmdir(dir.c_str());
+}
+
+} //namespace logTimeline_test
@@ -13,7 +13,10 @@
 #include "flatbuffers/flatbuffers.h"
 #include "flatbuffers/idl.h"
 
+#include <vector>
+
 #include "../logMeta.hpp"
+#include "../logBufferPool.hpp"
 
 namespace MagAOX
 {
@@ -21,13 +24,48 @@ namespace logger
 {
 
 
+///A flatbuffers allocator which takes its blocks from the logBufferPool.
+/** Each fbMessage builder gets its memory from the process-wide logBufferPool, and returns it there when the
+  * message is destroyed, so once the pool has warmed up constructing a message does not allocate.  The memory
+  * belongs to the message, not to a thread, so a message may be built in one thread and destroyed in another,
+  * or outlive the thread which built it.
+  *
+  * The allocator has no state of its own, and one instance is shared by all builders.
+  *
+  * \ingroup logger_types_basic
+  */
+class fbRecyclingAllocator : public flatbuffers::Allocator
+{
+public:
+
+   ///Get the allocator shared by all builders.
+   static fbRecyclingAllocator & instance()
+   {
+      static fbRecyclingAllocator * alloc = new fbRecyclingAllocator; //Deliberately never deleted, as is the pool.
+      return *alloc;
+   }
+
+   virtual uint8_t * allocate( size_t size ) override
+   {
+      return reinterpret_cast<uint8_t *>(logBufferPool::instance().allocateBlock(size));
+   }
+
+   virtual void deallocate( uint8_t * p,
+                            size_t size
+                          ) override
+   {
+      logBufferPool::instance().releaseBlock(reinterpret_cast<char *>(p), size);
+   }
+};
+
 ///Message type for resolving log messages with a f.b. builder.
-/**
+/** The builder uses the fbRecyclingAllocator, so building a message does not normally allocate.
+  * 
   * \ingroup logger_types_basic
   */
 struct fbMessage
 {
-   flatbuffers::FlatBufferBuilder builder;
+   flatbuffers::FlatBufferBuilder builder {1024, &fbRecyclingAllocator::instance()};
 };
 
 
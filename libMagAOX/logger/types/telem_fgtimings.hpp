@@ -48,6 +48,34 @@ struct telem_fgtimings : public flatbuffer_log
          builder.Finish(fp);
       }
 
+      ///Construct from components, including the latency percentiles
+      messageT( const double & atime,          ///< [in] acquisition time deltas
+                const double & atime_jitter,   ///< [in] jitter in acquisition time deltas
+                const double & wtime,          ///< [in] write time deltas
+                const double & wtime_jitter,   ///< [in] jitter in write time deltas
+                const double & mawtime,        ///< [in] write minus acquisition times
+                const double & mawtime_jitter, ///< [in] jitter in write minus acquisition times
+                const double & atime_p50,      ///< [in] median acquisition time delta
+                const double & atime_p99,      ///< [in] 99th percentile acquisition time delta
+                const double & atime_p999,     ///< [in] 99.9th percentile acquisition time delta
+                const double & atime_max,      ///< [in] maximum acquisition time delta
+                const double & wtime_p50,      ///< [in] median write time delta
+                const double & wtime_p99,      ///< [in] 99th percentile write time delta
+                const double & wtime_p999,     ///< [in] 99.9th percentile write time delta
+                const double & wtime_max,      ///< [in] maximum write time delta
+                const double & mawtime_p50,    ///< [in] median write minus acquisition time
+                const double & mawtime_p99,    ///< [in] 99th percentile write minus acquisition time
+                const double & mawtime_p999,   ///< [in] 99.9th percentile write minus acquisition time
+                const double & mawtime_max     ///< [in] maximum write minus acquisition time
+              )
+      {  
+         auto fp = CreateTelem_fgtimings_fb(builder, atime, atime_jitter, wtime, wtime_jitter, mawtime, mawtime_jitter,
+                                                     atime_p50, atime_p99, atime_p999, atime_max,
+                                                     wtime_p50, wtime_p99, wtime_p999, wtime_max,
+                                                     mawtime_p50, mawtime_p99, mawtime_p999, mawtime_max);
+         builder.Finish(fp);
+      }
+
    };
                  
    static bool verify( flatlogs::bufferPtrT & logBuff,  ///< [in] Buffer containing the flatbuffer serialized message.
@@ -65,7 +93,7 @@ struct telem_fgtimings : public flatbuffer_log
    {
       static_cast<void>(len);
 
-      char buf[64];
+      char buf[128];
 
       auto fbs = GetTelem_fgtimings_fb(msgBuffer);
 
@@ -94,6 +122,19 @@ struct telem_fgtimings : public flatbuffer_log
       msg += " +/- ";
       snprintf(buf, sizeof(buf), "%0.5e", fbs->wmatime_jitter());
       msg += buf;
+
+      //Percentiles are only present if the latency histograms are on
+      if(fbs->atime_max() > 0 || fbs->wtime_max() > 0 || fbs->wmatime_max() > 0)
+      {
+         snprintf(buf, sizeof(buf), " acq p50/p99/p999/max: %0.5e/%0.5e/%0.5e/%0.5e", fbs->atime_p50(), fbs->atime_p99(), fbs->atime_p999(), fbs->atime_max());
+         msg += buf;
+
+         snprintf(buf, sizeof(buf), " wrt p50/p99/p999/max: %0.5e/%0.5e/%0.5e/%0.5e", fbs->wtime_p50(), fbs->wtime_p99(), fbs->wtime_p999(), fbs->wtime_max());
+         msg += buf;
+
+         snprintf(buf, sizeof(buf), " wma p50/p99/p999/max: %0.5e/%0.5e/%0.5e/%0.5e", fbs->wmatime_p50(), fbs->wmatime_p99(), fbs->wmatime_p999(), fbs->wmatime_max());
+         msg += buf;
+      }
       
       return msg;
    
@@ -135,6 +176,78 @@ struct telem_fgtimings : public flatbuffer_log
       return fbs->wmatime_jitter();
    }
 
+   static double atime_p50( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgtimings_fb(msgBuffer);
+      return fbs->atime_p50();
+   }
+
+   static double atime_p99( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgtimings_fb(msgBuffer);
+      return fbs->atime_p99();
+   }
+
+   static double atime_p999( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgtimings_fb(msgBuffer);
+      return fbs->atime_p999();
+   }
+
+   static double atime_max( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgtimings_fb(msgBuffer);
+      return fbs->atime_max();
+   }
+
+   static double wtime_p50( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgtimings_fb(msgBuffer);
+      return fbs->wtime_p50();
+   }
+
+   static double wtime_p99( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgtimings_fb(msgBuffer);
+      return fbs->wtime_p99();
+   }
+
+   static double wtime_p999( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgtimings_fb(msgBuffer);
+      return fbs->wtime_p999();
+   }
+
+   static double wtime_max( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgtimings_fb(msgBuffer);
+      return fbs->wtime_max();
+   }
+
+   static double wmatime_p50( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgtimings_fb(msgBuffer);
+      return fbs->wmatime_p50();
+   }
+
+   static double wmatime_p99( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgtimings_fb(msgBuffer);
+      return fbs->wmatime_p99();
+   }
+
+   static double wmatime_p999( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgtimings_fb(msgBuffer);
+      return fbs->wmatime_p999();
+   }
+
+   static double wmatime_max( void * msgBuffer )
+   {
+      auto fbs = GetTelem_fgtimings_fb(msgBuffer);
+      return fbs->wmatime_max();
+   }
+
    /// Get pointer to the accessor for a member by name 
    /**
      * \returns the function pointer cast to void*
@@ -148,6 +261,18 @@ struct telem_fgtimings : public flatbuffer_log
       else if(member == "wtime_jitter") return logMetaDetail({"WRT JITTER", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&wtime_jitter)});
       else if(member == "wmatime") return logMetaDetail({"WRT-ACQ TIME", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&wmatime)});
       else if(member == "wmatime_jitter") return logMetaDetail({"WRT-ACQ JITTER", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&wmatime_jitter)});
+      else if(member == "atime_p50") return logMetaDetail({"ACQ P50", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&atime_p50)});
+      else if(member == "atime_p99") return logMetaDetail({"ACQ P99", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&atime_p99)});
+      else if(member == "atime_p999") return logMetaDetail({"ACQ P99.9", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&atime_p999)});
+      else if(member == "atime_max") return logMetaDetail({"ACQ MAX", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&atime_max)});
+      else if(member == "wtime_p50") return logMetaDetail({"WRT P50", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&wtime_p50)});
+      else if(member == "wtime_p99") return logMetaDetail({"WRT P99", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&wtime_p99)});
+      else if(member == "wtime_p999") return logMetaDetail({"WRT P99.9", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&wtime_p999)});
+      else if(member == "wtime_max") return logMetaDetail({"WRT MAX", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&wtime_max)});
+      else if(member == "wmatime_p50") return logMetaDetail({"WRT-ACQ P50", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&wmatime_p50)});
+      else if(member == "wmatime_p99") return logMetaDetail({"WRT-ACQ P99", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&wmatime_p99)});
+      else if(member == "wmatime_p999") return logMetaDetail({"WRT-ACQ P99.9", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&wmatime_p999)});
+      else if(member == "wmatime_max") return logMetaDetail({"WRT-ACQ MAX", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, reinterpret_cast<void*>(&wmatime_max)});
 
       else
       {
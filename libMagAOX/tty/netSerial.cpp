@@ -10,13 +10,13 @@
 
 #include "netSerial.hpp"
 
-#include <thread>
+#include <algorithm>
 #include <chrono>
 
 #include <cstring>
 #include <cerrno>
-#include <sys/time.h>
 
+#include <poll.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -46,8 +46,15 @@ int netSerial::serialInit( const char *address,
       return NETSERIAL_E_NETWORK;
    }
       
+   m_rxLen = 0;
+
    struct hostent *h = gethostbyname(address);
 
+   if(h == nullptr)
+   {
+      return NETSERIAL_E_NETWORK;
+   }
+
    servaddr.sin_family=AF_INET;
    servaddr.sin_port=htons(port);
    memcpy( &servaddr.sin_addr, h->h_addr_list[0], h->h_length);
@@ -82,7 +89,7 @@ int netSerial::serialOut( const char *buf,
       {
          i+= stat;
       }
-      if ((stat<0) && (stat != EAGAIN))
+      if ((stat<0) && (errno != EAGAIN) && (errno != EINTR))
       {
          return NETSERIAL_E_COMM;
       }
@@ -91,6 +98,57 @@ int netSerial::serialOut( const char *buf,
    return NETSERIAL_E_NOERROR;
 }
 
+int netSerial::fill( const std::chrono::steady_clock::time_point & deadline )
+{
+   if(m_rxLen == rxBufSize) return 0;
+
+   while(true)
+   {
+      auto now = std::chrono::steady_clock::now();
+      if(now >= deadline) return 0;
+
+      int timeout = std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+
+      struct pollfd pfd;
+      pfd.fd = m_sockfd;
+      pfd.events = POLLIN;
+
+      int rv = poll(&pfd, 1, timeout);
+
+      if(rv < 0)
+      {
+         //Interrupted by a signal, so keep going until the deadline.
+         if(errno == EINTR) continue;
+         return NETSERIAL_E_COMM;
+      }
+
+      if(rv == 0) return 0;
+
+      ssize_t nr = recv( m_sockfd, m_rxBuf + m_rxLen, rxBufSize - m_rxLen, 0);
+
+      if(nr < 0)
+      {
+         if(errno == EINTR) continue;
+         return NETSERIAL_E_COMM;
+      }
+
+      if(nr == 0) return NETSERIAL_E_COMM; //closed
+
+      m_rxLen += nr;
+
+      return nr;
+   }
+}
+
+void netSerial::consume( char *buf,
+                         size_t n
+                       )
+{
+   memcpy(buf, m_rxBuf, n);
+   m_rxLen -= n;
+   memmove(m_rxBuf, m_rxBuf + n, m_rxLen);
+}
+
 int netSerial::serialIn( char *buffer, 
                          int len, 
                          int timeout
@@ -100,25 +158,19 @@ int netSerial::serialIn( char *buffer,
 
    memset( buffer, 0, len);
 
+   auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
    while (res < len)
    {
-      fd_set rdfs;
-      struct timeval tv;
-      int retval;
-
-      memset( &tv, 0, sizeof( struct timeval));
-      FD_ZERO( &rdfs);
-      FD_SET( m_sockfd, &rdfs);
-      tv.tv_sec = timeout / 1000;
-      tv.tv_usec = (timeout-(timeout/1000)*1000)*1000;
-
-      retval = select( m_sockfd+1, &rdfs, NULL, NULL, &tv);
-      if (!retval)
-         return res;
-
-      res += recv( m_sockfd, buffer+res, len-res, 0);
+      if(m_rxLen > 0)
+      {
+         size_t n = std::min<size_t>(m_rxLen, len-res);
+         consume(buffer+res, n);
+         res += n;
+         continue;
+      }
 
-      std::this_thread::sleep_for(std::chrono::milliseconds(3));
+      if(fill(deadline) <= 0) return res;
    }
    
    return res;
@@ -130,126 +182,98 @@ int netSerial::serialInString( char *buffer,
                                char terminator
                              )
 {
-   int res=0;
-   struct timeval tv0, tv1;
-   double t0, t1;
-   
+   if(len < 1) return 0;
+
    memset( buffer, 0, len);
 
-   #ifdef DEBUG
-      printf("initial timeout = %i\n", timeout);
-   #endif
-      
-   gettimeofday(&tv0, 0);
-   t0 = ((double)tv0.tv_sec + (double)tv0.tv_usec/1e6);
+   auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
 
-   gettimeofday(&tv1, 0);
-   t1 = ((double)tv1.tv_sec + (double)tv1.tv_usec/1e6);
+   size_t maxLen = len - 1;
+   size_t scanned = 0;
 
-   while (res < len && ((t1-t0)*1000. < timeout))
+   while(true)
    {
-      fd_set rdfs;
-      struct timeval tv;
-      int retval;
-
-      memset( &tv, 0, sizeof( struct timeval));
-      FD_ZERO( &rdfs);
-      FD_SET( m_sockfd, &rdfs);
-      tv.tv_sec = timeout / 1000;
-      tv.tv_usec = (timeout-(timeout/1000)*1000)*1000;
-
-      #ifdef DEBUG
-         printf("Selecting . . .\n");
-      #endif
-         
-      /* Making this a signal-safe call to select*/
-      /*JRM: otherwise, signals will cause select to return
-          causing this loop to never timeout*/
-         
-      int signaled = 1;
-
-      retval = 0;
-      
-      while(signaled && ((t1-t0)*1000. < timeout))
+      char * term = (char *) memchr(m_rxBuf + scanned, terminator, m_rxLen - scanned);
+
+      size_t n;
+
+      if(term)
+      {
+         n = std::min<size_t>(term - m_rxBuf + 1, maxLen);
+      }
+      else if(m_rxLen >= maxLen || m_rxLen == rxBufSize)
+      {
+         n = std::min(m_rxLen, maxLen);
+      }
+      else
       {
-         errno = 0;
-         signaled = 0;
-         retval = select(m_sockfd+1, &rdfs, NULL, NULL, &tv);
-         if(retval < 0)
+         scanned = m_rxLen;
+
+         if(fill(deadline) > 0) continue;
+
+         n = m_rxLen; //timed out, return what we have
+      }
+
+      consume(buffer, n);
+      buffer[n] = 0;
+
+      return n;
+   }
+}
+
+int netSerial::serialQuery( const char *requests,
+                            int len,
+                            char **responses,
+                            int nResponses,
+                            int respLen,
+                            int timeout,
+                            char terminator
+                          )
+{
+   if(serialOut(requests, len) != NETSERIAL_E_NOERROR) return NETSERIAL_E_COMM;
+
+   for(int r = 0; r < nResponses; ++r)
+   {
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+      size_t scanned = 0;
+      char * term;
+
+      while( (term = (char *) memchr(m_rxBuf + scanned, terminator, m_rxLen - scanned)) == nullptr)
+      {
+         scanned = m_rxLen;
+
+         int rv = fill(deadline);
+         if(rv < 0) return NETSERIAL_E_COMM;
+         if(rv == 0)
          {
-            //This means select was interrupted by a signal, so keep going.
-            if(errno == EINTR)
-            {
-               #ifdef DEBUG
-                  printf("EINTR\n");
-               #endif
-                  
-               signaled = 1;
-               gettimeofday(&tv1, 0);
-               t1 = ((double)tv1.tv_sec + (double)tv1.tv_usec/1e6) ;
-               //Reset for smaller timeout
-               timeout = timeout - (t1-t0)*1000.;
-
-               #ifdef DEBUG
-                  printf("t1-t0 = %f\n", (t1-t0)*1000);
-                  printf("timeout = %i\n", timeout);
-               #endif
-               
-               tv.tv_sec = timeout / 1000;
-               tv.tv_usec = (timeout-(timeout/1000)*1000)*1000;
-               if(tv.tv_sec < 0) tv.tv_sec = 0;
-               if(tv.tv_usec < 0) tv.tv_usec = 0;
-                  
-            }
+            //The buffer is full without a terminator, so the response can't be read.
+            if(m_rxLen == rxBufSize) return NETSERIAL_E_COMM;
+            return r;
          }
       }
 
-      #ifdef DEBUG
-         printf("select returned %i . . .\n", retval);
-      #endif
-      
-      if (retval <= 0) //this means we timed out or had an error
-            return res;
-
-      #ifdef DEBUG
-         printf("Starting read . . .\n");
-      #endif
-            
-      res += recv( m_sockfd, buffer+res, len-res, 0);
-      
-      #ifdef DEBUG
-         printf("Read %i bytes. . .\n", res);
-      #endif
-
-      buffer[res] =0;
-         
-      #ifdef DEBUG
-         printf("SerialInString received %d bytes: %s\n", res, buffer);
-      #endif
-         
-      if (strchr( buffer, terminator)) return res;
-
-      gettimeofday(&tv1, 0);
-      t1 = ((double)tv1.tv_sec + (double)tv1.tv_usec/1e6);
-
-      #ifdef DEBUG
-         printf("t1-t0 = %f\n", (t1-t0)*1000.);
-         printf("timeout = %i\n", timeout);
-      #endif
-
-      std::this_thread::sleep_for(std::chrono::milliseconds(3));
+      size_t n = term - m_rxBuf;
+      size_t nc = std::min<size_t>(n, respLen - 1);
+
+      memcpy(responses[r], m_rxBuf, nc);
+      responses[r][nc] = 0;
+
+      m_rxLen -= n + 1;
+      memmove(m_rxBuf, term + 1, m_rxLen);
    }
 
-   
-   #ifdef DEBUG
-      int i;
-      printf("SerialIn(): received %d characters:\n", res);
-   
-      for ( i=0; i<res; i++) printf("0x%02X ", (unsigned char) buffer[i]);
-      printf("\n");
-   #endif
+   return nResponses;
+}
 
-   return res;
+void netSerial::serialFlush()
+{
+   m_rxLen = 0;
+}
+
+size_t netSerial::serialBuffered() const
+{
+   return m_rxLen;
 }
 
 int netSerial::getSocketFD(void)
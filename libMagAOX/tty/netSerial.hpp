@@ -11,6 +11,9 @@
 #ifndef tty_netSerial_hpp
 #define tty_netSerial_hpp
 
+#include <chrono>
+#include <cstddef>
+
 #define NETSERIAL_E_NOERROR   (0)
 #define NETSERIAL_E_NETWORK   (-50000)
 #define NETSERIAL_E_CONNECT   (-50010)
@@ -22,17 +25,36 @@ namespace tty
 {
 
 /// Manage a connectio to a serial device over a network 
-/**
+/** Input is read through one persistent receive buffer, with poll and recv.  Bytes received after a terminator are
+  * kept for the next read, so several requests can be outstanding at once (see serialQuery).  Timeouts are deadlines
+  * for the whole read, and there are no fixed sleeps.
   *
   * \todo document this, including methods
   * \todo add errors to ttyErrors
   */ 
 struct netSerial
 {
-   
+   static constexpr size_t rxBufSize {4096}; ///< The size of the receive buffer.
+
 protected:
    int m_sockfd {-1};
-   
+
+   char m_rxBuf[rxBufSize]; ///< The receive buffer
+   size_t m_rxLen {0};      ///< The number of bytes in the receive buffer
+
+   /// Wait for input and append it to the receive buffer
+   /**
+     * \returns the number of bytes received
+     * \returns 0 if the deadline passed, or the buffer is full
+     * \returns NETSERIAL_E_COMM on an error, or if the connection was closed
+     */
+   int fill( const std::chrono::steady_clock::time_point & deadline /**< [in] the time to wait until */);
+
+   /// Copy bytes from the front of the receive buffer, and remove them from it
+   void consume( char *buf, ///< [out] the destination, at least n bytes long
+                 size_t n   ///< [in] the number of bytes
+               );
+
 public:
 
    int serialInit( const char *address, 
@@ -50,10 +72,16 @@ public:
                  int timeout
                );
    
-   int serialInString( char *buf, 
-                       int len, 
-                       int timeout, 
-                       char terminator
+   /// Read up to and including a terminator
+   /** Anything received after the terminator is kept for the next read.  The result is null terminated, so at most
+     * len-1 bytes are returned.  If the terminator is not found by the deadline, what has been received is returned.
+     *
+     * \returns the number of bytes read, including the terminator
+     */
+   int serialInString( char *buf,      ///< [out] the string read
+                       int len,        ///< [in] the size of buf
+                       int timeout,    ///< [in] the timeout [msec]
+                       char terminator ///< [in] the terminator
                      );
    
    int serialInString2( char *buf, 
@@ -62,6 +90,29 @@ public:
                         char *terminator
                       );
 
+   /// Send several requests at once, then read the terminated response to each in order
+   /** The requests are written with one send, so the device receives them back-to-back and the cost is a single
+     * round trip.  The terminators are removed from the responses, which are null terminated and truncated to
+     * respLen-1 bytes.
+     *
+     * \returns the number of responses read, which is less than nResponses if one timed out
+     * \returns NETSERIAL_E_COMM on a send or receive error
+     */
+   int serialQuery( const char *requests, ///< [in] the terminated requests, concatenated
+                    int len,              ///< [in] the length of requests
+                    char **responses,     ///< [out] nResponses buffers for the responses, each respLen long
+                    int nResponses,       ///< [in] the number of responses to read
+                    int respLen,          ///< [in] the size of each response buffer
+                    int timeout,          ///< [in] the timeout for each response [msec]
+                    char terminator       ///< [in] the response terminator
+                  );
+
+   /// Discard any buffered input
+   void serialFlush();
+
+   /// Get the number of bytes received but not yet read
+   size_t serialBuffered() const;
+
    int getSocketFD(void);
 
 };
@@ -0,0 +1,348 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../tests/catch2/catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../netSerial.hpp"
+
+namespace netSerial_test
+{
+
+using namespace MagAOX::tty;
+
+/// A loopback line echo server
+/** Each received line is echoed back, in m_chunks separate sends.  The line "silent" is not answered.
+  */
+struct echoServer
+{
+   int m_chunks {1};
+
+   int m_listenfd {-1};
+   int m_port {0};
+   std::thread m_thread;
+   std::atomic<bool> m_stop {false};
+
+   ~echoServer()
+   {
+      m_stop = true;
+      if(m_thread.joinable()) m_thread.join();
+      if(m_listenfd >= 0) close(m_listenfd);
+   }
+
+   int start()
+   {
+      m_listenfd = socket(AF_INET, SOCK_STREAM, 0);
+
+      struct sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+      socklen_t alen = sizeof(addr);
+      if(bind(m_listenfd, (struct sockaddr *) &addr, sizeof(addr)) < 0) return -1;
+      if(listen(m_listenfd, 1) < 0) return -1;
+      if(getsockname(m_listenfd, (struct sockaddr *) &addr, &alen) < 0) return -1;
+
+      m_port = ntohs(addr.sin_port);
+
+      m_thread = std::thread([this](){ run(); });
+
+      return 0;
+   }
+
+   bool waitReadable( int fd )
+   {
+      while(!m_stop)
+      {
+         struct pollfd pfd;
+         pfd.fd = fd;
+         pfd.events = POLLIN;
+         if(poll(&pfd, 1, 50) > 0) return true;
+      }
+      return false;
+   }
+
+   void run()
+   {
+      if(!waitReadable(m_listenfd)) return;
+
+      int fd = accept(m_listenfd, nullptr, nullptr);
+      if(fd < 0) return;
+
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+      std::string rx;
+      char buf[4096];
+
+      while(waitReadable(fd))
+      {
+         ssize_t nr = recv(fd, buf, sizeof(buf), 0);
+         if(nr <= 0) break;
+         rx.append(buf, nr);
+
+         size_t nl;
+         while((nl = rx.find('\n')) != std::string::npos)
+         {
+            std::string line = rx.substr(0, nl + 1);
+            rx.erase(0, nl + 1);
+
+            if(line == "silent\n") continue;
+
+            size_t csz = (line.size() + m_chunks - 1) / m_chunks;
+            for(size_t st = 0; st < line.size(); st += csz)
+            {
+               if(st > 0) std::this_thread::sleep_for(std::chrono::microseconds(100));
+               send(fd, line.data() + st, std::min(csz, line.size() - st), MSG_NOSIGNAL);
+            }
+         }
+      }
+
+      close(fd);
+   }
+};
+
+/// The original netSerial::serialInString, which sleeps 3 msec after each read without the terminator
+int referenceInString( int sockfd,
+                       char *buffer,
+                       int len,
+                       int timeout,
+                       char terminator
+                     )
+{
+   int res=0;
+   struct timeval tv0, tv1;
+   double t0, t1;
+
+   memset( buffer, 0, len);
+
+   gettimeofday(&tv0, 0);
+   t0 = ((double)tv0.tv_sec + (double)tv0.tv_usec/1e6);
+   t1 = t0;
+
+   while (res < len && ((t1-t0)*1000. < timeout))
+   {
+      fd_set rdfs;
+      struct timeval tv;
+
+      memset( &tv, 0, sizeof( struct timeval));
+      FD_ZERO( &rdfs);
+      FD_SET( sockfd, &rdfs);
+      tv.tv_sec = timeout / 1000;
+      tv.tv_usec = (timeout-(timeout/1000)*1000)*1000;
+
+      int retval = select(sockfd+1, &rdfs, NULL, NULL, &tv);
+      if (retval <= 0) return res;
+
+      res += recv( sockfd, buffer+res, len-res, 0);
+      buffer[res] = 0;
+
+      if (strchr( buffer, terminator)) return res;
+
+      gettimeofday(&tv1, 0);
+      t1 = ((double)tv1.tv_sec + (double)tv1.tv_usec/1e6);
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(3));
+   }
+
+   return res;
+}
+
+SCENARIO( "Reading from a network serial connection", "[libMagAOX::tty::netSerial]" )
+{
+   GIVEN("a connection to an echo server")
+   {
+      echoServer server;
+      REQUIRE(server.start() == 0);
+
+      netSerial sock;
+      REQUIRE(sock.serialInit("localhost", server.m_port) == NETSERIAL_E_NOERROR);
+
+      char buf[256];
+
+      WHEN("two lines arrive together")
+      {
+         REQUIRE(sock.serialOut("first\nsecond\n", 13) == NETSERIAL_E_NOERROR);
+
+         THEN("they are read one at a time")
+         {
+            REQUIRE(sock.serialInString(buf, sizeof(buf), 1000, '\n') == 6);
+            REQUIRE(std::string(buf) == "first\n");
+
+            REQUIRE(sock.serialInString(buf, sizeof(buf), 1000, '\n') == 7);
+            REQUIRE(std::string(buf) == "second\n");
+
+            REQUIRE(sock.serialBuffered() == 0);
+         }
+      }
+
+      WHEN("the reply arrives in several packets")
+      {
+         server.m_chunks = 4;
+         REQUIRE(sock.serialOut("a longer line in pieces\n", 24) == NETSERIAL_E_NOERROR);
+
+         THEN("the whole line is read")
+         {
+            REQUIRE(sock.serialInString(buf, sizeof(buf), 1000, '\n') == 24);
+            REQUIRE(std::string(buf) == "a longer line in pieces\n");
+         }
+      }
+
+      WHEN("the buffer is too small for the line")
+      {
+         REQUIRE(sock.serialOut("0123456789\n", 11) == NETSERIAL_E_NOERROR);
+
+         THEN("the line is returned in parts")
+         {
+            REQUIRE(sock.serialInString(buf, 6, 1000, '\n') == 5);
+            REQUIRE(std::string(buf) == "01234");
+            REQUIRE(sock.serialInString(buf, sizeof(buf), 1000, '\n') == 6);
+            REQUIRE(std::string(buf) == "56789\n");
+         }
+      }
+
+      WHEN("reading a fixed number of bytes")
+      {
+         REQUIRE(sock.serialOut("abc\ndef\n", 8) == NETSERIAL_E_NOERROR);
+
+         THEN("exactly that many are read")
+         {
+            REQUIRE(sock.serialIn(buf, 6, 1000) == 6);
+            REQUIRE(std::string(buf, 6) == "abc\nde");
+            REQUIRE(sock.serialInString(buf, sizeof(buf), 1000, '\n') == 2);
+            REQUIRE(std::string(buf) == "f\n");
+         }
+      }
+
+      WHEN("there is no reply")
+      {
+         REQUIRE(sock.serialOut("silent\n", 7) == NETSERIAL_E_NOERROR);
+
+         auto t0 = std::chrono::steady_clock::now();
+         int rv = sock.serialInString(buf, sizeof(buf), 50, '\n');
+         double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+         THEN("the read times out at the deadline")
+         {
+            REQUIRE(rv == 0);
+            REQUIRE(dt >= 0.049);
+            REQUIRE(dt < 0.5);
+         }
+      }
+
+      WHEN("querying with several outstanding requests")
+      {
+         char r0[4], r1[4], r2[4];
+         char * resp[] = {r0, r1, r2};
+
+         const char * req = "one\ntwo\nthree\n";
+         int rv = sock.serialQuery(req, strlen(req), resp, 3, 4, 1000, '\n');
+
+         THEN("the responses are read in order, without terminators")
+         {
+            REQUIRE(rv == 3);
+            REQUIRE(std::string(r0) == "one");
+            REQUIRE(std::string(r1) == "two");
+            REQUIRE(std::string(r2) == "thr"); //truncated
+            REQUIRE(sock.serialBuffered() == 0);
+         }
+      }
+
+      WHEN("a query times out")
+      {
+         char r0[16], r1[16];
+         char * resp[] = {r0, r1};
+
+         const char * req = "one\nsilent\n";
+         int rv = sock.serialQuery(req, strlen(req), resp, 2, 16, 50, '\n');
+
+         THEN("the number of responses received is returned")
+         {
+            REQUIRE(rv == 1);
+            REQUIRE(std::string(r0) == "one");
+         }
+      }
+
+      sock.serialClose();
+   }
+}
+
+TEST_CASE( "Benchmark network serial reads", "[.benchmark][libMagAOX::tty::netSerial]" )
+{
+   const char * req = "datetime 12:20:50.26 -22:30:48.87 2000.0 -01:12:20.5 1.052 45.000\n";
+   int reqLen = strlen(req);
+
+   char buf[512];
+
+   for(int chunks : {1, 4})
+   {
+      echoServer server;
+      server.m_chunks = chunks;
+      REQUIRE(server.start() == 0);
+
+      netSerial sock;
+      REQUIRE(sock.serialInit("localhost", server.m_port) == NETSERIAL_E_NOERROR);
+
+      std::string sz = " packets=" + std::to_string(chunks);
+
+      BENCHMARK("original serialInString" + sz)
+      {
+         sock.serialOut(req, reqLen);
+         return referenceInString(sock.getSocketFD(), buf, sizeof(buf), 1000, '\n');
+      };
+
+      BENCHMARK("serialInString" + sz)
+      {
+         sock.serialOut(req, reqLen);
+         return sock.serialInString(buf, sizeof(buf), 1000, '\n');
+      };
+
+      sock.serialClose();
+   }
+
+   echoServer server;
+   REQUIRE(server.start() == 0);
+
+   netSerial sock;
+   REQUIRE(sock.serialInit("localhost", server.m_port) == NETSERIAL_E_NOERROR);
+
+   std::string reqs;
+   for(int n = 0; n < 6; ++n) reqs += req;
+
+   char resp[6][512];
+   char * resps[6];
+   for(int n = 0; n < 6; ++n) resps[n] = resp[n];
+
+   BENCHMARK("6 requests, serialInString each")
+   {
+      int rv = 0;
+      for(int n = 0; n < 6; ++n)
+      {
+         sock.serialOut(req, reqLen);
+         rv += sock.serialInString(buf, sizeof(buf), 1000, '\n');
+      }
+      return rv;
+   };
+
+   BENCHMARK("6 requests, serialQuery")
+   {
+      return sock.serialQuery(reqs.c_str(), reqs.size(), resps, 6, 512, 1000, '\n');
+   };
+
+   sock.serialClose();
+}
+
+} //namespace netSerial_test
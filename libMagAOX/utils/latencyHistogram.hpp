@@ -0,0 +1,189 @@
+/** \file latencyHistogram.hpp
+  * \brief A lock-free log-bucketed histogram for latency percentiles.
+  *
+  * \ingroup app_files
+  */
+
+#ifndef utils_latencyHistogram_hpp
+#define utils_latencyHistogram_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <cmath>
+#include <ctime>
+
+namespace MagAOX
+{
+namespace utils
+{
+
+/// Percentile statistics of a latency histogram over an interval, in seconds.
+struct latencyStats
+{
+   uint64_t count {0}; ///< The number of values in the interval
+   double p50 {0};     ///< The median
+   double p99 {0};     ///< The 99th percentile
+   double p999 {0};    ///< The 99.9th percentile
+   double max {0};     ///< The maximum
+};
+
+/// A log-bucketed (HDR-style) histogram of latencies, for tail percentiles.
+/** Values are recorded in nanoseconds.  Values below 2^subBucketBits ns have their own buckets, and above that each
+  * power of two is split into 2^(subBucketBits-1) equal buckets, so the relative precision of a percentile is
+  * better than 2^-(subBucketBits-1), about 3%.  Values above 2^maxBits ns (about 68 s) go in the last bucket.
+  *
+  * There is one writer, which calls record(), and one reader which calls the other non-static members.  The writer
+  * never waits: counts are cumulative atomics which only the writer changes, and the reader resets an interval by
+  * remembering the counts at the start of it.  The maximum is the exact maximum since the last reset.
+  *
+  * \ingroup appdev
+  */
+class latencyHistogram
+{
+public:
+   static constexpr int subBucketBits = 6; ///< The number of bits resolved within each power of two.
+
+   static constexpr int maxBits = 36; ///< The number of bits in the largest value resolved.
+
+   static constexpr size_t subBuckets = (static_cast<size_t>(1) << (subBucketBits-1)); ///< Buckets per power of two.
+
+   static constexpr size_t nBuckets = (maxBits - subBucketBits + 2) * subBuckets; ///< The total number of buckets.
+
+protected:
+   std::atomic<uint64_t> m_counts[nBuckets]; ///< Cumulative counts, written only by the writer.
+
+   std::atomic<uint64_t> m_max {0}; ///< The maximum value since the last reset.
+
+   uint64_t m_baseline[nBuckets]; ///< The counts at the last reset, used only by the reader.
+
+   uint64_t m_interval[nBuckets]; ///< Working memory for the counts in the current interval, used only by the reader.
+
+public:
+
+   latencyHistogram()
+   {
+      for(size_t n = 0; n < nBuckets; ++n)
+      {
+         m_counts[n].store(0, std::memory_order_relaxed);
+         m_baseline[n] = 0;
+         m_interval[n] = 0;
+      }
+   }
+
+   /// Get the bucket for a value
+   /**
+     * \returns the bucket index
+     */
+   static size_t bucketIndex( uint64_t ns /**< [in] the value */)
+   {
+      if(ns < (static_cast<uint64_t>(1) << subBucketBits)) return ns;
+
+      if(ns >= (static_cast<uint64_t>(1) << maxBits)) return nBuckets - 1;
+
+      int msb = 63 - __builtin_clzll(ns);
+      int e = msb - subBucketBits + 1;
+
+      return e*subBuckets + (ns >> e);
+   }
+
+   /// Get the largest value which goes in a bucket
+   /**
+     * \returns the upper bound, inclusive, of the bucket in ns
+     */
+   static uint64_t bucketHigh( size_t idx /**< [in] the bucket index */)
+   {
+      if(idx < (static_cast<size_t>(1) << subBucketBits)) return idx;
+
+      int e = (idx / subBuckets) - 1;
+      uint64_t mant = idx - e*subBuckets;
+
+      return ((mant + 1) << e) - 1;
+   }
+
+   /// Record a value.  Only the writer may call this.
+   /** Negative values are recorded as 0.
+     */
+   void record( int64_t ns /**< [in] the value in nanoseconds */)
+   {
+      uint64_t v = (ns > 0) ? ns : 0;
+
+      std::atomic<uint64_t> & c = m_counts[bucketIndex(v)];
+      c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+      uint64_t mx = m_max.load(std::memory_order_relaxed);
+      while(v > mx && !m_max.compare_exchange_weak(mx, v, std::memory_order_relaxed));
+   }
+
+   /// Record the difference between two times.  Only the writer may call this.
+   void record( const timespec & t1, ///< [in] the later time
+                const timespec & t0  ///< [in] the earlier time
+              )
+   {
+      record( (static_cast<int64_t>(t1.tv_sec) - t0.tv_sec)*1000000000 + (static_cast<int64_t>(t1.tv_nsec) - t0.tv_nsec));
+   }
+
+   /// Start a new interval
+   void reset()
+   {
+      for(size_t n = 0; n < nBuckets; ++n)
+      {
+         m_baseline[n] = m_counts[n].load(std::memory_order_relaxed);
+      }
+
+      m_max.store(0, std::memory_order_relaxed);
+   }
+
+   /// Get the percentiles of the current interval
+   void stats( latencyStats & st, ///< [out] the statistics in seconds
+               bool reset = false ///< [in] [optional] if true, start a new interval
+             )
+   {
+      st.count = 0;
+      for(size_t n = 0; n < nBuckets; ++n)
+      {
+         uint64_t c = m_counts[n].load(std::memory_order_relaxed);
+         m_interval[n] = c - m_baseline[n];
+         st.count += m_interval[n];
+
+         if(reset) m_baseline[n] = c;
+      }
+
+      uint64_t mx = reset ? m_max.exchange(0, std::memory_order_relaxed) : m_max.load(std::memory_order_relaxed);
+
+      st.p50 = percentile(m_interval, st.count, 0.5)/1e9;
+      st.p99 = percentile(m_interval, st.count, 0.99)/1e9;
+      st.p999 = percentile(m_interval, st.count, 0.999)/1e9;
+      st.max = (st.count > 0) ? mx/1e9 : 0;
+   }
+
+   /// Calculate a percentile from bucket counts
+   /** The result is the upper bound of the bucket containing the percentile.
+     *
+     * \returns the percentile in ns
+     * \returns 0 if there are no values
+     */
+   static uint64_t percentile( const uint64_t * counts, ///< [in] the bucket counts
+                               uint64_t total,          ///< [in] the sum of counts
+                               double p                 ///< [in] the percentile, as a fraction from 0 to 1
+                             )
+   {
+      if(total == 0) return 0;
+
+      uint64_t rank = std::ceil(p*total);
+      if(rank < 1) rank = 1;
+
+      uint64_t sum = 0;
+      for(size_t n = 0; n < nBuckets; ++n)
+      {
+         sum += counts[n];
+         if(sum >= rank) return bucketHigh(n);
+      }
+
+      return bucketHigh(nBuckets - 1);
+   }
+};
+
+} //namespace utils
+} //namespace MagAOX
+
+#endif //utils_latencyHistogram_hpp
@@ -0,0 +1,244 @@
+/** \file runningStats.hpp
+  * \brief Mean and variance over several sliding windows of a series, updated in O(1) per sample.
+  *
+  * \ingroup app_files
+  */
+
+#ifndef utils_runningStats_hpp
+#define utils_runningStats_hpp
+
+#include <cstdint>
+#include <vector>
+
+namespace MagAOX
+{
+namespace utils
+{
+
+/// Mean and variance over several sliding windows of the latest samples of a series.
+/** Each window keeps running sums of the samples and their squares, which are updated as each sample enters and
+  * leaves, so adding a sample costs O(1) per window and the statistics are available at any time without
+  * looping over the history.
+  *
+  * To control round-off the sums are of the samples minus a shift, and are replaced every window length by fresh
+  * sums.  Alongside the running sums, each window accumulates a fresh sum of the samples minus a new shift, the
+  * window's mean when it was started.  Once it has seen as many samples as the window holds it is exactly the
+  * window's sum, and replaces the running sum.  This also costs O(1) per sample, so no call to add loops over the
+  * history.
+  *
+  * The variance is the sample variance, normalized by N-1, to match mx::math::vectorVariance.
+  *
+  * Not thread safe.
+  *
+  * \tparam realT the floating point type of the samples and the sums
+  *
+  * \ingroup appdev
+  */
+template<typename realT>
+class runningStats
+{
+protected:
+   std::vector<size_t> m_windows; ///< The length of each window
+
+   std::vector<realT> m_hist; ///< The history, as long as the longest window
+
+   size_t m_next {0}; ///< The index in m_hist of the next sample
+
+   uint64_t m_samples {0}; ///< The number of samples added since the last reset
+
+   std::vector<realT> m_shift; ///< The shift subtracted from the samples in the sums of each window
+
+   std::vector<realT> m_sum; ///< The sum of each window
+
+   std::vector<realT> m_sumSq; ///< The sum of squares of each window
+
+   std::vector<realT> m_freshShift; ///< The shift of the fresh sums of each window
+
+   std::vector<realT> m_freshSum; ///< The fresh sum of each window, which replaces m_sum when complete
+
+   std::vector<realT> m_freshSumSq; ///< The fresh sum of squares of each window, which replaces m_sumSq when complete
+
+   std::vector<size_t> m_freshCount; ///< The number of samples in the fresh sums of each window
+
+public:
+
+   /// Set the window lengths, which resets the statistics.
+   void windows( const std::vector<size_t> & lens /**< [in] the length of each window, in samples */)
+   {
+      m_windows = lens;
+
+      size_t maxLen = 0;
+      for(size_t w = 0; w < m_windows.size(); ++w)
+      {
+         if(m_windows[w] > maxLen) maxLen = m_windows[w];
+      }
+
+      m_hist.assign(maxLen, 0);
+      m_shift.resize(m_windows.size());
+      m_sum.resize(m_windows.size());
+      m_sumSq.resize(m_windows.size());
+      m_freshShift.resize(m_windows.size());
+      m_freshSum.resize(m_windows.size());
+      m_freshSumSq.resize(m_windows.size());
+      m_freshCount.resize(m_windows.size());
+
+      reset();
+   }
+
+   /// Set a single window length, which resets the statistics.
+   void windows( size_t len /**< [in] the length of the window, in samples */)
+   {
+      windows(std::vector<size_t>({len}));
+   }
+
+   /// Clear the history, keeping the window lengths.
+   void reset()
+   {
+      m_next = 0;
+      m_samples = 0;
+
+      for(size_t w = 0; w < m_sum.size(); ++w)
+      {
+         m_shift[w] = 0;
+         m_sum[w] = 0;
+         m_sumSq[w] = 0;
+         m_freshShift[w] = 0;
+         m_freshSum[w] = 0;
+         m_freshSumSq[w] = 0;
+         m_freshCount[w] = 0;
+      }
+   }
+
+   /// Add a sample
+   void add( realT x /**< [in] the new sample */)
+   {
+      size_t nH = m_hist.size();
+      if(nH == 0) return;
+
+      for(size_t w = 0; w < m_windows.size(); ++w)
+      {
+         size_t len = m_windows[w];
+         if(len == 0) continue;
+
+         if(m_samples == 0)
+         {
+            m_shift[w] = x;
+            m_freshShift[w] = x;
+         }
+
+         realT v = x - m_shift[w];
+         m_sum[w] += v;
+         m_sumSq[w] += v*v;
+
+         if(m_samples >= len)
+         {
+            realT old = m_hist[(m_next + nH - len) % nH] - m_shift[w];
+            m_sum[w] -= old;
+            m_sumSq[w] -= old*old;
+         }
+
+         realT f = x - m_freshShift[w];
+         m_freshSum[w] += f;
+         m_freshSumSq[w] += f*f;
+
+         //The fresh sums now hold exactly the samples in the window, so they replace the running sums and start over.
+         if(++m_freshCount[w] >= len)
+         {
+            m_shift[w] = m_freshShift[w];
+            m_sum[w] = m_freshSum[w];
+            m_sumSq[w] = m_freshSumSq[w];
+
+            m_freshShift[w] = m_shift[w] + m_sum[w]/len;
+            m_freshSum[w] = 0;
+            m_freshSumSq[w] = 0;
+            m_freshCount[w] = 0;
+         }
+      }
+
+      m_hist[m_next] = x;
+      ++m_next;
+      if(m_next >= nH) m_next = 0;
+
+      ++m_samples;
+   }
+
+   /// Get the number of windows
+   size_t nWindows() const
+   {
+      return m_windows.size();
+   }
+
+   /// Get the length of a window
+   size_t window( size_t w /**< [in] the window */) const
+   {
+      return m_windows[w];
+   }
+
+   /// Get the number of samples added since the last reset
+   uint64_t samples() const
+   {
+      return m_samples;
+   }
+
+   /// Get the number of samples currently in a window
+   size_t count( size_t w /**< [in] the window */) const
+   {
+      return (m_samples < m_windows[w]) ? m_samples : m_windows[w];
+   }
+
+   /// Check if a window is full
+   bool full( size_t w /**< [in] the window */) const
+   {
+      return (m_samples >= m_windows[w]);
+   }
+
+   /// Get the mean of a window
+   /**
+     * \returns the mean of the samples in the window, 0 if it is empty
+     */
+   realT mean( size_t w /**< [in] the window */) const
+   {
+      size_t n = count(w);
+      if(n == 0) return 0;
+
+      return m_shift[w] + m_sum[w]/n;
+   }
+
+   /// Get the variance of a window
+   /**
+     * \returns the sample variance of the samples in the window, 0 if there are fewer than 2
+     */
+   realT variance( size_t w /**< [in] the window */) const
+   {
+      size_t n = count(w);
+      if(n < 2) return 0;
+
+      realT var = (m_sumSq[w] - m_sum[w]*m_sum[w]/n)/(n-1);
+      if(var < 0) var = 0;
+
+      return var;
+   }
+};
+
+/// A snapshot of the timing statistics of a stream's frames.
+/** The thread writing the frames keeps runningStats of the intervals, and copies their statistics into one of these,
+  * under a mutex, for the main thread to publish.
+  *
+  * \ingroup appdev
+  */
+struct frameTimingStats
+{
+   double mna {0};   ///< The mean acquisition interval
+   double vara {0};  ///< The variance of the acquisition interval
+   double mnw {0};   ///< The mean write interval
+   double varw {0};  ///< The variance of the write interval
+   double mnwa {0};  ///< The mean of write-minus-acquisition
+   double varwa {0}; ///< The variance of write-minus-acquisition
+
+   bool valid {false}; ///< Whether the statistics windows are full, so the statistics are valid
+};
+
+} //namespace utils
+} //namespace MagAOX
+
+#endif //utils_runningStats_hpp
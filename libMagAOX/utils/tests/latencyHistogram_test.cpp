@@ -0,0 +1,144 @@
+//#define CATCH_CONFIG_MAIN
+#include "../../../tests/catch2/catch.hpp"
+
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <memory>
+
+#include "../latencyHistogram.hpp"
+
+namespace latencyHistogram_test
+{
+
+using namespace MagAOX::utils;
+
+SCENARIO( "Bucketing latency values", "[libMagAOX::utils]" )
+{
+   GIVEN("values from 0 up to 2^20 ns")
+   {
+      WHEN("finding their buckets")
+      {
+         THEN("each value is in the bucket whose range contains it, and buckets are contiguous")
+         {
+            size_t lastIdx = 0;
+            for(uint64_t v = 0; v < (1 << 20); ++v)
+            {
+               size_t idx = latencyHistogram::bucketIndex(v);
+
+               REQUIRE(v <= latencyHistogram::bucketHigh(idx));
+               if(idx > 0) REQUIRE(v > latencyHistogram::bucketHigh(idx-1));
+
+               REQUIRE( (idx == lastIdx || idx == lastIdx + 1) );
+               lastIdx = idx;
+            }
+         }
+      }
+
+      WHEN("the value is larger than the largest bucket")
+      {
+         THEN("it goes in the last bucket")
+         {
+            REQUIRE(latencyHistogram::bucketIndex(static_cast<uint64_t>(1) << 40) == latencyHistogram::nBuckets - 1);
+         }
+      }
+   }
+}
+
+SCENARIO( "Calculating latency percentiles", "[libMagAOX::utils]" )
+{
+   //Heap allocated, it's about 24 kB
+   std::unique_ptr<latencyHistogram> hist(new latencyHistogram);
+
+   GIVEN("no values")
+   {
+      latencyStats st;
+      hist->stats(st);
+
+      THEN("all statistics are 0")
+      {
+         REQUIRE(st.count == 0);
+         REQUIRE(st.p50 == 0);
+         REQUIRE(st.p99 == 0);
+         REQUIRE(st.max == 0);
+      }
+   }
+
+   GIVEN("exponentially distributed latencies around 1 ms")
+   {
+      std::mt19937_64 gen(1234);
+      std::exponential_distribution<double> dist(1.0/1e6);
+
+      std::vector<int64_t> vals(100000);
+      for(size_t n = 0; n < vals.size(); ++n)
+      {
+         vals[n] = 1e5 + dist(gen); //the minimum is 100 us
+         hist->record(vals[n]);
+      }
+
+      std::vector<int64_t> sorted = vals;
+      std::sort(sorted.begin(), sorted.end());
+
+      WHEN("getting the statistics")
+      {
+         latencyStats st;
+         hist->stats(st);
+
+         THEN("the percentiles are within the bucket precision of the exact values, and the max is exact")
+         {
+            REQUIRE(st.count == vals.size());
+            REQUIRE(st.p50 == Approx(sorted[vals.size()/2 - 1]/1e9).epsilon(1.0/latencyHistogram::subBuckets));
+            REQUIRE(st.p99 == Approx(sorted[vals.size()*99/100 - 1]/1e9).epsilon(1.0/latencyHistogram::subBuckets));
+            REQUIRE(st.p999 == Approx(sorted[vals.size()*999/1000 - 1]/1e9).epsilon(1.0/latencyHistogram::subBuckets));
+            REQUIRE(st.max == Approx(sorted.back()/1e9));
+         }
+      }
+
+      WHEN("starting a new interval")
+      {
+         latencyStats st;
+         hist->stats(st, true);
+
+         hist->record(2000);
+         hist->record(timespec({1,500}), timespec({0,999999500})); //1000 ns
+
+         hist->stats(st);
+
+         THEN("only values recorded since are included")
+         {
+            REQUIRE(st.count == 2);
+            REQUIRE(st.p50 == Approx(1000/1e9).epsilon(1.0/latencyHistogram::subBuckets));
+            REQUIRE(st.max == Approx(2000/1e9));
+         }
+      }
+
+      WHEN("resetting")
+      {
+         hist->reset();
+         latencyStats st;
+         hist->stats(st);
+
+         THEN("there are no values in the interval")
+         {
+            REQUIRE(st.count == 0);
+            REQUIRE(st.max == 0);
+         }
+      }
+   }
+
+   GIVEN("a negative value")
+   {
+      hist->record(-5);
+      latencyStats st;
+      hist->stats(st);
+
+      THEN("it is recorded as 0")
+      {
+         REQUIRE(st.count == 1);
+         REQUIRE(st.p50 == 0);
+         REQUIRE(st.max == 0);
+      }
+   }
+}
+
+} //namespace latencyHistogram_test
@@ -0,0 +1,141 @@
+//#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../tests/catch2/catch.hpp"
+
+#include <random>
+#include <vector>
+
+#include "../runningStats.hpp"
+
+namespace runningStats_test
+{
+
+using namespace MagAOX::utils;
+
+/// Mean of the last n values, as calculated by mx::math::vectorMean
+double directMean( const std::vector<double> & x,
+                   size_t n
+                 )
+{
+   double mn = 0;
+   for(size_t i = x.size() - n; i < x.size(); ++i) mn += x[i];
+   return mn/n;
+}
+
+/// Variance of the last n values, as calculated by mx::math::vectorVariance
+double directVariance( const std::vector<double> & x,
+                       size_t n
+                     )
+{
+   double mn = directMean(x, n);
+   double var = 0;
+   for(size_t i = x.size() - n; i < x.size(); ++i) var += (x[i]-mn)*(x[i]-mn);
+   return var/(n-1);
+}
+
+SCENARIO( "Running statistics over several windows", "[libMagAOX::utils]" )
+{
+   GIVEN("frame intervals of about 1 ms with jitter, on top of a large offset")
+   {
+      std::mt19937 gen(1);
+      std::normal_distribution<double> jitter(0, 1e-6);
+
+      runningStats<double> rs;
+      rs.windows({10, 100, 250, 1000});
+
+      std::vector<double> x;
+
+      for(size_t k = 0; k < 10000; ++k)
+      {
+         x.push_back(1e-3 + jitter(gen) + (k > 5000 ? 1e-4 : 0)); //with a step
+         rs.add(x.back());
+
+         if(k % 97 == 0 || k < 12)
+         {
+            for(size_t w = 0; w < rs.nWindows(); ++w)
+            {
+               size_t n = rs.count(w);
+               REQUIRE(n == std::min(x.size(), rs.window(w)));
+               REQUIRE(rs.full(w) == (x.size() >= rs.window(w)));
+
+               REQUIRE(rs.mean(w) == Approx(directMean(x, n)).epsilon(1e-12));
+               if(n > 1)
+               {
+                  REQUIRE(rs.variance(w) == Approx(directVariance(x, n)).epsilon(1e-6));
+               }
+            }
+         }
+      }
+
+      REQUIRE(rs.samples() == 10000);
+
+      WHEN("reset")
+      {
+         rs.reset();
+
+         THEN("the statistics start over")
+         {
+            REQUIRE(rs.samples() == 0);
+            REQUIRE(rs.count(0) == 0);
+            REQUIRE(rs.mean(0) == 0);
+            REQUIRE(rs.variance(0) == 0);
+
+            rs.add(5);
+            REQUIRE(rs.mean(3) == 5);
+            REQUIRE(rs.variance(3) == 0);
+         }
+      }
+   }
+
+   GIVEN("a constant series")
+   {
+      runningStats<float> rs;
+      rs.windows(20);
+
+      for(int k = 0; k < 100; ++k) rs.add(3.25);
+
+      THEN("the variance is exactly zero")
+      {
+         REQUIRE(rs.mean(0) == 3.25);
+         REQUIRE(rs.variance(0) == 0);
+      }
+   }
+}
+
+TEST_CASE( "Benchmark running statistics", "[.benchmark][libMagAOX::utils]" )
+{
+   //refRMS at 2 kHz: 1, 2, 5, and 10 second windows
+   std::vector<size_t> wins = {2000, 4000, 10000, 20000};
+
+   std::mt19937 gen(2);
+   std::normal_distribution<double> dist(10, 1);
+
+   std::vector<double> x(22000);
+   for(auto & v : x) v = dist(gen);
+
+   runningStats<double> rs;
+   rs.windows(wins);
+   for(size_t k = 0; k < 20000; ++k) rs.add(x[k]);
+
+   size_t k = 0;
+   BENCHMARK("add a sample, 4 windows")
+   {
+      rs.add(x[k++ % x.size()]);
+      return rs.mean(3);
+   };
+
+   //The loops in the original refRMS::appLogic
+   BENCHMARK("recompute 4 window means")
+   {
+      double s = 0;
+      for(size_t w = 0; w < wins.size(); ++w)
+      {
+         double m = 0;
+         for(size_t n = 0; n < wins[w]; ++n) m += x[n];
+         s += m/wins[w];
+      }
+      return s;
+   };
+}
+
+} //namespace runningStats_test
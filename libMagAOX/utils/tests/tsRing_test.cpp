@@ -0,0 +1,304 @@
+//#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../../../tests/catch2/catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../tsRing.hpp"
+
+namespace tsRing_test
+{
+
+using namespace MagAOX::utils;
+
+/// Memory for a ring, standing in for an ImageStreamIO stream
+struct ringMemory
+{
+   uint8_t write;
+   uint64_t cnt0;
+   uint64_t cnt1;
+   std::vector<float> data;
+   std::vector<timespec> atimes;
+   std::vector<timespec> wtimes;
+   std::vector<uint64_t> cnts;
+   timespec atime;
+   timespec wtime;
+
+   tsRing ring;
+
+   ringMemory( uint32_t nCols,
+               uint32_t nSamp
+             ) : data(nCols*nSamp), atimes(nSamp), wtimes(nSamp), cnts(nSamp)
+   {
+      ring.write = &write;
+      ring.cnt0 = &cnt0;
+      ring.cnt1 = &cnt1;
+      ring.data = data.data();
+      ring.atimes = atimes.data();
+      ring.wtimes = wtimes.data();
+      ring.cnts = cnts.data();
+      ring.atime = &atime;
+      ring.wtime = &wtime;
+      ring.nCols = nCols;
+      ring.nSamp = nSamp;
+
+      tsRingInit(ring);
+   }
+
+   /// Push sample k, with column c = 10*k + c and time k seconds
+   void push( uint64_t k )
+   {
+      std::vector<float> row(ring.nCols);
+      for(size_t c = 0; c < row.size(); ++c) row[c] = 10*k + c;
+
+      timespec ts = {static_cast<time_t>(k), 0};
+      tsRingPush(ring, row.data(), ts, ts);
+   }
+};
+
+SCENARIO( "Reading snapshots of a time-series ring", "[libMagAOX::utils]" )
+{
+   GIVEN("a ring of 3 columns and 100 samples")
+   {
+      ringMemory mem(3, 100);
+
+      tsRingReader reader;
+      reader.ring(mem.ring);
+
+      WHEN("the ring is empty")
+      {
+         REQUIRE(reader.snapshot() == 0);
+         REQUIRE(reader.size() == 0);
+      }
+
+      WHEN("the ring is partially full")
+      {
+         for(uint64_t k = 1; k <= 40; ++k) mem.push(k);
+
+         THEN("all samples are read in order, by column")
+         {
+            REQUIRE(reader.snapshot() == 0);
+            REQUIRE(reader.size() == 40);
+            REQUIRE(reader.cnt0() == 40);
+
+            for(size_t c = 0; c < 3; ++c)
+            {
+               for(size_t i = 0; i < 40; ++i)
+               {
+                  REQUIRE(reader.column(c)[i] == 10*(i+1) + c);
+               }
+            }
+            REQUIRE(reader.times()[0].tv_sec == 1);
+            REQUIRE(reader.times()[39].tv_sec == 40);
+         }
+
+         THEN("a time window is read")
+         {
+            REQUIRE(reader.snapshot({10,0}, {20,0}) == 0);
+            REQUIRE(reader.size() == 11);
+            REQUIRE(reader.column(1)[0] == 101);
+            REQUIRE(reader.column(1)[10] == 201);
+         }
+      }
+
+      WHEN("the ring has wrapped")
+      {
+         for(uint64_t k = 1; k <= 250; ++k) mem.push(k);
+
+         THEN("the latest samples are read in order")
+         {
+            REQUIRE(reader.snapshot() == 0);
+            REQUIRE(reader.size() == 100);
+            REQUIRE(reader.times()[0].tv_sec == 151);
+            REQUIRE(reader.times()[99].tv_sec == 250);
+            for(size_t i = 0; i < 100; ++i) REQUIRE(reader.column(2)[i] == 10*(151+i) + 2);
+         }
+
+         THEN("a window across the wrap is read")
+         {
+            REQUIRE(reader.snapshot({195,0}, {205,0}) == 0);
+            REQUIRE(reader.size() == 11);
+            REQUIRE(reader.times()[0].tv_sec == 195);
+            REQUIRE(reader.column(0)[10] == 2050);
+         }
+
+         THEN("a window outside the ring is empty")
+         {
+            REQUIRE(reader.snapshot({10,0}, {20,0}) == 0);
+            REQUIRE(reader.size() == 0);
+         }
+      }
+
+      WHEN("the writer is in the middle of a write")
+      {
+         mem.push(1);
+         mem.write = 1;
+
+         THEN("the snapshot fails")
+         {
+            REQUIRE(reader.snapshot(10) == -1);
+         }
+      }
+   }
+}
+
+SCENARIO( "Downsampling a time-series snapshot", "[libMagAOX::utils]" )
+{
+   GIVEN("100 samples at 1 s intervals")
+   {
+      ringMemory mem(2, 200);
+      for(uint64_t k = 0; k < 100; ++k) mem.push(k);
+
+      tsRingReader reader;
+      reader.ring(mem.ring);
+      REQUIRE(reader.snapshot() == 0);
+
+      WHEN("downsampling to 10 s buckets")
+      {
+         std::vector<tsBucket> out;
+         reader.downsample(out, {0,0}, {100,0}, 10);
+
+         THEN("each bucket has the min, max, and mean of its samples")
+         {
+            REQUIRE(out.size() == 20);
+            for(size_t c = 0; c < 2; ++c)
+            {
+               for(size_t b = 0; b < 10; ++b)
+               {
+                  const tsBucket & bk = out[c*10 + b];
+                  REQUIRE(bk.count == 10);
+                  REQUIRE(bk.min == 100*b + c);
+                  REQUIRE(bk.max == 100*b + 90 + c);
+                  REQUIRE(bk.mean == Approx(100*b + 45 + c));
+               }
+            }
+         }
+      }
+
+      WHEN("downsampling a window with empty buckets")
+      {
+         std::vector<tsBucket> out;
+         reader.downsample(out, {90,0}, {110,0}, 4);
+
+         THEN("empty buckets have no samples")
+         {
+            REQUIRE(out[0].count == 5);
+            REQUIRE(out[1].count == 5);
+            REQUIRE(out[2].count == 0);
+            REQUIRE(out[2].mean == 0);
+            REQUIRE(out[3].count == 0);
+         }
+      }
+   }
+}
+
+/// Stops and joins the writer thread when it goes out of scope, so a failed REQUIRE can't leave it joinable
+struct writerGuard
+{
+   std::atomic<bool> & m_stop;
+   std::thread & m_thread;
+
+   ~writerGuard()
+   {
+      m_stop = true;
+      if(m_thread.joinable()) m_thread.join();
+   }
+};
+
+/// Check that the reader's last snapshot holds consecutive samples with matching columns
+void checkSnapshot( tsRingReader & reader )
+{
+   for(size_t i = 0; i < reader.size(); ++i)
+   {
+      uint64_t k = reader.times()[i].tv_sec;
+      if(i > 0) REQUIRE(k == static_cast<uint64_t>(reader.times()[i-1].tv_sec) + 1);
+      for(size_t c = 0; c < 8; ++c) REQUIRE(reader.column(c)[i] == static_cast<float>(10*k + c));
+   }
+}
+
+SCENARIO( "Reading while writing", "[libMagAOX::utils]" )
+{
+   GIVEN("a writer thread pushing samples in bursts")
+   {
+      ringMemory mem(8, 64);
+
+      //Start full, so there is always something to read.
+      uint64_t k0 = 1;
+      for(; k0 <= 64; ++k0) mem.push(k0);
+
+      //The writer pauses between bursts, like a real property, so that snapshots can complete.
+      std::atomic<bool> stop {false};
+      std::thread writer([&mem, &stop, k0]()
+      {
+         uint64_t k = k0;
+         while(!stop)
+         {
+            for(int n = 0; n < 16; ++n) mem.push(k++);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+         }
+      });
+
+      writerGuard guard {stop, writer};
+
+      THEN("every successful snapshot is consistent")
+      {
+         tsRingReader reader;
+         reader.ring(mem.ring);
+
+         for(int n = 0; n < 2000; ++n)
+         {
+            if(reader.snapshot() != 0) continue;
+            checkSnapshot(reader);
+         }
+
+         stop = true;
+         writer.join();
+
+         //Once the writer has stopped a snapshot can't be interrupted, however many of the above were.
+         REQUIRE(reader.snapshot() == 0);
+         REQUIRE(reader.size() == 64);
+         checkSnapshot(reader);
+      }
+   }
+}
+
+TEST_CASE( "Benchmark time-series ring", "[.benchmark][libMagAOX::utils]" )
+{
+   //A property with 8 elements and a day of 1 Hz samples
+   ringMemory mem(8, 86400);
+   for(uint64_t k = 1; k <= 86400; ++k) mem.push(k);
+
+   tsRingReader reader;
+   reader.ring(mem.ring);
+
+   uint64_t k = 86401;
+   BENCHMARK("push")
+   {
+      mem.push(k++);
+      return mem.cnt0;
+   };
+
+   BENCHMARK("snapshot of 1 hour")
+   {
+      reader.snapshot({static_cast<time_t>(k - 3600), 0}, {static_cast<time_t>(k), 0});
+      return reader.size();
+   };
+
+   BENCHMARK("snapshot of 1 day")
+   {
+      reader.snapshot();
+      return reader.size();
+   };
+
+   std::vector<tsBucket> out;
+   BENCHMARK("downsample 1 day to 1000 buckets")
+   {
+      reader.downsample(out, 1000);
+      return out.size();
+   };
+}
+
+} //namespace tsRing_test
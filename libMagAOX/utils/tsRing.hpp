@@ -0,0 +1,387 @@
+/** \file tsRing.hpp
+  * \brief A shared-memory time-series ring with lock-free consistent snapshots.
+  *
+  * \ingroup app_files
+  */
+
+#ifndef utils_tsRing_hpp
+#define utils_tsRing_hpp
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <vector>
+
+namespace MagAOX
+{
+namespace utils
+{
+
+/// Pointers to the parts of a time-series ring in shared memory.
+/** A ring holds up to nSamp samples of nCols float columns.  It is stored in an ImageStreamIO circular buffer of
+  * size nCols x 1 x nSamp, with one sample of every column per slice, so a single stream holds all the elements of
+  * a property and the acquisition time array is the timestamp column shared by all of them.
+  *
+  * There is one writer, which calls tsRingPush().  Readers never block the writer: the write flag and the sample
+  * counter cnt0 form a seqlock, so a reader copies what it needs and then checks that no write started or finished
+  * while it was copying, see tsRingReader.
+  *
+  * \ingroup appdev
+  */
+struct tsRing
+{
+   uint8_t * write {nullptr};   ///< The write flag, md->write
+   uint64_t * cnt0 {nullptr};   ///< The number of samples written, md->cnt0.  The seqlock sequence.
+   uint64_t * cnt1 {nullptr};   ///< The slice of the latest sample, md->cnt1
+   float * data {nullptr};      ///< The samples, nSamp slices of nCols
+   timespec * atimes {nullptr}; ///< The time of each sample, atimearray
+   timespec * wtimes {nullptr}; ///< The write time of each sample, writetimearray
+   uint64_t * cnts {nullptr};   ///< The value of cnt0 for each sample, cntarray
+   timespec * atime {nullptr};  ///< The time of the latest sample, md->atime
+   timespec * wtime {nullptr};  ///< The write time of the latest sample, md->writetime
+   uint32_t nCols {0};          ///< The number of columns
+   uint32_t nSamp {0};          ///< The number of samples in the ring
+};
+
+/// Get the ring pointers of an ImageStreamIO circular buffer.
+/** A template so that this header does not depend on ImageStreamIO.
+  *
+  * \returns the ring pointers, with nCols = size[0] and nSamp = size[2]
+  */
+template<typename imageT>
+tsRing tsRingFromImage( imageT * im /**< [in] the IMAGE, which must be a FLOAT circular buffer*/)
+{
+   tsRing ring;
+
+   ring.write = reinterpret_cast<uint8_t *>(&im->md->write);
+   ring.cnt0 = &im->md->cnt0;
+   ring.cnt1 = &im->md->cnt1;
+   ring.data = im->array.F;
+   ring.atimes = im->atimearray;
+   ring.wtimes = im->writetimearray;
+   ring.cnts = im->cntarray;
+   ring.atime = &im->md->atime;
+   ring.wtime = &im->md->writetime;
+   ring.nCols = im->md->size[0];
+   ring.nSamp = im->md->size[2];
+
+   return ring;
+}
+
+/// Initialize an empty ring, so that the first sample goes in slice 0.
+inline
+void tsRingInit( tsRing & ring /**< [in] the ring */)
+{
+   *ring.write = 0;
+   *ring.cnt0 = 0;
+   *ring.cnt1 = ring.nSamp - 1;
+   *ring.atime = {0,0};
+   *ring.wtime = {0,0};
+
+   for(size_t m = 0; m < ring.nSamp; ++m)
+   {
+      ring.cnts[m] = std::numeric_limits<uint64_t>::max();
+      ring.atimes[m] = {0,0};
+      ring.wtimes[m] = {0,0};
+   }
+}
+
+/// Write a sample to a ring.
+/** Follows the ImageStreamIO write protocol, with fences so that readers on other cores see the write flag set
+  * before the data changes and cnt0 change after.  The caller posts the semaphores.
+  */
+inline
+void tsRingPush( tsRing & ring,          ///< [in] the ring
+                 const float * row,      ///< [in] the values of the nCols columns
+                 const timespec & atime, ///< [in] the time of the sample
+                 const timespec & wtime  ///< [in] the write time
+               )
+{
+   uint64_t cnt1 = *ring.cnt1 + 1;
+   if(cnt1 >= ring.nSamp) cnt1 = 0;
+
+   *ring.write = 1;
+   std::atomic_thread_fence(std::memory_order_release);
+
+   memcpy(ring.data + cnt1*ring.nCols, row, ring.nCols*sizeof(float));
+   ring.atimes[cnt1] = atime;
+   ring.wtimes[cnt1] = wtime;
+   ring.cnts[cnt1] = *ring.cnt0 + 1;
+   *ring.atime = atime;
+   *ring.wtime = wtime;
+
+   std::atomic_thread_fence(std::memory_order_release);
+   *ring.cnt1 = cnt1;
+   *ring.cnt0 = *ring.cnt0 + 1;
+
+   std::atomic_thread_fence(std::memory_order_release);
+   *ring.write = 0;
+}
+
+/// The statistics of one column in one bucket of a downsampled view.
+/** Empty buckets have count 0 and the other members 0.  They are not NaN, since we build with -ffast-math.
+  */
+struct tsBucket
+{
+   float min {0};      ///< The minimum
+   float max {0};      ///< The maximum
+   float mean {0};     ///< The mean
+   uint32_t count {0}; ///< The number of samples in the bucket
+};
+
+/// Reads consistent snapshots of a tsRing without locking.
+/** A snapshot copies a time window of all columns in one pass over the ring, and stores them by column so each
+  * element's series is contiguous.  If the writer changes the ring during the copy the snapshot is retried.
+  *
+  * Sample times are assumed to be non-decreasing, which holds for INDI timestamps from a single device.
+  *
+  * \ingroup appdev
+  */
+class tsRingReader
+{
+protected:
+   tsRing m_ring; ///< The ring being read
+
+   std::vector<float> m_data; ///< The snapshot, by column, m_data[c*m_size + i]
+
+   std::vector<timespec> m_times; ///< The time of each sample in the snapshot
+
+   size_t m_size {0}; ///< The number of samples in the snapshot
+
+   uint64_t m_cnt0 {0}; ///< The value of cnt0 when the snapshot was taken
+
+   std::vector<float> m_slices; ///< Working memory for the raw slices
+
+   /// Compare timespecs
+   static bool before( const timespec & a,
+                       const timespec & b
+                     )
+   {
+      return (a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec));
+   }
+
+   /// Time difference in seconds
+   static double diff( const timespec & a,
+                       const timespec & b
+                     )
+   {
+      return (a.tv_sec - b.tv_sec) + (a.tv_nsec - b.tv_nsec)/1e9;
+   }
+
+public:
+
+   /// Set the ring to read
+   void ring( const tsRing & r /**< [in] the ring pointers */)
+   {
+      m_ring = r;
+      m_size = 0;
+   }
+
+   /// Take a snapshot of the samples with times in [t0, t1]
+   /** Pass {0,0} for t0 to start at the oldest sample, and t1 later than the latest sample to end with it.
+     *
+     * \returns 0 on success
+     * \returns -1 if the writer changed the ring during each of maxTries attempts
+     */
+   int snapshot( const timespec & t0, ///< [in] the start of the window
+                 const timespec & t1, ///< [in] the end of the window
+                 int maxTries = 100   ///< [in] [optional] the number of attempts before giving up
+               )
+   {
+      const volatile uint8_t * write = m_ring.write;
+      const volatile uint64_t * cnt0 = m_ring.cnt0;
+      const volatile uint64_t * cnt1 = m_ring.cnt1;
+
+      size_t nSamp = m_ring.nSamp;
+      size_t nCols = m_ring.nCols;
+
+      for(int tries = 0; tries < maxTries; ++tries)
+      {
+         uint64_t seq = *cnt0;
+         std::atomic_thread_fence(std::memory_order_acquire);
+
+         if(*write) continue;
+
+         uint64_t last = *cnt1;
+         size_t nValid = (seq < nSamp) ? seq : nSamp;
+         size_t oldest = (last + 1 + nSamp - nValid) % nSamp;
+
+         auto slice = [oldest, nSamp](size_t i){ return (oldest + i) % nSamp; };
+
+         //Binary search for the window in chronological order
+         size_t lo = 0, hi = nValid;
+         while(lo < hi)
+         {
+            size_t mid = (lo + hi)/2;
+            if(before(m_ring.atimes[slice(mid)], t0)) lo = mid + 1;
+            else hi = mid;
+         }
+         size_t i0 = lo;
+
+         hi = nValid;
+         while(lo < hi)
+         {
+            size_t mid = (lo + hi)/2;
+            if(before(t1, m_ring.atimes[slice(mid)])) hi = mid;
+            else lo = mid + 1;
+         }
+         size_t i1 = lo;
+
+         size_t n = i1 - i0;
+
+         m_slices.resize(n*nCols);
+         m_times.resize(n);
+         for(size_t i = 0; i < n; ++i)
+         {
+            size_t s = slice(i0 + i);
+            memcpy(m_slices.data() + i*nCols, m_ring.data + s*nCols, nCols*sizeof(float));
+            m_times[i] = m_ring.atimes[s];
+         }
+
+         std::atomic_thread_fence(std::memory_order_acquire);
+         if(*write || *cnt0 != seq) continue;
+
+         //Consistent, now transpose to columns
+         m_size = n;
+         m_cnt0 = seq;
+         m_data.resize(n*nCols);
+         for(size_t c = 0; c < nCols; ++c)
+         {
+            float * col = m_data.data() + c*n;
+            for(size_t i = 0; i < n; ++i) col[i] = m_slices[i*nCols + c];
+         }
+
+         return 0;
+      }
+
+      return -1;
+   }
+
+   /// Take a snapshot of all samples in the ring
+   /**
+     * \returns 0 on success
+     * \returns -1 if the writer changed the ring during each of maxTries attempts
+     */
+   int snapshot( int maxTries = 100 /**< [in] [optional] the number of attempts before giving up */)
+   {
+      return snapshot({0,0}, {std::numeric_limits<time_t>::max(), 0}, maxTries);
+   }
+
+   /// Get the number of samples in the snapshot
+   size_t size() const
+   {
+      return m_size;
+   }
+
+   /// Get the value of cnt0 when the snapshot was taken, the total number of samples written
+   uint64_t cnt0() const
+   {
+      return m_cnt0;
+   }
+
+   /// Get a column of the snapshot
+   /**
+     * \returns a pointer to the size() values of column c
+     */
+   const float * column( size_t c /**< [in] the column */) const
+   {
+      return m_data.data() + c*m_size;
+   }
+
+   /// Get the times of the samples in the snapshot
+   const std::vector<timespec> & times() const
+   {
+      return m_times;
+   }
+
+   /// Downsample the snapshot into equal time buckets
+   /** The buckets evenly divide [t0, t1].  Samples outside it are ignored.
+     *
+     * The output is by column, out[c*nBuckets + b].
+     */
+   void downsample( std::vector<tsBucket> & out, ///< [out] the min, max, and mean of each column in each bucket
+                    const timespec & t0,         ///< [in] the start of the first bucket
+                    const timespec & t1,         ///< [in] the end of the last bucket
+                    size_t nBuckets              ///< [in] the number of buckets
+                  ) const
+   {
+      size_t nCols = m_ring.nCols;
+
+      out.assign(nCols*nBuckets, tsBucket());
+      if(nBuckets == 0) return;
+
+      double span = diff(t1, t0);
+      if(span <= 0) span = 1;
+
+      std::vector<uint32_t> bucket(m_size);
+      for(size_t i = 0; i < m_size; ++i)
+      {
+         double f = diff(m_times[i], t0)/span;
+         if(f < 0 || f > 1) bucket[i] = nBuckets; //ignored
+         else
+         {
+            bucket[i] = f*nBuckets;
+            if(bucket[i] >= nBuckets) bucket[i] = nBuckets - 1;
+         }
+      }
+
+      std::vector<double> sums(nBuckets);
+
+      for(size_t c = 0; c < nCols; ++c)
+      {
+         const float * col = column(c);
+         tsBucket * ob = out.data() + c*nBuckets;
+
+         sums.assign(nBuckets, 0);
+
+         for(size_t i = 0; i < m_size; ++i)
+         {
+            uint32_t b = bucket[i];
+            if(b >= nBuckets) continue;
+
+            float v = col[i];
+            if(ob[b].count == 0)
+            {
+               ob[b].min = v;
+               ob[b].max = v;
+            }
+            else
+            {
+               if(v < ob[b].min) ob[b].min = v;
+               if(v > ob[b].max) ob[b].max = v;
+            }
+            sums[b] += v;
+            ++ob[b].count;
+         }
+
+         for(size_t b = 0; b < nBuckets; ++b)
+         {
+            if(ob[b].count > 0) ob[b].mean = sums[b]/ob[b].count;
+         }
+      }
+   }
+
+   /// Downsample the whole snapshot into equal time buckets
+   /** The buckets evenly divide the time from the first to the last sample of the snapshot.
+     */
+   void downsample( std::vector<tsBucket> & out, ///< [out] the min, max, and mean of each column in each bucket
+                    size_t nBuckets              ///< [in] the number of buckets
+                  ) const
+   {
+      if(m_size == 0)
+      {
+         out.assign(m_ring.nCols*nBuckets, tsBucket());
+         return;
+      }
+
+      downsample(out, m_times.front(), m_times.back(), nBuckets);
+   }
+};
+
+} //namespace utils
+} //namespace MagAOX
+
+#endif //utils_tsRing_hpp
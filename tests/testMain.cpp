@@ -1,4 +1,5 @@
 
 
 #define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING //Benchmarks are tagged [.benchmark], so are only run on request
 #include "catch2/catch.hpp"
@@ -0,0 +1,17 @@
+/** \file logtimeline.cpp
+  * \brief A utility to dump the merged, time-ordered logs of many MagAO-X applications to stdout.
+  *
+  * \ingroup logtimeline_files
+  */
+
+#include "logtimeline.hpp"
+
+
+
+int main(int argc, char **argv)
+{
+   logtimeline lt;
+
+   return lt.main(argc, argv);
+
+}
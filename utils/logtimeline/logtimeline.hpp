@@ -0,0 +1,211 @@
+/** \file logtimeline.hpp
+  * \brief A utility to dump the merged, time-ordered logs of many MagAO-X applications to stdout.
+  *
+  * \ingroup logtimeline_files
+  */
+
+#ifndef logtimeline_hpp
+#define logtimeline_hpp
+
+#include <iostream>
+#include <cstring>
+
+#include <mx/ioutils/fileUtils.hpp>
+
+#include "../../libMagAOX/libMagAOX.hpp"
+using namespace MagAOX::logger;
+
+using namespace flatlogs;
+
+/** \defgroup logtimeline logtimeline: MagAO-X Merged Log Reader
+  * \brief Read the binary logs of many MagAO-X applications as a single timeline.
+  *
+  * \ingroup utils
+  *
+  */
+
+/** \defgroup logtimeline_files logtimeline Files
+  * \ingroup logtimeline
+  */
+
+/// An application to dump the logs of many apps over a time range, merged in time order.
+/** Apps are given as non-option arguments.  If none are given all apps with logs in the directory are included.
+  *
+  * Example:
+  * \verbatim
+    logtimeline --start=2023-05-12T04:10:00 --end=2023-05-12T04:15:00 camwfs dmwooferCtrl loloop
+    \endverbatim
+  *
+  * \ingroup logtimeline
+  */
+class logtimeline : public mx::app::application
+{
+protected:
+
+   std::string m_dir;
+   std::string m_ext;
+
+   std::string m_start; ///< The start time, as an ISO 8601 UTC string.
+   std::string m_end; ///< The end time, as an ISO 8601 UTC string.  Default is now.
+   double m_last {0}; ///< If > 0 and no start time is given, the length of the time range in seconds before the end.
+
+   bool m_jsonMode {false};
+
+   bool m_stats {false}; ///< Print the number of files found and read, and the number of entries, to stderr.
+
+   logPrioT m_level {logPrio::LOG_DEFAULT};
+
+   std::vector<eventCodeT> m_codes;
+
+   /// Parse an ISO 8601 UTC date and time string, i.e. YYYY-MM-DDTHH:MM:SS.SSS, where the trailing Z is optional.
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int parseTime( timespecX & ts,         ///< [out] the parsed time
+                  const std::string & str ///< [in] the string to parse
+                );
+
+public:
+   virtual void setupConfig();
+
+   virtual void loadConfig();
+
+   virtual int execute();
+
+};
+
+void logtimeline::setupConfig()
+{
+   config.add("dir","d", "dir" , argType::Required, "", "dir", false,  "string", "Directory to search for logs. MagAO-X default is normally used.");
+   config.add("ext","e", "ext" , argType::Required, "", "ext", false,  "string", "The file extension of log files.  MagAO-X default is normally used.");
+   config.add("start","s", "start" , argType::Required, "", "start", false,  "string", "The start of the time range, ISO 8601 UTC, e.g. 2023-05-12T04:10:00.  Default is the beginning of the logs, unless --last is set.");
+   config.add("end","t", "end" , argType::Required, "", "end", false,  "string", "The end of the time range, ISO 8601 UTC, e.g. 2023-05-12T04:15:00.5.  Default is now.");
+   config.add("last","l", "last" , argType::Required, "", "last", false,  "real", "If no start is given, the length of the time range before the end, in seconds.");
+   config.add("level","L", "level" , argType::Required, "", "level", false,  "int/string", "Minimum log level to dump, either an integer or a string. -1/TELEMETRY [the default], 0/DEFAULT, 1/D1/DBG1/DEBUG2, 2/D2/DBG2/DEBUG1,3/INFO,4/WARNING,5/ERROR,6/CRITICAL,7/FATAL.  Note that only the mininum unique string is required.");
+   config.add("code","C", "code" , argType::Required, "", "code", false,  "int", "The event code, or vector of codes, to dump.  If not specified, all codes are dumped.  See logCodes.hpp for a complete list of codes.");
+   config.add("json","J", "json" , argType::True, "", "json", false,  "bool", "JSON mode: emits one JSON document per line for each record, with the app name in the \"app\" member.");
+   config.add("stats","S", "stats" , argType::True, "", "stats", false,  "bool", "Print the number of files found and read, and the number of entries dumped, to stderr.");
+}
+
+void logtimeline::loadConfig()
+{
+   //Get default log dir
+   std::string tmpstr = mx::sys::getEnv(MAGAOX_env_path);
+   if(tmpstr == "")
+   {
+      tmpstr = MAGAOX_path;
+   }
+   m_dir = tmpstr +  "/" + MAGAOX_logRelPath;
+
+   //Now check for config option for dir
+   config(m_dir, "dir");
+
+   m_ext = ".";
+   m_ext += MAGAOX_default_logExt;
+   config(m_ext, "ext");
+   if(m_ext.size() > 0 && m_ext[0] != '.') m_ext = "." + m_ext;
+
+   config(m_start, "start");
+   config(m_end, "end");
+   config(m_last, "last");
+
+   if(config.isSet("json")) m_jsonMode = true;
+   if(config.isSet("stats")) m_stats = true;
+
+   tmpstr = "";
+   config(tmpstr, "level");
+   if(tmpstr != "")
+   {
+      m_level = logLevelFromString(tmpstr);
+   }
+
+   config(m_codes, "code");
+}
+
+int logtimeline::parseTime( timespecX & ts,
+                            const std::string & str
+                          )
+{
+   std::string tstr = str;
+   if(tstr.size() > 0 && (tstr.back() == 'Z' || tstr.back() == 'z')) tstr.pop_back();
+
+   tm bdt;
+   double dsec;
+
+   if(mx::sys::ISO8601dateBreakdown(bdt.tm_year, bdt.tm_mon, bdt.tm_mday, bdt.tm_hour, bdt.tm_min, dsec, tstr) < 0)
+   {
+      return -1;
+   }
+
+   bdt.tm_year -= 1900;
+   bdt.tm_mon -= 1;
+   bdt.tm_sec = (int) dsec;
+   bdt.tm_isdst = 0;
+   bdt.tm_gmtoff = 0;
+
+   ts.time_s = timegm(&bdt);
+   ts.time_ns = (nanosecT) ((dsec-bdt.tm_sec)*1e9 + 0.5);
+
+   return 0;
+}
+
+int logtimeline::execute()
+{
+   timespecX startTime {0,0};
+   timespecX endTime;
+
+   if(m_end == "")
+   {
+      endTime.gettime();
+   }
+   else if(parseTime(endTime, m_end) < 0)
+   {
+      std::cerr << "logtimeline: could not parse end time " << m_end << "\n";
+      return -1;
+   }
+
+   if(m_start != "")
+   {
+      if(parseTime(startTime, m_start) < 0)
+      {
+         std::cerr << "logtimeline: could not parse start time " << m_start << "\n";
+         return -1;
+      }
+   }
+   else if(m_last > 0)
+   {
+      double st = endTime.time_s + endTime.time_ns/1e9 - m_last;
+      if(st < 0) st = 0;
+      startTime.time_s = st;
+      startTime.time_ns = (st - startTime.time_s)*1e9;
+   }
+
+   if(endTime < startTime)
+   {
+      std::cerr << "logtimeline: end time is before start time.\n";
+      return -1;
+   }
+
+   logTimeline ltl;
+
+   ltl.dir(m_dir);
+   ltl.ext(m_ext);
+   ltl.apps(std::set<std::string>(config.nonOptions.begin(), config.nonOptions.end()));
+   ltl.codes(std::set<eventCodeT>(m_codes.begin(), m_codes.end()));
+   ltl.level(m_level);
+   ltl.timeRange(startTime, endTime);
+
+   int rv = ltl.query(std::cout, m_jsonMode);
+
+   std::cout.flush();
+
+   if(m_stats)
+   {
+      std::cerr << "logtimeline: " << ltl.nFiles() << " files found, " << ltl.nFilesOpened() << " files read, " << ltl.nEntries() << " entries.\n";
+   }
+
+   return rv;
+}
+
+#endif //logtimeline_hpp
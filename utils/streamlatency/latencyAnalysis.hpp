@@ -0,0 +1,236 @@
+/** \file latencyAnalysis.hpp
+  * \brief Matching of frames across a chain of streams, and latency statistics.
+  *
+  * \ingroup streamlatency_files
+  */
+
+#ifndef latencyAnalysis_hpp
+#define latencyAnalysis_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/// The times of one frame of a stream, in ns since the epoch.
+/** \ingroup streamlatency
+  */
+struct frameTime
+{
+   uint64_t cnt0 {0};  ///< The frame counter
+   int64_t atime {0};  ///< The acquisition time, md->atime or atimearray
+   int64_t wtime {0};  ///< The write time, md->writetime or writetimearray
+   int64_t rtime {0};  ///< The time the monitor woke up for this frame.  0 if the frame was recovered from the timing arrays.
+};
+
+/// Summary statistics of a latency distribution, in microseconds.
+/** \ingroup streamlatency
+  */
+struct latencySummary
+{
+   std::string hop; ///< The name of the hop
+   size_t n {0}; ///< The number of samples
+   double mean {0}; ///< The mean
+   double min {0}; ///< The minimum
+   double p50 {0}; ///< The median
+   double p90 {0}; ///< The 90th percentile
+   double p99 {0}; ///< The 99th percentile
+   double p999 {0}; ///< The 99.9th percentile
+   double max {0}; ///< The maximum
+};
+
+/// Calculate the summary statistics of latency samples
+/** The samples are sorted in place.  Percentiles are nearest-rank.
+  */
+inline
+void summarize( latencySummary & sum,         ///< [out] the statistics.  The hop name is not changed.
+                std::vector<int64_t> & samples ///< [in/out] the samples in ns.  Sorted on output.
+              )
+{
+   sum.n = samples.size();
+
+   if(sum.n == 0)
+   {
+      sum.mean = sum.min = sum.p50 = sum.p90 = sum.p99 = sum.p999 = sum.max = 0;
+      return;
+   }
+
+   std::sort(samples.begin(), samples.end());
+
+   double s = 0;
+   for(size_t n = 0; n < samples.size(); ++n) s += samples[n];
+   sum.mean = s/samples.size()/1e3;
+
+   auto pct = [&samples](double p)
+   {
+      size_t rank = ceil(p*samples.size());
+      if(rank < 1) rank = 1;
+      return samples[rank-1]/1e3;
+   };
+
+   sum.min = samples.front()/1e3;
+   sum.p50 = pct(0.5);
+   sum.p90 = pct(0.9);
+   sum.p99 = pct(0.99);
+   sum.p999 = pct(0.999);
+   sum.max = samples.back()/1e3;
+}
+
+/// Calculate the per-hop and end-to-end latencies of a chain of streams
+/** Each downstream frame is matched to the latest upstream frame written at or before it, which is the frame that
+  * triggered it for an app which processes every frame.  If an app falls behind and skips frames this matches a
+  * later frame than the one processed, so the hop latency is underestimated, but the skipped frames show up as a
+  * lower frame rate on the downstream stream.
+  *
+  * The hops reported are:
+  * - `<source>:acquire`, from atime to writetime of the source, i.e. the framegrabber latency
+  * - `<upstream>-><downstream>`, from the upstream writetime to the downstream writetime
+  * - `<last>->consumer`, from the writetime of the last stream to the wake up of its monitor
+  * - `end-to-end`, from the source atime to the writetime of the last stream
+  * - `end-to-end:consumer`, from the source atime to the wake up of the last stream's monitor
+  *
+  * Only frames of the last stream written within [t0, t1] are used for the end-to-end latencies, and only frames of
+  * each stream written within [t0, t1] for its hop.
+  */
+inline
+void analyzeChain( std::vector<latencySummary> & hops,                ///< [out] the statistics of each hop
+                   const std::vector<std::string> & names,            ///< [in] the names of the streams, source first
+                   const std::vector<std::vector<frameTime>> & frames, ///< [in] the frames of each stream, in write order
+                   int64_t t0,                                         ///< [in] the start of the measurement, ns
+                   int64_t t1                                          ///< [in] the end of the measurement, ns
+                 )
+{
+   hops.clear();
+
+   if(frames.size() == 0 || frames.size() != names.size()) return;
+
+   std::vector<int64_t> samples;
+
+   //Source acquisition
+   samples.clear();
+   for(const frameTime & f : frames[0])
+   {
+      if(f.wtime < t0 || f.wtime > t1) continue;
+      samples.push_back(f.wtime - f.atime);
+   }
+   hops.push_back(latencySummary());
+   hops.back().hop = names[0] + ":acquire";
+   summarize(hops.back(), samples);
+
+   //origin[n] is the index of the source frame which frame n of the current stream descends from, or -1.
+   std::vector<int64_t> origin(frames[0].size());
+   for(size_t n = 0; n < origin.size(); ++n) origin[n] = n;
+
+   std::vector<int64_t> upW;
+
+   for(size_t s = 1; s < frames.size(); ++s)
+   {
+      const std::vector<frameTime> & up = frames[s-1];
+      const std::vector<frameTime> & down = frames[s];
+
+      upW.resize(up.size());
+      for(size_t n = 0; n < up.size(); ++n) upW[n] = up[n].wtime;
+
+      std::vector<int64_t> downOrigin(down.size(), -1);
+
+      samples.clear();
+      for(size_t n = 0; n < down.size(); ++n)
+      {
+         //The latest upstream frame written at or before this one.
+         auto it = std::upper_bound(upW.begin(), upW.end(), down[n].wtime);
+         if(it == upW.begin()) continue;
+         size_t u = (it - upW.begin()) - 1;
+
+         downOrigin[n] = origin[u];
+
+         if(down[n].wtime < t0 || down[n].wtime > t1) continue;
+         samples.push_back(down[n].wtime - up[u].wtime);
+      }
+
+      hops.push_back(latencySummary());
+      hops.back().hop = names[s-1] + "->" + names[s];
+      summarize(hops.back(), samples);
+
+      origin.swap(downOrigin);
+   }
+
+   const std::vector<frameTime> & last = frames.back();
+
+   //The last hop, to the monitor
+   samples.clear();
+   for(const frameTime & f : last)
+   {
+      if(f.wtime < t0 || f.wtime > t1 || f.rtime == 0) continue;
+      samples.push_back(f.rtime - f.wtime);
+   }
+   hops.push_back(latencySummary());
+   hops.back().hop = names.back() + "->consumer";
+   summarize(hops.back(), samples);
+
+   //End-to-end
+   std::vector<int64_t> samplesC;
+   samples.clear();
+   for(size_t n = 0; n < last.size(); ++n)
+   {
+      if(last[n].wtime < t0 || last[n].wtime > t1 || origin[n] < 0) continue;
+
+      int64_t at = frames[0][origin[n]].atime;
+      samples.push_back(last[n].wtime - at);
+      if(last[n].rtime != 0) samplesC.push_back(last[n].rtime - at);
+   }
+
+   hops.push_back(latencySummary());
+   hops.back().hop = "end-to-end";
+   summarize(hops.back(), samples);
+
+   hops.push_back(latencySummary());
+   hops.back().hop = "end-to-end:consumer";
+   summarize(hops.back(), samplesC);
+}
+
+/// Write the statistics of one hop as a single-line JSON object
+inline
+void writeHopJSON( std::ostream & out,          ///< [out] the stream to write to
+                   const latencySummary & sum   ///< [in] the statistics
+                 )
+{
+   out << "{\"hop\": \"" << sum.hop << "\", \"n\": " << sum.n << std::fixed << std::setprecision(3)
+       << ", \"mean_us\": " << sum.mean << ", \"min_us\": " << sum.min << ", \"p50_us\": " << sum.p50
+       << ", \"p90_us\": " << sum.p90 << ", \"p99_us\": " << sum.p99 << ", \"p999_us\": " << sum.p999
+       << ", \"max_us\": " << sum.max << "}" << std::defaultfloat;
+}
+
+/// Read the p99 of each hop from a report written by writeHopJSON, one hop per line.
+/**
+  * \returns the number of hops read
+  */
+inline
+size_t readBaseline( std::map<std::string, double> & p99, ///< [out] the p99 in us of each hop, by hop name
+                     std::istream & in                    ///< [in] the report to read
+                   )
+{
+   p99.clear();
+
+   std::string line;
+   while(std::getline(in, line))
+   {
+      size_t h = line.find("\"hop\": \"");
+      size_t p = line.find("\"p99_us\": ");
+      if(h == std::string::npos || p == std::string::npos) continue;
+
+      h += 8;
+      size_t he = line.find('"', h);
+      if(he == std::string::npos) continue;
+
+      p99[line.substr(h, he-h)] = strtod(line.c_str() + p + 10, nullptr);
+   }
+
+   return p99.size();
+}
+
+#endif //latencyAnalysis_hpp
@@ -0,0 +1,17 @@
+/** \file streamlatency.cpp
+  * \brief A utility to benchmark the latency of a chain of MagAO-X stream applications.
+  *
+  * \ingroup streamlatency_files
+  */
+
+#include "streamlatency.hpp"
+
+
+
+int main(int argc, char **argv)
+{
+   streamlatency sl;
+
+   return sl.main(argc, argv);
+
+}
@@ -0,0 +1,702 @@
+/** \file streamlatency.hpp
+  * \brief A utility to benchmark the latency of a chain of MagAO-X stream applications.
+  *
+  * \ingroup streamlatency_files
+  */
+
+#ifndef streamlatency_hpp
+#define streamlatency_hpp
+
+#include <ImageStreamIO/ImageStruct.h>
+#include <ImageStreamIO/ImageStreamIO.h>
+
+#include <mx/sys/timeUtils.hpp>
+
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <random>
+
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "../../libMagAOX/libMagAOX.hpp"
+
+#include "latencyAnalysis.hpp"
+
+/** \defgroup streamlatency streamlatency: Stream Pipeline Latency Benchmark
+  * \brief Measure the per-hop and end-to-end latency of a chain of stream applications.
+  *
+  * \ingroup utils
+  *
+  */
+
+/** \defgroup streamlatency_files streamlatency Files
+  * \ingroup streamlatency
+  */
+
+bool g_timeToDie = false;
+
+void sigTermHandler( int signum,
+                     siginfo_t *siginf,
+                     void *ucont
+                    )
+{
+   //Suppress those warnings . . .
+   static_cast<void>(signum);
+   static_cast<void>(siginf);
+   static_cast<void>(ucont);
+
+   std::cerr << "\n"; //clear out the ^C char
+
+   g_timeToDie = true;
+}
+
+/// Convert a timespec to ns
+inline
+int64_t tsToNs( const timespec & ts )
+{
+   return static_cast<int64_t>(ts.tv_sec)*1000000000 + ts.tv_nsec;
+}
+
+/// A utility to benchmark the latency of a chain of MagAO-X stream applications.
+/** The chain is given as an ordered list of streams, starting with the source.  Each stream is monitored on its own
+  * semaphore, and the atime and writetime of every frame are recorded, recovering frames missed by the monitor from
+  * the timing arrays of circular buffers.  After the run each downstream frame is matched to the upstream frame which
+  * triggered it, giving the latency distribution of each hop and from the source atime to the end of the chain.  See
+  * analyzeChain.
+  *
+  * The source can be simulated by streamlatency itself (`--source`), which needs nothing else running, or can be a
+  * camera app such as cameraSim.  The apps in the chain can be launched by streamlatency (`--launch`), each as a
+  * command line, and are sent SIGTERM at the end of the run.  MagAO-X apps run without an INDI server, and stream
+  * apps process frames as soon as their input stream exists.
+  *
+  * The report is JSON, with one hop per line, and is written to stdout or to `--report`.  If `--baseline` is a
+  * previous report, any hop whose p99 has increased by more than `--tolerance` (fractional) plus `--toleranceAbs`
+  * (us) is reported to stderr and the exit code is 1, so the benchmark can run as a regression check.
+  *
+  * Example, simulating a 2 kHz source, to benchmark pwfsSlopeCalc and shmimIntegrator:
+  * \verbatim
+    streamlatency --source --fps=2000 --width=120 --height=120 --streams=bench_src,bench_slopes,bench_avg \
+                  --launch="pwfsSlopeCalc -n bench_slopes","shmimIntegrator -n bench_avg" --duration=30 \
+                  --report=bench.json --baseline=bench_last.json
+    \endverbatim
+  * where the bench_slopes and bench_avg configurations read bench_src and bench_slopes respectively.
+  *
+  * \ingroup streamlatency
+  */
+class streamlatency : public mx::app::application
+{
+protected:
+
+   /** \name Configurable Parameters
+     * @{
+     */
+
+   std::vector<std::string> m_streams; ///< The streams in the chain, in order, starting with the source.
+
+   std::vector<std::string> m_launch; ///< Commands to launch before measuring, in order.  Each is split on white space.
+
+   double m_settle {5}; ///< Time in seconds to wait after launching before measuring.
+
+   double m_duration {10}; ///< The time in seconds to measure.
+
+   std::string m_report; ///< The file to write the report to.  If empty the report goes to stdout.
+
+   std::string m_samples; ///< If not empty, a file to write the raw frame times of every stream to, as CSV.
+
+   std::string m_baseline; ///< A previous report to compare to.
+
+   double m_tolerance {0.2}; ///< The fractional increase in the p99 of a hop over the baseline which is a regression.
+
+   double m_toleranceAbs {5}; ///< An absolute increase in us allowed in addition to m_tolerance, for hops with small latencies.
+
+   bool m_source {false}; ///< If true, simulate the source stream.
+
+   uint32_t m_width {128}; ///< The width of the simulated source
+   uint32_t m_height {128}; ///< The height of the simulated source
+   double m_fps {1000}; ///< The frame rate of the simulated source
+   uint32_t m_circBuffLength {100}; ///< The circular buffer length of the simulated source
+
+   ///@}
+
+   /// The state of the monitor of one stream
+   struct streamMonitor
+   {
+      std::string m_name; ///< The stream name
+
+      IMAGE m_image; ///< The stream
+
+      std::vector<frameTime> m_frames; ///< The frames seen.  Only touched by the monitor thread until it is joined.
+
+      uint64_t m_nLost {0}; ///< Frames which were missed and could not be recovered from the timing arrays.
+
+      std::thread m_thread; ///< The monitor thread
+   };
+
+   std::vector<streamMonitor> m_monitors; ///< One monitor per stream
+
+   std::atomic<bool> m_stop {false}; ///< Tells the monitor and source threads to stop
+
+   std::vector<pid_t> m_pids; ///< The launched apps
+
+   IMAGE m_srcImage; ///< The simulated source stream
+   std::thread m_srcThread; ///< The simulated source thread
+
+   /// Create the simulated source stream and start writing it
+   int startSource();
+
+   /// Write the simulated source frames
+   void sourceThreadExec();
+
+   /// Launch the apps in m_launch
+   int launchApps();
+
+   /// Send SIGTERM to the launched apps, in reverse order, and wait for them.
+   void stopApps();
+
+   /// Open a stream, waiting up to m_settle seconds for it to exist
+   /**
+     * \returns 0 on success
+     * \returns -1 if the stream could not be opened
+     */
+   int openStream( streamMonitor & mon /**< [in/out] the monitor of the stream*/);
+
+   /// Monitor a stream, recording the times of its frames until m_stop is set
+   void monitorThreadExec( streamMonitor * mon /**< [in] the monitor*/);
+
+   /// Write the JSON report
+   void writeReport( std::ostream & out,                         ///< [out] the stream to write to
+                     const std::vector<latencySummary> & hops,   ///< [in] the hop statistics
+                     double elapsed                              ///< [in] the measurement time in seconds
+                   );
+
+   /// Compare to the baseline report
+   /**
+     * \returns 0 if there are no regressions
+     * \returns 1 if there is a regression
+     * \returns -1 on error
+     */
+   int checkBaseline( const std::vector<latencySummary> & hops /**< [in] the hop statistics*/);
+
+public:
+   ~streamlatency() noexcept;
+
+   virtual void setupConfig();
+
+   virtual void loadConfig();
+
+   virtual int execute();
+};
+
+inline
+streamlatency::~streamlatency() noexcept
+{
+   m_stop = true;
+
+   if(m_srcThread.joinable()) m_srcThread.join();
+
+   for(size_t n = 0; n < m_monitors.size(); ++n)
+   {
+      if(m_monitors[n].m_thread.joinable()) m_monitors[n].m_thread.join();
+   }
+}
+
+inline
+void streamlatency::setupConfig()
+{
+   config.add("streams","s", "streams" , argType::Required, "", "streams", false,  "vector<string>", "The streams in the chain, in order, starting with the source.  Required.");
+   config.add("launch","l", "launch" , argType::Required, "", "launch", false,  "vector<string>", "Commands to launch before measuring, in order, e.g. \"pwfsSlopeCalc -n bench_slopes\".  Sent SIGTERM at the end.");
+   config.add("settle","", "settle" , argType::Required, "", "settle", false,  "real", "Time in seconds to wait for the chain to start before measuring.  Default is 5.");
+   config.add("duration","D", "duration" , argType::Required, "", "duration", false,  "real", "Time in seconds to measure.  Default is 10.");
+   config.add("report","r", "report" , argType::Required, "", "report", false,  "string", "The file to write the JSON report to.  Default is stdout.");
+   config.add("samples","", "samples" , argType::Required, "", "samples", false,  "string", "A file to write the raw frame times of every stream to, as CSV.");
+   config.add("baseline","b", "baseline" , argType::Required, "", "baseline", false,  "string", "A previous report.  Hops whose p99 has increased by more than the tolerance are reported and the exit code is 1.");
+   config.add("tolerance","", "tolerance" , argType::Required, "", "tolerance", false,  "real", "The fractional increase in p99 over the baseline which is a regression.  Default is 0.2.");
+   config.add("toleranceAbs","", "toleranceAbs" , argType::Required, "", "toleranceAbs", false,  "real", "An absolute increase in p99, in us, allowed in addition to tolerance.  Default is 5.");
+   config.add("source","S", "source" , argType::True, "", "source", false,  "bool", "If set, simulate the source, writing random frames to the first stream.");
+   config.add("width","W", "width" , argType::Required, "", "width", false,  "int", "The width of the simulated source.  Default is 128.");
+   config.add("height","H", "height" , argType::Required, "", "height", false,  "int", "The height of the simulated source.  Default is 128.");
+   config.add("fps","F", "fps" , argType::Required, "", "fps", false,  "real", "The frame rate of the simulated source.  Default is 1000.");
+   config.add("circBuffLength","L", "circBuffLength" , argType::Required, "", "circBuffLength", false,  "int", "The circular buffer length of the simulated source.  Default is 100.");
+}
+
+inline
+void streamlatency::loadConfig()
+{
+   config(m_streams, "streams");
+   config(m_launch, "launch");
+   config(m_settle, "settle");
+   config(m_duration, "duration");
+   config(m_report, "report");
+   config(m_samples, "samples");
+   config(m_baseline, "baseline");
+   config(m_tolerance, "tolerance");
+   config(m_toleranceAbs, "toleranceAbs");
+   if(config.isSet("source")) m_source = true;
+   config(m_width, "width");
+   config(m_height, "height");
+   config(m_fps, "fps");
+   config(m_circBuffLength, "circBuffLength");
+}
+
+inline
+int streamlatency::execute()
+{
+   //Install signal handling
+   struct sigaction act;
+   sigset_t set;
+
+   act.sa_sigaction = sigTermHandler;
+   act.sa_flags = SA_SIGINFO;
+   sigemptyset(&set);
+   act.sa_mask = set;
+
+   if( sigaction(SIGTERM, &act, 0) < 0 || sigaction(SIGQUIT, &act, 0) < 0 || sigaction(SIGINT, &act, 0) < 0 )
+   {
+      std::cerr << " (" << invokedName << "): error setting signal handlers: " << strerror(errno) << "\n";
+      return -1;
+   }
+
+   if(m_streams.size() == 0)
+   {
+      std::cerr << " (" << invokedName << "): no streams specified.\n";
+      return -1;
+   }
+
+   if(m_source && startSource() < 0) return -1;
+
+   if(launchApps() < 0)
+   {
+      stopApps();
+      return -1;
+   }
+
+   //Open the streams, which also waits for the chain to start.
+   m_monitors.resize(m_streams.size());
+   for(size_t n = 0; n < m_streams.size(); ++n)
+   {
+      m_monitors[n].m_name = m_streams[n];
+      if(openStream(m_monitors[n]) < 0)
+      {
+         std::cerr << " (" << invokedName << "): could not open " << m_streams[n] << "\n";
+         m_stop = true;
+         for(size_t m = 0; m < n; ++m) ImageStreamIO_closeIm(&m_monitors[m].m_image);
+         stopApps();
+         if(m_srcThread.joinable()) m_srcThread.join();
+         if(m_source) ImageStreamIO_destroyIm(&m_srcImage);
+         return -1;
+      }
+   }
+
+   //Let the chain settle, e.g. for the apps to open their inputs.
+   double t = mx::sys::get_curr_time();
+   while(!g_timeToDie && mx::sys::get_curr_time() - t < m_settle) mx::sys::milliSleep(100);
+
+   for(size_t n = 0; n < m_monitors.size(); ++n)
+   {
+      m_monitors[n].m_thread = std::thread(&streamlatency::monitorThreadExec, this, &m_monitors[n]);
+   }
+
+   timespec ts0, ts1;
+   clock_gettime(CLOCK_REALTIME, &ts0);
+
+   t = mx::sys::get_curr_time();
+   while(!g_timeToDie && mx::sys::get_curr_time() - t < m_duration) mx::sys::milliSleep(100);
+
+   clock_gettime(CLOCK_REALTIME, &ts1);
+
+   //Frames in flight at the end are still caught by the monitors before they stop
+   mx::sys::milliSleep(100);
+
+   m_stop = true;
+
+   for(size_t n = 0; n < m_monitors.size(); ++n)
+   {
+      if(m_monitors[n].m_thread.joinable()) m_monitors[n].m_thread.join();
+      ImageStreamIO_closeIm(&m_monitors[n].m_image);
+   }
+
+   stopApps();
+
+   if(m_srcThread.joinable()) m_srcThread.join();
+   if(m_source) ImageStreamIO_destroyIm(&m_srcImage);
+
+   //Analyze
+   std::vector<std::vector<frameTime>> frames(m_monitors.size());
+   for(size_t n = 0; n < m_monitors.size(); ++n) frames[n].swap(m_monitors[n].m_frames);
+
+   std::vector<latencySummary> hops;
+   analyzeChain(hops, m_streams, frames, tsToNs(ts0), tsToNs(ts1));
+
+   for(size_t n = 0; n < m_monitors.size(); ++n) m_monitors[n].m_frames.swap(frames[n]);
+
+   double elapsed = (tsToNs(ts1) - tsToNs(ts0))/1e9;
+
+   if(m_report == "")
+   {
+      writeReport(std::cout, hops, elapsed);
+   }
+   else
+   {
+      std::ofstream fout(m_report);
+      if(!fout.good())
+      {
+         std::cerr << " (" << invokedName << "): could not open " << m_report << "\n";
+         return -1;
+      }
+      writeReport(fout, hops, elapsed);
+   }
+
+   if(m_samples != "")
+   {
+      std::ofstream fout(m_samples);
+      if(!fout.good())
+      {
+         std::cerr << " (" << invokedName << "): could not open " << m_samples << "\n";
+         return -1;
+      }
+
+      fout << "stream,cnt0,atime_ns,wtime_ns,rtime_ns\n";
+      for(size_t n = 0; n < m_monitors.size(); ++n)
+      {
+         for(const frameTime & f : m_monitors[n].m_frames)
+         {
+            fout << m_monitors[n].m_name << "," << f.cnt0 << "," << f.atime << "," << f.wtime << "," << f.rtime << "\n";
+         }
+      }
+   }
+
+   if(m_baseline != "") return checkBaseline(hops);
+
+   return 0;
+}
+
+inline
+int streamlatency::startSource()
+{
+   uint32_t imsize[3];
+   imsize[0] = m_width;
+   imsize[1] = m_height;
+   imsize[2] = m_circBuffLength;
+
+   if(ImageStreamIO_createIm_gpu(&m_srcImage, m_streams[0].c_str(), 3, imsize, _DATATYPE_UINT16, -1, 1, IMAGE_NB_SEMAPHORE, 0, CIRCULAR_BUFFER | ZAXIS_TEMPORAL, 0) != 0)
+   {
+      std::cerr << " (" << invokedName << "): could not create " << m_streams[0] << "\n";
+      return -1;
+   }
+
+   m_srcImage.md->cnt1 = m_circBuffLength - 1;
+
+   m_srcThread = std::thread(&streamlatency::sourceThreadExec, this);
+
+   return 0;
+}
+
+inline
+void streamlatency::sourceThreadExec()
+{
+   //A few random frames, so the downstream apps have something to chew on.
+   constexpr size_t nFrames = 16;
+   size_t npix = static_cast<size_t>(m_width)*m_height;
+
+   std::vector<uint16_t> frames(nFrames*npix);
+   std::mt19937 gen(1);
+   std::uniform_int_distribution<uint16_t> dist(0, 4095);
+   for(size_t n = 0; n < frames.size(); ++n) frames[n] = dist(gen);
+
+   int64_t period = 1e9/m_fps;
+
+   timespec deadline;
+   clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+   uint64_t next_cnt1 = 0;
+   size_t nf = 0;
+
+   while(!m_stop && !g_timeToDie)
+   {
+      deadline.tv_nsec += period;
+      while(deadline.tv_nsec >= 1000000000)
+      {
+         deadline.tv_nsec -= 1000000000;
+         ++deadline.tv_sec;
+      }
+
+      while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+      {
+         if(g_timeToDie) break;
+      }
+
+      timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+
+      //If we're more than a period behind, resync rather than bursting to catch up
+      if(tsToNs(now) - tsToNs(deadline) > period) deadline = now;
+
+      //The frame is "acquired" at the deadline
+      timespec atime;
+      clock_gettime(CLOCK_REALTIME, &atime);
+
+      m_srcImage.md->write = 1;
+
+      memcpy(m_srcImage.array.UI16 + next_cnt1*npix, frames.data() + nf*npix, npix*sizeof(uint16_t));
+
+      clock_gettime(CLOCK_REALTIME, &m_srcImage.md->writetime);
+      m_srcImage.md->atime = atime;
+
+      m_srcImage.md->cnt1 = next_cnt1;
+      m_srcImage.md->cnt0++;
+
+      m_srcImage.writetimearray[next_cnt1] = m_srcImage.md->writetime;
+      m_srcImage.atimearray[next_cnt1] = m_srcImage.md->atime;
+      m_srcImage.cntarray[next_cnt1] = m_srcImage.md->cnt0;
+
+      m_srcImage.md->write = 0;
+      ImageStreamIO_sempost(&m_srcImage, -1);
+
+      if(++next_cnt1 >= m_circBuffLength) next_cnt1 = 0;
+      if(++nf >= nFrames) nf = 0;
+   }
+}
+
+inline
+int streamlatency::launchApps()
+{
+   for(size_t n = 0; n < m_launch.size(); ++n)
+   {
+      std::vector<std::string> args;
+      std::istringstream iss(m_launch[n]);
+      std::string arg;
+      while(iss >> arg) args.push_back(arg);
+
+      if(args.size() == 0) continue;
+
+      std::vector<char *> argv;
+      for(size_t m = 0; m < args.size(); ++m) argv.push_back(const_cast<char *>(args[m].c_str()));
+      argv.push_back(nullptr);
+
+      pid_t pid = fork();
+
+      if(pid < 0)
+      {
+         std::cerr << " (" << invokedName << "): fork failed: " << strerror(errno) << "\n";
+         return -1;
+      }
+
+      if(pid == 0)
+      {
+         execvp(argv[0], argv.data());
+
+         std::cerr << " (" << invokedName << "): exec of " << m_launch[n] << " failed: " << strerror(errno) << "\n";
+         _exit(127);
+      }
+
+      std::cerr << " (" << invokedName << "): launched " << m_launch[n] << " [" << pid << "]\n";
+
+      m_pids.push_back(pid);
+   }
+
+   return 0;
+}
+
+inline
+void streamlatency::stopApps()
+{
+   for(size_t n = m_pids.size(); n > 0; --n)
+   {
+      kill(m_pids[n-1], SIGTERM);
+   }
+
+   //Give them 5 seconds to shut down cleanly
+   double t = mx::sys::get_curr_time();
+   for(size_t n = m_pids.size(); n > 0; --n)
+   {
+      while(waitpid(m_pids[n-1], nullptr, WNOHANG) == 0)
+      {
+         if(mx::sys::get_curr_time() - t > 5)
+         {
+            std::cerr << " (" << invokedName << "): killing [" << m_pids[n-1] << "]\n";
+            kill(m_pids[n-1], SIGKILL);
+            waitpid(m_pids[n-1], nullptr, 0);
+            break;
+         }
+         mx::sys::milliSleep(50);
+      }
+   }
+
+   m_pids.clear();
+}
+
+inline
+int streamlatency::openStream( streamMonitor & mon )
+{
+   double t = mx::sys::get_curr_time();
+
+   while(!g_timeToDie)
+   {
+      //Check for the file first, since ImageStreamIO_openIm complains every time it fails.
+      char SM_fname[200];
+      ImageStreamIO_filename(SM_fname, sizeof(SM_fname), mon.m_name.c_str());
+
+      if(access(SM_fname, R_OK) == 0 && ImageStreamIO_openIm(&mon.m_image, mon.m_name.c_str()) == 0)
+      {
+         return 0;
+      }
+
+      if(mx::sys::get_curr_time() - t > m_settle + 5) break;
+
+      mx::sys::milliSleep(100);
+   }
+
+   return -1;
+}
+
+inline
+void streamlatency::monitorThreadExec( streamMonitor * mon )
+{
+   IMAGE & image = mon->m_image;
+
+   int semIdx = ImageStreamIO_getsemwaitindex(&image, -1);
+   if(semIdx < 0)
+   {
+      std::cerr << " (" << invokedName << "): no free semaphore for " << mon->m_name << "\n";
+      return;
+   }
+
+   ImageStreamIO_semflush(&image, semIdx);
+
+   sem_t * sem = image.semptr[semIdx];
+
+   bool circBuff = (image.md->imagetype & CIRCULAR_BUFFER) && image.md->naxis == 3 && image.atimearray != nullptr;
+   uint64_t depth = circBuff ? image.md->size[2] : 1;
+
+   mon->m_frames.reserve( (m_duration + 1) * 2 * m_fps);
+
+   uint64_t lastCnt0 = image.md->cnt0;
+
+   while(!m_stop && !g_timeToDie)
+   {
+      timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += 100000000;
+      if(ts.tv_nsec >= 1000000000)
+      {
+         ts.tv_nsec -= 1000000000;
+         ++ts.tv_sec;
+      }
+
+      if(sem_timedwait(sem, &ts) != 0) continue;
+
+      timespec rtime;
+      clock_gettime(CLOCK_REALTIME, &rtime);
+
+      uint64_t cnt0 = image.md->cnt0;
+
+      if(cnt0 == lastCnt0) continue; //an extra post
+
+      if(!circBuff)
+      {
+         frameTime ft;
+         ft.cnt0 = cnt0;
+         ft.atime = tsToNs(image.md->atime);
+         ft.wtime = tsToNs(image.md->writetime);
+         ft.rtime = tsToNs(rtime);
+         mon->m_frames.push_back(ft);
+
+         mon->m_nLost += cnt0 - lastCnt0 - 1;
+         lastCnt0 = cnt0;
+         continue;
+      }
+
+      //Recover any frames we missed from the timing arrays, oldest first.  The newest may not be cnt0 anymore
+      //if it has been written since we read it, but cntarray tells us which frame is in each slot.
+      uint64_t cnt1 = image.md->cnt1;
+      uint64_t nnew = cnt0 - lastCnt0;
+      if(nnew > depth - 1)
+      {
+         mon->m_nLost += nnew - (depth - 1);
+         nnew = depth - 1;
+      }
+
+      for(uint64_t k = nnew; k > 0; --k)
+      {
+         uint64_t slot = (cnt1 + depth - (k-1)) % depth;
+
+         frameTime ft;
+         ft.cnt0 = image.cntarray[slot];
+         ft.atime = tsToNs(image.atimearray[slot]);
+         ft.wtime = tsToNs(image.writetimearray[slot]);
+         ft.rtime = (k == 1) ? tsToNs(rtime) : 0;
+
+         if(mon->m_frames.size() > 0 && ft.wtime <= mon->m_frames.back().wtime) continue; //already have it
+
+         mon->m_frames.push_back(ft);
+      }
+
+      lastCnt0 = cnt0;
+   }
+}
+
+inline
+void streamlatency::writeReport( std::ostream & out,
+                                 const std::vector<latencySummary> & hops,
+                                 double elapsed
+                               )
+{
+   out << "{\n";
+   out << "  \"duration_s\": " << elapsed << ",\n";
+
+   out << "  \"streams\": [\n";
+   for(size_t n = 0; n < m_monitors.size(); ++n)
+   {
+      out << "    {\"stream\": \"" << m_monitors[n].m_name << "\", \"frames\": " << m_monitors[n].m_frames.size();
+      out << ", \"lost\": " << m_monitors[n].m_nLost;
+      out << ", \"fps\": " << ((elapsed > 0) ? m_monitors[n].m_frames.size()/elapsed : 0) << "}";
+      if(n < m_monitors.size() - 1) out << ",";
+      out << "\n";
+   }
+   out << "  ],\n";
+
+   out << "  \"hops\": [\n";
+   for(size_t n = 0; n < hops.size(); ++n)
+   {
+      out << "    ";
+      writeHopJSON(out, hops[n]);
+      if(n < hops.size() - 1) out << ",";
+      out << "\n";
+   }
+   out << "  ]\n";
+   out << "}\n";
+}
+
+inline
+int streamlatency::checkBaseline( const std::vector<latencySummary> & hops )
+{
+   std::ifstream fin(m_baseline);
+   if(!fin.good())
+   {
+      std::cerr << " (" << invokedName << "): could not open baseline " << m_baseline << "\n";
+      return -1;
+   }
+
+   std::map<std::string, double> base;
+   readBaseline(base, fin);
+
+   int rv = 0;
+   for(size_t n = 0; n < hops.size(); ++n)
+   {
+      auto it = base.find(hops[n].hop);
+      if(it == base.end() || hops[n].n == 0) continue;
+
+      if(hops[n].p99 > it->second*(1 + m_tolerance) + m_toleranceAbs)
+      {
+         std::cerr << " (" << invokedName << "): regression in " << hops[n].hop << ": p99 " << hops[n].p99 << " us, baseline " << it->second << " us\n";
+         rv = 1;
+      }
+   }
+
+   return rv;
+}
+
+#endif //streamlatency_hpp
@@ -11,6 +11,12 @@
 
 #include <xrif/xrif.h>
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <sstream>
+
 
 
 
@@ -43,7 +49,7 @@ using namespace mx::sys::tsop;
   * \ingroup xrif2fits
   */
 
-bool g_timeToDie = false;
+std::atomic<bool> g_timeToDie {false};
 
 void sigTermHandler( int signum,
                      siginfo_t *siginf,
@@ -91,6 +97,8 @@ protected:
    
    bool m_cubeMode {false};
 
+   int m_nThreads {1}; ///< The number of worker threads used to decode files.  If <= 1 the files are processed serially.
+
    logMap logs;
    
    logMap tels;
@@ -102,6 +110,31 @@ protected:
    xrif_t m_xrif {nullptr};
    xrif_t m_xrif_timing {nullptr};
 
+   /** \name Parallel Decoding
+     * Each worker thread has its own xrif handles and telemetry buffers, and claims the next
+     * file to process from a shared counter.  Results are buffered per file and emitted in file
+     * order by the main thread, so the output is identical to the serial path.
+     * @{
+     */
+   std::atomic<size_t> m_nextFile {0}; ///< The index of the next file to be claimed by a worker.
+
+   std::atomic<bool> m_stop {false}; ///< Flag telling the workers to stop after their current file.
+
+   std::mutex m_resultMutex; ///< Mutex protecting the per-file results.
+
+   std::condition_variable m_resultCond; ///< Signaled each time a worker finishes a file or exits.
+
+   size_t m_workersRunning {0}; ///< The number of workers still running.  Protected by m_resultMutex.
+
+   std::vector<bool> m_fileDone; ///< Flag for each file indicating it has been processed.
+
+   std::vector<int> m_fileStatus; ///< The return value of processFile for each file.
+
+   std::vector<std::string> m_fileOut; ///< The buffered standard output for each file.
+
+   std::vector<std::string> m_fileMeta; ///< The buffered meta data output for each file.
+
+   ///@}
 
 public:
 
@@ -113,9 +146,36 @@ public:
 
    virtual int execute();
 
+   /// Read, decode, and write the output for one file.
+   /**
+     * \returns 0 on success
+     * \returns 1 if the program should stop (time to die)
+     * \returns -1 on an error
+     */
+   int processFile( size_t n,                ///< [in] the index of the file in m_files
+                    xrif_t xrif,             ///< [in] the xrif handle to use for the image data
+                    xrif_t xrif_timing,      ///< [in] the xrif handle to use for the timing data
+                    logMap & tels,           ///< [in] the telemetry map to use for meta data look up
+                    std::ostream & out,      ///< [out] the stream to which status output is written
+                    std::ostream & metaOut   ///< [out] the stream to which the meta data is written
+                  );
+
+   /// Process the files using a pool of worker threads
+   /** Results are written in file order.
+     *
+     * \returns the first non-zero return value of processFile, or 0 on success
+     */
+   int executeParallel( std::ostream & metaOut /**< [out] the stream to which the meta data is written */);
+
+   /// The worker thread function for parallel decoding.
+   void workerThreadExec();
+
    virtual int writeFloat( int n,
                            logFileName & lfn,
-                           std::vector<logMeta> & logMetas
+                           std::vector<logMeta> & logMetas,
+                           xrif_t xrif,
+                           xrif_t xrif_timing,
+                           logMap & tels
                          );
 };
 
@@ -148,6 +208,7 @@ void xrif2fits::setupConfig()
    
    config.add("noMeta","", "noMeta" , argType::True, "", "noMeta", false,  "bool", "If true, the meta data file is not written (FITS headers will still be).  Default is false.");
    config.add("cubeMode","C", "cubeMode" , argType::True, "", "cubeMode", false,  "bool", "If true, the archive is written as a FITS cube with minimal header.  Default is false.");
+   config.add("threads","j", "threads" , argType::Required, "", "threads", false,  "int", "The number of threads used to decode files in parallel.  Default is 1, which processes the files serially.");
 }
 
 inline
@@ -162,6 +223,7 @@ void xrif2fits::loadConfig()
    config(m_timesOnly, "time");
    config(m_noMeta, "noMeta");
    config(m_cubeMode, "cubeMode");
+   config(m_nThreads, "threads");
 }
 
 inline
@@ -257,7 +319,6 @@ int xrif2fits::execute()
       return -1;
    }
    
-   char header[XRIF_HEADER_SIZE];
 
    
       
@@ -294,331 +355,298 @@ int xrif2fits::execute()
       
    //Now de-compress and load the frames
    //Only decompressing the number of files needed, and only copying the number of frames needed
-   for(size_t n=0; n < m_files.size(); ++n)
+   int prv = 0;
+   if(m_nThreads <= 1)
    {
-      logFileName lfn(m_files[n]);
+      for(size_t n=0; n < m_files.size(); ++n)
+      {
+         prv = processFile(n, m_xrif, m_xrif_timing, tels, std::cout, metaOut);
+         if(prv != 0) break;
+      }
+   }
+   else
+   {
+      prv = executeParallel(metaOut);
+   }
 
-      std::vector<logMeta> logMetas;
-      logMetas.push_back(logMetaSpec({"observers", telem_observer::eventCode, "email"}));
-      logMetas.push_back(logMetaSpec({"observers", telem_observer::eventCode, "obsName"}));
+   if(prv < 0) return -1;
 
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catObj"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catRA"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catDec"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catEp"}));
+   if(!m_noMeta) metaOut.close();
    
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "ra"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "dec"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "epoch"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "el"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "am"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "ha"}));
-      logMetas.push_back(logMetaSpec({"tcsi", telem_teldata::eventCode, "pa"}));
-
-      logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "state"}));
-      logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "gain"}));
-      logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "multcoef"}));
-      logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "limit"}));
+   std::cerr << " (" << invokedName << "): exited normally.\n";
 
-      logMetas.push_back(logMetaSpec({"fxngenmodwfs", telem_fxngen::eventCode, "C1freq"}));
-      logMetas.push_back(logMetaSpec({"fxngenmodwfs", telem_fxngen::eventCode, "C2freq"}));
    
-      logMetas.push_back(logMetaSpec({"stagebs", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"stagebs", telem_stage::eventCode, "preset"}));
-      logMetas.push_back(logMetaSpec({"stagebs", telem_zaber::eventCode, "pos"}));
+   return 0;
+}
 
-      logMetas.push_back(logMetaSpec({"fwscind", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwscind", telem_stage::eventCode, "preset"}));
+inline
+int xrif2fits::processFile( size_t n,
+                            xrif_t xrif,
+                            xrif_t xrif_timing,
+                            logMap & tels,
+                            std::ostream & out,
+                            std::ostream & metaOut
+                          )
+{
+   xrif_error_t rv;
+   char header[XRIF_HEADER_SIZE];
 
-      logMetas.push_back(logMetaSpec({"fwpupil", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwpupil", telem_stage::eventCode, "preset"}));
-      
-      logMetas.push_back(logMetaSpec({"fwfpm", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwfpm", telem_stage::eventCode, "preset"}));
-   
-      logMetas.push_back(logMetaSpec({"fwlowfs", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwlowfs", telem_stage::eventCode, "preset"}));
+   logFileName lfn(m_files[n]);
 
-      logMetas.push_back(logMetaSpec({"fwlyot", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwlyot", telem_stage::eventCode, "preset"}));
-   
-      logMetas.push_back(logMetaSpec({"stagescibs", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"stagescibs", telem_stage::eventCode, "preset"}));
-      logMetas.push_back(logMetaSpec({"stagescibs", telem_zaber::eventCode, "pos"}));
+   std::vector<logMeta> logMetas;
+   logMetas.push_back(logMetaSpec({"observers", telem_observer::eventCode, "email"}));
+   logMetas.push_back(logMetaSpec({"observers", telem_observer::eventCode, "obsName"}));
 
-      logMetas.push_back(logMetaSpec({"fwsci1", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwsci1", telem_stage::eventCode, "preset"}));
-      
-      logMetas.push_back(logMetaSpec({"fwsci2", telem_stage::eventCode, "presetName"}));
-      logMetas.push_back(logMetaSpec({"fwsci2", telem_stage::eventCode, "preset"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catObj"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catRA"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catDec"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telcat::eventCode, "catEp"}));
 
-      logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "fps"));
-      logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "xbin"));
-      logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "ybin"));
-      logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "emGain"));
-      
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "exptime"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "fps"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "mode"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "xcen"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "ycen"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "width"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "xbin"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "ybin"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "emGain"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "adcSpeed"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "temp"));
-      logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "shutterState"));
-
-      std::string channel = lfn.appName().substr(3);
-
-      // For channels with associated focus stages, report those positions as headers
-      if (channel == "sci1" || channel == "sci2" || channel == "lowfs") {
-         logMetas.push_back(logMetaSpec({"stage" + channel, telem_stage::eventCode, "presetName"}));
-         logMetas.push_back(logMetaSpec({"stage" + channel, telem_stage::eventCode, "preset"}));
-         logMetas.push_back(logMetaSpec({"stage" + channel, telem_zaber::eventCode, "pos"}));
-      }
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "ra"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "dec"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "epoch"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "el"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "am"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_telpos::eventCode, "ha"}));
+   logMetas.push_back(logMetaSpec({"tcsi", telem_teldata::eventCode, "pa"}));
 
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "modulating"}));
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "trigger"}));
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "frequency"}));
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "separations"}));
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "angles"}));
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "amplitudes"}));
-      logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "crosses"}));
+   logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "state"}));
+   logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "gain"}));
+   logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "multcoef"}));
+   logMetas.push_back(logMetaSpec({"holoop", telem_loopgain::eventCode, "limit"}));
 
-      logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "state"}));
-      logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "gain"}));
-      logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "multcoef"}));
-      logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "limit"}));
+   logMetas.push_back(logMetaSpec({"fxngenmodwfs", telem_fxngen::eventCode, "C1freq"}));
+   logMetas.push_back(logMetaSpec({"fxngenmodwfs", telem_fxngen::eventCode, "C2freq"}));
 
-      if(g_timeToDie == true) break; //check before going on
+   logMetas.push_back(logMetaSpec({"stagebs", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"stagebs", telem_stage::eventCode, "preset"}));
+   logMetas.push_back(logMetaSpec({"stagebs", telem_zaber::eventCode, "pos"}));
 
-      
-      
-      tels.loadFiles(lfn.appName(), lfn.timestamp());
-      
-      logMeta exptimeMeta(logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "exptime"));
-
-      if (!m_timesOnly) {
+   logMetas.push_back(logMetaSpec({"fwscind", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwscind", telem_stage::eventCode, "preset"}));
 
-         std::cout << "******************************************************\n";
-         std::cout << "* xrif2fits: decoding for " << lfn.appName() << " (" + m_files[n] << ")\n";
-         std::cout << "******************************************************\n";
-      }
-      
-      FILE * fp_xrif = fopen(m_files[n].c_str(), "rb");
-      if(fp_xrif == nullptr)
-      {
-         std::cerr << " (" << invokedName << "): Error opening " << m_files[n] << "\n";
-         std::cerr << " (" << invokedName << "): " << strerror(errno) << "\n";
-         return -1;
-      }
+   logMetas.push_back(logMetaSpec({"fwpupil", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwpupil", telem_stage::eventCode, "preset"}));
+   
+   logMetas.push_back(logMetaSpec({"fwfpm", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwfpm", telem_stage::eventCode, "preset"}));
 
-      size_t nr = fread(header, 1, XRIF_HEADER_SIZE, fp_xrif);
-      if(nr != XRIF_HEADER_SIZE)
-      {
-         std::cerr << " (" << invokedName << "): Error reading header of " << m_files[n] << "\n";
-         fclose(fp_xrif);
-         return -1;
-      }
+   logMetas.push_back(logMetaSpec({"fwlowfs", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwlowfs", telem_stage::eventCode, "preset"}));
 
-      uint32_t header_size;
-      xrif_read_header(m_xrif, &header_size , header);
-      if (!m_timesOnly) {
-         std::cout << "xrif compression details:\n";
-         std::cout << "  difference method:  " << xrif_difference_method_string(m_xrif->difference_method) << '\n';
-         std::cout << "  reorder method:     " << xrif_reorder_method_string(m_xrif->reorder_method) << '\n';
-         std::cout << "  compression method: " << xrif_compress_method_string( m_xrif->compress_method) << '\n';
-         if(m_xrif->compress_method == XRIF_COMPRESS_LZ4)
-         {
-            std::cout << "    LZ4 acceleration: " << m_xrif->lz4_acceleration << '\n';
-         }
-         std::cout << "  dimensions:         " << m_xrif->width << " x " << m_xrif->height << " x " << m_xrif->depth << " x " << m_xrif->frames << "\n";
-         std::cout << "  raw size:           " << m_xrif->width*m_xrif->height*m_xrif->depth*m_xrif->frames*m_xrif->data_size << " bytes\n";
-         std::cout << "  encoded size:       " << m_xrif->compressed_size << " bytes\n";
-         std::cout << "  ratio:              " << ((double)m_xrif->compressed_size) / (m_xrif->width*m_xrif->height*m_xrif->depth*m_xrif->frames*m_xrif->data_size) << '\n';
-      }
-      rv = xrif_allocate_raw(m_xrif); 
-      if( rv != XRIF_NOERROR)
-      {
-         std::cerr << " (" << invokedName << "): Error allocating raw buffer for " << m_files[n] << "\n";
-         std::cerr << "\t code: " << rv << "\n";
-         return -1;
-      }
-      
-      rv = xrif_allocate_reordered(m_xrif); 
-      if(rv != XRIF_NOERROR)
-      {
-         std::cerr << " (" << invokedName << "): Error allocating reordered buffer for " << m_files[n] << "\n";
-         std::cerr << "\t code: " << rv << "\n";
-         return -1;
-      }
+   logMetas.push_back(logMetaSpec({"fwlyot", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwlyot", telem_stage::eventCode, "preset"}));
 
-      nr = fread(m_xrif->raw_buffer, 1, m_xrif->compressed_size, fp_xrif);
-      
-      if(nr != m_xrif->compressed_size)
-      {
-         std::cerr << " (" << invokedName << "): Error reading data from " << m_files[n] << "\n";
-         return -1;
-      }
+   logMetas.push_back(logMetaSpec({"stagescibs", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"stagescibs", telem_stage::eventCode, "preset"}));
+   logMetas.push_back(logMetaSpec({"stagescibs", telem_zaber::eventCode, "pos"}));
 
-      
-      //Now get timing data
-      nr = fread(header, 1, XRIF_HEADER_SIZE, fp_xrif);
-      if(nr != XRIF_HEADER_SIZE)
-      {
-         std::cerr << " (" << invokedName << "): Error reading timing header of " << m_files[n] << "\n";
-         fclose(fp_xrif);
-         return -1;
-      }
-      
-      xrif_read_header(m_xrif_timing, &header_size , header);
+   logMetas.push_back(logMetaSpec({"fwsci1", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwsci1", telem_stage::eventCode, "preset"}));
+   
+   logMetas.push_back(logMetaSpec({"fwsci2", telem_stage::eventCode, "presetName"}));
+   logMetas.push_back(logMetaSpec({"fwsci2", telem_stage::eventCode, "preset"}));
 
-      if (!m_timesOnly) {
-         std::cout << "xrif timing data compression details:\n";
-         std::cout << "  difference method:  " << xrif_difference_method_string(m_xrif_timing->difference_method) << '\n';
-         std::cout << "  reorder method:     " << xrif_reorder_method_string(m_xrif_timing->reorder_method) << '\n';
-         std::cout << "  compression method: " << xrif_compress_method_string( m_xrif_timing->compress_method) << '\n';
-         if(m_xrif_timing->compress_method == XRIF_COMPRESS_LZ4)
-         {
-            std::cout << "    LZ4 acceleration: " << m_xrif_timing->lz4_acceleration << '\n';
-         }
-         std::cout << "  dimensions:         " << m_xrif_timing->width << " x " << m_xrif_timing->height << " x " << m_xrif_timing->depth << " x " << m_xrif_timing->frames << "\n";
-         std::cout << "  raw size:           " << m_xrif_timing->width*m_xrif_timing->height*m_xrif_timing->depth*m_xrif_timing->frames*m_xrif_timing->data_size << " bytes\n";
-         std::cout << "  encoded size:       " << m_xrif_timing->compressed_size << " bytes\n";
-         std::cout << "  ratio:              " << ((double)m_xrif_timing->compressed_size) / (m_xrif_timing->width*m_xrif_timing->height*m_xrif_timing->depth*m_xrif_timing->frames*m_xrif_timing->data_size) << '\n';
-      }
-      rv = xrif_allocate_raw(m_xrif_timing);
-      if(rv != XRIF_NOERROR)
-      {
-         std::cerr << " (" << invokedName << "): Error allocating raw buffer for timing data from " << m_files[n] << "\n";
-         std::cerr << "\t code: " << rv << "\n";
-         return -1;
-      }
-      
-      rv = xrif_allocate_reordered(m_xrif_timing);
-      if(rv != XRIF_NOERROR)
-      {
-         std::cerr << " (" << invokedName << "): Error allocating reordered buffer for  timing data from " << m_files[n] << "\n";
-         std::cerr << "\t code: " << rv << "\n";
-         return -1;
-      }
-      
-      nr = fread(m_xrif_timing->raw_buffer, 1, m_xrif_timing->compressed_size, fp_xrif);
-    
-      if(nr != m_xrif_timing->compressed_size)
-      {
-         std::cerr << " (" << invokedName << "): Error reading timing data from " << m_files[n] << "\n";
-         return -1;
-      }
-      
-      fclose(fp_xrif);
+   logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "fps"));
+   logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "xbin"));
+   logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "ybin"));
+   logMetas.push_back( logMetaSpec("camwfs", telem_stdcam::eventCode, "emGain"));
+   
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "exptime"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "fps"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "mode"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "xcen"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "ycen"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "width"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "xbin"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "ybin"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "emGain"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "adcSpeed"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "temp"));
+   logMetas.push_back( logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "shutterState"));
+
+   std::string channel = lfn.appName().substr(3);
+
+   // For channels with associated focus stages, report those positions as headers
+   if (channel == "sci1" || channel == "sci2" || channel == "lowfs") {
+      logMetas.push_back(logMetaSpec({"stage" + channel, telem_stage::eventCode, "presetName"}));
+      logMetas.push_back(logMetaSpec({"stage" + channel, telem_stage::eventCode, "preset"}));
+      logMetas.push_back(logMetaSpec({"stage" + channel, telem_zaber::eventCode, "pos"}));
+   }
 
-      if(g_timeToDie == true) break; //check after the long read.
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "modulating"}));
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "trigger"}));
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "frequency"}));
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "separations"}));
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "angles"}));
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "amplitudes"}));
+   logMetas.push_back( logMetaSpec({"tweeterSpeck", telem_dmspeck::eventCode, "crosses"}));
 
-      if(!m_metaOnly)
-      {
-         rv = xrif_decode(m_xrif);
-         if(rv != XRIF_NOERROR)
-         {
-            std::cerr << " (" << invokedName << "): Error decoding image data from " << m_files[n] << "\n";
-            std::cerr << "\t code: " << rv << "\n";
-            return -1;
-         }
-      }
-      
-      rv = xrif_decode(m_xrif_timing); 
-      if(rv != XRIF_NOERROR)
-      {
-         std::cerr << " (" << invokedName << "): Error decoding timing data from " << m_files[n] << "\n";
-         std::cerr << "\t code: " << rv << "\n";
-         return -1;
-      }
-               
-      if(g_timeToDie == true) break; //check after the decompress.
+   logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "state"}));
+   logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "gain"}));
+   logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "multcoef"}));
+   logMetas.push_back(logMetaSpec({"loloop", telem_loopgain::eventCode, "limit"}));
 
+   if(g_timeToDie == true) return 1; //check before going on
 
-      if(m_timesOnly) {
-         std::cout << m_files[n] << " ";
-         double totalExposureTime = 0;
+   
+   
+   tels.loadFiles(lfn.appName(), lfn.timestamp());
+   
+   logMeta exptimeMeta(logMetaSpec(lfn.appName(), telem_stdcam::eventCode, "exptime"));
 
-         for(xrif_dimension_t q=0; q < m_xrif->frames; ++q)
-         {
-            timespec atime; //This is the acquisition time of the exposure
-            timespec stime = {0,0}; //This is the start time of the exposure, calculated as atime-exptime.
+   if (!m_timesOnly) {
 
-            uint64_t * curr_timing = (uint64_t*) m_xrif_timing->raw_buffer + 5*q;
+      out << "******************************************************\n";
+      out << "* xrif2fits: decoding for " << lfn.appName() << " (" + m_files[n] << ")\n";
+      out << "******************************************************\n";
+   }
+   
+   FILE * fp_xrif = fopen(m_files[n].c_str(), "rb");
+   if(fp_xrif == nullptr)
+   {
+      std::cerr << " (" << invokedName << "): Error opening " << m_files[n] << "\n";
+      std::cerr << " (" << invokedName << "): " << strerror(errno) << "\n";
+      return -1;
+   }
 
-            atime.tv_sec = curr_timing[1];
-            atime.tv_nsec = curr_timing[2];
+   size_t nr = fread(header, 1, XRIF_HEADER_SIZE, fp_xrif);
+   if(nr != XRIF_HEADER_SIZE)
+   {
+      std::cerr << " (" << invokedName << "): Error reading header of " << m_files[n] << "\n";
+      fclose(fp_xrif);
+      return -1;
+   }
 
-            //We have to bootstrap the exposure time
-            char * prior = nullptr;
-            tels.getPriorLog(prior, lfn.appName(), eventCodes::TELEM_STDCAM, atime);
-            double exptime = -1;
-            if(prior)
-            {
-               char * priorprior = nullptr;
-               exptime = telem_stdcam::exptime(logHeader::messageBuffer(prior));
-               stime = atime-exptime;
-               tels.getPriorLog(priorprior, lfn.appName(), eventCodes::TELEM_STDCAM, stime);
-
-               if(telem_stdcam::exptime(logHeader::messageBuffer(priorprior)) != exptime) ///\todo this needs to check for any log entries between end and start
-               {
-                  std::cerr << "Change in exposure time mid-exposure\n";
-               }
-            }
-            else
-            {
-               std::cerr << "no prior\n";
-            }
-            totalExposureTime += exptime;
+   uint32_t header_size;
+   xrif_read_header(xrif, &header_size , header);
+   if (!m_timesOnly) {
+      out << "xrif compression details:\n";
+      out << "  difference method:  " << xrif_difference_method_string(xrif->difference_method) << '\n';
+      out << "  reorder method:     " << xrif_reorder_method_string(xrif->reorder_method) << '\n';
+      out << "  compression method: " << xrif_compress_method_string( xrif->compress_method) << '\n';
+      if(xrif->compress_method == XRIF_COMPRESS_LZ4)
+      {
+         out << "    LZ4 acceleration: " << xrif->lz4_acceleration << '\n';
+      }
+      out << "  dimensions:         " << xrif->width << " x " << xrif->height << " x " << xrif->depth << " x " << xrif->frames << "\n";
+      out << "  raw size:           " << xrif->width*xrif->height*xrif->depth*xrif->frames*xrif->data_size << " bytes\n";
+      out << "  encoded size:       " << xrif->compressed_size << " bytes\n";
+      out << "  ratio:              " << ((double)xrif->compressed_size) / (xrif->width*xrif->height*xrif->depth*xrif->frames*xrif->data_size) << '\n';
+   }
+   rv = xrif_allocate_raw(xrif); 
+   if( rv != XRIF_NOERROR)
+   {
+      std::cerr << " (" << invokedName << "): Error allocating raw buffer for " << m_files[n] << "\n";
+      std::cerr << "\t code: " << rv << "\n";
+      return -1;
+   }
+   
+   rv = xrif_allocate_reordered(xrif); 
+   if(rv != XRIF_NOERROR)
+   {
+      std::cerr << " (" << invokedName << "): Error allocating reordered buffer for " << m_files[n] << "\n";
+      std::cerr << "\t code: " << rv << "\n";
+      return -1;
+   }
 
-            std::string timestamp;
-            mx::sys::timeStamp(timestamp, atime);
+   nr = fread(xrif->raw_buffer, 1, xrif->compressed_size, fp_xrif);
+   
+   if(nr != xrif->compressed_size)
+   {
+      std::cerr << " (" << invokedName << "): Error reading data from " << m_files[n] << "\n";
+      return -1;
+   }
 
-            std::string dateobs = mx::sys::ISO8601DateTimeStr(atime, 1);
-            if (q == 0) {
-               std::cout << dateobs << " ";
-            }
-            if (q == (m_xrif->frames - 1)) {
-               std::cout << dateobs << " " << totalExposureTime << " " << m_xrif->frames << "\n";
-            }
-         }
-      } else if (m_xrif->type_code == XRIF_TYPECODE_FLOAT)
+   
+   //Now get timing data
+   nr = fread(header, 1, XRIF_HEADER_SIZE, fp_xrif);
+   if(nr != XRIF_HEADER_SIZE)
+   {
+      std::cerr << " (" << invokedName << "): Error reading timing header of " << m_files[n] << "\n";
+      fclose(fp_xrif);
+      return -1;
+   }
+   
+   xrif_read_header(xrif_timing, &header_size , header);
+
+   if (!m_timesOnly) {
+      out << "xrif timing data compression details:\n";
+      out << "  difference method:  " << xrif_difference_method_string(xrif_timing->difference_method) << '\n';
+      out << "  reorder method:     " << xrif_reorder_method_string(xrif_timing->reorder_method) << '\n';
+      out << "  compression method: " << xrif_compress_method_string( xrif_timing->compress_method) << '\n';
+      if(xrif_timing->compress_method == XRIF_COMPRESS_LZ4)
       {
-         writeFloat(n, lfn, logMetas);
+         out << "    LZ4 acceleration: " << xrif_timing->lz4_acceleration << '\n';
       }
-      else
-      {
-      mx::improc::eigenCube<unsigned short> tmpc( (unsigned short*) m_xrif->raw_buffer, m_xrif->width, m_xrif->height, m_xrif->frames);
+      out << "  dimensions:         " << xrif_timing->width << " x " << xrif_timing->height << " x " << xrif_timing->depth << " x " << xrif_timing->frames << "\n";
+      out << "  raw size:           " << xrif_timing->width*xrif_timing->height*xrif_timing->depth*xrif_timing->frames*xrif_timing->data_size << " bytes\n";
+      out << "  encoded size:       " << xrif_timing->compressed_size << " bytes\n";
+      out << "  ratio:              " << ((double)xrif_timing->compressed_size) / (xrif_timing->width*xrif_timing->height*xrif_timing->depth*xrif_timing->frames*xrif_timing->data_size) << '\n';
+   }
+   rv = xrif_allocate_raw(xrif_timing);
+   if(rv != XRIF_NOERROR)
+   {
+      std::cerr << " (" << invokedName << "): Error allocating raw buffer for timing data from " << m_files[n] << "\n";
+      std::cerr << "\t code: " << rv << "\n";
+      return -1;
+   }
+   
+   rv = xrif_allocate_reordered(xrif_timing);
+   if(rv != XRIF_NOERROR)
+   {
+      std::cerr << " (" << invokedName << "): Error allocating reordered buffer for  timing data from " << m_files[n] << "\n";
+      std::cerr << "\t code: " << rv << "\n";
+      return -1;
+   }
+   
+   nr = fread(xrif_timing->raw_buffer, 1, xrif_timing->compressed_size, fp_xrif);
+ 
+   if(nr != xrif_timing->compressed_size)
+   {
+      std::cerr << " (" << invokedName << "): Error reading timing data from " << m_files[n] << "\n";
+      return -1;
+   }
+   
+   fclose(fp_xrif);
 
-      mx::fits::fitsFile<unsigned short> ff;
-      mx::fits::fitsHeader fh;
-      
-      if(m_cubeMode)
+   if(g_timeToDie == true) return 1; //check after the long read.
+
+   if(!m_metaOnly)
+   {
+      rv = xrif_decode(xrif);
+      if(rv != XRIF_NOERROR)
       {
-         std::string outfname = m_outDir + mx::ioutils::pathStem(m_files[n]) + ".fits";
-         ff.write(outfname, tmpc);
+         std::cerr << " (" << invokedName << "): Error decoding image data from " << m_files[n] << "\n";
+         std::cerr << "\t code: " << rv << "\n";
+         return -1;
       }
-      else
-      {
+   }
+   
+   rv = xrif_decode(xrif_timing); 
+   if(rv != XRIF_NOERROR)
+   {
+      std::cerr << " (" << invokedName << "): Error decoding timing data from " << m_files[n] << "\n";
+      std::cerr << "\t code: " << rv << "\n";
+      return -1;
+   }
+            
+   if(g_timeToDie == true) return 1; //check after the decompress.
 
-      for( int q=0; q < tmpc.planes(); ++q)
+
+   if(m_timesOnly) {
+      out << m_files[n] << " ";
+      double totalExposureTime = 0;
+
+      for(xrif_dimension_t q=0; q < xrif->frames; ++q)
       {
-         uint64_t cnt0;
          timespec atime; //This is the acquisition time of the exposure
-         timespec wtime;
          timespec stime = {0,0}; //This is the start time of the exposure, calculated as atime-exptime.
-      
-         uint64_t * curr_timing = (uint64_t*) m_xrif_timing->raw_buffer + 5*q;
-         
-         cnt0 = curr_timing[0];
+
+         uint64_t * curr_timing = (uint64_t*) xrif_timing->raw_buffer + 5*q;
+
          atime.tv_sec = curr_timing[1];
-         atime.tv_nsec = curr_timing[2]; 
-         wtime.tv_sec = curr_timing[3];
-         wtime.tv_nsec = curr_timing[4];
+         atime.tv_nsec = curr_timing[2];
 
          //We have to bootstrap the exposure time
          char * prior = nullptr;
@@ -628,12 +656,9 @@ int xrif2fits::execute()
          {
             char * priorprior = nullptr;
             exptime = telem_stdcam::exptime(logHeader::messageBuffer(prior));
-         
             stime = atime-exptime;
             tels.getPriorLog(priorprior, lfn.appName(), eventCodes::TELEM_STDCAM, stime);
 
-            //std::cerr << "Exptime: " << telem_stdcam::exptime(logHeader::messageBuffer(priorprior)) << "\n";
-
             if(telem_stdcam::exptime(logHeader::messageBuffer(priorprior)) != exptime) ///\todo this needs to check for any log entries between end and start
             {
                std::cerr << "Change in exposure time mid-exposure\n";
@@ -643,92 +668,271 @@ int xrif2fits::execute()
          {
             std::cerr << "no prior\n";
          }
-         
+         totalExposureTime += exptime;
+
          std::string timestamp;
          mx::sys::timeStamp(timestamp, atime);
-         std::string outfname = m_outDir + lfn.appName() + "_" + timestamp + ".fits";
 
-         fh.clear();
-         
          std::string dateobs = mx::sys::ISO8601DateTimeStr(atime, 1);
-         
-         fh.append("DATE-OBS", dateobs, "Date of obs. YYYY-mm-ddTHH:MM:SS");
-         fh.append("INSTRUME", "MagAO-X");
-         fh.append("CAMERA", lfn.appName());
-         fh.append("TELESCOP", "Magellan Clay, Las Campanas Obs.");
-         
-         if(!m_noMeta)
-         {
-            metaOut << dateobs << " " << cnt0 << " " << atime.tv_sec << " " << atime.tv_nsec << " " << wtime.tv_sec << " " << wtime.tv_nsec << " ";
+         if (q == 0) {
+            out << dateobs << " ";
          }
-         
-         if(exptime > -1)
-         {
-            //First output exposure time
-            //fh.append(exptimeMeta.card(tels,stime,atime));
-            if(!m_noMeta) metaOut << exptimeMeta.value(tels, stime, atime);
-
-            //Then output each value in turn
-            for(size_t u=0;u<logMetas.size();++u)
-            {
-               mx::fits::fitsHeaderCard fc = logMetas[u].card(tels, stime, atime);
-               fh.append(fc);
-               if(!m_noMeta) metaOut << " " << logMetas[u].value(tels, stime, atime) ;
-            }         
+         if (q == (xrif->frames - 1)) {
+            out << dateobs << " " << totalExposureTime << " " << xrif->frames << "\n";
          }
+      }
+   } else if (xrif->type_code == XRIF_TYPECODE_FLOAT)
+   {
+      writeFloat(n, lfn, logMetas, xrif, xrif_timing, tels);
+   }
+   else
+   {
+   mx::improc::eigenCube<unsigned short> tmpc( (unsigned short*) xrif->raw_buffer, xrif->width, xrif->height, xrif->frames);
 
+   mx::fits::fitsFile<unsigned short> ff;
+   mx::fits::fitsHeader fh;
+   
+   if(m_cubeMode)
+   {
+      std::string outfname = m_outDir + mx::ioutils::pathStem(m_files[n]) + ".fits";
+      ff.write(outfname, tmpc);
+   }
+   else
+   {
 
-         fh.append("FRAMENO", cnt0);
-         fh.append("ACQSEC", atime.tv_sec);
-         fh.append("ACQNSEC", atime.tv_nsec);
-         fh.append("WRTSEC", wtime.tv_sec);
-         fh.append("WRTNSEC", wtime.tv_nsec);
-
-
-         if(!m_noMeta) metaOut << "\n";
+   for( int q=0; q < tmpc.planes(); ++q)
+   {
+      uint64_t cnt0;
+      timespec atime; //This is the acquisition time of the exposure
+      timespec wtime;
+      timespec stime = {0,0}; //This is the start time of the exposure, calculated as atime-exptime.
+   
+      uint64_t * curr_timing = (uint64_t*) xrif_timing->raw_buffer + 5*q;
+      
+      cnt0 = curr_timing[0];
+      atime.tv_sec = curr_timing[1];
+      atime.tv_nsec = curr_timing[2]; 
+      wtime.tv_sec = curr_timing[3];
+      wtime.tv_nsec = curr_timing[4];
+
+      //We have to bootstrap the exposure time
+      char * prior = nullptr;
+      tels.getPriorLog(prior, lfn.appName(), eventCodes::TELEM_STDCAM, atime);
+      double exptime = -1;
+      if(prior)
+      {
+         char * priorprior = nullptr;
+         exptime = telem_stdcam::exptime(logHeader::messageBuffer(prior));
+      
+         stime = atime-exptime;
+         tels.getPriorLog(priorprior, lfn.appName(), eventCodes::TELEM_STDCAM, stime);
 
+         //std::cerr << "Exptime: " << telem_stdcam::exptime(logHeader::messageBuffer(priorprior)) << "\n";
 
-         if(!m_metaOnly)
+         if(telem_stdcam::exptime(logHeader::messageBuffer(priorprior)) != exptime) ///\todo this needs to check for any log entries between end and start
          {
-            mx::improc::eigenImage<unsigned short> im = tmpc.image(q);
-            ff.write(outfname, tmpc.image(q), fh);
+            std::cerr << "Change in exposure time mid-exposure\n";
          }
-
       }
+      else
+      {
+         std::cerr << "no prior\n";
       }
-      //Below is for cubes
-      /*
-      outname = m_files[n];
-      ext = outname.find(".xrif");
-      outname.replace( ext, 5, ".time");
       
-      std::ofstream fout;
-      fout.open(outname);
-      fout << "#cnt0   atime-sec  atime-nsec wtime-sec  wtime-nsec\n";
-      for(int i=0; i< tmpc.planes(); ++i)
+      std::string timestamp;
+      mx::sys::timeStamp(timestamp, atime);
+      std::string outfname = m_outDir + lfn.appName() + "_" + timestamp + ".fits";
+
+      fh.clear();
+      
+      std::string dateobs = mx::sys::ISO8601DateTimeStr(atime, 1);
+      
+      fh.append("DATE-OBS", dateobs, "Date of obs. YYYY-mm-ddTHH:MM:SS");
+      fh.append("INSTRUME", "MagAO-X");
+      fh.append("CAMERA", lfn.appName());
+      fh.append("TELESCOP", "Magellan Clay, Las Campanas Obs.");
+      
+      if(!m_noMeta)
       {
-         uint64_t * curr_timing = (uint64_t*) m_xrif_timing->raw_buffer + 5*i;
-         
-         fout << curr_timing[0] << " " << curr_timing[1] << " " << curr_timing[2] << "  " << curr_timing[3] << " " << curr_timing[4] << "\n";
-      }*/
-   }
+         metaOut << dateobs << " " << cnt0 << " " << atime.tv_sec << " " << atime.tv_nsec << " " << wtime.tv_sec << " " << wtime.tv_nsec << " ";
+      }
+      
+      if(exptime > -1)
+      {
+         //First output exposure time
+         //fh.append(exptimeMeta.card(tels,stime,atime));
+         if(!m_noMeta) metaOut << exptimeMeta.value(tels, stime, atime);
+
+         //Then output each value in turn
+         for(size_t u=0;u<logMetas.size();++u)
+         {
+            mx::fits::fitsHeaderCard fc = logMetas[u].card(tels, stime, atime);
+            fh.append(fc);
+            if(!m_noMeta) metaOut << " " << logMetas[u].value(tels, stime, atime) ;
+         }         
+      }
+
+
+      fh.append("FRAMENO", cnt0);
+      fh.append("ACQSEC", atime.tv_sec);
+      fh.append("ACQNSEC", atime.tv_nsec);
+      fh.append("WRTSEC", wtime.tv_sec);
+      fh.append("WRTNSEC", wtime.tv_nsec);
+
+
+      if(!m_noMeta) metaOut << "\n";
+
+
+      if(!m_metaOnly)
+      {
+         mx::improc::eigenImage<unsigned short> im = tmpc.image(q);
+         ff.write(outfname, tmpc.image(q), fh);
+      }
 
    }
-   if(!m_noMeta) metaOut.close();
+   }
+   //Below is for cubes
+   /*
+   outname = m_files[n];
+   ext = outname.find(".xrif");
+   outname.replace( ext, 5, ".time");
    
-   std::cerr << " (" << invokedName << "): exited normally.\n";
-
+   std::ofstream fout;
+   fout.open(outname);
+   fout << "#cnt0   atime-sec  atime-nsec wtime-sec  wtime-nsec\n";
+   for(int i=0; i< tmpc.planes(); ++i)
+   {
+      uint64_t * curr_timing = (uint64_t*) xrif_timing->raw_buffer + 5*i;
+      
+      fout << curr_timing[0] << " " << curr_timing[1] << " " << curr_timing[2] << "  " << curr_timing[3] << " " << curr_timing[4] << "\n";
+   }*/
+   }
    
    return 0;
 }
 
+inline
+int xrif2fits::executeParallel( std::ostream & metaOut )
+{
+   size_t nThreads = m_nThreads;
+   if(nThreads > m_files.size()) nThreads = m_files.size();
+
+   m_nextFile = 0;
+   m_stop = false;
+   m_workersRunning = nThreads;
+   m_fileDone.assign(m_files.size(), false);
+   m_fileStatus.assign(m_files.size(), 0);
+   m_fileOut.assign(m_files.size(), "");
+   m_fileMeta.assign(m_files.size(), "");
+
+   std::vector<std::thread> workers;
+   for(size_t t=0; t < nThreads; ++t)
+   {
+      workers.emplace_back(&xrif2fits::workerThreadExec, this);
+   }
+
+   //Emit the results in file order as they become available
+   int rv = 0;
+   for(size_t n=0; n < m_files.size(); ++n)
+   {
+      std::string fout, fmeta;
+      int status;
+
+      {
+         std::unique_lock<std::mutex> lock(m_resultMutex);
+         m_resultCond.wait(lock, [this, n]{ return m_fileDone[n] || m_workersRunning == 0; });
+
+         if(!m_fileDone[n]) break; //workers stopped before this file was claimed
+
+         fout.swap(m_fileOut[n]);
+         fmeta.swap(m_fileMeta[n]);
+         status = m_fileStatus[n];
+      }
+
+      std::cout << fout;
+      metaOut << fmeta;
+
+      if(status != 0)
+      {
+         rv = status;
+         break;
+      }
+   }
+
+   m_stop = true;
+   for(size_t t=0; t < workers.size(); ++t)
+   {
+      workers[t].join();
+   }
+
+   return rv;
+}
+
+inline
+void xrif2fits::workerThreadExec()
+{
+   xrif_t xrif {nullptr};
+   xrif_t xrif_timing {nullptr};
+
+   int rv = 0;
+
+   if(xrif_new(&xrif) < 0)
+   {
+      std::cerr << " (" << invokedName << "): Error allocating xrif.\n";
+      rv = -1;
+   }
+   else if(xrif_new(&xrif_timing) < 0)
+   {
+      std::cerr << " (" << invokedName << "): Error allocating xrif_timing.\n";
+      rv = -1;
+   }
+
+   //logMap loads files on demand and is not thread safe, so each worker gets its own buffers
+   logMap wtels;
+   wtels.m_appToFileMap = tels.m_appToFileMap;
+
+   while(rv == 0 && !m_stop && !g_timeToDie)
+   {
+      size_t n = m_nextFile.fetch_add(1);
+      if(n >= m_files.size()) break;
+
+      std::ostringstream out;
+      std::ostringstream meta;
+
+      rv = processFile(n, xrif, xrif_timing, wtels, out, meta);
+
+      {
+         std::lock_guard<std::mutex> lock(m_resultMutex);
+         m_fileOut[n] = out.str();
+         m_fileMeta[n] = meta.str();
+         m_fileStatus[n] = rv;
+         m_fileDone[n] = true;
+      }
+      m_resultCond.notify_all();
+   }
+
+   if(rv != 0) m_stop = true;
+
+   if(xrif) xrif_delete(xrif);
+   if(xrif_timing) xrif_delete(xrif_timing);
+
+   {
+      std::lock_guard<std::mutex> lock(m_resultMutex);
+      --m_workersRunning;
+   }
+   m_resultCond.notify_all();
+}
+
 inline
 int xrif2fits::writeFloat( int n,
                            logFileName & lfn,
-                           std::vector<logMeta> & logMetas
+                           std::vector<logMeta> & logMetas,
+                           xrif_t xrif,
+                           xrif_t xrif_timing,
+                           logMap & tels
                          )
 {
-   mx::improc::eigenCube<float> tmpc( (float*) m_xrif->raw_buffer, m_xrif->width, m_xrif->height, m_xrif->frames);
+   mx::improc::eigenCube<float> tmpc( (float*) xrif->raw_buffer, xrif->width, xrif->height, xrif->frames);
 
       mx::fits::fitsFile<float> ff;
       mx::fits::fitsHeader fh;
@@ -748,7 +952,7 @@ int xrif2fits::writeFloat( int n,
          timespec wtime;
          timespec stime = {0,0}; //This is the start time of the exposure, calculated as atime-exptime.
       
-         uint64_t * curr_timing = (uint64_t*) m_xrif_timing->raw_buffer + 5*q;
+         uint64_t * curr_timing = (uint64_t*) xrif_timing->raw_buffer + 5*q;
          
          cnt0 = curr_timing[0];
          atime.tv_sec = curr_timing[1];
@@ -18,6 +18,12 @@
 
 #include <mx/sys/timeUtils.hpp>
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cmath>
+
 #include "../../libMagAOX/libMagAOX.hpp"
 
 /// Sleep for a specified period in microseconds.
@@ -43,7 +49,7 @@ void microsleep( unsigned usec /**< [in] the number of microseconds to sleep. */
   * \ingroup xrif2shmim
   */
 
-bool g_timeToDie = false;
+std::atomic<bool> g_timeToDie {false};
 
 void sigTermHandler( int signum,
                      siginfo_t *siginf,
@@ -87,6 +93,16 @@ protected:
 
    double m_fps {10}; ///< The rate, in frames per second, at which to stream images.  Default is 10 fps.
 
+   bool m_stream {false}; ///< If true, frames are decoded ahead into a bounded ring while playing, instead of loading all frames first.
+
+   size_t m_ringLength {64}; ///< The number of decoded frames held in the ring in stream mode.  Default is 64.
+
+   bool m_realTime {false}; ///< If true, stream mode replays frames with the original atime spacing instead of at m_fps.
+
+   double m_maxGap {1.0}; ///< The maximum delay, in seconds, between frames in real-time mode.  Longer gaps (e.g. between archives) are replaced by 1/fps.
+
+   double m_reportInterval {10.0}; ///< The interval, in seconds, at which pacing statistics are reported in stream mode.  0 disables reporting.
+
    ///@}
 
 
@@ -111,6 +127,29 @@ protected:
 
    ///@}
 
+   /** \name Streaming Playback
+     * In stream mode a decode-ahead thread fills a bounded ring of frames, which the main thread
+     * publishes to the stream.  The ring has a single producer and a single consumer, so the slots
+     * between m_ringTail and m_ringHead are owned by the consumer and the rest by the producer.
+     * @{
+     */
+
+   std::vector<char> m_ring; ///< The decoded frame storage, m_ringLength frames.
+
+   std::vector<timespec> m_ringAtime; ///< The original acquisition time of each frame in the ring.
+
+   std::atomic<uint64_t> m_ringHead {0}; ///< The total number of frames written to the ring.
+
+   std::atomic<uint64_t> m_ringTail {0}; ///< The total number of frames read from the ring.
+
+   std::mutex m_ringMutex; ///< Mutex used to wait on ring changes.
+
+   std::condition_variable m_ringCond; ///< Signaled when a frame is written to or read from the ring.
+
+   std::atomic<bool> m_decodeError {false}; ///< Set by the decode thread if it can not continue.
+
+   ///@}
+
 public:
 
    ~xrif2shmim();
@@ -120,6 +159,29 @@ public:
    virtual void loadConfig();
 
    virtual int execute();
+
+protected:
+
+   /// Create the shared memory stream using m_width, m_height, and m_dataType.
+   void createStream();
+
+   /// Publish one frame to the shared memory stream.
+   void publishFrame( const char * src,        ///< [in] the frame data
+                      uint64_t & next_cnt1     ///< [in/out] the slice to write, updated to the next slice
+                    );
+
+   /// Stream frames while decoding ahead into a bounded ring.
+   /**
+     * \returns 0 on success
+     * \returns -1 on an error
+     */
+   int executeStream();
+
+   /// The decode-ahead thread function for stream mode.
+   /** Decodes each file in turn, looping back to the first file at the end, and writes frames
+     * and their acquisition times into the ring.
+     */
+   void decodeThreadExec();
 };
 
 inline
@@ -142,6 +204,12 @@ void xrif2shmim::setupConfig()
    config.add("circBuffLength","L", "circBuffLength" , argType::Required, "", "circBuffLength", false,  "int", "The length of the shared memory circular buffer. Default is 1.");
 
    config.add("fps","F", "fps" , argType::Required, "", "fps", false,  "float", "The rate, in frames per second, at which to stream images. Default is 10 fps.");
+
+   config.add("stream","S", "stream" , argType::True, "", "stream", false,  "bool", "If set or true, frames are decoded while streaming using a bounded ring, rather than loading all frames first.  All frames in the files are played in order, and numFrames and earliest are ignored.");
+   config.add("ringLength","R", "ringLength" , argType::Required, "", "ringLength", false,  "int", "The number of decoded frames held in memory in stream mode. Default is 64.");
+   config.add("realTime","r", "realTime" , argType::True, "", "realTime", false,  "bool", "If set or true, stream mode replays frames with their original atime spacing from the timing data, rather than at fps.");
+   config.add("maxGap","", "maxGap" , argType::Required, "", "maxGap", false,  "float", "The maximum delay, in seconds, between frames in real-time mode.  Longer gaps are replaced by 1/fps. Default is 1.0.");
+   config.add("reportInterval","", "reportInterval" , argType::Required, "", "reportInterval", false,  "float", "The interval, in seconds, at which pacing jitter and underruns are reported in stream mode.  0 disables. Default is 10.");
 }
 
 inline
@@ -154,6 +222,11 @@ void xrif2shmim::loadConfig()
    config(m_shmimName, "shmimName");
    config(m_circBuffLength, "circBuffLength");
    config(m_fps, "fps");
+   config(m_stream, "stream");
+   config(m_ringLength, "ringLength");
+   config(m_realTime, "realTime");
+   config(m_maxGap, "maxGap");
+   config(m_reportInterval, "reportInterval");
 }
 
 inline
@@ -228,6 +301,11 @@ int xrif2shmim::execute()
       return -1;
    }
 
+   if(m_stream)
+   {
+      return executeStream();
+   }
+
    long st = 0;
    long ed = m_files.size();
    int stp = 1;
@@ -350,8 +428,15 @@ int xrif2shmim::execute()
       uint32_t header_size;
       xrif_read_header(m_xrif, &header_size , header);
 
-      xrif_allocate_raw(m_xrif);
-      xrif_allocate_reordered(m_xrif);
+      rv = xrif_allocate_raw(m_xrif);
+      if(rv == XRIF_NOERROR) rv = xrif_allocate_reordered(m_xrif);
+      if(rv != XRIF_NOERROR)
+      {
+         std::cerr << " (" << invokedName << "): Error allocating buffers for " << m_files[n] << "\n";
+         std::cerr << "\t code: " << rv << "\n";
+         fclose(fp_xrif);
+         return -1;
+      }
 
       nr = fread(m_xrif->raw_buffer, 1, m_xrif->compressed_size, fp_xrif);
       fclose(fp_xrif);
@@ -364,7 +449,13 @@ int xrif2shmim::execute()
          return -1;
       }
 
-      xrif_decode(m_xrif);
+      rv = xrif_decode(m_xrif);
+      if(rv != XRIF_NOERROR)
+      {
+         std::cerr << " (" << invokedName << "): Error decoding " << m_files[n] << "\n";
+         std::cerr << "\t code: " << rv << "\n";
+         return -1;
+      }
 
       if(g_timeToDie == true) break; //check after the decompress.
 
@@ -401,7 +492,41 @@ int xrif2shmim::execute()
    m_xrif = nullptr; //This is so destructor doesn't choke
 
    //Now create share memory stream.
+   createStream();
+
+   //Begin streaming
+   uint64_t next_cnt1 = 0;
+
+   findex = 0;
+   double lastSend = mx::sys::get_curr_time();
+   double delta = 0;
+
+   while(g_timeToDie == false)
+   {
+      publishFrame( (char *) m_frames.image(findex).data(), next_cnt1);
+
+      ++findex;
+      if(findex >= m_frames.planes()) findex = 0;
+
+
+      double ct = mx::sys::get_curr_time();
+      delta += 0.1 * (ct-lastSend - 1.0/m_fps);
+      lastSend = ct;
 
+
+      if(1./m_fps - delta > 0) microsleep( (1./m_fps - delta)*1e6 ); //Argument is unsigned, since we can't unsleep, so don't pass a big number by axe.
+   }
+
+   ImageStreamIO_destroyIm( &m_imageStream );
+
+   std::cerr << " (" << invokedName << "): exited normally.\n";
+
+   return 0;
+}
+
+inline
+void xrif2shmim::createStream()
+{
    uint32_t imsize[3];
    imsize[0] = m_width;
    imsize[1] = m_height;
@@ -412,68 +537,372 @@ int xrif2shmim::execute()
    ImageStreamIO_createIm_gpu(&m_imageStream, m_shmimName.c_str(), 3, imsize, m_dataType, -1, 1, IMAGE_NB_SEMAPHORE, 0, CIRCULAR_BUFFER | ZAXIS_TEMPORAL, 0);
 
    m_imageStream.md->cnt1 = m_circBuffLength;
+}
+
+inline
+void xrif2shmim::publishFrame( const char * src,
+                               uint64_t & next_cnt1
+                             )
+{
+   char * next_dest = (char *) m_imageStream.array.raw + next_cnt1*m_width*m_height*m_typeSize;
+
+   m_imageStream.md->write=1;
+
+   memcpy(next_dest, src, m_width*m_height*m_typeSize);
+
+   //Set the time of last write
+   clock_gettime(CLOCK_REALTIME, &m_imageStream.md->writetime);
+   m_imageStream.md->atime = m_imageStream.md->writetime;
+
+   //Update cnt1
+   m_imageStream.md->cnt1 = next_cnt1;
+
+   //Update cnt0
+   m_imageStream.md->cnt0++;
+
+   m_imageStream.writetimearray[next_cnt1] = m_imageStream.md->writetime;
+   m_imageStream.atimearray[next_cnt1] = m_imageStream.md->atime;
+   m_imageStream.cntarray[next_cnt1] = m_imageStream.md->cnt0;
+
+   //And post
+   m_imageStream.md->write=0;
+   ImageStreamIO_sempost(&m_imageStream,-1);
+
+   next_cnt1 = m_imageStream.md->cnt1+1;
+   if(next_cnt1 >= m_circBuffLength) next_cnt1 = 0;
+}
+
+inline
+int xrif2shmim::executeStream()
+{
+   //Get the frame geometry from the first file
+   char header[XRIF_HEADER_SIZE];
+
+   FILE * fp_xrif = fopen(m_files[0].c_str(), "rb");
+   if(fp_xrif == nullptr)
+   {
+      std::cerr << " (" << invokedName << "): Error opening " << m_files[0] << "\n";
+      return -1;
+   }
+   size_t nr = fread(header, 1, XRIF_HEADER_SIZE, fp_xrif);
+   fclose(fp_xrif);
+   if(nr != XRIF_HEADER_SIZE)
+   {
+      std::cerr << " (" << invokedName << "): Error reading header of " << m_files[0] << "\n";
+      return -1;
+   }
+
+   uint32_t header_size;
+   xrif_read_header(m_xrif, &header_size , header);
+
+   m_width = m_xrif->width;
+   m_height = m_xrif->height;
+   m_dataType = m_xrif->type_code;
+   m_typeSize = xrif_typesize(m_dataType);
+
+   xrif_delete(m_xrif);
+   m_xrif = nullptr; //This is so destructor doesn't choke
+
+   if(m_ringLength < 2) m_ringLength = 2;
+
+   size_t frameSize = m_width*m_height*m_typeSize;
+   m_ring.resize(m_ringLength*frameSize);
+   m_ringAtime.resize(m_ringLength);
+   m_ringHead = 0;
+   m_ringTail = 0;
+   m_decodeError = false;
+
+   std::cerr << " (" << invokedName << "): Streaming " << m_files.size() << " file";
+   if(m_files.size() > 1) std::cerr << "s";
+   std::cerr << " through a " << m_ringLength << " frame ring\n";
+
+   std::thread decodeThread(&xrif2shmim::decodeThreadExec, this);
+
+   createStream();
 
-   //Begin streaming
    uint64_t next_cnt1 = 0;
-   char * next_dest = (char *) m_imageStream.array.raw;
-   timespec * next_wtimearr = &m_imageStream.writetimearray[0];
-   timespec * next_atimearr = &m_imageStream.atimearray[0];
-   uint64_t * next_cntarr = &m_imageStream.cntarray[0];
 
-   findex = 0;
-   double lastSend = mx::sys::get_curr_time();
-   double delta = 0;
+   int64_t period = static_cast<int64_t>(1e9/m_fps);
+   int64_t maxGap = static_cast<int64_t>(m_maxGap*1e9);
 
-   while(g_timeToDie == false)
+   //Pacing statistics for the current report interval
+   uint64_t nFrames = 0;
+   uint64_t nUnderruns = 0;
+   uint64_t nLate = 0;
+   double jitSum = 0;
+   double jitSumSq = 0;
+   double jitMax = 0;
+
+   timespec deadline;
+   clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+   timespec lastReport = deadline;
+   timespec lastAtime = {0,0};
+
+   while(g_timeToDie == false && m_decodeError == false)
    {
-      m_imageStream.md->write=1;
+      //Wait for the decode thread if the ring is empty
+      if(m_ringHead == m_ringTail)
+      {
+         if(m_ringTail > 0) ++nUnderruns; //not an underrun while the ring is first filling
 
-      memcpy(next_dest, m_frames.image(findex).data(), m_width*m_height*m_typeSize); 
+         {
+            std::unique_lock<std::mutex> lock(m_ringMutex);
+            while(m_ringHead == m_ringTail && g_timeToDie == false && m_decodeError == false)
+            {
+               m_ringCond.wait_for(lock, std::chrono::milliseconds(100));
+            }
+         }
 
-      //Set the time of last write
-      clock_gettime(CLOCK_REALTIME, &m_imageStream.md->writetime);
-      m_imageStream.md->atime = m_imageStream.md->writetime;
+         if(m_ringHead == m_ringTail) break;
 
-      //Update cnt1
-      m_imageStream.md->cnt1 = next_cnt1;
+         //Don't try to catch up after an underrun
+         clock_gettime(CLOCK_MONOTONIC, &deadline);
+      }
+
+      size_t slot = m_ringTail % m_ringLength;
 
-      //Update cnt0
-      m_imageStream.md->cnt0++;
+      //Determine the deadline for this frame
+      if(m_ringTail > 0)
+      {
+         int64_t gap = period;
 
-      *next_wtimearr = m_imageStream.md->writetime;
-      *next_atimearr = m_imageStream.md->atime;
-      *next_cntarr = m_imageStream.md->cnt0;
+         if(m_realTime && lastAtime.tv_sec != 0 && m_ringAtime[slot].tv_sec != 0)
+         {
+            gap = (m_ringAtime[slot].tv_sec - lastAtime.tv_sec)*1000000000 + (m_ringAtime[slot].tv_nsec - lastAtime.tv_nsec);
+            if(gap < 0 || gap > maxGap) gap = period;
+         }
 
-      //And post
-      m_imageStream.md->write=0;
-      ImageStreamIO_sempost(&m_imageStream,-1);
+         deadline.tv_nsec += gap;
+      }
 
-      //Now we increment pointers outside the time-critical part of the loop.
-      next_cnt1 = m_imageStream.md->cnt1+1;
-      if(next_cnt1 >= m_circBuffLength) next_cnt1 = 0;
+      while(deadline.tv_nsec >= 1000000000)
+      {
+         deadline.tv_nsec -= 1000000000;
+         ++deadline.tv_sec;
+      }
 
-      next_dest = (char *) m_imageStream.array.raw + next_cnt1*m_width*m_height*m_typeSize;
-      next_wtimearr = &m_imageStream.writetimearray[next_cnt1];
-      next_atimearr = &m_imageStream.atimearray[next_cnt1];
-      next_cntarr = &m_imageStream.cntarray[next_cnt1];
+      lastAtime = m_ringAtime[slot];
 
-      ++findex;
-      if(findex >= m_frames.planes()) findex = 0;
+      //Sleep until the absolute deadline, restarting if interrupted by a signal other than a shutdown.
+      while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+      {
+         if(g_timeToDie) break;
+      }
+      if(g_timeToDie) break;
 
+      timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
 
-      double ct = mx::sys::get_curr_time();
-      delta += 0.1 * (ct-lastSend - 1.0/m_fps);
-      lastSend = ct;
+      publishFrame(m_ring.data() + slot*frameSize, next_cnt1);
+
+      {
+         std::lock_guard<std::mutex> lock(m_ringMutex);
+         ++m_ringTail;
+      }
+      m_ringCond.notify_all();
 
+      //Accumulate pacing statistics
+      double jit = (now.tv_sec - deadline.tv_sec) + (now.tv_nsec - deadline.tv_nsec)/1e9;
+      ++nFrames;
+      jitSum += jit;
+      jitSumSq += jit*jit;
+      if(jit > jitMax) jitMax = jit;
 
-      if(1./m_fps - delta > 0) microsleep( (1./m_fps - delta)*1e6 ); //Argument is unsigned, since we can't unsleep, so don't pass a big number by axe.
+      //If we're more than a period behind, resync rather than bursting to catch up
+      if(jit*1e9 > period)
+      {
+         ++nLate;
+         deadline = now;
+      }
+
+      double dt = (now.tv_sec - lastReport.tv_sec) + (now.tv_nsec - lastReport.tv_nsec)/1e9;
+      if(m_reportInterval > 0 && dt >= m_reportInterval)
+      {
+         double jitMean = jitSum/nFrames;
+         double jitRMS = sqrt(jitSumSq/nFrames - jitMean*jitMean);
+
+         std::cerr << " (" << invokedName << "): " << nFrames/dt << " fps";
+         std::cerr << "  jitter mean/rms/max: " << jitMean*1e6 << "/" << jitRMS*1e6 << "/" << jitMax*1e6 << " us";
+         std::cerr << "  late: " << nLate << "  underruns: " << nUnderruns << "\n";
+
+         nFrames = 0;
+         nUnderruns = 0;
+         nLate = 0;
+         jitSum = 0;
+         jitSumSq = 0;
+         jitMax = 0;
+         lastReport = now;
+      }
    }
 
+   g_timeToDie = true; //signal the decode thread
+   m_ringCond.notify_all();
+   decodeThread.join();
+
    ImageStreamIO_destroyIm( &m_imageStream );
 
+   if(m_decodeError)
+   {
+      std::cerr << " (" << invokedName << "): exiting on decode error.\n";
+      return -1;
+   }
+
    std::cerr << " (" << invokedName << "): exited normally.\n";
 
    return 0;
 }
 
+inline
+void xrif2shmim::decodeThreadExec()
+{
+   xrif_t xrif {nullptr};
+   xrif_t xrif_timing {nullptr};
+
+   if(xrif_new(&xrif) < 0 || xrif_new(&xrif_timing) < 0)
+   {
+      std::cerr << " (" << invokedName << "): Error allocating xrif.\n";
+      if(xrif) xrif_delete(xrif);
+      m_decodeError = true;
+      m_ringCond.notify_all();
+      return;
+   }
+
+   char header[XRIF_HEADER_SIZE];
+   size_t frameSize = m_width*m_height*m_typeSize;
+
+   size_t n = 0;
+   while(g_timeToDie == false)
+   {
+      FILE * fp_xrif = fopen(m_files[n].c_str(), "rb");
+      if(fp_xrif == nullptr)
+      {
+         std::cerr << " (" << invokedName << "): Error opening " << m_files[n] << "\n";
+         m_decodeError = true;
+         break;
+      }
+
+      size_t nr = fread(header, 1, XRIF_HEADER_SIZE, fp_xrif);
+      if(nr != XRIF_HEADER_SIZE)
+      {
+         std::cerr << " (" << invokedName << "): Error reading header of " << m_files[n] << "\n";
+         fclose(fp_xrif);
+         m_decodeError = true;
+         break;
+      }
+
+      uint32_t header_size;
+      xrif_read_header(xrif, &header_size , header);
+
+      if(xrif->width != m_width || xrif->height != m_height || xrif->type_code != m_dataType || xrif->depth != 1)
+      {
+         std::cerr << " (" << invokedName << "): format mis-match in " << m_files[n] << "\n";
+         fclose(fp_xrif);
+         m_decodeError = true;
+         break;
+      }
+
+      xrif_error_t rv = xrif_allocate_raw(xrif);
+      if(rv == XRIF_NOERROR) rv = xrif_allocate_reordered(xrif);
+      if(rv != XRIF_NOERROR)
+      {
+         std::cerr << " (" << invokedName << "): Error allocating buffers for " << m_files[n] << "\n";
+         std::cerr << "\t code: " << rv << "\n";
+         fclose(fp_xrif);
+         m_decodeError = true;
+         break;
+      }
+
+      nr = fread(xrif->raw_buffer, 1, xrif->compressed_size, fp_xrif);
+      if(nr != xrif->compressed_size)
+      {
+         std::cerr << " (" << invokedName << "): Error reading data from " << m_files[n] << "\n";
+         fclose(fp_xrif);
+         m_decodeError = true;
+         break;
+      }
+
+      //The timing data is only needed for real-time pacing
+      bool haveTiming = false;
+      if(m_realTime)
+      {
+         nr = fread(header, 1, XRIF_HEADER_SIZE, fp_xrif);
+         if(nr == XRIF_HEADER_SIZE)
+         {
+            xrif_read_header(xrif_timing, &header_size , header);
+
+            if(xrif_allocate_raw(xrif_timing) == XRIF_NOERROR && xrif_allocate_reordered(xrif_timing) == XRIF_NOERROR)
+            {
+               nr = fread(xrif_timing->raw_buffer, 1, xrif_timing->compressed_size, fp_xrif);
+               if(nr == xrif_timing->compressed_size && xrif_decode(xrif_timing) == XRIF_NOERROR && xrif_timing->frames == xrif->frames)
+               {
+                  haveTiming = true;
+               }
+            }
+         }
+
+         if(!haveTiming)
+         {
+            std::cerr << " (" << invokedName << "): no timing data in " << m_files[n] << ", using fps\n";
+         }
+      }
+      fclose(fp_xrif);
+
+      if(g_timeToDie == true) break; //check after the long read.
+
+      rv = xrif_decode(xrif);
+      if(rv != XRIF_NOERROR)
+      {
+         std::cerr << " (" << invokedName << "): Error decoding " << m_files[n] << "\n";
+         std::cerr << "\t code: " << rv << "\n";
+         m_decodeError = true;
+         break;
+      }
+
+      for(xrif_dimension_t q = 0; q < xrif->frames; ++q)
+      {
+         //Wait for a free slot
+         if(m_ringHead - m_ringTail >= m_ringLength)
+         {
+            std::unique_lock<std::mutex> lock(m_ringMutex);
+            while(m_ringHead - m_ringTail >= m_ringLength && g_timeToDie == false)
+            {
+               m_ringCond.wait_for(lock, std::chrono::milliseconds(100));
+            }
+         }
+         if(g_timeToDie == true) break;
+
+         size_t slot = m_ringHead % m_ringLength;
+
+         memcpy(m_ring.data() + slot*frameSize, xrif->raw_buffer + q*frameSize, frameSize);
+
+         if(haveTiming)
+         {
+            uint64_t * curr_timing = (uint64_t*) xrif_timing->raw_buffer + 5*q;
+            m_ringAtime[slot].tv_sec = curr_timing[1];
+            m_ringAtime[slot].tv_nsec = curr_timing[2];
+         }
+         else
+         {
+            m_ringAtime[slot] = {0,0};
+         }
+
+         {
+            std::lock_guard<std::mutex> lock(m_ringMutex);
+            ++m_ringHead;
+         }
+         m_ringCond.notify_all();
+      }
+
+      ++n;
+      if(n >= m_files.size()) n = 0;
+   }
+
+   //Wake the publisher, so it sees an error without waiting out its timeout
+   m_ringCond.notify_all();
+
+   xrif_delete(xrif);
+   xrif_delete(xrif_timing);
+}
+
 #endif //xrif2shmim_hpp